@@ -0,0 +1,408 @@
+// Throughput and latency of the primitives in base.h and ring_buffer.h:
+// arena allocation, growing arrays, linked lists, binary search, the ring
+// buffer within one thread and across two, and the slab cache under
+// contention.
+//
+// Usage: prock_core_bench [--json] [--filter TEXT] [--min-time S]
+//
+// --json prints one object for tracking regressions between commits:
+//   {"context":{...},"benchmarks":[{"name":"arena_alloc/size:64/align:8",
+//    "ns_per_op":1.9,"min_ns_per_op":1.8,"mops":520.1}, ...]}
+// Benchmarks run for --min-time seconds (default 0.2) split into
+// repetitions, ns_per_op is the median and min_ns_per_op the best of them.
+
+#include "base.h"
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t REPETITIONS = 5;
+constexpr size_t ARENA_ALLOCS = 4096;
+
+volatile size_t g_sink; // keeps results from being optimized away
+double g_min_time = 0.2;
+const char *g_filter = nullptr;
+bool g_json = false;
+bool g_first_result = true;
+
+struct Result {
+  char name[96];
+  double ns_per_op;
+  double min_ns_per_op;
+  // Of cross-thread benchmarks, 0 otherwise
+  double p50_ns;
+  double p99_ns;
+};
+
+double now_ns() {
+  return std::chrono::duration<double, std::nano>(
+             SteadyClock::now().time_since_epoch())
+      .count();
+}
+
+bool selected(const char *name) {
+  return !g_filter || strstr(name, g_filter) != nullptr;
+}
+
+void print_header() {
+  if (g_json) {
+    printf("{\"context\":{\"cpus\":%u,\"min_time\":%g},\"benchmarks\":[",
+           std::thread::hardware_concurrency(), g_min_time);
+  } else {
+    printf("%-40s %12s %12s %10s %10s %10s\n", "benchmark", "ns/op",
+           "min ns/op", "Mops/s", "p50 ns", "p99 ns");
+  }
+}
+
+void print_result(const Result &result) {
+  const double mops = 1e3 / result.ns_per_op;
+  if (g_json) {
+    printf("%s\n{\"name\":\"%s\",\"ns_per_op\":%.3f,\"min_ns_per_op\":%.3f,"
+           "\"mops\":%.3f",
+           g_first_result ? "" : ",", result.name, result.ns_per_op,
+           result.min_ns_per_op, mops);
+    if (result.p99_ns > 0) {
+      printf(",\"p50_ns\":%.1f,\"p99_ns\":%.1f", result.p50_ns,
+             result.p99_ns);
+    }
+    printf("}");
+  } else {
+    printf("%-40s %12.3f %12.3f %10.1f", result.name, result.ns_per_op,
+           result.min_ns_per_op, mops);
+    if (result.p99_ns > 0) {
+      printf(" %10.1f %10.1f", result.p50_ns, result.p99_ns);
+    }
+    printf("\n");
+  }
+  g_first_result = false;
+  fflush(stdout);
+}
+
+void print_footer() {
+  if (g_json) printf("\n]}\n");
+}
+
+// Runs `batch(ops)` in repetitions of about min_time / REPETITIONS, `ops`
+// grows until a repetition is long enough and is a multiple of `step`.
+// `batch` returns a checksum.
+template <class F> void run(const char *name, F batch, const size_t step = 1) {
+  if (!selected(name)) return;
+  const double target_ns = g_min_time * 1e9 / REPETITIONS;
+  size_t ops = step;
+  for (;;) {
+    const double start = now_ns();
+    g_sink = g_sink + batch(ops);
+    const double elapsed = now_ns() - start;
+    if (elapsed >= target_ns / 4 || ops >= (size_t{1} << 40)) {
+      const double scale = std::max(1.0, target_ns / elapsed);
+      ops = std::max<size_t>(static_cast<size_t>(ops * scale) / step, 1) * step;
+      break;
+    }
+    ops *= 8;
+  }
+
+  double per_op[REPETITIONS];
+  for (double &ns : per_op) {
+    const double start = now_ns();
+    g_sink = g_sink + batch(ops);
+    ns = (now_ns() - start) / ops;
+  }
+  std::sort(per_op, per_op + REPETITIONS);
+  Result result = {};
+  snprintf(result.name, sizeof(result.name), "%s", name);
+  result.ns_per_op = per_op[REPETITIONS / 2];
+  result.min_ns_per_op = per_op[0];
+  print_result(result);
+}
+
+void bench_arena() {
+  const size_t sizes[] = {8, 64, 512, 4096};
+  const size_t alignments[] = {1, 8, 64};
+  for (const size_t size : sizes) {
+    for (const size_t alignment : alignments) {
+      char name[96];
+      snprintf(name, sizeof(name), "arena_alloc/size:%zu/align:%zu", size,
+               alignment);
+      // Arenas live for one update, ARENA_ALLOCS allocations each
+      run(
+          name,
+          [size, alignment](const size_t ops) {
+            size_t res = 0;
+            for (size_t done = 0; done < ops; done += ARENA_ALLOCS) {
+              BumpArena arena = BumpArena::create();
+              for (size_t i = 0; i < ARENA_ALLOCS; ++i) {
+                res += reinterpret_cast<uintptr_t>(
+                    arena.alloc_raw(size, alignment));
+              }
+              arena.destroy();
+            }
+            return res;
+          },
+          ARENA_ALLOCS);
+    }
+  }
+}
+
+void bench_growing_array() {
+  const size_t sizes[] = {16, 1024, 65536, 1 << 20};
+  for (const size_t n : sizes) {
+    char name[96];
+    snprintf(name, sizeof(name), "growing_array_emplace_back/n:%zu", n);
+    run(
+        name,
+        [n](const size_t ops) {
+          size_t res = 0;
+          for (size_t done = 0; done < ops; done += n) {
+            BumpArena arena = BumpArena::create();
+            GrowingArray<ulong> array = {};
+            size_t wasted = 0;
+            for (size_t i = 0; i < n; ++i) {
+              *array.emplace_back(arena, wasted) = i;
+            }
+            res += array.size() + wasted;
+            arena.destroy();
+          }
+          return res;
+        },
+        n);
+  }
+}
+
+void bench_linked_list() {
+  const size_t sizes[] = {16, 1024, 65536, 1 << 20};
+  for (const size_t n : sizes) {
+    char name[96];
+    snprintf(name, sizeof(name), "linked_list_emplace_walk/n:%zu", n);
+    // Both the build and the walk of read_all_processes
+    run(
+        name,
+        [n](const size_t ops) {
+          size_t res = 0;
+          for (size_t done = 0; done < ops; done += n) {
+            BumpArena arena = BumpArena::create();
+            LinkedList<long> list = {};
+            for (size_t i = 0; i < n; ++i) {
+              *list.emplace_front(arena) = static_cast<long>(i);
+            }
+            for (const LinkedNode<long> *it = list.head; it; it = it->next) {
+              res += it->value;
+            }
+            arena.destroy();
+          }
+          return res;
+        },
+        n);
+  }
+}
+
+void bench_search() {
+  const size_t sizes[] = {16, 1024, 65536, 1 << 20};
+  for (const size_t n : sizes) {
+    std::vector<ulong> sorted(n);
+    for (size_t i = 0; i < n; ++i) {
+      sorted[i] = 3 * i + 1; // pids and inodes have gaps
+    }
+    // Random keys, half of them missing
+    std::vector<ulong> keys(4096);
+    ulong state = 88172645463325252ul;
+    for (ulong &key : keys) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      key = state % (3 * n);
+    }
+    const auto get = [&sorted](const size_t i) { return sorted[i]; };
+
+    char name[96];
+    snprintf(name, sizeof(name), "lower_bound/n:%zu", n);
+    run(name, [&](const size_t ops) {
+      size_t res = 0;
+      for (size_t i = 0; i < ops; ++i) {
+        res += lower_bound(n, get, keys[i % keys.size()]);
+      }
+      return res;
+    });
+    snprintf(name, sizeof(name), "bin_search_exact/n:%zu", n);
+    run(name, [&](const size_t ops) {
+      size_t res = 0;
+      for (size_t i = 0; i < ops; ++i) {
+        res += bin_search_exact(n, get, keys[i % keys.size()]);
+      }
+      return res;
+    });
+  }
+}
+
+struct Stamp {
+  double sent_ns;
+  size_t seq;
+};
+
+void bench_ring_buffer_single() {
+  run("ring_buffer_push_pop/threads:1", [](const size_t ops) {
+    static RingBuffer<Stamp, 256> ring = {};
+    size_t res = 0;
+    Stamp stamp = {};
+    for (size_t i = 0; i < ops; ++i) {
+      ring.push({0, i});
+      ring.pop(stamp);
+      res += stamp.seq;
+    }
+    return res;
+  });
+}
+
+// Producer and consumer on their own threads, like gathering and the UI.
+// Spinning threads yield, a core may run both of them.
+template <class T> void push_spinning(RingBuffer<T, 256> &ring, const T &item) {
+  while (!ring.push(item)) {
+    std::this_thread::yield();
+  }
+}
+
+template <class T> T pop_spinning(RingBuffer<T, 256> &ring) {
+  T res;
+  while (!ring.pop(res)) {
+    std::this_thread::yield();
+  }
+  return res;
+}
+
+// A full ring all the time, ns_per_op is the time between two pops
+void bench_ring_buffer_throughput() {
+  const char *name = "ring_buffer_throughput/threads:2";
+  if (!selected(name)) return;
+  static RingBuffer<Stamp, 256> ring = {};
+  const double deadline = now_ns() + g_min_time * 1e9;
+  std::thread producer{[deadline] {
+    for (size_t i = 0;; ++i) {
+      const bool last = now_ns() > deadline;
+      push_spinning(ring, Stamp{0, last ? SIZE_MAX : i});
+      if (last) return;
+    }
+  }};
+  const double start = now_ns();
+  size_t received = 0;
+  while (pop_spinning(ring).seq != SIZE_MAX) {
+    ++received;
+  }
+  const double elapsed = now_ns() - start;
+  producer.join();
+
+  Result result = {};
+  snprintf(result.name, sizeof(result.name), "%s", name);
+  result.ns_per_op = elapsed / std::max<size_t>(received, 1);
+  result.min_ns_per_op = result.ns_per_op;
+  print_result(result);
+}
+
+// One item in flight, bounced back on a second ring. Latency is half of the
+// round trip.
+void bench_ring_buffer_latency() {
+  const char *name = "ring_buffer_latency/threads:2";
+  if (!selected(name)) return;
+  static RingBuffer<Stamp, 256> ping = {};
+  static RingBuffer<Stamp, 256> pong = {};
+  std::thread echo{[] {
+    for (;;) {
+      const Stamp stamp = pop_spinning(ping);
+      push_spinning(pong, stamp);
+      if (stamp.seq == SIZE_MAX) return;
+    }
+  }};
+  std::vector<float> latencies;
+  const double deadline = now_ns() + g_min_time * 1e9;
+  while (now_ns() < deadline) {
+    const double sent = now_ns();
+    push_spinning(ping, Stamp{sent, latencies.size()});
+    pop_spinning(pong);
+    latencies.push_back(static_cast<float>((now_ns() - sent) / 2));
+  }
+  push_spinning(ping, Stamp{0, SIZE_MAX});
+  pop_spinning(pong);
+  echo.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  double total = 0;
+  for (const float latency : latencies) {
+    total += latency;
+  }
+  const size_t count = std::max<size_t>(latencies.size(), 1);
+  latencies.resize(count);
+  Result result = {};
+  snprintf(result.name, sizeof(result.name), "%s", name);
+  result.ns_per_op = total / count;
+  result.min_ns_per_op = latencies[0];
+  result.p50_ns = latencies[count / 2];
+  result.p99_ns = latencies[count * 99 / 100];
+  print_result(result);
+}
+
+// Every thread creates and releases arenas of one slab, the cache is shared
+void bench_slab_cache() {
+  for (const unsigned threads : {1u, 2u, 4u, 8u}) {
+    char name[96];
+    snprintf(name, sizeof(name), "slab_cache_create_release/threads:%u",
+             threads);
+    run(name, [threads](const size_t ops) {
+      std::atomic<size_t> res{0};
+      std::vector<std::thread> workers;
+      const size_t per_thread = std::max<size_t>(ops / threads, 1);
+      for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([per_thread, &res] {
+          size_t sum = 0;
+          for (size_t i = 0; i < per_thread; ++i) {
+            ArenaSlab *slab = ArenaSlab::create(SLAB_SIZE);
+            if (!slab) std::abort();
+            sum += slab->left_size;
+            ArenaSlab::release(slab);
+          }
+          res += sum;
+        });
+      }
+      for (std::thread &worker : workers) {
+        worker.join();
+      }
+      return res.load();
+    });
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0) {
+      g_json = true;
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      g_filter = argv[++i];
+    } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+      g_min_time = strtod(argv[++i], nullptr);
+    } else {
+      fprintf(stderr, "Usage: %s [--json] [--filter TEXT] [--min-time S]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  print_header();
+  bench_arena();
+  bench_growing_array();
+  bench_linked_list();
+  bench_search();
+  bench_ring_buffer_single();
+  bench_ring_buffer_throughput();
+  bench_ring_buffer_latency();
+  bench_slab_cache();
+  print_footer();
+  return 0;
+}
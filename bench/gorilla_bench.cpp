@@ -0,0 +1,194 @@
+// Compression ratio and decode throughput of Gorilla blocks on real traces.
+//
+// Usage: prock_gorilla_bench [--samples N] [--period-ms P] [trace files...]
+//
+// Trace files hold one "time value" pair per line (seconds since epoch and
+// the value). Without files the system CPU usage and available memory are
+// recorded from /proc for N samples, P milliseconds apart.
+
+#include "base.h"
+#include "gorilla.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+volatile double g_sink; // keeps decoding from being optimized away
+
+struct Trace {
+  const char *name;
+  std::vector<double> times;
+  std::vector<float> values;
+};
+
+double now_secs() {
+  return std::chrono::duration_cast<Seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+bool read_cpu_ticks(ulonglong &busy, ulonglong &total) {
+  FILE *f = fopen("/proc/stat", "r");
+  if (!f) return false;
+  ulonglong v[8] = {};
+  const int n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0],
+                       &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+  fclose(f);
+  if (n < 4) return false;
+  total = 0;
+  for (const ulonglong t : v) {
+    total += t;
+  }
+  busy = total - v[3] - v[4]; // without idle and iowait
+  return true;
+}
+
+bool read_mem_available(ulonglong &kb) {
+  FILE *f = fopen("/proc/meminfo", "r");
+  if (!f) return false;
+  char line[256];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), f)) {
+    found = sscanf(line, "MemAvailable: %llu kB", &kb) == 1;
+  }
+  fclose(f);
+  return found;
+}
+
+void record_system(const size_t samples, const int period_ms, Trace &cpu,
+                   Trace &mem) {
+  ulonglong prev_busy = 0;
+  ulonglong prev_total = 0;
+  read_cpu_ticks(prev_busy, prev_total);
+  for (size_t i = 0; i < samples; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(period_ms));
+    const double at = now_secs();
+
+    ulonglong busy = 0;
+    ulonglong total = 0;
+    ulonglong mem_kb = 0;
+    if (!read_cpu_ticks(busy, total) || !read_mem_available(mem_kb)) {
+      fprintf(stderr, "failed to read /proc\n");
+      exit(1);
+    }
+    const ulonglong dt = total - prev_total;
+    const double perc = dt > 0 ? 100.0 * (busy - prev_busy) / dt : 0;
+    prev_busy = busy;
+    prev_total = total;
+
+    cpu.times.push_back(at);
+    cpu.values.push_back(static_cast<float>(perc));
+    mem.times.push_back(at);
+    mem.values.push_back(static_cast<float>(mem_kb));
+  }
+}
+
+bool load_trace(const char *path, Trace &trace) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  trace.name = path;
+  double time;
+  double value;
+  while (fscanf(f, "%lf %lf", &time, &value) == 2) {
+    trace.times.push_back(time);
+    trace.values.push_back(static_cast<float>(value));
+  }
+  fclose(f);
+  return true;
+}
+
+void bench_trace(const Trace &trace) {
+  GorillaArray<double> times = {};
+  GorillaArray<float> values = {};
+  for (size_t i = 0; i < trace.times.size(); ++i) {
+    *times.emplace_back() = std::round(trace.times[i] * 1000) / 1000;
+    *values.emplace_back() = trace.values[i];
+  }
+
+  // Only full blocks are encoded, the open one stays as it is
+  const size_t encoded = times.blocks.size() * GORILLA_BLOCK;
+  if (encoded == 0) {
+    printf("%-24s not enough samples for a block (%zu)\n", trace.name,
+           GORILLA_BLOCK);
+    times.destroy();
+    values.destroy();
+    return;
+  }
+  const size_t time_bytes = times.encoded_byte_size();
+  const size_t value_bytes = values.encoded_byte_size();
+  const double plain_bytes = encoded * 16.0; // (double time, double value)
+
+  double decoded_times[GORILLA_BLOCK];
+  float decoded_values[GORILLA_BLOCK];
+  double checksum = 0;
+  size_t decoded = 0;
+  const auto start = std::chrono::steady_clock::now();
+  Seconds elapsed{};
+  while (elapsed.count() < 0.25) {
+    for (size_t b = times.blocks.begin(); b < times.blocks.size(); ++b) {
+      const GorillaBlock &t = times.blocks[b];
+      const GorillaBlock &v = values.blocks[b];
+      gorilla_decode(reinterpret_cast<const uint8_t *>(t.slab) + t.offset,
+                     decoded_times);
+      gorilla_decode(reinterpret_cast<const uint8_t *>(v.slab) + v.offset,
+                     decoded_values);
+      checksum += decoded_times[b % GORILLA_BLOCK] +
+                  decoded_values[b % GORILLA_BLOCK];
+    }
+    decoded += encoded;
+    elapsed = std::chrono::steady_clock::now() - start;
+  }
+
+  printf("%-24s %8zu samples  time %5.2f bits  value %5.2f bits  "
+         "ratio %5.1fx  decode %7.1f M samples/s\n",
+         trace.name, encoded, time_bytes * 8.0 / encoded,
+         value_bytes * 8.0 / encoded, plain_bytes / (time_bytes + value_bytes),
+         decoded / elapsed.count() / 1e6);
+  g_sink = checksum;
+
+  times.destroy();
+  values.destroy();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t samples = 2400;
+  int period_ms = 5;
+  std::vector<Trace> traces;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      samples = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc) {
+      period_ms = atoi(argv[++i]);
+    } else {
+      Trace trace = {};
+      if (!load_trace(argv[i], trace)) {
+        fprintf(stderr, "failed to read %s\n", argv[i]);
+        return 1;
+      }
+      traces.push_back(std::move(trace));
+    }
+  }
+
+  if (traces.empty()) {
+    Trace cpu = {"system cpu %", {}, {}};
+    Trace mem = {"mem available kb", {}, {}};
+    printf("Recording %zu samples every %d ms...\n", samples, period_ms);
+    record_system(samples, period_ms, cpu, mem);
+    traces.push_back(std::move(cpu));
+    traces.push_back(std::move(mem));
+  }
+
+  for (const Trace &trace : traces) {
+    bench_trace(trace);
+  }
+  return 0;
+}
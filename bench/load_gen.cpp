@@ -0,0 +1,427 @@
+// Puts the machine under the process populations prock has to keep up with
+// and measures gathering meanwhile, without root.
+//
+// Usage: prock_load [--spawn-rate N] [--spawn-life MS] [--threads N]
+//                   [--sockets N] [--depth N] [--env-kb N] [--maps N]
+//                   [--period S] [--duration S] [--watch PID]
+//
+// Populations, 0 turns one off:
+// --spawn-rate  short-lived processes started per second (default 1000),
+//               each living --spawn-life ms (default 10)
+// --threads     one process with that many threads (default 10000)
+// --sockets     one process with that many open unix sockets (default
+//               100000, capped by the hard RLIMIT_NOFILE)
+// --depth       chain of processes, each the parent of the next (default 500)
+// --env-kb      one process with an environment of that size (default 1024)
+// --maps        one process with that many file mappings (default 10000)
+//
+// Meanwhile the same gather() as prock runs every --period seconds (default
+// 0.5) for --duration seconds (default 10) and watches the threads of the
+// thread population. Reported: gather latency percentiles, the share of
+// periods missed because a gather ran past the next one, and the CPU and
+// RSS of the gathering, also of --watch PID (e.g. a running prock) if given.
+//
+// All populations share one process group and die with this process.
+
+#include "base.h"
+#include "sources/process_stat.h"
+#include "sources/sync.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Unity build, like prock_bench
+#include "base.cpp"
+#include "self_stats.cpp"
+#include "sources/process_stat.cpp"
+#include "sources/snapshot_codec.cpp"
+#include "sources/snapshot_file.cpp"
+
+namespace {
+
+constexpr const char *HOLD_ARG = "--hold"; // re-executed environment holder
+constexpr size_t ENV_ENTRY_SIZE = 1024;
+
+struct Options {
+  size_t spawn_rate;
+  size_t spawn_life_ms;
+  size_t threads;
+  size_t sockets;
+  size_t depth;
+  size_t env_kb;
+  size_t maps;
+  double period;
+  double duration;
+  int watch_pid;
+};
+
+Sync g_sync;
+pid_t g_group;                      // process group of all populations
+volatile sig_atomic_t g_interrupted; // SIGINT / SIGTERM
+
+void on_interrupt(int) { g_interrupted = 1; }
+
+[[noreturn]] void hold() {
+  for (;;) {
+    pause();
+  }
+}
+
+double now_secs() {
+  return std::chrono::duration<double>(SteadyClock::now().time_since_epoch())
+      .count();
+}
+
+// Forks a population into the shared process group, it dies with its parent
+template <class F> pid_t start(const char *name, F body) {
+  const pid_t parent = getpid();
+  const pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "%s: fork: %s\n", name, strerror(errno));
+    return 0;
+  }
+  if (pid == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) _exit(0);
+    setpgid(0, g_group);
+    body();
+    _exit(0);
+  }
+  // Also from the parent, so the group exists before the next fork
+  setpgid(pid, g_group);
+  if (g_group == 0) g_group = pid;
+  return pid;
+}
+
+void spawn_short_lived(const Options &options) {
+  signal(SIGCHLD, SIG_IGN); // reaped by the kernel
+  const double start_at = now_secs();
+  size_t spawned = 0;
+  for (;;) {
+    const size_t due =
+        static_cast<size_t>((now_secs() - start_at) * options.spawn_rate);
+    for (; spawned < due; ++spawned) {
+      const pid_t pid = fork();
+      if (pid == 0) {
+        usleep(static_cast<useconds_t>(options.spawn_life_ms * 1000));
+        _exit(0);
+      }
+    }
+    usleep(1000);
+  }
+}
+
+void *blocked_thread(void *) {
+  hold();
+}
+
+void run_threads(const size_t count) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN);
+  size_t started = 1; // the main thread
+  for (; started < count; ++started) {
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, blocked_thread, nullptr) != 0) {
+      fprintf(stderr, "threads: stopped at %zu: %s\n", started,
+              strerror(errno));
+      break;
+    }
+  }
+  pthread_attr_destroy(&attr);
+  hold();
+}
+
+void open_sockets(size_t count) {
+  constexpr rlim_t SPARE_FDS = 64;
+  rlimit limit = {};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  if (count + SPARE_FDS > limit.rlim_max) {
+    count = limit.rlim_max > SPARE_FDS ? limit.rlim_max - SPARE_FDS : 0;
+    fprintf(stderr, "sockets: capped at %zu by RLIMIT_NOFILE\n", count);
+  }
+  limit.rlim_cur = count + SPARE_FDS;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  size_t opened = 0;
+  for (; opened + 2 <= count; opened += 2) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      fprintf(stderr, "sockets: stopped at %zu: %s\n", opened,
+              strerror(errno));
+      break;
+    }
+  }
+  hold();
+}
+
+void fork_chain(const size_t depth) {
+  for (size_t level = 1; level < depth; ++level) {
+    const pid_t parent = getpid();
+    const pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "depth: stopped at %zu: %s\n", level, strerror(errno));
+      break;
+    }
+    if (pid > 0) hold();
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) _exit(0);
+  }
+  hold();
+}
+
+// /proc/[pid]/environ shows the environment given to execve, so the holder
+// is this binary executed again with a large one
+void exec_with_environment(const size_t kb) {
+  std::vector<std::vector<char>> entries(kb * 1024 / ENV_ENTRY_SIZE);
+  std::vector<char *> envp;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    std::vector<char> &entry = entries[i];
+    entry.assign(ENV_ENTRY_SIZE, 'x');
+    snprintf(entry.data(), entry.size(), "PROCK_LOAD_%zu=", i);
+    entry[strlen(entry.data())] = 'x';
+    entry.back() = '\0';
+    envp.push_back(entry.data());
+  }
+  envp.push_back(nullptr);
+  char *argv[] = {const_cast<char *>("prock_load"),
+                  const_cast<char *>(HOLD_ARG), nullptr};
+  execve("/proc/self/exe", argv, envp.data());
+  fprintf(stderr, "env: execve: %s\n", strerror(errno));
+}
+
+// Separate mappings of one page of a deleted file, none of them can merge
+void map_file(const size_t count) {
+  char path[] = "/tmp/prock-load-XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    fprintf(stderr, "maps: mkstemp: %s\n", strerror(errno));
+    return;
+  }
+  unlink(path);
+  const long page = sysconf(_SC_PAGESIZE);
+  if (ftruncate(fd, page) != 0) {
+    fprintf(stderr, "maps: ftruncate: %s\n", strerror(errno));
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (mmap(nullptr, page, PROT_READ, MAP_SHARED, fd, 0) == MAP_FAILED) {
+      fprintf(stderr, "maps: stopped at %zu: %s\n", i, strerror(errno));
+      break;
+    }
+  }
+  hold();
+}
+
+struct Usage {
+  double cpu_secs;
+  size_t rss_kb;
+};
+
+// CPU time and resident memory of `pid`, 0 for this process
+bool read_usage(const int pid, Usage &out) {
+  char path[PROC_PATH_SIZE];
+  if (pid == 0) {
+    snprintf(path, sizeof(path), "/proc/self/stat");
+  } else {
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  }
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char buf[1024] = {};
+  const size_t size = fread(buf, 1, sizeof(buf) - 1, file);
+  fclose(file);
+  buf[size] = '\0';
+  // Fields after the comm, which may contain spaces
+  const char *it = strrchr(buf, ')');
+  unsigned long utime = 0;
+  unsigned long stime = 0;
+  long rss = 0;
+  if (!it || sscanf(it + 2,
+                    "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu "
+                    "%*d %*d %*d %*d %*d %*d %*u %*u %ld",
+                    &utime, &stime, &rss) != 3) {
+    return false;
+  }
+  out.cpu_secs = static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+  out.rss_kb = static_cast<size_t>(rss) * sysconf(_SC_PAGESIZE) / 1024;
+  return true;
+}
+
+void start_populations(const Options &options, int &threads_pid) {
+  start("group", hold);
+  if (options.spawn_rate > 0) {
+    start("spawn", [&options] { spawn_short_lived(options); });
+  }
+  if (options.threads > 0) {
+    threads_pid =
+        start("threads", [&options] { run_threads(options.threads); });
+  }
+  if (options.sockets > 0) {
+    start("sockets", [&options] { open_sockets(options.sockets); });
+  }
+  if (options.depth > 0) {
+    start("depth", [&options] { fork_chain(options.depth); });
+  }
+  if (options.env_kb > 0) {
+    start("env", [&options] { exec_with_environment(options.env_kb); });
+  }
+  if (options.maps > 0) {
+    start("maps", [&options] { map_file(options.maps); });
+  }
+}
+
+bool parse_args(Options &options, const int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) return false;
+    ++i;
+    if (strcmp(arg, "--spawn-rate") == 0) {
+      options.spawn_rate = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--spawn-life") == 0) {
+      options.spawn_life_ms = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--threads") == 0) {
+      options.threads = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--sockets") == 0) {
+      options.sockets = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--depth") == 0) {
+      options.depth = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--env-kb") == 0) {
+      options.env_kb = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--maps") == 0) {
+      options.maps = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--period") == 0) {
+      options.period = std::max(strtod(value, nullptr), 0.001);
+    } else if (strcmp(arg, "--duration") == 0) {
+      options.duration = std::max(strtod(value, nullptr), 0.0);
+    } else if (strcmp(arg, "--watch") == 0) {
+      options.watch_pid = atoi(value);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+double percentile(const std::vector<double> &sorted, const double p) {
+  return sorted[std::min(sorted.size() - 1,
+                         static_cast<size_t>(p * sorted.size()))];
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], HOLD_ARG) == 0) hold();
+
+  Options options = {1000, 10, 10000, 100000, 500, 1024, 10000, 0.5, 10, 0};
+  if (!parse_args(options, argc, argv)) {
+    fprintf(stderr,
+            "Usage: %s [--spawn-rate N] [--spawn-life MS] [--threads N]\n"
+            "          [--sockets N] [--depth N] [--env-kb N] [--maps N]\n"
+            "          [--period S] [--duration S] [--watch PID]\n",
+            argv[0]);
+    return 1;
+  }
+  signal(SIGINT, on_interrupt);
+  signal(SIGTERM, on_interrupt);
+
+  int threads_pid = 0;
+  start_populations(options, threads_pid);
+  // Let the populations reach their size before measuring
+  sleep(1);
+
+  Sync &sync = g_sync;
+  sync.update_period.store(1e-6f); // gather() must not wait, we schedule
+  if (threads_pid > 0) {
+    sync.watched_pids[0].store(threads_pid);
+    sync.watched_pids_count.store(1);
+  }
+
+  Usage own_start = {};
+  Usage watched_start = {};
+  Usage watched_end = {};
+  read_usage(0, own_start);
+  const bool watching =
+      options.watch_pid > 0 && read_usage(options.watch_pid, watched_start);
+  size_t watched_rss_max = watched_start.rss_kb;
+
+  std::vector<double> latencies_ms;
+  size_t periods = 0;
+  size_t missed = 0;
+  size_t processes_min = SIZE_MAX;
+  size_t processes_max = 0;
+  size_t threads_max = 0;
+  GatheringState gathering_state = {};
+  const double start_at = now_secs();
+  double deadline = start_at;
+  while (!g_interrupted && now_secs() - start_at < options.duration) {
+    const double begin = now_secs();
+    gather(gathering_state, sync);
+    latencies_ms.push_back((now_secs() - begin) * 1000);
+    UpdateSnapshot snapshot;
+    while (sync.update_queue.pop(snapshot)) {
+      processes_min = std::min(processes_min, snapshot.stats.size);
+      processes_max = std::max(processes_max, snapshot.stats.size);
+      for (size_t i = 0; i < snapshot.thread_snapshots.size; ++i) {
+        threads_max = std::max(threads_max,
+                               snapshot.thread_snapshots.data[i].threads.size);
+      }
+      snapshot.owner_arena.destroy();
+    }
+    if (watching && read_usage(options.watch_pid, watched_end)) {
+      watched_rss_max = std::max(watched_rss_max, watched_end.rss_kb);
+    }
+
+    // Fixed rate: periods a late gather ran into are missed
+    ++periods;
+    deadline += options.period;
+    const double now = now_secs();
+    if (now > deadline) {
+      const size_t late =
+          static_cast<size_t>((now - deadline) / options.period) + 1;
+      missed += late;
+      periods += late;
+      deadline += late * options.period;
+    }
+    usleep(static_cast<useconds_t>((deadline - now_secs()) * 1e6));
+  }
+  const double elapsed = now_secs() - start_at;
+
+  Usage own_end = {};
+  read_usage(0, own_end);
+  killpg(g_group, SIGKILL);
+  while (wait(nullptr) > 0) {
+  }
+
+  if (latencies_ms.empty()) return 0;
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  printf("%zu gathers in %.1f s, %zu to %zu processes, %zu watched threads\n",
+         latencies_ms.size(), elapsed, processes_min, processes_max,
+         threads_max);
+  printf("gather ms   p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+         percentile(latencies_ms, 0.5), percentile(latencies_ms, 0.9),
+         percentile(latencies_ms, 0.99), latencies_ms.back());
+  printf("missed      %zu of %zu periods of %.3f s (%.1f%%)\n", missed,
+         periods, options.period, 100.0 * missed / periods);
+  printf("gatherer    cpu %.1f%%  rss %zu KB\n",
+         100 * (own_end.cpu_secs - own_start.cpu_secs) / elapsed,
+         own_end.rss_kb);
+  if (watching) {
+    printf("pid %-7d cpu %.1f%%  rss %zu KB (max)\n", options.watch_pid,
+           100 * (watched_end.cpu_secs - watched_start.cpu_secs) / elapsed,
+           watched_rss_max);
+  }
+  return 0;
+}
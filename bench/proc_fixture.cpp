@@ -0,0 +1,375 @@
+#include "proc_fixture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t HEAVY_EVERY = 32; // every Nth process has heavy_threads
+constexpr size_t CHAIN_EVERY = 8;  // every Nth process extends a deep chain
+
+const char *const COMMS[] = {
+    "bash",    "sshd",     "kworker/0:1", "Web Content", "(sd-pam)",
+    "python3", "postgres", "nginx",       "tmux: server", "node",
+    "java",    "systemd",  "containerd",  "rsyslogd",    "chrome",
+};
+
+const char *const LIBRARIES[] = {
+    "/usr/lib/x86_64-linux-gnu/libc.so.6",
+    "/usr/lib/x86_64-linux-gnu/libm.so.6",
+    "/usr/lib/x86_64-linux-gnu/libstdc++.so.6.0.33",
+    "/usr/lib/x86_64-linux-gnu/libssl.so.3",
+    "/usr/lib/x86_64-linux-gnu/ld-linux-x86-64.so.2",
+};
+
+// xorshift64*, the same options give the same tree
+struct Random {
+  uint64_t state;
+
+  unsigned long long next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ull;
+  }
+  unsigned long long below(const unsigned long long n) {
+    return n > 0 ? next() % n : 0;
+  }
+};
+
+struct FixtureWriter {
+  char path[4096];
+  size_t root_size;
+  char buf[8192];
+  size_t size;
+  bool failed;
+
+  // Sets the path relative to the root
+  __attribute__((format(printf, 2, 3))) void at(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(path + root_size, sizeof(path) - root_size, format, args);
+    va_end(args);
+  }
+
+  __attribute__((format(printf, 2, 3))) void print(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    const int n = vsnprintf(buf + size, sizeof(buf) - size, format, args);
+    va_end(args);
+    if (n > 0) size = std::min(size + static_cast<size_t>(n), sizeof(buf) - 1);
+  }
+
+  void append(const char *data, const size_t length) {
+    const size_t n = std::min(length, sizeof(buf) - 1 - size);
+    memcpy(buf + size, data, n);
+    size += n;
+  }
+
+  void error(const char *what) {
+    if (!failed) fprintf(stderr, "%s %s: %s\n", what, path, strerror(errno));
+    failed = true;
+  }
+
+  void mkdir_at() {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) error("mkdir");
+  }
+
+  void symlink_at(const char *target) {
+    if (symlink(target, path) != 0 && errno != EEXIST) error("symlink");
+  }
+
+  // Writes the buffer into the current path and clears it
+  void flush() {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, buf, size) != static_cast<ssize_t>(size)) {
+      error("write");
+    }
+    if (fd >= 0) close(fd);
+    size = 0;
+  }
+};
+
+void write_system(FixtureWriter &w, const ProcFixtureOptions &options,
+                  Random &random) {
+  w.at("/stat");
+  const size_t cpus = std::max<size_t>(options.cpus, 1);
+  unsigned long long total[7] = {};
+  char cores[4096 * 2];
+  size_t cores_size = 0;
+  for (size_t i = 0; i < cpus; ++i) {
+    unsigned long long core[7];
+    for (unsigned long long &ticks : core) {
+      ticks = 1000 + random.below(1000000);
+    }
+    for (size_t j = 0; j < 7; ++j) {
+      total[j] += core[j];
+    }
+    if (cores_size + 128 < sizeof(cores)) {
+      cores_size +=
+          snprintf(cores + cores_size, sizeof(cores) - cores_size,
+                   "cpu%zu %llu %llu %llu %llu %llu %llu %llu 0 0 0\n", i,
+                   core[0], core[1], core[2], core[3], core[4], core[5],
+                   core[6]);
+    }
+  }
+  w.print("cpu  %llu %llu %llu %llu %llu %llu %llu 0 0 0\n", total[0],
+          total[1], total[2], total[3], total[4], total[5], total[6]);
+  w.append(cores, cores_size);
+  w.print("intr 123456789 0 0\nctxt 987654321\nbtime 1700000000\n"
+          "processes %zu\nprocs_running 3\nprocs_blocked 0\n",
+          options.processes);
+  w.flush();
+
+  w.at("/meminfo");
+  w.print("MemTotal:       32768000 kB\n"
+          "MemFree:         8192000 kB\n"
+          "MemAvailable:   16384000 kB\n"
+          "Buffers:          512000 kB\n"
+          "Cached:          6144000 kB\n"
+          "SwapCached:            0 kB\n"
+          "Active:         12000000 kB\n"
+          "Inactive:        6000000 kB\n"
+          "SwapTotal:       8192000 kB\n"
+          "SwapFree:        8000000 kB\n"
+          "Dirty:              1024 kB\n");
+  w.flush();
+
+  w.at("/diskstats");
+  const char *const disks[] = {"sda", "sda1", "sda2", "nvme0n1", "nvme0n1p1",
+                               "loop0"};
+  for (size_t i = 0; i < sizeof(disks) / sizeof(disks[0]); ++i) {
+    w.print("   8       %zu %s 123456 789 %llu 4567 234567 890 %llu 6789 0 "
+            "12345 23456 0 0 0 0 0 0\n",
+            i, disks[i], 1000000 + random.below(1000000),
+            2000000 + random.below(1000000));
+  }
+  w.flush();
+
+  w.at("/net");
+  w.mkdir_at();
+  w.at("/net/dev");
+  w.print("Inter-|   Receive                                                |"
+          "  Transmit\n"
+          " face |bytes    packets errs drop fifo frame compressed multicast|"
+          "bytes    packets errs drop fifo colls carrier compressed\n");
+  const char *const interfaces[] = {"lo", "eth0", "wlan0"};
+  for (const char *name : interfaces) {
+    w.print("%6s: %llu 12345 0 0 0 0 0 0 %llu 6789 0 0 0 0 0 0\n", name,
+            100000000 + random.below(100000000),
+            50000000 + random.below(50000000));
+  }
+  w.flush();
+}
+
+void write_stat(FixtureWriter &w, const size_t tid, const char *comm,
+                const size_t ppid, const size_t threads, Random &random) {
+  const char state = "SSSSRDI"[random.below(7)];
+  w.print("%zu (%s) %c %zu %zu %zu 34816 %zu 4194560 %llu 0 %llu 0 %llu %llu "
+          "0 0 20 0 %zu 0 %llu %llu %llu 18446744073709551615 1 1 0 0 0 0 0 "
+          "4096 16384 0 0 0 17 %llu 0 0 %llu 0 0 0 0 0 0 0 0 0 0\n",
+          tid, comm, state, ppid, ppid, ppid, ppid, random.below(100000),
+          random.below(100), random.below(1000000), random.below(100000),
+          threads, random.below(10000000), 10000000 + random.below(1000000000),
+          random.below(100000), random.below(64), random.below(1000));
+  w.flush();
+}
+
+// From the tid rather than `random`, so the rest of the tree stays the same
+void write_schedstat(FixtureWriter &w, const size_t tid) {
+  w.print("%zu %zu %zu\n", tid * 1000003 % 100000000000, tid * 7919 % 10000000,
+          tid % 1000 + 1);
+  w.flush();
+}
+
+// From the pid and the sizes of stat and statm, the layout of a real one
+void write_status(FixtureWriter &w, const size_t pid, const char *comm,
+                  const size_t ppid, const size_t threads,
+                  const size_t size_pages, const size_t cpus) {
+  const size_t rss_kb = size_pages / 4 * 4; // statm resident, 4 KB pages
+  w.print("Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%zu\n"
+          "Ngid:\t0\nPid:\t%zu\nPPid:\t%zu\nTracerPid:\t0\n"
+          "Uid:\t0\t0\t0\t0\nGid:\t0\t0\t0\t0\nFDSize:\t64\n"
+          "Groups:\t0 4 24 27 30 46 100 118\nNStgid:\t%zu\nNSpid:\t%zu\n"
+          "NSpgid:\t%zu\nNSsid:\t%zu\n",
+          comm, pid, pid, ppid, pid, pid, ppid, ppid);
+  w.print("VmPeak:\t%8zu kB\nVmSize:\t%8zu kB\nVmLck:\t       0 kB\n"
+          "VmPin:\t       0 kB\nVmHWM:\t%8zu kB\nVmRSS:\t%8zu kB\n"
+          "RssAnon:\t%8zu kB\nRssFile:\t%8zu kB\nRssShmem:\t       0 kB\n"
+          "VmData:\t%8zu kB\nVmStk:\t     132 kB\nVmExe:\t     864 kB\n"
+          "VmLib:\t    8732 kB\nVmPTE:\t     120 kB\nVmSwap:\t%8zu kB\n"
+          "HugetlbPages:\t       0 kB\nCoreDumping:\t0\nTHP_enabled:\t1\n"
+          "Threads:\t%zu\n",
+          size_pages * 5, size_pages * 4, rss_kb + pid % 1024, rss_kb,
+          rss_kb / 2, rss_kb / 2, size_pages / 2, pid % 7 == 0 ? pid : 0,
+          threads);
+  w.print("SigQ:\t0/127431\nSigPnd:\t0000000000000000\n"
+          "ShdPnd:\t0000000000000000\nSigBlk:\t0000000000000000\n"
+          "SigIgn:\t0000000000001000\nSigCgt:\t0000000180000a02\n"
+          "CapInh:\t0000000000000000\nCapPrm:\t000001ffffffffff\n"
+          "CapEff:\t000001ffffffffff\nCapBnd:\t000001ffffffffff\n"
+          "CapAmb:\t0000000000000000\nNoNewPrivs:\t0\nSeccomp:\t0\n"
+          "Seccomp_filters:\t0\nSpeculation_Store_Bypass:\tvulnerable\n"
+          "Cpus_allowed:\t%zx\nCpus_allowed_list:\t0-%zu\n"
+          "Mems_allowed:\t00000001\nMems_allowed_list:\t0\n"
+          "voluntary_ctxt_switches:\t%zu\n"
+          "nonvoluntary_ctxt_switches:\t%zu\n",
+          cpus >= 64 ? ~size_t{0} : (size_t{1} << cpus) - 1, cpus - 1,
+          pid * 31, pid % 97);
+  w.flush();
+}
+
+void write_process(FixtureWriter &w, const ProcFixtureOptions &options,
+                   const size_t pid, const size_t ppid, size_t &next_tid,
+                   Random &random) {
+  char comm[32];
+  snprintf(comm, sizeof(comm), "%s",
+           pid == 1 ? "systemd"
+                    : COMMS[random.below(sizeof(COMMS) / sizeof(COMMS[0]))]);
+  const size_t threads =
+      pid % HEAVY_EVERY == 0 ? std::max<size_t>(options.heavy_threads, 1) : 1;
+
+  w.at("/%zu", pid);
+  w.mkdir_at();
+  w.at("/%zu/stat", pid);
+  write_stat(w, pid, comm, ppid, threads, random);
+
+  const size_t size_pages = 10000 + random.below(1000000);
+  w.at("/%zu/statm", pid);
+  w.print("%zu %zu %zu %zu 0 %zu 0\n", size_pages, size_pages / 4,
+          size_pages / 16, size_pages / 64, size_pages / 8);
+  w.flush();
+
+  w.at("/%zu/comm", pid);
+  w.print("%s\n", comm);
+  w.flush();
+
+  w.at("/%zu/status", pid);
+  write_status(w, pid, comm, ppid, threads, size_pages,
+               std::max<size_t>(options.cpus, 1));
+
+  w.at("/%zu/schedstat", pid);
+  write_schedstat(w, pid);
+
+  w.at("/%zu/io", pid);
+  w.print("rchar: %llu\nwchar: %llu\nsyscr: 1234\nsyscw: 567\n"
+          "read_bytes: %llu\nwrite_bytes: %llu\ncancelled_write_bytes: 0\n",
+          random.below(1ull << 32), random.below(1ull << 32),
+          random.below(1ull << 30), random.below(1ull << 30));
+  w.flush();
+
+  w.at("/%zu/environ", pid);
+  const char environ[] = "PATH=/usr/local/bin:/usr/bin:/bin\0HOME=/root\0"
+                         "LANG=C.UTF-8\0TERM=xterm-256color\0SHELL=/bin/bash";
+  w.append(environ, sizeof(environ));
+  w.flush();
+
+  w.at("/%zu/maps", pid);
+  unsigned long long address = 0x7f0000000000ull + (pid << 24);
+  for (const char *library : LIBRARIES) {
+    for (const char *perms : {"r--p", "r-xp", "rw-p"}) {
+      w.print("%llx-%llx %s 00000000 08:01 %zu %s\n", address,
+              address + 0x1000, perms, pid, library);
+      address += 0x1000;
+    }
+  }
+  w.print("%llx-%llx rw-p 00000000 00:00 0 [heap]\n", address,
+          address + 0x21000);
+  w.flush();
+
+  w.at("/%zu/fd", pid);
+  w.mkdir_at();
+  for (size_t fd = 0; fd < options.fds; ++fd) {
+    char target[64];
+    if (fd < 3) {
+      snprintf(target, sizeof(target), "/dev/pts/0");
+    } else if (fd % 4 == 0) {
+      snprintf(target, sizeof(target), "socket:[%zu]", pid * 1000 + fd);
+    } else {
+      snprintf(target, sizeof(target), "/var/log/app-%zu.log", fd);
+    }
+    w.at("/%zu/fd/%zu", pid, fd);
+    w.symlink_at(target);
+  }
+
+  w.at("/%zu/task", pid);
+  w.mkdir_at();
+  for (size_t i = 0; i < threads; ++i) {
+    const size_t tid = i == 0 ? pid : next_tid++;
+    w.at("/%zu/task/%zu", pid, tid);
+    w.mkdir_at();
+    w.at("/%zu/task/%zu/stat", pid, tid);
+    write_stat(w, tid, comm, ppid, threads, random);
+    w.at("/%zu/task/%zu/comm", pid, tid);
+    w.print("%s\n", comm);
+    w.flush();
+    w.at("/%zu/task/%zu/schedstat", pid, tid);
+    write_schedstat(w, tid);
+  }
+}
+
+int remove_entry(const char *path, const struct stat *, int, FTW *) {
+  return remove(path);
+}
+
+} // namespace
+
+ProcFixtureOptions proc_fixture_default_options() {
+  ProcFixtureOptions res = {};
+  res.processes = 10000;
+  res.cpus = 16;
+  res.max_depth = 32;
+  res.fds = 16;
+  res.heavy_threads = 64;
+  return res;
+}
+
+bool proc_fixture_write(const char *root, const ProcFixtureOptions &options) {
+  FixtureWriter *w = new FixtureWriter();
+  w->root_size = snprintf(w->path, sizeof(w->path), "%s", root);
+  w->mkdir_at();
+
+  Random random = {0x9e3779b97f4a7c15ull};
+  write_system(*w, options, random);
+
+  // Most processes hang off a random shallow parent, every CHAIN_EVERY one
+  // extends a chain down to max_depth
+  std::vector<uint32_t> depths(options.processes + 1, 0);
+  size_t chain_tip = 1;
+  size_t next_tid = options.processes + 1;
+  for (size_t pid = 1; pid <= options.processes && !w->failed; ++pid) {
+    size_t ppid = 0;
+    if (pid > 1) {
+      if (pid % CHAIN_EVERY == 0) {
+        if (depths[chain_tip] >= options.max_depth) chain_tip = 1;
+        ppid = chain_tip;
+        chain_tip = pid;
+      } else {
+        ppid = 1 + random.below(pid - 1);
+        if (depths[ppid] >= options.max_depth) ppid = 1;
+      }
+      depths[pid] = depths[ppid] + 1;
+    }
+    write_process(*w, options, pid, ppid, next_tid, random);
+  }
+  const bool res = !w->failed;
+  delete w;
+  return res;
+}
+
+bool proc_fixture_remove(const char *root) {
+  if (nftw(root, remove_entry, 64, FTW_DEPTH | FTW_PHYS) != 0) {
+    fprintf(stderr, "Failed to remove %s: %s\n", root, strerror(errno));
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Synthetic procfs tree to run the sources against scales a normal machine
+// does not have (prock_bench, --proc-root of prock, prock-collect and
+// prock-tui).
+//
+// The system has stat, meminfo, diskstats and net/dev, every process stat,
+// statm, comm, status, schedstat, io, environ, maps, fd/ (symlinks, some of
+// them sockets) and task/ with a stat, comm and schedstat per thread. Content
+// is deterministic for the same options.
+struct ProcFixtureOptions {
+  size_t processes;     // pids 1..processes, tids continue after them
+  size_t cpus;          // cpuN lines of stat
+  size_t max_depth;     // of the process tree, pid 1 is the root
+  size_t fds;           // per process
+  size_t heavy_threads; // threads of every 32nd process, others have one
+};
+
+ProcFixtureOptions proc_fixture_default_options();
+
+// Writes the tree into `root`, created if missing. Prints the problem and
+// returns false on error.
+bool proc_fixture_write(const char *root, const ProcFixtureOptions &options);
+// Removes a tree written by proc_fixture_write
+bool proc_fixture_remove(const char *root);
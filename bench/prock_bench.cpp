@@ -0,0 +1,187 @@
+// Time of every gather phase and of the whole gather() on a synthetic procfs
+// tree (see proc_fixture.h) or an existing one.
+//
+// Usage: prock_bench [--processes N] [--threads N] [--fds N] [--depth N]
+//                    [--iterations N] [--fixture DIR | --root DIR]
+//
+// Without --root a tree of N processes is generated into a temporary
+// directory and removed at the end, --fixture DIR generates into DIR and
+// keeps it. --root DIR benchmarks an existing tree, e.g. /proc.
+//
+// The processes phase also queries the sockets of this machine over netlink,
+// they are matched against the socket:[inode] fds of the tree. +status is
+// the same with /proc/[pid]/status, which gather() reads only every
+// STATUS_EVERY_GATHERS gathers unless something shows it.
+
+#include "base.h"
+#include "proc_fixture.h"
+#include "sources/process_stat.h"
+#include "sources/sync.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Unity build, the phases are static functions of process_stat.cpp
+#include "base.cpp"
+#include "self_stats.cpp"
+#include "sources/process_stat.cpp"
+#include "sources/snapshot_codec.cpp"
+#include "sources/snapshot_file.cpp"
+
+namespace {
+
+Sync g_sync;
+volatile size_t g_sink; // keeps phases from being optimized away
+
+struct Phase {
+  const char *name;
+  std::vector<double> ms;
+};
+
+double elapsed_ms(const SteadyTimePoint start) {
+  return std::chrono::duration<double, std::milli>(SteadyClock::now() - start)
+      .count();
+}
+
+template <class F> void run_phase(Phase &phase, F f) {
+  BumpArena arena = BumpArena::create();
+  const SteadyTimePoint start = SteadyClock::now();
+  g_sink = g_sink + f(arena);
+  phase.ms.push_back(elapsed_ms(start));
+  arena.destroy();
+}
+
+// Watches the processes with the most threads, like open thread views
+void watch_busiest(Sync &sync) {
+  BumpArena arena = BumpArena::create();
+  const Array<ProcessStat> stats = read_all_processes(false, arena);
+  std::vector<const ProcessStat *> order;
+  for (size_t i = 0; i < stats.size; ++i) {
+    order.push_back(&stats.data[i]);
+  }
+  const size_t count = std::min<size_t>(order.size(), MAX_WATCHED_PIDS);
+  std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                    [](const ProcessStat *left, const ProcessStat *right) {
+                      return left->num_threads > right->num_threads;
+                    });
+  for (size_t i = 0; i < count; ++i) {
+    sync.watched_pids[i].store(order[i]->pid);
+  }
+  sync.watched_pids_count.store(static_cast<int>(count));
+  arena.destroy();
+}
+
+void print_phase(Phase &phase, const size_t processes) {
+  std::sort(phase.ms.begin(), phase.ms.end());
+  const double median = phase.ms[phase.ms.size() / 2];
+  printf("%-10s %9.2f %9.2f %9.2f %9.2f\n", phase.name, phase.ms.front(),
+         median, phase.ms.back(),
+         processes > 0 ? median * 1000 / processes : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  ProcFixtureOptions options = proc_fixture_default_options();
+  size_t iterations = 10;
+  const char *fixture = nullptr;
+  const char *root = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+      options.processes = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      options.heavy_threads = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--fds") == 0 && i + 1 < argc) {
+      options.fds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+      options.max_depth = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = std::max<size_t>(strtoul(argv[++i], nullptr, 10), 1);
+    } else if (strcmp(argv[i], "--fixture") == 0 && i + 1 < argc) {
+      fixture = argv[++i];
+    } else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+      root = argv[++i];
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--processes N] [--threads N] [--fds N] "
+              "[--depth N]\n"
+              "          [--iterations N] [--fixture DIR | --root DIR]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  char temp_root[] = "/tmp/prock-bench-XXXXXX";
+  if (!root) {
+    if (!fixture && !mkdtemp(temp_root)) {
+      perror("mkdtemp");
+      return 1;
+    }
+    root = fixture ? fixture : temp_root;
+    printf("Generating %zu processes into %s...\n", options.processes, root);
+    const SteadyTimePoint start = SteadyClock::now();
+    if (!proc_fixture_write(root, options)) {
+      if (!fixture) proc_fixture_remove(root);
+      return 1;
+    }
+    printf("Generated in %.1f s\n", elapsed_ms(start) / 1000);
+  }
+  g_proc_root = root;
+
+  Sync &sync = g_sync;
+  sync.update_period.store(1e-6f);
+  watch_busiest(sync);
+
+  Phase phases[] = {{"processes", {}}, {"+status", {}}, {"cpu", {}},
+                    {"meminfo", {}},   {"diskstats", {}}, {"net/dev", {}},
+                    {"threads", {}},   {"gather", {}}};
+  size_t processes = 0;
+  GatheringState gathering_state = {};
+  for (size_t i = 0; i < iterations; ++i) {
+    run_phase(phases[0], [&processes](BumpArena &arena) {
+      processes = read_all_processes(false, arena).size;
+      return processes;
+    });
+    run_phase(phases[1], [](BumpArena &arena) {
+      return read_all_processes(true, arena).size;
+    });
+    run_phase(phases[2],
+              [](BumpArena &arena) { return read_cpu_stats(arena).size; });
+    run_phase(phases[3],
+              [](BumpArena &) { return read_mem_info().mem_total; });
+    run_phase(phases[4], [](BumpArena &) {
+      return read_disk_io_stats().sectors_read;
+    });
+    run_phase(phases[5], [](BumpArena &) {
+      return read_net_io_stats().bytes_received;
+    });
+    run_phase(phases[6], [&sync](BumpArena &arena) {
+      return read_watched_threads(sync, arena).size;
+    });
+    run_phase(phases[7], [&](BumpArena &) {
+      gather(gathering_state, sync);
+      UpdateSnapshot snapshot;
+      size_t res = 0;
+      while (sync.update_queue.pop(snapshot)) {
+        res += snapshot.stats.size;
+        snapshot.owner_arena.destroy();
+      }
+      return res;
+    });
+  }
+
+  printf("%zu processes, %d watched, %zu iterations\n", processes,
+         sync.watched_pids_count.load(), iterations);
+  printf("%-10s %9s %9s %9s %9s\n", "phase", "min ms", "median ms", "max ms",
+         "us/proc");
+  for (Phase &phase : phases) {
+    print_phase(phase, processes);
+  }
+
+  if (root == temp_root) proc_fixture_remove(root);
+  return 0;
+}
@@ -0,0 +1,340 @@
+// CPU cost and geometry of drawing the views, without a window or GPU: an
+// ImGui / ImPlot context without platform and renderer backends draws every
+// view alone for a number of frames and counts the resulting draw data.
+//
+// Usage: prock_render_bench [--processes N] [--charts N] [--hours H]
+//                           [--frames N]
+//
+// The state comes from a synthetic host (see synthetic_host.h) with N
+// processes (default 10000). Before drawing, H hours (default 1) of updates
+// at 1 s fill the history of the system charts and of the CPU, memory, disk
+// and network charts opened for the first --charts processes (default 4).
+// The process table only gets all N processes for the last updates, so
+// building the history stays fast.
+//
+// Reported per view: percentiles of the time from NewFrame() to Render()
+// (default 100 frames after warm-up) and the vertices, indices and draw calls
+// of its frame. The "empty" view is the cost of a frame without any window.
+
+#include "base.h"
+#include "history.h"
+#include "sources/sync.h"
+#include "state.h"
+#include "synthetic_host.h"
+#include "views/entry.h"
+#include "views/view_state.h"
+
+#include "imgui.h"
+#include "implot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Unity build of everything views_draw reaches, like main.cpp
+#include "base.cpp"
+#include "gorilla.cpp"
+#include "history.cpp"
+#include "process_recorder.cpp"
+#include "self_stats.cpp"
+#include "sources/annotations.cpp"
+#include "state.cpp"
+#include "views/brief_table.cpp"
+#include "views/brief_table_logic.cpp"
+#include "views/cpu_chart.cpp"
+#include "views/entry.cpp"
+#include "views/environ_viewer.cpp"
+#include "views/host_overview.cpp"
+#include "views/internals_window.cpp"
+#include "views/io_chart.cpp"
+#include "views/library_viewer.cpp"
+#include "views/mem_chart.cpp"
+#include "views/menu_bar.cpp"
+#include "views/net_chart.cpp"
+#include "views/process_host.cpp"
+#include "views/process_window_flags.cpp"
+#include "views/socket_viewer.cpp"
+#include "views/system_cpu_chart.cpp"
+#include "views/system_io_chart.cpp"
+#include "views/system_mem_chart.cpp"
+#include "views/system_net_chart.cpp"
+#include "views/threads_viewer.cpp"
+
+namespace {
+
+Sync g_sync; // only read by the viewers, nothing gathers
+
+constexpr float DISPLAY_WIDTH = 1280;
+constexpr float DISPLAY_HEIGHT = 720;
+constexpr size_t WARM_UP_FRAMES = 3; // window sizes settle, fonts load
+
+struct Options {
+  size_t processes;
+  size_t charts;
+  double hours;
+  size_t frames;
+};
+
+using DrawFn = void (*)(FrameContext &ctx, ViewState &view_state,
+                        const State &state);
+
+struct View {
+  const char *name;
+  bool fullscreen; // single window covering the display
+  DrawFn draw;
+};
+
+struct Frame {
+  double us;
+  size_t vertices;
+  size_t indices;
+  size_t draw_calls;
+};
+
+void draw_nothing(FrameContext &, ViewState &, const State &) {}
+
+void draw_brief_table(FrameContext &ctx, ViewState &view_state,
+                      const State &state) {
+  brief_table_draw(ctx, view_state, state);
+}
+
+void draw_system_cpu(FrameContext &ctx, ViewState &view_state,
+                     const State &) {
+  view_state.system_cpu_chart_state.show_per_core = false;
+  system_cpu_chart_draw(ctx, view_state);
+}
+
+void draw_system_cpu_per_core(FrameContext &ctx, ViewState &view_state,
+                              const State &) {
+  view_state.system_cpu_chart_state.show_per_core = true;
+  view_state.system_cpu_chart_state.stacked = false;
+  system_cpu_chart_draw(ctx, view_state);
+}
+
+void draw_system_cpu_stacked(FrameContext &ctx, ViewState &view_state,
+                             const State &) {
+  view_state.system_cpu_chart_state.show_per_core = true;
+  view_state.system_cpu_chart_state.stacked = true;
+  system_cpu_chart_draw(ctx, view_state);
+}
+
+void draw_system_mem(FrameContext &ctx, ViewState &view_state,
+                     const State &) {
+  system_mem_chart_draw(ctx, view_state);
+}
+
+void draw_system_io(FrameContext &ctx, ViewState &view_state, const State &) {
+  system_io_chart_draw(ctx, view_state);
+}
+
+void draw_system_net(FrameContext &ctx, ViewState &view_state,
+                     const State &) {
+  system_net_chart_draw(ctx, view_state);
+}
+
+void draw_cpu_charts(FrameContext &, ViewState &view_state, const State &) {
+  cpu_chart_draw(view_state);
+}
+
+void draw_mem_charts(FrameContext &, ViewState &view_state, const State &) {
+  mem_chart_draw(view_state);
+}
+
+void draw_io_charts(FrameContext &, ViewState &view_state, const State &) {
+  io_chart_draw(view_state);
+}
+
+void draw_net_charts(FrameContext &, ViewState &view_state, const State &) {
+  net_chart_draw(view_state);
+}
+
+void draw_internals(FrameContext &, ViewState &view_state,
+                    const State &state) {
+  view_state.preferences_state.show_internals = true;
+  internals_window_draw(view_state, state);
+}
+
+const View VIEWS[] = {
+    {"empty", false, draw_nothing},
+    {"brief_table", true, draw_brief_table},
+    {"system_cpu", true, draw_system_cpu},
+    {"system_cpu_per_core", true, draw_system_cpu_per_core},
+    {"system_cpu_stacked", true, draw_system_cpu_stacked},
+    {"system_mem", true, draw_system_mem},
+    {"system_io", true, draw_system_io},
+    {"system_net", true, draw_system_net},
+    {"cpu_charts", false, draw_cpu_charts},
+    {"mem_charts", false, draw_mem_charts},
+    {"io_charts", false, draw_io_charts},
+    {"net_charts", false, draw_net_charts},
+    {"internals", false, draw_internals},
+};
+
+// Same steps as state_update of main.cpp
+void state_update(State &state, ViewState &view_state,
+                  const UpdateSnapshot &snapshot) {
+  BumpArena old_arena = state_apply_snapshot(state, snapshot);
+
+  const double update_at = std::chrono::duration_cast<Seconds>(
+                               state.update_system_time.time_since_epoch())
+                               .count();
+  history_push_time(g_history.timeline, update_at);
+  process_recorder_update(state.recorder, state.snapshot, update_at);
+
+  views_process_thread_snapshots(view_state, state, snapshot);
+  views_update(view_state, state);
+  old_arena.destroy();
+}
+
+void open_charts(State &state, ViewState &view_state, const size_t count) {
+  for (size_t i = 0; i < std::min(count, state.snapshot.stats.size); ++i) {
+    const ProcessStat &stat = state.snapshot.stats.data[i];
+    cpu_chart_add(view_state.cpu_chart_state, state, stat.pid, stat.comm);
+    mem_chart_add(view_state.mem_chart_state, state, stat.pid, stat.comm);
+    io_chart_add(view_state.io_chart_state, state, stat.pid, stat.comm);
+    net_chart_add(view_state.net_chart_state, state, stat.pid, stat.comm);
+  }
+}
+
+// Stands in for a renderer backend: every texture request succeeds
+void accept_textures(const ImDrawData &draw_data) {
+  if (!draw_data.Textures) return;
+  for (ImTextureData *tex : *draw_data.Textures) {
+    if (tex->Status == ImTextureStatus_WantCreate ||
+        tex->Status == ImTextureStatus_WantUpdates) {
+      tex->SetTexID(static_cast<ImTextureID>(tex->UniqueID + 1));
+      tex->SetStatus(ImTextureStatus_OK);
+    } else if (tex->Status == ImTextureStatus_WantDestroy) {
+      tex->SetTexID(ImTextureID_Invalid);
+      tex->SetStatus(ImTextureStatus_Destroyed);
+    }
+  }
+}
+
+Frame draw_frame(const View &view, ViewState &view_state,
+                 const State &state) {
+  const SteadyTimePoint start = SteadyClock::now();
+  ImGui::NewFrame();
+  if (view.fullscreen) {
+    ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize, ImGuiCond_Always);
+  }
+  FrameContext ctx = {};
+  view.draw(ctx, view_state, state);
+  ctx.frame_arena.destroy();
+  ImGui::Render();
+
+  Frame res = {};
+  res.us = std::chrono::duration<double, std::micro>(SteadyClock::now() -
+                                                     start)
+               .count();
+  const ImDrawData &draw_data = *ImGui::GetDrawData();
+  res.vertices = static_cast<size_t>(draw_data.TotalVtxCount);
+  res.indices = static_cast<size_t>(draw_data.TotalIdxCount);
+  for (const ImDrawList *list : draw_data.CmdLists) {
+    for (const ImDrawCmd &cmd : list->CmdBuffer) {
+      if (!cmd.UserCallback && cmd.ElemCount > 0) ++res.draw_calls;
+    }
+  }
+  accept_textures(draw_data);
+  return res;
+}
+
+void print_view(const char *name, std::vector<Frame> &frames) {
+  std::sort(frames.begin(), frames.end(),
+            [](const Frame &left, const Frame &right) {
+              return left.us < right.us;
+            });
+  const Frame &p50 = frames[frames.size() / 2];
+  const Frame &p99 = frames[std::min(frames.size() - 1,
+                                     frames.size() * 99 / 100)];
+  // Geometry is the same every frame, the median one stands for all
+  printf("%-20s %9.1f %9.1f %10zu %10zu %10zu\n", name, p50.us, p99.us,
+         p50.vertices, p50.indices, p50.draw_calls);
+}
+
+bool parse_args(Options &options, const int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) return false;
+    ++i;
+    if (strcmp(arg, "--processes") == 0) {
+      options.processes = std::max<size_t>(strtoul(value, nullptr, 10), 1);
+    } else if (strcmp(arg, "--charts") == 0) {
+      options.charts = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--hours") == 0) {
+      options.hours = std::max(strtod(value, nullptr), 0.0);
+    } else if (strcmp(arg, "--frames") == 0) {
+      options.frames = std::max<size_t>(strtoul(value, nullptr, 10), 1);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options = {10000, 4, 1, 100};
+  if (!parse_args(options, argc, argv)) {
+    fprintf(stderr,
+            "Usage: %s [--processes N] [--charts N] [--hours H] "
+            "[--frames N]\n",
+            argv[0]);
+    return 1;
+  }
+
+  ImGui::CreateContext();
+  ImPlot::CreateContext();
+  ImGuiIO &io = ImGui::GetIO();
+  io.IniFilename = nullptr;
+  io.DisplaySize = ImVec2(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+  io.DeltaTime = 1.0f / 60;
+  io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+  io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+  io.Fonts->AddFontDefault();
+
+  SyntheticHost host = {};
+  synthetic_host_init(host, {options.processes, 0.01, 5, options.charts});
+  State state = {};
+  state.system = {SYNTHETIC_HOST_TICKS_IN_SECOND, SYNTHETIC_HOST_PAGE_SIZE};
+  ViewState &view_state = *new ViewState();
+  view_state.sync = &g_sync;
+
+  // Two full updates at the end, CPU usage needs a previous snapshot
+  const SteadyTimePoint start = SteadyClock::now();
+  const size_t updates =
+      std::max<size_t>(static_cast<size_t>(options.hours * 3600), 3);
+  for (size_t i = 0; i < updates; ++i) {
+    const size_t limit =
+        i + 2 < updates ? std::max<size_t>(options.charts, 1) : SIZE_MAX;
+    state_update(state, view_state, synthetic_host_next(host, limit));
+    if (i == 0) open_charts(state, view_state, options.charts);
+  }
+  const double history_secs =
+      std::chrono::duration<double>(SteadyClock::now() - start).count();
+
+  printf("%zu processes, %zu charted, %.1f h of history (built in %.1f s), "
+         "%zu frames of %.0fx%.0f\n",
+         state.snapshot.stats.size, options.charts, options.hours,
+         history_secs, options.frames, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+  printf("%-20s %9s %9s %10s %10s %10s\n", "view", "p50 us", "p99 us",
+         "vertices", "indices", "draw calls");
+  std::vector<Frame> frames;
+  for (const View &view : VIEWS) {
+    frames.clear();
+    for (size_t i = 0; i < WARM_UP_FRAMES + options.frames; ++i) {
+      const Frame frame = draw_frame(view, view_state, state);
+      if (i >= WARM_UP_FRAMES) frames.push_back(frame);
+    }
+    print_view(view.name, frames);
+  }
+
+  ImPlot::DestroyContext();
+  ImGui::DestroyContext();
+  return 0;
+}
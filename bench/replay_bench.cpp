@@ -0,0 +1,362 @@
+// Time and memory of the UI thread's update path per snapshot, without GLFW
+// or OpenGL: state_snapshot_update, the history and recorder, the brief
+// table (with its tree sort) and the chart and viewer updates of
+// views_update.
+//
+// Usage: prock_replay_bench [--processes N,N,..] [--updates N] [--churn F]
+//                           [--cpu-variance P] [--charts N] [--replay FILE]
+//
+// Synthetic snapshots start with N processes (default 1000,10000,100000).
+// Every update replaces a fraction F of them (--churn, default 0.01) with new
+// pids, and moves the CPU usage of every process by up to P percent
+// (--cpu-variance, default 5) around its own base. --charts opens CPU,
+// memory, disk and network charts of that many long-lived processes
+// (default 4). --replay feeds the snapshots of a prock --record recording
+// instead and also times their decoding.
+//
+// Every scale runs in a child process, so g_history and the slab caches
+// start empty. Reported per stage: percentiles of the time of one update
+// and the slab bytes handed out per update (see g_slab_bytes).
+
+#include "base.h"
+#include "history.h"
+#include "sources/snapshot_file.h"
+#include "sources/sync.h"
+#include "state.h"
+#include "synthetic_host.h"
+#include "views/entry.h"
+#include "views/view_state.h"
+
+#include "imgui.h"
+#include "implot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Unity build of everything views_update reaches, like main.cpp
+#include "base.cpp"
+#include "gorilla.cpp"
+#include "history.cpp"
+#include "process_recorder.cpp"
+#include "self_stats.cpp"
+#include "sources/annotations.cpp"
+#include "sources/snapshot_codec.cpp"
+#include "sources/snapshot_file.cpp"
+#include "state.cpp"
+#include "views/brief_table.cpp"
+#include "views/brief_table_logic.cpp"
+#include "views/cpu_chart.cpp"
+#include "views/entry.cpp"
+#include "views/environ_viewer.cpp"
+#include "views/host_overview.cpp"
+#include "views/internals_window.cpp"
+#include "views/io_chart.cpp"
+#include "views/library_viewer.cpp"
+#include "views/mem_chart.cpp"
+#include "views/menu_bar.cpp"
+#include "views/net_chart.cpp"
+#include "views/process_host.cpp"
+#include "views/process_window_flags.cpp"
+#include "views/socket_viewer.cpp"
+#include "views/system_cpu_chart.cpp"
+#include "views/system_io_chart.cpp"
+#include "views/system_mem_chart.cpp"
+#include "views/system_net_chart.cpp"
+#include "views/threads_viewer.cpp"
+
+namespace {
+
+Sync g_sync; // only read by the viewers, nothing gathers
+
+constexpr size_t MAX_SCALES = 8;
+
+enum Stage {
+  eStage_Decode, // of a recording only
+  eStage_State,
+  eStage_Recorder,
+  eStage_BriefTable,
+  eStage_Charts,
+  eStage_Viewers,
+  eStage_Total,
+  eStage_COUNT,
+};
+
+constexpr const char *STAGE_NAMES[eStage_COUNT] = {
+    "decode", "state", "recorder", "brief_table", "charts", "viewers", "total",
+};
+
+struct Options {
+  size_t scales[MAX_SCALES];
+  size_t scale_count;
+  size_t updates;
+  double churn;
+  double cpu_variance;
+  size_t charts;
+  const char *replay;
+};
+
+struct Samples {
+  std::vector<double> us[eStage_COUNT];
+  std::vector<size_t> bytes[eStage_COUNT];
+};
+
+// Times consecutive stages of one update
+struct Laps {
+  Samples &samples;
+  bool recording; // false while warming up
+  SteadyTimePoint start;
+  SteadyTimePoint last;
+  size_t start_bytes;
+  size_t last_bytes;
+
+  void begin() {
+    start = last = SteadyClock::now();
+    start_bytes = last_bytes = g_slab_bytes.load(std::memory_order_relaxed);
+  }
+
+  void lap(const Stage stage) {
+    const SteadyTimePoint now = SteadyClock::now();
+    const size_t bytes = g_slab_bytes.load(std::memory_order_relaxed);
+    add(stage, now - last, bytes - last_bytes);
+    last = now;
+    last_bytes = bytes;
+  }
+
+  void end() { add(eStage_Total, last - start, last_bytes - start_bytes); }
+
+  void add(const Stage stage, const SteadyClock::duration elapsed,
+           const size_t bytes) {
+    if (!recording) return;
+    samples.us[stage].push_back(
+        std::chrono::duration<double, std::micro>(elapsed).count());
+    samples.bytes[stage].push_back(bytes);
+  }
+};
+
+// Same steps as state_update of main.cpp, views_update split into stages
+void update(State &state, ViewState &view_state,
+            const UpdateSnapshot &snapshot, Laps &laps) {
+  BumpArena old_arena = state_apply_snapshot(state, snapshot);
+  laps.lap(eStage_State);
+
+  const double update_at = std::chrono::duration_cast<Seconds>(
+                               state.update_system_time.time_since_epoch())
+                               .count();
+  history_push_time(g_history.timeline, update_at);
+  process_recorder_update(state.recorder, state.snapshot, update_at);
+  laps.lap(eStage_Recorder);
+
+  brief_table_update(view_state.brief_table_state, state);
+  laps.lap(eStage_BriefTable);
+
+  cpu_chart_update(view_state.cpu_chart_state, state);
+  mem_chart_update(view_state.mem_chart_state, state);
+  io_chart_update(view_state.io_chart_state, state);
+  net_chart_update(view_state.net_chart_state, state);
+  system_cpu_chart_update(view_state.system_cpu_chart_state, state);
+  system_mem_chart_update(view_state.system_mem_chart_state, state);
+  system_io_chart_update(view_state.system_io_chart_state, state);
+  system_net_chart_update(view_state.system_net_chart_state, state);
+  laps.lap(eStage_Charts);
+
+  // Before views_update in main.cpp, no difference without thread snapshots
+  views_process_thread_snapshots(view_state, state, snapshot);
+  library_viewer_update(view_state.library_viewer_state, *view_state.sync);
+  environ_viewer_update(view_state.environ_viewer_state, *view_state.sync);
+  threads_viewer_update(view_state.threads_viewer_state, state,
+                        *view_state.sync);
+  socket_viewer_update(view_state.socket_viewer_state, *view_state.sync);
+  history_enforce_budget();
+  old_arena.destroy();
+  laps.lap(eStage_Viewers);
+}
+
+void open_charts(State &state, ViewState &view_state, const size_t count) {
+  for (size_t i = 0; i < std::min(count, state.snapshot.stats.size); ++i) {
+    const ProcessStat &stat = state.snapshot.stats.data[i];
+    cpu_chart_add(view_state.cpu_chart_state, state, stat.pid, stat.comm);
+    mem_chart_add(view_state.mem_chart_state, state, stat.pid, stat.comm);
+    io_chart_add(view_state.io_chart_state, state, stat.pid, stat.comm);
+    net_chart_add(view_state.net_chart_state, state, stat.pid, stat.comm);
+  }
+}
+
+double percentile(const std::vector<double> &sorted, const double p) {
+  return sorted[std::min(sorted.size() - 1,
+                         static_cast<size_t>(p * sorted.size()))];
+}
+
+void print_samples(Samples &samples) {
+  printf("%-12s %9s %9s %9s %9s %12s\n", "stage", "p50 us", "p90 us",
+         "p99 us", "max us", "KB/update");
+  for (size_t i = 0; i < eStage_COUNT; ++i) {
+    std::vector<double> &us = samples.us[i];
+    if (us.empty()) continue;
+    std::sort(us.begin(), us.end());
+    double bytes = 0;
+    for (const size_t b : samples.bytes[i]) {
+      bytes += b;
+    }
+    printf("%-12s %9.1f %9.1f %9.1f %9.1f %12.1f\n", STAGE_NAMES[i],
+           percentile(us, 0.5), percentile(us, 0.9), percentile(us, 0.99),
+           us.back(), bytes / samples.bytes[i].size() / 1024);
+  }
+}
+
+ViewState *create_view_state(Sync &sync) {
+  ViewState *res = new ViewState();
+  res->sync = &sync;
+  return res;
+}
+
+// Warm-up updates fill the history and the brief table before timing
+size_t warm_up_updates(const size_t updates) {
+  return std::max<size_t>(updates / 10, 2);
+}
+
+int run_synthetic(const Options &options, const size_t processes) {
+  SyntheticHost host = {};
+  synthetic_host_init(host, {processes, options.churn, options.cpu_variance,
+                             options.charts});
+
+  State state = {};
+  state.system = {SYNTHETIC_HOST_TICKS_IN_SECOND, SYNTHETIC_HOST_PAGE_SIZE};
+  ViewState &view_state = *create_view_state(g_sync);
+
+  Samples samples;
+  Laps laps = {samples, false, {}, {}, 0, 0};
+  const size_t warm_up = warm_up_updates(options.updates);
+  for (size_t i = 0; i < warm_up + options.updates; ++i) {
+    const UpdateSnapshot snapshot = synthetic_host_next(host);
+    laps.recording = i >= warm_up;
+    laps.begin();
+    update(state, view_state, snapshot, laps);
+    laps.end();
+    if (i == 0) open_charts(state, view_state, options.charts);
+  }
+
+  printf("%zu processes, %zu updates, churn %.1f%%, cpu variance %.0f%%, "
+         "%zu charted\n",
+         processes, options.updates, options.churn * 100,
+         options.cpu_variance, options.charts);
+  print_samples(samples);
+  return 0;
+}
+
+int run_replay(const Options &options) {
+  SnapshotReader reader = {};
+  if (!snapshot_reader_open(reader, options.replay)) {
+    fprintf(stderr, "Failed to open recording: %s\n", options.replay);
+    return 1;
+  }
+  State state = {};
+  state.system = {reader.header->ticks_in_second,
+                  reader.header->mem_page_size};
+  ViewState &view_state = *create_view_state(g_sync);
+
+  Samples samples;
+  Laps laps = {samples, false, {}, {}, 0, 0};
+  const size_t count = reader.index.size;
+  const size_t warm_up = std::min(warm_up_updates(count), count / 2);
+  size_t processes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    laps.recording = i >= warm_up;
+    laps.begin();
+    UpdateSnapshot snapshot = {};
+    if (!snapshot_reader_read(reader, i, snapshot)) {
+      fprintf(stderr, "Failed to read snapshot %zu\n", i);
+      return 1;
+    }
+    laps.lap(eStage_Decode);
+    update(state, view_state, snapshot, laps);
+    laps.end();
+    if (i == 0) open_charts(state, view_state, options.charts);
+    processes = std::max(processes, snapshot.stats.size);
+  }
+
+  printf("%s: %zu updates, up to %zu processes, %zu charted\n",
+         options.replay, count - warm_up, processes, options.charts);
+  print_samples(samples);
+  snapshot_reader_close(reader);
+  return 0;
+}
+
+// Runs `f` in a child process, returns its exit status
+template <class F> int in_child(F f) {
+  fflush(stdout);
+  const pid_t child = fork();
+  if (child < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (child == 0) {
+    ImGui::CreateContext();
+    ImPlot::CreateContext();
+    const int res = f();
+    fflush(stdout);
+    _exit(res);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+bool parse_args(Options &options, const int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) return false;
+    ++i;
+    if (strcmp(arg, "--processes") == 0) {
+      options.scale_count = 0;
+      for (const char *it = value; *it && options.scale_count < MAX_SCALES;) {
+        char *end = nullptr;
+        options.scales[options.scale_count++] = strtoul(it, &end, 10);
+        it = *end == ',' ? end + 1 : end;
+      }
+    } else if (strcmp(arg, "--updates") == 0) {
+      options.updates = std::max<size_t>(strtoul(value, nullptr, 10), 1);
+    } else if (strcmp(arg, "--churn") == 0) {
+      options.churn = strtod(value, nullptr);
+    } else if (strcmp(arg, "--cpu-variance") == 0) {
+      options.cpu_variance = strtod(value, nullptr);
+    } else if (strcmp(arg, "--charts") == 0) {
+      options.charts = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--replay") == 0) {
+      options.replay = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options = {{1000, 10000, 100000}, 3, 200, 0.01, 5, 4, nullptr};
+  if (!parse_args(options, argc, argv)) {
+    fprintf(stderr,
+            "Usage: %s [--processes N,N,..] [--updates N] [--churn F]\n"
+            "          [--cpu-variance P] [--charts N] [--replay FILE]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (options.replay) {
+    return in_child([&options] { return run_replay(options); });
+  }
+  int res = 0;
+  for (size_t i = 0; i < options.scale_count; ++i) {
+    const size_t processes = std::max(options.scales[i], options.charts + 1);
+    res |= in_child(
+        [&options, processes] { return run_synthetic(options, processes); });
+    printf("\n");
+  }
+  return res;
+}
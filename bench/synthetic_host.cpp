@@ -0,0 +1,141 @@
+#include "synthetic_host.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char *const COMMS[] = {
+    "bash",     "sshd",     "kworker/0:1", "Web Content", "python3",
+    "postgres", "nginx",    "node",        "java",        "containerd",
+    "chrome",   "rsyslogd", "tmux: server", "(sd-pam)",   "systemd-journal",
+};
+
+uint64_t next_random(SyntheticHost &host) {
+  host.random ^= host.random << 13;
+  host.random ^= host.random >> 7;
+  host.random ^= host.random << 17;
+  return host.random;
+}
+
+size_t below(SyntheticHost &host, const size_t n) {
+  return n > 0 ? next_random(host) % n : 0;
+}
+
+double uniform(SyntheticHost &host, const double lo, const double hi) {
+  return lo + (hi - lo) * static_cast<double>(next_random(host) >> 11) /
+                  static_cast<double>(1ull << 53);
+}
+
+SyntheticProcess make_process(SyntheticHost &host, const int pid,
+                              const int ppid) {
+  SyntheticProcess res = {};
+  res.stat.pid = pid;
+  res.stat.ppid = ppid;
+  res.stat.state = 'S';
+  res.stat.comm = COMMS[below(host, sizeof(COMMS) / sizeof(COMMS[0]))];
+  res.stat.num_threads = 1 + static_cast<long>(below(host, 8));
+  res.stat.starttime = host.update * SYNTHETIC_HOST_TICKS_IN_SECOND;
+  res.stat.statm_size = 10000 + below(host, 100000);
+  res.stat.statm_resident = res.stat.statm_size / 4;
+  // Most processes idle, a few busy
+  res.base_cpu = below(host, 10) == 0 ? uniform(host, 5, 100)
+                                      : uniform(host, 0, 1);
+  return res;
+}
+
+} // namespace
+
+void synthetic_host_init(SyntheticHost &host,
+                         const SyntheticHostOptions &options) {
+  host.options = options;
+  host.options.stable = std::min(options.stable, options.processes);
+  host.processes.clear();
+  host.random = 0x2545f4914f6cdd1dull;
+  host.next_pid = 1;
+  for (size_t i = 0; i < options.processes; ++i) {
+    const int pid = host.next_pid++;
+    const int ppid = pid == 1 ? 0 : host.processes[below(host, i)].stat.pid;
+    host.processes.push_back(make_process(host, pid, ppid));
+  }
+}
+
+UpdateSnapshot synthetic_host_next(SyntheticHost &host, const size_t limit) {
+  const SyntheticHostOptions &options = host.options;
+  std::vector<SyntheticProcess> &processes = host.processes;
+  ++host.update;
+
+  // Exits among all but the stable processes, as many starts at new pids
+  const size_t mortal = processes.size() - options.stable;
+  host.pending_churn += options.churn * processes.size();
+  const size_t churn =
+      std::min(static_cast<size_t>(host.pending_churn), mortal);
+  host.pending_churn -= churn;
+  for (size_t exited = 0; exited < churn;) {
+    int &pid = processes[options.stable + below(host, mortal)].stat.pid;
+    if (pid != 0) ++exited;
+    pid = 0;
+  }
+  processes.erase(std::remove_if(processes.begin(), processes.end(),
+                                 [](const SyntheticProcess &process) {
+                                   return process.stat.pid == 0;
+                                 }),
+                  processes.end());
+  for (size_t i = 0; i < churn; ++i) {
+    const int ppid = processes.empty()
+                         ? 1
+                         : processes[below(host, processes.size())].stat.pid;
+    processes.push_back(make_process(host, host.next_pid++, ppid));
+  }
+
+  for (SyntheticProcess &process : processes) {
+    const double cpu = std::clamp(
+        process.base_cpu +
+            uniform(host, -options.cpu_variance, options.cpu_variance),
+        0.0, 100.0);
+    const ulong ticks =
+        static_cast<ulong>(cpu * SYNTHETIC_HOST_TICKS_IN_SECOND / 100);
+    process.stat.utime += ticks - ticks / 4;
+    process.stat.stime += ticks / 4;
+    process.stat.io_read_bytes += below(host, 4096) * ticks;
+    process.stat.io_write_bytes += below(host, 1024) * ticks;
+  }
+
+  // Every core busy for 10-90% of the second, [0] is their sum
+  CpuCoreStat &total = host.cores[0];
+  for (size_t i = 1; i <= SYNTHETIC_HOST_CORES; ++i) {
+    const ulong busy = 10 + below(host, 81);
+    const ulong system = busy / 4;
+    host.cores[i].user += busy - system;
+    host.cores[i].system += system;
+    host.cores[i].idle += SYNTHETIC_HOST_TICKS_IN_SECOND - busy;
+    total.user += busy - system;
+    total.system += system;
+    total.idle += SYNTHETIC_HOST_TICKS_IN_SECOND - busy;
+  }
+
+  const size_t count = std::min(limit, processes.size());
+  UpdateSnapshot res = {};
+  res.owner_arena = BumpArena::create();
+  res.stats = Array<ProcessStat>::create(res.owner_arena, count);
+  for (size_t i = 0; i < count; ++i) {
+    ProcessStat &stat = res.stats.data[i];
+    stat = processes[i].stat;
+    stat.comm = res.owner_arena.alloc_string_copy(stat.comm);
+  }
+  res.cpu_stats =
+      Array<CpuCoreStat>::create(res.owner_arena, SYNTHETIC_HOST_CORES + 1);
+  memcpy(res.cpu_stats.data, host.cores, sizeof(host.cores));
+  res.mem_info = {32768000, 8192000, 16384000, 512000,
+                  6144000,  8192000, 8000000};
+  host.disk_io.sectors_read += below(host, 20000);
+  host.disk_io.sectors_written += below(host, 10000);
+  host.net_io.bytes_received += below(host, 8 << 20);
+  host.net_io.bytes_transmitted += below(host, 2 << 20);
+  res.disk_io_stats = host.disk_io;
+  res.net_io_stats = host.net_io;
+  res.at = SteadyTimePoint{} + std::chrono::seconds(host.update);
+  res.system_time = SystemTimePoint{} +
+                    std::chrono::seconds(1700000000 + host.update);
+  return res;
+}
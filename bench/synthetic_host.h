@@ -0,0 +1,47 @@
+#pragma once
+
+#include "sources/sync.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Synthetic host feeding the UI benchmarks (prock_replay_bench,
+// prock_render_bench) with UpdateSnapshots at scales a normal machine does
+// not have. Between updates a share of the processes exits and as many new
+// ones start, and every process uses some CPU around its own base usage.
+// Content is deterministic for the same options.
+constexpr size_t SYNTHETIC_HOST_CORES = 16;
+constexpr uint64_t SYNTHETIC_HOST_TICKS_IN_SECOND = 100;
+constexpr uint64_t SYNTHETIC_HOST_PAGE_SIZE = 4096;
+
+struct SyntheticHostOptions {
+  size_t processes;
+  double churn;        // fraction of the processes replaced per update
+  double cpu_variance; // percent of one core around the base usage
+  size_t stable;       // the first processes never exit, e.g. charted ones
+};
+
+struct SyntheticProcess {
+  ProcessStat stat; // comm is a string literal
+  double base_cpu;  // percent of one core
+};
+
+struct SyntheticHost {
+  SyntheticHostOptions options;
+  std::vector<SyntheticProcess> processes; // sorted by pid
+  CpuCoreStat cores[SYNTHETIC_HOST_CORES + 1];
+  DiskIoStat disk_io;
+  NetIoStat net_io;
+  int next_pid;
+  size_t update;        // one second apart
+  double pending_churn; // fraction of a process carried to the next update
+  uint64_t random;
+};
+
+void synthetic_host_init(SyntheticHost &host,
+                         const SyntheticHostOptions &options);
+// Advances the host by one second and copies it into a new snapshot like
+// gather() makes, with only the first `limit` processes
+UpdateSnapshot synthetic_host_next(SyntheticHost &host,
+                                   size_t limit = SIZE_MAX);
@@ -1,3 +1,30 @@
 #include "base.h"
 
+#include <cstdarg>
+#include <cstdio>
+#include <pthread.h>
+
 SlabCache g_slab_cache;
+SlabCache g_large_slab_caches[LARGE_SLAB_CLASSES];
+std::atomic<size_t> g_mapped_slabs;
+std::atomic<size_t> g_slab_bytes;
+
+const char *g_proc_root = "/proc";
+
+void proc_path(char (&out)[PROC_PATH_SIZE], const char *format, ...) {
+  const int root_size = snprintf(out, PROC_PATH_SIZE, "%s", g_proc_root);
+  if (root_size < 0 || static_cast<size_t>(root_size) >= PROC_PATH_SIZE) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  vsnprintf(out + root_size, PROC_PATH_SIZE - root_size, format, args);
+  va_end(args);
+}
+
+void set_thread_name(const char *name) {
+#ifdef TRACY_ENABLE
+  tracy::SetThreadName(name);
+#endif
+  pthread_setname_np(pthread_self(), name);
+}
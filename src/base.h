@@ -9,11 +9,17 @@
 #include <memory>
 #include <sys/mman.h>
 
+#ifdef TRACY_ENABLE
+#include "tracy/Tracy.hpp"
+#endif
+
 using uint = unsigned int;
 using ulong = unsigned long;
 using ulonglong = unsigned long long;
 
 constexpr size_t SLAB_SIZE = 4096; // 4KB, matches page size
+// Released slabs up to this size are zeroed with memset, see ArenaSlab::reset
+constexpr size_t SLAB_MEMSET_BYTES = 64 * 1024;
 
 struct ArenaSlab {
   void *cur;
@@ -22,6 +28,7 @@ struct ArenaSlab {
   ArenaSlab *prev;
 
   static ArenaSlab *create(size_t size, ArenaSlab *prev = nullptr);
+  static void release(ArenaSlab *slab);
 
   void *advance(const size_t size) {
     void *res = cur;
@@ -30,17 +37,32 @@ struct ArenaSlab {
     return res;
   }
 
+  // Zeroed like a fresh mapping. Big slabs give their pages back instead of
+  // writing every one of them, the pages fault in zeroed on reuse.
   void reset() {
     cur = reinterpret_cast<uint8_t *>(this) + sizeof(ArenaSlab);
     left_size = total_size - sizeof(ArenaSlab);
-    memset(cur, 0, left_size);
+    if (total_size <= SLAB_MEMSET_BYTES) {
+      memset(cur, 0, left_size);
+      return;
+    }
+    memset(cur, 0, SLAB_SIZE - sizeof(ArenaSlab));
+    madvise(reinterpret_cast<uint8_t *>(this) + SLAB_SIZE,
+            total_size - SLAB_SIZE, MADV_DONTNEED);
   }
 };
 
 struct SlabCache {
   std::atomic<ArenaSlab *> head{nullptr};
-
-  void push(ArenaSlab *slab) {
+  std::atomic<size_t> size{0}; // slabs in the cache, for the Internals window
+
+  // False when the cache already holds `max_slabs`, the caller unmaps `slab`
+  bool push(ArenaSlab *slab, const size_t max_slabs = SIZE_MAX) {
+    // Counted before it can be popped, so size never wraps below 0
+    if (size.fetch_add(1, std::memory_order_relaxed) >= max_slabs) {
+      size.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
     slab->reset();
     ArenaSlab *old_head = head.load(std::memory_order_relaxed);
     do {
@@ -48,6 +70,7 @@ struct SlabCache {
     } while (!head.compare_exchange_weak(old_head, slab,
                                          std::memory_order_release,
                                          std::memory_order_relaxed));
+    return true;
   }
 
   ArenaSlab *pop() {
@@ -57,23 +80,60 @@ struct SlabCache {
     } while (!head.compare_exchange_weak(old_head, old_head->prev,
                                          std::memory_order_acquire,
                                          std::memory_order_relaxed));
+    size.fetch_sub(1, std::memory_order_relaxed);
     return old_head;
   }
 };
 
 extern SlabCache g_slab_cache;
 
-inline ArenaSlab *ArenaSlab::create(const size_t size, ArenaSlab *prev) {
+// Larger slabs are rounded up to SLAB_SIZE << (class + 1) and cached per
+// class, so arenas holding big arrays stop mapping memory once warmed up
+constexpr size_t LARGE_SLAB_CLASSES = 16; // up to 256 MB
+extern SlabCache g_large_slab_caches[LARGE_SLAB_CLASSES];
+// Slabs a class keeps up to, at least 2 so double buffered arenas reuse
+// theirs. One huge snapshot doesn't stay mapped for the life of the process.
+constexpr size_t LARGE_SLAB_CACHE_BYTES = 4 * 1024 * 1024;
+
+// Memory pool of all slabs in Tracy, handed out slabs count as allocated
+inline constexpr char TRACY_SLABS_POOL[] = "Arena slabs";
+
+// Slabs mapped so far, flat while arenas reuse cached slabs
+extern std::atomic<size_t> g_mapped_slabs;
+// Bytes of slabs handed out so far, cached or newly mapped
+extern std::atomic<size_t> g_slab_bytes;
+
+inline size_t large_slab_class(const size_t size) {
+  size_t res = 0;
+  while (res < LARGE_SLAB_CLASSES && (SLAB_SIZE << (res + 1)) < size) {
+    ++res;
+  }
+  return res;
+}
+
+inline size_t large_slab_cache_slabs(const size_t cls) {
+  const size_t res = LARGE_SLAB_CACHE_BYTES / (SLAB_SIZE << (cls + 1));
+  return res > 2 ? res : 2;
+}
+
+inline ArenaSlab *ArenaSlab::create(size_t size, ArenaSlab *prev) {
   ArenaSlab *res = nullptr;
 
   if (size == SLAB_SIZE) {
     res = g_slab_cache.pop();
+  } else if (size > SLAB_SIZE) {
+    const size_t cls = large_slab_class(size);
+    if (cls < LARGE_SLAB_CLASSES) {
+      size = SLAB_SIZE << (cls + 1);
+      res = g_large_slab_caches[cls].pop();
+    }
   }
 
   if (!res) {
     void *slab = mmap(nullptr, size, PROT_READ | PROT_WRITE,
                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if (slab == MAP_FAILED) return nullptr;
+    g_mapped_slabs.fetch_add(1, std::memory_order_relaxed);
     res = static_cast<ArenaSlab *>(slab);
     res->cur = static_cast<uint8_t *>(slab) + sizeof(ArenaSlab);
     res->left_size = size - sizeof(ArenaSlab);
@@ -81,9 +141,46 @@ inline ArenaSlab *ArenaSlab::create(const size_t size, ArenaSlab *prev) {
   }
 
   res->prev = prev;
+  g_slab_bytes.fetch_add(res->total_size, std::memory_order_relaxed);
+#ifdef TRACY_ENABLE
+  TracyAllocN(res, res->total_size, TRACY_SLABS_POOL);
+#endif
   return res;
 }
 
+// Slabs of a cached size go back to their cache unless it's full, others are
+// unmapped
+inline void ArenaSlab::release(ArenaSlab *slab) {
+#ifdef TRACY_ENABLE
+  TracyFreeN(slab, TRACY_SLABS_POOL);
+#endif
+  const size_t size = slab->total_size;
+  if (size == SLAB_SIZE) {
+    g_slab_cache.push(slab);
+    return;
+  }
+  if (size > SLAB_SIZE) {
+    const size_t cls = large_slab_class(size);
+    if (cls < LARGE_SLAB_CLASSES && size == SLAB_SIZE << (cls + 1) &&
+        g_large_slab_caches[cls].push(slab, large_slab_cache_slabs(cls))) {
+      return;
+    }
+  }
+  munmap(slab, size);
+}
+
+// Data of a slab kept between calls, replaced by a bigger one when it has less
+// than `size` bytes
+inline uint8_t *ensure_slab(ArenaSlab *&slab, const size_t size) {
+  if (!slab || slab->total_size - sizeof(ArenaSlab) < size) {
+    if (slab) ArenaSlab::release(slab);
+    const size_t slab_size = 2 * size + sizeof(ArenaSlab);
+    slab = ArenaSlab::create(slab_size > SLAB_SIZE ? slab_size : SLAB_SIZE);
+    if (!slab) std::abort();
+  }
+  return reinterpret_cast<uint8_t *>(slab) + sizeof(ArenaSlab);
+}
+
 struct BumpArena {
   ArenaSlab *cur_slab = nullptr;
 
@@ -127,16 +224,21 @@ struct BumpArena {
     return static_cast<T *>(alloc_raw(sizeof(T), alignof(T)));
   }
 
+  // Bytes of all slabs of the arena, used or not
+  size_t slab_bytes() const {
+    size_t res = 0;
+    for (const ArenaSlab *it = cur_slab; it; it = it->prev) {
+      res += it->total_size;
+    }
+    return res;
+  }
+
   void destroy() {
     ArenaSlab *it = cur_slab;
     cur_slab = nullptr;
     while (it) {
       ArenaSlab *prev = it->prev;
-      if (it->total_size == SLAB_SIZE) {
-        g_slab_cache.push(it);
-      } else {
-        munmap(it, it->total_size);
-      }
+      ArenaSlab::release(it);
       it = prev;
     }
   }
@@ -215,6 +317,140 @@ template <class T> struct GrowingArray {
   Array<T> to_array() { return {data(), size()}; }
 };
 
+// Append-only array stored in fixed-size chunks. Every chunk is exactly one
+// slab, so elements are never moved once written and destroy() hands all
+// chunks back to g_slab_cache. Only the small chunk pointer table is ever
+// reallocated.
+//
+// Indices are absolute: drop_front() releases old chunks without renumbering
+// the remaining elements, so live elements are [begin(), size()).
+template <class T> struct ChunkedArray {
+  static constexpr size_t CHUNK_SIZE =
+      (SLAB_SIZE - sizeof(ArenaSlab)) / sizeof(T);
+  static_assert(CHUNK_SIZE > 0, "element does not fit into a slab");
+  static_assert(sizeof(ArenaSlab) % alignof(T) == 0,
+                "chunk data would be misaligned");
+
+  ArenaSlab *index_slab; // owns the `chunks` table
+  T **chunks;            // chunks[0] is chunk number `first_chunk`
+  size_t first_chunk;
+  size_t begin_index;
+  size_t cur_size;
+
+  T *emplace_back() {
+    const size_t offset = cur_size % CHUNK_SIZE;
+    if (offset == 0) {
+      add_chunk();
+    }
+    return &chunks[cur_size++ / CHUNK_SIZE - first_chunk][offset];
+  }
+
+  void add_chunk() {
+    const size_t count = chunk_count() - first_chunk;
+    if (count == chunk_capacity()) {
+      const size_t new_size =
+          std::max(SLAB_SIZE, 2 * (index_slab ? index_slab->total_size : 0));
+      ArenaSlab *new_index = ArenaSlab::create(new_size);
+      if (!new_index) std::abort();
+      T **new_chunks =
+          static_cast<T **>(new_index->advance(new_index->left_size));
+      if (count > 0) memcpy(new_chunks, chunks, count * sizeof(T *));
+      if (index_slab) ArenaSlab::release(index_slab);
+      index_slab = new_index;
+      chunks = new_chunks;
+    }
+    ArenaSlab *slab = ArenaSlab::create(SLAB_SIZE);
+    if (!slab) std::abort();
+    chunks[count] = static_cast<T *>(slab->advance(CHUNK_SIZE * sizeof(T)));
+  }
+
+  // Makes an empty array start at absolute `index`
+  void start_at(const size_t index) {
+    first_chunk = index / CHUNK_SIZE;
+    begin_index = cur_size = first_chunk * CHUNK_SIZE;
+    if (index > cur_size) {
+      add_chunk();
+      begin_index = cur_size = index;
+    }
+  }
+
+  // Forgets elements before `index`, fully dropped chunks are released
+  void drop_front(const size_t index) {
+    begin_index = std::max(begin_index, std::min(index, cur_size));
+    const size_t dropped = begin_index / CHUNK_SIZE - first_chunk;
+    if (dropped == 0) return;
+    for (size_t i = 0; i < dropped; ++i) {
+      release_chunk(chunks[i]);
+    }
+    const size_t left = chunk_count() - first_chunk - dropped;
+    memmove(chunks, chunks + dropped, left * sizeof(T *));
+    first_chunk += dropped;
+  }
+
+  T &operator[](const size_t i) {
+    return chunks[i / CHUNK_SIZE - first_chunk][i % CHUNK_SIZE];
+  }
+  const T &operator[](const size_t i) const {
+    return chunks[i / CHUNK_SIZE - first_chunk][i % CHUNK_SIZE];
+  }
+
+  size_t begin() const { return begin_index; }
+  size_t size() const { return cur_size; }
+  size_t live_size() const { return cur_size - begin_index; }
+  bool contains(const size_t i) const {
+    return i >= begin_index && i < cur_size;
+  }
+  size_t chunk_count() const {
+    return (cur_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  }
+  size_t chunk_capacity() const {
+    return index_slab
+               ? (index_slab->total_size - sizeof(ArenaSlab)) / sizeof(T *)
+               : 0;
+  }
+
+  // Contiguous live span of chunk number `i`
+  Array<const T> chunk(const size_t i) const {
+    const size_t chunk_begin = i * CHUNK_SIZE;
+    const size_t from = std::max(chunk_begin, begin_index);
+    const size_t to = std::min(chunk_begin + CHUNK_SIZE, cur_size);
+    return {&chunks[i - first_chunk][from - chunk_begin], to - from};
+  }
+
+  size_t total_byte_size() const {
+    return (chunk_count() - first_chunk) * SLAB_SIZE +
+           (index_slab ? index_slab->total_size : 0);
+  }
+
+  T last_or(T def) const {
+    return cur_size > begin_index ? (*this)[cur_size - 1] : def;
+  }
+
+  // Copies elements [from, to) into contiguous memory
+  void copy_to(T *out, const size_t from, const size_t to) const {
+    for (size_t i = from; i < to;) {
+      const size_t offset = i % CHUNK_SIZE;
+      const size_t n = std::min(CHUNK_SIZE - offset, to - i);
+      memcpy(out, &(*this)[i], n * sizeof(T));
+      out += n;
+      i += n;
+    }
+  }
+
+  void destroy() {
+    for (size_t i = 0; i < chunk_count() - first_chunk; ++i) {
+      release_chunk(chunks[i]);
+    }
+    if (index_slab) ArenaSlab::release(index_slab);
+    *this = {};
+  }
+
+  static void release_chunk(T *chunk) {
+    ArenaSlab::release(reinterpret_cast<ArenaSlab *>(
+        reinterpret_cast<uint8_t *>(chunk) - sizeof(ArenaSlab)));
+  }
+};
+
 
 template<class T, class F>
 size_t lower_bound(const size_t size, F get_val, const T val) {
@@ -247,3 +483,16 @@ using SteadyTimePoint = std::chrono::time_point<SteadyClock>;
 
 using SystemClock = std::chrono::system_clock;
 using SystemTimePoint = std::chrono::time_point<SystemClock>;
+
+// procfs root of every source, "/proc" unless --proc-root points it at another
+// tree, e.g. a fixture of prock_bench. Set before the reader threads start.
+extern const char *g_proc_root;
+
+constexpr size_t PROC_PATH_SIZE = 256;
+
+// `format` appended to g_proc_root, e.g. proc_path(path, "/%d/stat", pid)
+__attribute__((format(printf, 2, 3))) void
+proc_path(char (&out)[PROC_PATH_SIZE], const char *format, ...);
+
+// Names the calling thread for debuggers, top -H and Tracy
+void set_thread_name(const char *name);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+// Writer into an export buffer (collector records, traces, metrics pages).
+// Callers compute the bound of what they write up front and size the buffer
+// for it, print() also stops at `capacity`.
+struct BoundedWriter {
+  char *data;
+  size_t size;
+  size_t capacity;
+
+  __attribute__((format(printf, 2, 3))) void print(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    const int n = vsnprintf(data + size, capacity - size, format, args);
+    va_end(args);
+    if (n > 0) size = std::min(size + static_cast<size_t>(n), capacity - 1);
+  }
+
+  void put(const void *value, const size_t bytes) {
+    memcpy(data + size, value, bytes);
+    size += bytes;
+  }
+
+  // Quoted with JSON escapes, at most 6 times as long as `str` plus 2
+  void print_json_string(const char *str) {
+    data[size++] = '"';
+    for (const char *it = str; *it; ++it) {
+      const unsigned char c = *it;
+      if (c == '"' || c == '\\') {
+        data[size++] = '\\';
+        data[size++] = c;
+      } else if (c < 0x20) {
+        print("\\u%04x", c);
+      } else {
+        data[size++] = c;
+      }
+    }
+    data[size++] = '"';
+  }
+};
@@ -0,0 +1,281 @@
+// prock-collect: the gathering loop of prock without GLFW and ImGui, for
+// machines without a display. See collector.h for the output formats,
+// trace_export.h for traces, sources/agent.h for the agent mode (--listen)
+// and metrics.h for the metrics mode (--metrics).
+
+#include "base.h"
+#include "collector.h"
+#include "metrics.h"
+#include "shm_publisher.h"
+#include "sources/agent.h"
+#include "sources/process_stat.h"
+#include "sources/snapshot_file.h"
+#include "sources/sync.h"
+#include "state.h"
+#include "trace_export.h"
+
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sys/resource.h>
+#include <thread>
+
+// UNITY BUILD:
+#include "base.cpp"
+#include "collector.cpp"
+#include "metrics.cpp"
+#include "self_stats.cpp"
+#include "shm_publisher.cpp"
+#include "sources/agent.cpp"
+#include "sources/environ_reader.cpp"
+#include "sources/library_reader.cpp"
+#include "sources/listener.cpp"
+#include "sources/process_stat.cpp"
+#include "sources/snapshot_codec.cpp"
+#include "sources/snapshot_file.cpp"
+#include "sources/socket_reader.cpp"
+#include "state.cpp"
+#include "trace_export.cpp"
+
+static Sync g_sync;
+
+static AgentServer g_agent;
+static MetricsServer g_metrics;
+
+static void on_signal(int) {
+  g_sync.quit.store(true);
+  if (g_agent.listener.wake_fds[1] > 0) agent_notify(g_agent);
+  if (g_metrics.listener.wake_fds[1] > 0) metrics_notify(g_metrics);
+}
+
+static double cpu_time_ms(const rusage &usage) {
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+// PATH -> PATH.1 -> PATH.2 ..., the oldest one is overwritten
+static FILE *rotate(const CollectOptions &options, FILE *file) {
+  fclose(file);
+  char from[PATH_MAX];
+  char to[PATH_MAX];
+  for (int i = options.keep_files - 1; i >= 1; --i) {
+    snprintf(from, sizeof(from), "%s.%d", options.output, i);
+    snprintf(to, sizeof(to), "%s.%d", options.output, i + 1);
+    rename(from, to);
+  }
+  if (options.keep_files > 0) {
+    snprintf(to, sizeof(to), "%s.1", options.output);
+    rename(options.output, to);
+  }
+  return fopen(options.output, "wb");
+}
+
+static bool write_record(FILE *out, const String &record) {
+  // A trace update without changes is empty
+  if (record.length == 0) return true;
+  if (fwrite(record.data, record.length, 1, out) != 1 || fflush(out) != 0) {
+    if (errno != EPIPE) perror("prock-collect: write");
+    return false;
+  }
+  return true;
+}
+
+// Gathers on its own thread, the main thread serves the clients
+static int run_agent(const CollectOptions &options, const State &state) {
+  AgentServer &server = g_agent;
+  if (!agent_listen(server, options.listen, state.system.ticks_in_second,
+                    state.system.mem_page_size)) {
+    return 1;
+  }
+  Sync &sync = g_sync;
+  sync.update_period.store(options.period);
+  sync.status_wanted.store(collect_needs_status(options));
+  std::thread gathering_thread{[&sync, &server] {
+    set_thread_name("gathering");
+    GatheringState gathering_state = {};
+    while (!sync.quit.load()) {
+      gather(gathering_state, sync);
+      agent_notify(server);
+    }
+  }};
+
+  agent_serve(server, sync);
+  sync.quit.store(true);
+  sync.quit_cv.notify_one();
+  gathering_thread.join();
+  agent_server_close(server);
+  return 0;
+}
+
+// Gathers on its own thread, the main thread answers scrapes
+static int run_metrics(const CollectOptions &options, State &state) {
+  MetricsServer &server = g_metrics;
+  const size_t top = options.top > 0 ? options.top : METRICS_MAX_TOP;
+  if (!metrics_listen(server, options.metrics, top)) {
+    return 1;
+  }
+  Sync &sync = g_sync;
+  sync.update_period.store(options.period);
+  sync.status_wanted.store(collect_needs_status(options));
+  std::thread gathering_thread{[&sync, &server] {
+    set_thread_name("gathering");
+    GatheringState gathering_state = {};
+    while (!sync.quit.load()) {
+      gather(gathering_state, sync);
+      metrics_notify(server);
+    }
+  }};
+
+  metrics_serve(server, state, sync);
+  sync.quit.store(true);
+  sync.quit_cv.notify_one();
+  gathering_thread.join();
+  metrics_server_close(server);
+  state.snapshot_arena.destroy();
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  CollectOptions options = collect_default_options();
+  if (!collect_parse_args(options, argc, argv)) {
+    return 1;
+  }
+  if (options.proc_root) {
+    g_proc_root = options.proc_root;
+  }
+
+  State state = {};
+  if (!state_init(state)) {
+    return 1;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN); // a closed pipe ends the loop on write
+  if (options.listen) {
+    return run_agent(options, state);
+  }
+  if (options.metrics) {
+    return run_metrics(options, state);
+  }
+
+  SnapshotReader reader = {};
+  if (options.from) {
+    if (!snapshot_reader_open(reader, options.from)) {
+      fprintf(stderr, "Failed to open recording: %s\n", options.from);
+      return 1;
+    }
+    // Rates are computed with the clock ticks and pages of the recorded host
+    state.system.ticks_in_second = reader.header->ticks_in_second;
+    state.system.mem_page_size = reader.header->mem_page_size;
+  }
+
+  // A trace is one JSON document, appending would break it
+  const bool trace = options.format == eCollectFormat_Trace;
+  FILE *out = stdout;
+  if (options.output) {
+    out = fopen(options.output, trace ? "wb" : "ab");
+    if (!out) {
+      fprintf(stderr, "Failed to open %s: %s\n", options.output,
+              strerror(errno));
+      return 1;
+    }
+  }
+  size_t written = out != stdout ? ftell(out) : 0;
+
+  ShmPublisher publisher = {};
+  if (options.shm && !shm_publisher_open(publisher, options.shm, SHM_MAX_CPUS,
+                                         SHM_MAX_PROCESSES)) {
+    return 1;
+  }
+
+  Sync &sync = g_sync;
+  sync.update_period.store(options.period);
+  sync.status_wanted.store(collect_needs_status(options));
+  GatheringState gathering_state = {};
+  Collector collector = {};
+  collector.options = options;
+  TraceExporter exporter = {};
+  if (trace && !write_record(out, trace_export_begin(exporter))) {
+    return 1;
+  }
+
+  rusage prev_usage = {};
+  getrusage(RUSAGE_SELF, &prev_usage);
+  SteadyTimePoint prev_at = SteadyClock::now();
+  size_t prev_mapped = g_mapped_slabs.load();
+
+  size_t next_record = 0;
+  while (!sync.quit.load()) {
+    UpdateSnapshot snapshot = {};
+    if (options.from) {
+      if (next_record == reader.index.size ||
+          !snapshot_reader_read(reader, next_record++, snapshot)) {
+        break;
+      }
+    } else {
+      gather(gathering_state, sync);
+      if (!sync.update_queue.pop(snapshot)) continue;
+    }
+
+    state_apply_snapshot(state, snapshot).destroy();
+    shm_publish(publisher, state);
+    // Rates need two updates
+    if (state.update_count < 2 || options.format == eCollectFormat_None) {
+      continue;
+    }
+
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    const SteadyTimePoint now = SteadyClock::now();
+    const size_t mapped = g_mapped_slabs.load();
+    CollectOverhead overhead = {};
+    overhead.cpu_ms = cpu_time_ms(usage) - cpu_time_ms(prev_usage);
+    const double wall_ms =
+        std::chrono::duration_cast<Seconds>(now - prev_at).count() * 1000;
+    overhead.cpu_perc = wall_ms > 0 ? overhead.cpu_ms / wall_ms * 100 : 0;
+    overhead.max_rss_kb = usage.ru_maxrss;
+    overhead.mapped_slabs = mapped - prev_mapped;
+    prev_usage = usage;
+    prev_at = now;
+    prev_mapped = mapped;
+
+    const double time = std::chrono::duration_cast<Seconds>(
+                            state.update_system_time.time_since_epoch())
+                            .count();
+    const String record =
+        trace ? trace_export_update(exporter, state.snapshot, time)
+              : collect_format(collector, state.snapshot, time, overhead);
+    if (!write_record(out, record)) {
+      break;
+    }
+
+    written += record.length;
+    if (options.output && options.rotate_bytes > 0 &&
+        written >= options.rotate_bytes) {
+      // Every file of a trace is a whole trace
+      if (trace && !write_record(out, trace_export_end(exporter))) {
+        break;
+      }
+      out = rotate(options, out);
+      written = 0;
+      if (!out) {
+        perror("prock-collect: rotate");
+        break;
+      }
+      if (trace && !write_record(out, trace_export_begin(exporter))) {
+        break;
+      }
+    }
+  }
+
+  if (out && trace) write_record(out, trace_export_end(exporter));
+  if (out && out != stdout) fclose(out);
+  if (options.from) snapshot_reader_close(reader);
+  trace_export_destroy(exporter);
+  shm_publisher_close(publisher);
+  collect_destroy(collector);
+  state.snapshot_arena.destroy();
+  return 0;
+}
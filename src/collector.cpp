@@ -0,0 +1,394 @@
+#include "collector.h"
+
+#include "bounded_writer.h"
+#include "state.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+struct CollectFieldInfo {
+  const char *name;
+  bool integral;
+};
+
+static constexpr CollectFieldInfo FIELDS[eCollectField_COUNT] = {
+    {"comm", false},         {"state", false},        {"ppid", true},
+    {"threads", true},       {"cpu", false},          {"cpu_user", false},
+    {"cpu_kernel", false},   {"mem_kb", true},        {"vmem_kb", true},
+    {"io_read_kbs", false},  {"io_write_kbs", false}, {"net_recv_kbs", false},
+    {"net_send_kbs", false}, {"run_delay", false},    {"ctxsw", false},
+    {"faults", false},       {"peak_mem_kb", true},   {"swap_kb", true},
+};
+
+static const char *SYSTEM_NAMES[COLLECT_SYSTEM_VALUES] = {
+    "cpu",           "cpu_kernel",    "mem_used_kb",       "mem_available_kb",
+    "swap_used_kb",  "disk_read_mbs", "disk_write_mbs",    "net_recv_mbs",
+    "net_send_mbs",  "self_cpu",      "self_cpu_ms",       "self_max_rss_kb",
+    "self_mapped_slabs",
+};
+
+static constexpr uint32_t DEFAULT_FIELDS =
+    1u << eCollectField_Comm | 1u << eCollectField_State |
+    1u << eCollectField_Cpu | 1u << eCollectField_Mem |
+    1u << eCollectField_IoRead | 1u << eCollectField_IoWrite |
+    1u << eCollectField_NetRecv | 1u << eCollectField_NetSend;
+
+const char *collect_field_name(const CollectField field) {
+  return FIELDS[field].name;
+}
+
+static bool is_numeric(const CollectField field) {
+  return field != eCollectField_Comm && field != eCollectField_State;
+}
+
+static double field_value(const CollectField field, const ProcessStat &stat,
+                          const ProcessDerivedStat &derived) {
+  switch (field) {
+  case eCollectField_Ppid:
+    return stat.ppid;
+  case eCollectField_Threads:
+    return static_cast<double>(stat.num_threads);
+  case eCollectField_Cpu:
+    return derived.cpu_user_perc + derived.cpu_kernel_perc;
+  case eCollectField_CpuUser:
+    return derived.cpu_user_perc;
+  case eCollectField_CpuKernel:
+    return derived.cpu_kernel_perc;
+  case eCollectField_Mem:
+    return derived.mem_resident_bytes / 1024;
+  case eCollectField_VirtualMem:
+    return derived.mem_virtual_bytes / 1024;
+  case eCollectField_IoRead:
+    return derived.io_read_kb_per_sec;
+  case eCollectField_IoWrite:
+    return derived.io_write_kb_per_sec;
+  case eCollectField_NetRecv:
+    return derived.net_recv_kb_per_sec;
+  case eCollectField_NetSend:
+    return derived.net_send_kb_per_sec;
+  case eCollectField_RunDelay:
+    return derived.run_delay_perc;
+  case eCollectField_Ctxsw:
+    return derived.ctxsw_per_sec;
+  case eCollectField_Faults:
+    return derived.faults_per_sec;
+  case eCollectField_PeakMem:
+    return derived.mem_peak_resident_bytes / 1024;
+  case eCollectField_Swap:
+    return derived.mem_swap_bytes / 1024;
+  case eCollectField_Comm:
+  case eCollectField_State:
+  case eCollectField_COUNT:
+    return 0;
+  }
+  return 0;
+}
+
+static bool parse_field(const char *name, const size_t len,
+                        CollectField &field) {
+  for (int i = 0; i < eCollectField_COUNT; ++i) {
+    if (strlen(FIELDS[i].name) == len &&
+        strncmp(FIELDS[i].name, name, len) == 0) {
+      field = static_cast<CollectField>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+CollectOptions collect_default_options() {
+  CollectOptions res = {};
+  res.period = 1.0f;
+  res.format = eCollectFormat_Json;
+  res.fields = DEFAULT_FIELDS;
+  res.sort_by = eCollectField_Cpu;
+  res.top = 20;
+  res.rotate_bytes = 64 * 1024 * 1024;
+  res.keep_files = 5;
+  return res;
+}
+
+bool collect_needs_status(const CollectOptions &options) {
+  constexpr uint32_t status_fields = 1u << eCollectField_Ctxsw |
+                                     1u << eCollectField_PeakMem |
+                                     1u << eCollectField_Swap;
+  return (options.fields & status_fields) != 0;
+}
+
+void collect_print_usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --period S       seconds between records (default 1)\n"
+          "  --format F       json (one object per line), binary, trace\n"
+          "                   (Chrome / Perfetto JSON) or none\n"
+          "  --fields A,B,..  process fields or \"all\", pid is always "
+          "included\n"
+          "  --top N          only N processes with the highest --sort "
+          "value,\n"
+          "                   0 for all (default 20)\n"
+          "  --sort FIELD     numeric field for --top (default cpu)\n"
+          "  --output PATH    write to PATH instead of stdout\n"
+          "  --rotate-mb N    start a new file after N MB (default 64, 0 "
+          "never)\n"
+          "  --keep N         rotated files to keep as PATH.1.. (default 5)\n"
+          "  --listen ADDR    agent mode: stream snapshots to prock "
+          "--connect\n"
+          "                   GUIs on unix:PATH or HOST:PORT instead, "
+          ":PORT is\n"
+          "                   loopback only\n"
+          "  --metrics ADDR   metrics mode: serve OpenMetrics on "
+          "http://ADDR/metrics\n"
+          "                   instead, --top N (at most 100) processes by cpu "
+          "and\n"
+          "                   by memory\n"
+          "  --shm NAME       also publish every record to the shared "
+          "memory\n"
+          "                   object NAME (/prock), see prock_shm.h\n"
+          "  --from FILE      read a prock --record recording as fast as "
+          "possible\n"
+          "                   instead of gathering\n"
+          "  --proc-root DIR  read procfs from DIR instead of /proc\n"
+          "Fields:",
+          argv0);
+  for (const CollectFieldInfo &field : FIELDS) {
+    fprintf(stderr, " %s", field.name);
+  }
+  fprintf(stderr, "\n");
+}
+
+bool collect_parse_args(CollectOptions &options, const int argc,
+                        char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--help") == 0) {
+      collect_print_usage(argv[0]);
+      return false;
+    }
+    if (!value) {
+      fprintf(stderr, "Unknown option or missing value: %s\n", arg);
+      return false;
+    }
+    ++i;
+
+    if (strcmp(arg, "--period") == 0) {
+      options.period = strtof(value, nullptr);
+      if (options.period <= 0.0f) {
+        fprintf(stderr, "Period must be positive: %s\n", value);
+        return false;
+      }
+    } else if (strcmp(arg, "--format") == 0) {
+      if (strcmp(value, "json") == 0) {
+        options.format = eCollectFormat_Json;
+      } else if (strcmp(value, "binary") == 0) {
+        options.format = eCollectFormat_Binary;
+      } else if (strcmp(value, "trace") == 0) {
+        options.format = eCollectFormat_Trace;
+      } else if (strcmp(value, "none") == 0) {
+        options.format = eCollectFormat_None;
+      } else {
+        fprintf(stderr, "Unknown format: %s\n", value);
+        return false;
+      }
+    } else if (strcmp(arg, "--fields") == 0) {
+      if (strcmp(value, "all") == 0) {
+        options.fields = (1u << eCollectField_COUNT) - 1;
+        continue;
+      }
+      options.fields = 0;
+      for (const char *it = value; *it;) {
+        const char *end = strchr(it, ',');
+        const size_t len = end ? end - it : strlen(it);
+        CollectField field;
+        if (!parse_field(it, len, field)) {
+          fprintf(stderr, "Unknown field: %.*s\n", static_cast<int>(len), it);
+          return false;
+        }
+        options.fields |= 1u << field;
+        it += end ? len + 1 : len;
+      }
+    } else if (strcmp(arg, "--top") == 0) {
+      options.top = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--sort") == 0) {
+      if (!parse_field(value, strlen(value), options.sort_by) ||
+          !is_numeric(options.sort_by)) {
+        fprintf(stderr, "Not a numeric field: %s\n", value);
+        return false;
+      }
+    } else if (strcmp(arg, "--output") == 0) {
+      options.output = value;
+    } else if (strcmp(arg, "--rotate-mb") == 0) {
+      options.rotate_bytes = strtoul(value, nullptr, 10) * 1024 * 1024;
+    } else if (strcmp(arg, "--keep") == 0) {
+      options.keep_files = atoi(value);
+    } else if (strcmp(arg, "--listen") == 0) {
+      options.listen = value;
+    } else if (strcmp(arg, "--metrics") == 0) {
+      options.metrics = value;
+    } else if (strcmp(arg, "--shm") == 0) {
+      options.shm = value;
+    } else if (strcmp(arg, "--from") == 0) {
+      options.from = value;
+    } else if (strcmp(arg, "--proc-root") == 0) {
+      options.proc_root = value;
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      return false;
+    }
+  }
+  if ((options.listen != nullptr) + (options.metrics != nullptr) +
+          (options.shm != nullptr) >
+      1) {
+    fprintf(stderr, "--listen, --metrics and --shm are exclusive\n");
+    return false;
+  }
+  if (options.from && (options.listen || options.metrics)) {
+    fprintf(stderr, "--from only works with --format output\n");
+    return false;
+  }
+  return true;
+}
+
+static void put_float(BoundedWriter &out, const double value) {
+  const float f = static_cast<float>(value);
+  out.put(&f, sizeof(f));
+}
+
+static void system_values(const StateSnapshot &snapshot,
+                          const CollectOverhead &overhead,
+                          double (&values)[COLLECT_SYSTEM_VALUES]) {
+  const MemInfo &mem = snapshot.mem_info;
+  const SystemCpuPerc &cpu = snapshot.cpu_perc;
+  values[0] = cpu.total.size > 0 ? cpu.total.data[0] : 0;
+  values[1] = cpu.kernel.size > 0 ? cpu.kernel.data[0] : 0;
+  values[2] = static_cast<double>(mem.mem_total - mem.mem_available);
+  values[3] = static_cast<double>(mem.mem_available);
+  values[4] = static_cast<double>(mem.swap_total - mem.swap_free);
+  values[5] = snapshot.disk_io_rate.read_mb_per_sec;
+  values[6] = snapshot.disk_io_rate.write_mb_per_sec;
+  values[7] = snapshot.net_io_rate.recv_mb_per_sec;
+  values[8] = snapshot.net_io_rate.send_mb_per_sec;
+  values[9] = overhead.cpu_perc;
+  values[10] = overhead.cpu_ms;
+  values[11] = static_cast<double>(overhead.max_rss_kb);
+  values[12] = static_cast<double>(overhead.mapped_slabs);
+}
+
+String collect_format(Collector &collector, const StateSnapshot &snapshot,
+                      const double time, const CollectOverhead &overhead) {
+  ZoneScoped;
+  const CollectOptions &options = collector.options;
+  const size_t total = snapshot.stats.size;
+
+  // Indices of reported processes, highest --sort value first
+  uint32_t *order = reinterpret_cast<uint32_t *>(
+      ensure_slab(collector.order, total * sizeof(uint32_t)));
+  for (size_t i = 0; i < total; ++i) {
+    order[i] = static_cast<uint32_t>(i);
+  }
+  size_t count = total;
+  const auto higher = [&](const uint32_t left, const uint32_t right) {
+    const double l = field_value(options.sort_by, snapshot.stats.data[left],
+                                 snapshot.derived_stats.data[left]);
+    const double r = field_value(options.sort_by, snapshot.stats.data[right],
+                                 snapshot.derived_stats.data[right]);
+    return l != r ? l > r : left < right;
+  };
+  if (options.top > 0 && options.top < total) {
+    count = options.top;
+    std::partial_sort(order, order + count, order + total, higher);
+  } else if (options.top > 0) {
+    std::sort(order, order + total, higher);
+  }
+
+  size_t bound = 1024 + COLLECT_SYSTEM_VALUES * 64;
+  for (size_t i = 0; i < count; ++i) {
+    const char *comm = snapshot.stats.data[order[i]].comm;
+    bound += 64 + eCollectField_COUNT * 48 + 6 * (comm ? strlen(comm) : 0);
+  }
+  BoundedWriter out = {
+      reinterpret_cast<char *>(ensure_slab(collector.buffer, bound)), 0,
+      bound};
+
+  double system[COLLECT_SYSTEM_VALUES];
+  system_values(snapshot, overhead, system);
+
+  if (options.format == eCollectFormat_Binary) {
+    CollectFrameHeader header = {};
+    header.magic = COLLECT_FRAME_MAGIC;
+    header.version = COLLECT_FORMAT_VERSION;
+    header.fields = options.fields;
+    header.process_count = static_cast<uint32_t>(count);
+    header.total_processes = static_cast<uint32_t>(total);
+    header.time = time;
+    out.put(&header, sizeof(header));
+    for (const double value : system) {
+      put_float(out, value);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      const ProcessStat &stat = snapshot.stats.data[order[i]];
+      const ProcessDerivedStat &derived = snapshot.derived_stats.data[order[i]];
+      const int32_t pid = stat.pid;
+      out.put(&pid, sizeof(pid));
+      for (int f = 0; f < eCollectField_COUNT; ++f) {
+        if (!(options.fields & (1u << f))) continue;
+        const CollectField field = static_cast<CollectField>(f);
+        if (field == eCollectField_Comm) {
+          const char *comm = stat.comm ? stat.comm : "";
+          const uint8_t len =
+              static_cast<uint8_t>(std::min<size_t>(strlen(comm), 255));
+          out.put(&len, sizeof(len));
+          out.put(comm, len);
+        } else if (field == eCollectField_State) {
+          out.put(&stat.state, sizeof(stat.state));
+        } else {
+          put_float(out, field_value(field, stat, derived));
+        }
+      }
+    }
+    const uint32_t bytes = static_cast<uint32_t>(out.size);
+    memcpy(out.data + offsetof(CollectFrameHeader, bytes), &bytes,
+           sizeof(bytes));
+    return {out.data, out.size};
+  }
+
+  out.print("{\"time\":%.3f", time);
+  for (size_t i = 0; i < COLLECT_SYSTEM_VALUES; ++i) {
+    out.print(",\"%s\":%.2f", SYSTEM_NAMES[i], system[i]);
+  }
+  out.print(",\"total_procs\":%zu,\"procs\":[", total);
+  for (size_t i = 0; i < count; ++i) {
+    const ProcessStat &stat = snapshot.stats.data[order[i]];
+    const ProcessDerivedStat &derived = snapshot.derived_stats.data[order[i]];
+    out.print("%s{\"pid\":%d", i > 0 ? "," : "", stat.pid);
+    for (int f = 0; f < eCollectField_COUNT; ++f) {
+      if (!(options.fields & (1u << f))) continue;
+      const CollectField field = static_cast<CollectField>(f);
+      out.print(",\"%s\":", FIELDS[f].name);
+      if (field == eCollectField_Comm) {
+        out.print_json_string(stat.comm ? stat.comm : "");
+      } else if (field == eCollectField_State) {
+        out.print("\"%c\"", stat.state ? stat.state : '?');
+      } else {
+        const double value = field_value(field, stat, derived);
+        if (FIELDS[f].integral) {
+          out.print("%.0f", value);
+        } else {
+          out.print("%.2f", value);
+        }
+      }
+    }
+    out.print("}");
+  }
+  out.print("]}\n");
+  return {out.data, out.size};
+}
+
+void collect_destroy(Collector &collector) {
+  if (collector.buffer) ArenaSlab::release(collector.buffer);
+  if (collector.order) ArenaSlab::release(collector.order);
+  collector = {};
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "base.h"
+
+struct StateSnapshot;
+
+// Headless collector (prock-collect): one record per update with system
+// stats, the collector's own overhead and the selected processes.
+//
+// JSON: one object per line, processes in "procs".
+// Trace: a Chrome / Perfetto JSON trace, see trace_export.h.
+// Binary: little endian frames of
+//   CollectFrameHeader
+//   float[COLLECT_SYSTEM_VALUES] system values
+//   per process: int32 pid, then for every selected field in field order
+//   a float, except comm (uint8 length + bytes) and state (one char)
+enum CollectField {
+  eCollectField_Comm,
+  eCollectField_State,
+  eCollectField_Ppid,
+  eCollectField_Threads,
+  eCollectField_Cpu,
+  eCollectField_CpuUser,
+  eCollectField_CpuKernel,
+  eCollectField_Mem,
+  eCollectField_VirtualMem,
+  eCollectField_IoRead,
+  eCollectField_IoWrite,
+  eCollectField_NetRecv,
+  eCollectField_NetSend,
+  eCollectField_RunDelay,
+  eCollectField_Ctxsw,
+  eCollectField_Faults,
+  eCollectField_PeakMem,
+  eCollectField_Swap,
+  eCollectField_COUNT,
+};
+
+enum CollectFormat {
+  eCollectFormat_Json,
+  eCollectFormat_Binary,
+  eCollectFormat_Trace,
+  eCollectFormat_None, // no records, e.g. only --shm
+};
+
+constexpr uint32_t COLLECT_FRAME_MAGIC = 0x4b434f52; // "ROCK"
+constexpr uint32_t COLLECT_FORMAT_VERSION = 1;
+constexpr size_t COLLECT_SYSTEM_VALUES = 13;
+
+struct CollectFrameHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t bytes; // whole frame
+  uint32_t fields; // bit mask of CollectField
+  uint32_t process_count;   // in this frame
+  uint32_t total_processes; // before top-N
+  double time;              // seconds since epoch
+};
+
+struct CollectOptions {
+  float period; // seconds
+  CollectFormat format;
+  uint32_t fields; // bit mask of CollectField
+  CollectField sort_by;
+  size_t top; // 0 = every process
+  const char *output; // nullptr = stdout
+  size_t rotate_bytes; // 0 = never rotate
+  int keep_files;      // rotated files kept next to `output`
+  const char *listen;  // agent mode address, see sources/agent.h
+  const char *metrics; // metrics mode address, see metrics.h
+  const char *shm;     // shared memory name, see prock_shm.h
+  const char *from;    // recording read instead of gathering, nullptr = live
+  // procfs root read when gathering, nullptr = /proc
+  const char *proc_root;
+};
+
+// Collector's own cost, reported in every record
+struct CollectOverhead {
+  double cpu_perc;     // of one core since the previous record
+  double cpu_ms;       // CPU time spent since the previous record
+  size_t max_rss_kb;
+  size_t mapped_slabs; // new memory mappings since the previous record
+};
+
+struct Collector {
+  CollectOptions options;
+  ArenaSlab *buffer; // formatted record, grown on demand
+  ArenaSlab *order;  // process indices, grown on demand
+};
+
+const char *collect_field_name(CollectField field);
+CollectOptions collect_default_options();
+// Parses command line arguments, prints the problem and returns false on error
+bool collect_parse_args(CollectOptions &options, int argc, char **argv);
+void collect_print_usage(const char *argv0);
+// Fields from /proc/[pid]/status are selected, it's read on every gather then
+bool collect_needs_status(const CollectOptions &options);
+
+// Formats one record of `snapshot`, valid until the next call
+String collect_format(Collector &collector, const StateSnapshot &snapshot,
+                      double time, const CollectOverhead &overhead);
+void collect_destroy(Collector &collector);
@@ -0,0 +1,193 @@
+#include "gorilla.h"
+
+#include <cmath>
+
+namespace {
+
+// Most significant bit first
+struct BitWriter {
+  uint8_t *out;
+  size_t bytes;
+  uint64_t acc;
+  uint bits;
+
+  void write(uint64_t value, uint count) {
+    if (count > 32) {
+      write(value >> 32, count - 32);
+      count = 32;
+    }
+    acc = (acc << count) | (value & ((1ull << count) - 1));
+    bits += count;
+    while (bits >= 8) {
+      bits -= 8;
+      out[bytes++] = static_cast<uint8_t>(acc >> bits);
+    }
+    acc &= (1ull << bits) - 1;
+  }
+
+  size_t finish() {
+    if (bits > 0) out[bytes++] = static_cast<uint8_t>(acc << (8 - bits));
+    return bytes;
+  }
+};
+
+struct BitReader {
+  const uint8_t *in;
+  uint64_t acc;
+  uint bits;
+
+  uint64_t read(uint count) {
+    if (count > 32) {
+      const uint64_t high = read(count - 32);
+      return (high << 32) | read(32);
+    }
+    while (bits < count) {
+      acc = (acc << 8) | *in++;
+      bits += 8;
+    }
+    bits -= count;
+    const uint64_t res = (acc >> bits) & ((1ull << count) - 1);
+    acc &= (1ull << bits) - 1;
+    return res;
+  }
+};
+
+// Delta-of-delta buckets: prefix bits, prefix and payload width
+struct DodBucket {
+  uint64_t prefix;
+  uint prefix_bits;
+  uint value_bits;
+};
+
+constexpr DodBucket DOD_BUCKETS[] = {
+    {0b10, 2, 7}, {0b110, 3, 9}, {0b1110, 4, 12}, {0b11110, 5, 32}};
+
+int64_t sign_extend(const uint64_t value, const uint bits) {
+  const uint64_t sign = 1ull << (bits - 1);
+  return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+} // namespace
+
+size_t gorilla_encode(const double *values, uint8_t *out) {
+  BitWriter writer = {out, 0, 0, 0};
+  int64_t prev = std::llround(values[0] * 1000);
+  int64_t prev_delta = 0;
+  writer.write(static_cast<uint64_t>(prev), 64);
+
+  for (size_t i = 1; i < GORILLA_BLOCK; ++i) {
+    const int64_t cur = std::llround(values[i] * 1000);
+    const int64_t delta = cur - prev;
+    const int64_t dod = delta - prev_delta;
+    prev = cur;
+    prev_delta = delta;
+
+    if (dod == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+    bool written = false;
+    for (const DodBucket &bucket : DOD_BUCKETS) {
+      const int64_t limit = int64_t(1) << (bucket.value_bits - 1);
+      if (dod >= -limit && dod < limit) {
+        writer.write(bucket.prefix, bucket.prefix_bits);
+        writer.write(static_cast<uint64_t>(dod), bucket.value_bits);
+        written = true;
+        break;
+      }
+    }
+    if (!written) {
+      writer.write(0b11111, 5);
+      writer.write(static_cast<uint64_t>(dod), 64);
+    }
+  }
+  return writer.finish();
+}
+
+void gorilla_decode(const uint8_t *in, double *values) {
+  BitReader reader = {in, 0, 0};
+  int64_t prev = static_cast<int64_t>(reader.read(64));
+  int64_t prev_delta = 0;
+  values[0] = prev / 1000.0;
+
+  for (size_t i = 1; i < GORILLA_BLOCK; ++i) {
+    int64_t dod = 0;
+    if (reader.read(1) != 0) {
+      uint ones = 1;
+      while (ones < 5 && reader.read(1) != 0) {
+        ++ones;
+      }
+      if (ones == 5) {
+        dod = static_cast<int64_t>(reader.read(64));
+      } else {
+        const uint bits = DOD_BUCKETS[ones - 1].value_bits;
+        dod = sign_extend(reader.read(bits), bits);
+      }
+    }
+    prev_delta += dod;
+    prev += prev_delta;
+    values[i] = prev / 1000.0;
+  }
+}
+
+static uint32_t float_bits(const float value) {
+  uint32_t res;
+  memcpy(&res, &value, sizeof(res));
+  return res;
+}
+
+size_t gorilla_encode(const float *values, uint8_t *out) {
+  BitWriter writer = {out, 0, 0, 0};
+  uint32_t prev = float_bits(values[0]);
+  writer.write(prev, 32);
+
+  // Window of meaningful bits used by the previous value
+  uint prev_leading = 33;
+  uint prev_trailing = 0;
+  for (size_t i = 1; i < GORILLA_BLOCK; ++i) {
+    const uint32_t cur = float_bits(values[i]);
+    const uint32_t x = cur ^ prev;
+    prev = cur;
+    if (x == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+
+    const uint leading = std::min(__builtin_clz(x), 31);
+    const uint trailing = __builtin_ctz(x);
+    if (leading >= prev_leading && trailing >= prev_trailing) {
+      writer.write(0b10, 2);
+      writer.write(x >> prev_trailing, 32 - prev_leading - prev_trailing);
+    } else {
+      const uint meaningful = 32 - leading - trailing;
+      writer.write(0b11, 2);
+      writer.write(leading, 5);
+      writer.write(meaningful - 1, 5);
+      writer.write(x >> trailing, meaningful);
+      prev_leading = leading;
+      prev_trailing = trailing;
+    }
+  }
+  return writer.finish();
+}
+
+void gorilla_decode(const uint8_t *in, float *values) {
+  BitReader reader = {in, 0, 0};
+  uint32_t prev = static_cast<uint32_t>(reader.read(32));
+  memcpy(&values[0], &prev, sizeof(prev));
+
+  uint leading = 0;
+  uint trailing = 0;
+  for (size_t i = 1; i < GORILLA_BLOCK; ++i) {
+    if (reader.read(1) != 0) {
+      if (reader.read(1) != 0) {
+        leading = static_cast<uint>(reader.read(5));
+        const uint meaningful = static_cast<uint>(reader.read(5)) + 1;
+        trailing = 32 - leading - meaningful;
+      }
+      const uint meaningful = 32 - leading - trailing;
+      prev ^= static_cast<uint32_t>(reader.read(meaningful)) << trailing;
+    }
+    memcpy(&values[i], &prev, sizeof(prev));
+  }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "base.h"
+
+#include <algorithm>
+
+// Gorilla style compression of chart history ("Gorilla: A Fast, Scalable,
+// In-Memory Time Series Database", Pelkonen et al.).
+//
+// Values are kept in blocks of GORILLA_BLOCK. The newest block stays
+// uncompressed, every full block is encoded once and decoded on demand:
+// - times (double) as delta-of-delta of milliseconds, so times must have
+//   millisecond precision to survive the round trip
+// - values (float) XORed with the previous value, storing only the bits
+//   between leading and trailing zeros
+constexpr size_t GORILLA_BLOCK = 240;
+
+// Worst case of a double block: 64 bits and then 5 + 64 bits per value
+constexpr size_t GORILLA_MAX_BLOCK_BYTES =
+    (64 + (GORILLA_BLOCK - 1) * 69 + 7) / 8;
+static_assert(GORILLA_MAX_BLOCK_BYTES <= SLAB_SIZE - sizeof(ArenaSlab),
+              "encoded block must fit into a slab");
+
+// Encode one block of GORILLA_BLOCK values into `out`, returning its size
+size_t gorilla_encode(const double *values, uint8_t *out);
+size_t gorilla_encode(const float *values, uint8_t *out);
+void gorilla_decode(const uint8_t *in, double *values);
+void gorilla_decode(const uint8_t *in, float *values);
+
+struct GorillaBlock {
+  ArenaSlab *slab; // shared by consecutive blocks
+  uint32_t offset;
+  uint32_t bytes;
+};
+
+// Append-only array with the interface of ChunkedArray, indices are absolute
+// and drop_front() releases the memory of old blocks.
+template <class T> struct GorillaArray {
+  static_assert(2 * GORILLA_BLOCK * sizeof(T) <=
+                    SLAB_SIZE - sizeof(ArenaSlab),
+                "open and decoded blocks must fit into a slab");
+
+  ChunkedArray<GorillaBlock> blocks; // encoded blocks by block number
+  ArenaSlab *hot;  // the open block followed by the decoded block
+  ArenaSlab *pool; // receives newly encoded blocks
+  size_t slab_count; // slabs holding encoded blocks
+  size_t begin_index;
+  size_t cur_size;
+  mutable size_t decoded; // block number + 1 of the decoded block, 0 if none
+
+  T *emplace_back() {
+    if (!hot) init();
+    if (cur_size % GORILLA_BLOCK == 0 &&
+        blocks.size() < cur_size / GORILLA_BLOCK) {
+      seal();
+    }
+    return &open_data()[cur_size++ % GORILLA_BLOCK];
+  }
+
+  // Makes an empty array start at absolute `index`
+  void start_at(const size_t index) {
+    begin_index = cur_size = index;
+    blocks.start_at(index / GORILLA_BLOCK);
+  }
+
+  // Forgets elements before `index`, fully dropped blocks are released
+  void drop_front(const size_t index) {
+    begin_index = std::max(begin_index, std::min(index, cur_size));
+    const size_t first_live =
+        std::min(begin_index / GORILLA_BLOCK, blocks.size());
+    while (blocks.begin() < first_live) {
+      const size_t b = blocks.begin();
+      ArenaSlab *slab = blocks[b].slab;
+      const bool last_in_slab =
+          b + 1 < blocks.size() ? blocks[b + 1].slab != slab : slab != pool;
+      if (last_in_slab) {
+        ArenaSlab::release(slab);
+        --slab_count;
+      }
+      blocks.drop_front(b + 1);
+    }
+  }
+
+  const T &operator[](const size_t i) const {
+    const size_t block = i / GORILLA_BLOCK;
+    if (block >= blocks.size()) {
+      return open_data()[i % GORILLA_BLOCK];
+    }
+    T *decoded_data = open_data() + GORILLA_BLOCK;
+    if (decoded != block + 1) {
+      const GorillaBlock &encoded = blocks[block];
+      gorilla_decode(reinterpret_cast<const uint8_t *>(encoded.slab) +
+                         encoded.offset,
+                     decoded_data);
+      decoded = block + 1;
+    }
+    return decoded_data[i % GORILLA_BLOCK];
+  }
+
+  size_t begin() const { return begin_index; }
+  size_t size() const { return cur_size; }
+  size_t live_size() const { return cur_size - begin_index; }
+  bool contains(const size_t i) const {
+    return i >= begin_index && i < cur_size;
+  }
+
+  size_t total_byte_size() const {
+    return blocks.total_byte_size() + (hot ? SLAB_SIZE : 0) +
+           slab_count * SLAB_SIZE;
+  }
+
+  // Bytes of encoded blocks, without slab slack
+  size_t encoded_byte_size() const {
+    size_t res = 0;
+    for (size_t b = blocks.begin(); b < blocks.size(); ++b) {
+      res += blocks[b].bytes;
+    }
+    return res;
+  }
+
+  T last_or(T def) const {
+    return cur_size > begin_index ? (*this)[cur_size - 1] : def;
+  }
+
+  void destroy() {
+    ArenaSlab *prev = nullptr;
+    for (size_t b = blocks.begin(); b < blocks.size(); ++b) {
+      if (blocks[b].slab != prev) {
+        prev = blocks[b].slab;
+        ArenaSlab::release(prev);
+      }
+    }
+    if (pool && pool != prev) ArenaSlab::release(pool);
+    if (hot) ArenaSlab::release(hot);
+    blocks.destroy();
+    *this = {};
+  }
+
+  T *open_data() const {
+    return reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(hot) +
+                                 sizeof(ArenaSlab));
+  }
+
+  void init() {
+    hot = ArenaSlab::create(SLAB_SIZE);
+    if (!hot) std::abort();
+    memset(open_data(), 0, GORILLA_BLOCK * sizeof(T));
+  }
+
+  void seal() {
+    uint8_t buf[GORILLA_MAX_BLOCK_BYTES];
+    const size_t bytes = gorilla_encode(open_data(), buf);
+    if (!pool || pool->left_size < bytes) {
+      pool = ArenaSlab::create(SLAB_SIZE);
+      if (!pool) std::abort();
+      ++slab_count;
+    }
+    const uint32_t offset = static_cast<uint32_t>(
+        static_cast<uint8_t *>(pool->cur) - reinterpret_cast<uint8_t *>(pool));
+    memcpy(pool->advance(bytes), buf, bytes);
+    *blocks.emplace_back() = {pool, offset, static_cast<uint32_t>(bytes)};
+  }
+};
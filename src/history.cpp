@@ -0,0 +1,388 @@
+#include "history.h"
+
+#include <algorithm>
+#include <cmath>
+
+HistoryStore g_history;
+
+// Byte accounting for both ChunkedArray and GorillaArray
+template <template <class> class A, class T>
+static T *tracked_emplace_back(A<T> &arr) {
+  const size_t before = arr.total_byte_size();
+  T *res = arr.emplace_back();
+  g_history.used_bytes += arr.total_byte_size() - before;
+  return res;
+}
+
+template <template <class> class A, class T>
+static void tracked_drop_front(A<T> &arr, const size_t index) {
+  const size_t before = arr.total_byte_size();
+  arr.drop_front(index);
+  g_history.used_bytes -= before - arr.total_byte_size();
+}
+
+template <template <class> class A, class T>
+static void tracked_destroy(A<T> &arr) {
+  g_history.used_bytes -= arr.total_byte_size();
+  arr.destroy();
+}
+
+// Absolute index of the first element greater than `val` (or not less than
+// `val` when `inclusive` is set)
+static size_t upper_index(const GorillaArray<double> &times, const double val,
+                          const bool inclusive = false) {
+  size_t left = times.begin();
+  size_t right = times.size();
+  while (left < right) {
+    const size_t mid = (left + right) / 2;
+    if (times[mid] < val || (!inclusive && times[mid] == val)) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+// Times are compressed as milliseconds
+static double quantize_time(const double time) {
+  return std::round(time * 1000) / 1000;
+}
+
+void history_push_time(HistoryTimeline &timeline, double time) {
+  time = quantize_time(time);
+  *tracked_emplace_back(timeline.times[0]) = time;
+
+  for (size_t l = 1; l < HISTORY_LEVELS; ++l) {
+    const double secs = HISTORY_BUCKET_SECS[l];
+    const double start = std::floor(time / secs) * secs;
+    timeline.closed_count[l] = 0;
+    if (timeline.open_count[l] > 0 && start != timeline.open_start[l]) {
+      *tracked_emplace_back(timeline.times[l]) =
+          timeline.open_start[l] + secs / 2;
+      timeline.closed_count[l] = timeline.open_count[l];
+      timeline.open_count[l] = 0;
+    }
+    if (timeline.open_count[l] == 0) {
+      timeline.open_start[l] = start;
+    }
+    ++timeline.open_count[l];
+  }
+
+  for (size_t l = 0; l < HISTORY_LEVELS; ++l) {
+    GorillaArray<double> &times = timeline.times[l];
+    const double cutoff = time - g_history.retention[l];
+    if (times.live_size() > 0 && times[times.begin()] < cutoff) {
+      tracked_drop_front(times, upper_index(times, cutoff));
+    }
+  }
+}
+
+// Absolute index of `time` in `times`, SIZE_MAX if it is not there
+static size_t time_index(const GorillaArray<double> &times,
+                         const double time) {
+  if (times.live_size() == 0) return SIZE_MAX;
+  if (times[times.size() - 1] == time) return times.size() - 1;
+  const size_t idx = upper_index(times, time, true);
+  return idx < times.size() && times[idx] == time ? idx : SIZE_MAX;
+}
+
+// Element for absolute `index`, gaps since the last pushed element are
+// filled with zeros. Returns nullptr if `index` is already behind.
+template <template <class> class A, class T>
+static T *series_slot(A<T> &arr, const size_t index) {
+  if (arr.live_size() == 0) {
+    tracked_destroy(arr);
+    arr.start_at(index);
+    g_history.used_bytes += arr.total_byte_size();
+  } else if (index < arr.size()) {
+    return nullptr;
+  }
+  while (arr.size() < index) {
+    *tracked_emplace_back(arr) = {};
+  }
+  return tracked_emplace_back(arr);
+}
+
+static void history_close_bucket(HistorySeries &series,
+                                 const HistoryTimeline &timeline,
+                                 const size_t level) {
+  HistoryOpenBucket &open = series.open[level];
+  const double mid = open.start + HISTORY_BUCKET_SECS[level] / 2;
+  const size_t index = time_index(timeline.times[level], mid);
+  if (index != SIZE_MAX) {
+    HistoryBucket *bucket = series_slot(series.buckets[level], index);
+    if (bucket) {
+      *bucket = {static_cast<float>(open.min), static_cast<float>(open.max),
+                 static_cast<float>(open.sum / open.count)};
+    }
+  }
+  open.count = 0;
+}
+
+void history_push(HistorySeries &series, const HistoryTimeline &timeline,
+                  double time, const double value) {
+  time = quantize_time(time);
+  const size_t index = time_index(timeline.times[0], time);
+  if (index == SIZE_MAX) return;
+  float *slot = series_slot(series.raw, index);
+  if (!slot) return;
+  *slot = static_cast<float>(value);
+  tracked_drop_front(series.raw, timeline.times[0].begin());
+
+  for (size_t l = 1; l < HISTORY_LEVELS; ++l) {
+    const double secs = HISTORY_BUCKET_SECS[l];
+    const double start = std::floor(time / secs) * secs;
+    HistoryOpenBucket &open = series.open[l];
+    if (open.count > 0 && start != open.start) {
+      history_close_bucket(series, timeline, l);
+    }
+    tracked_drop_front(series.buckets[l], timeline.times[l].begin());
+
+    if (open.count == 0) {
+      open = {start, 0, value, value, 0};
+    }
+    ++open.count;
+    open.min = std::min(open.min, value);
+    open.max = std::max(open.max, value);
+    open.sum += value;
+  }
+}
+
+void history_destroy(HistoryTimeline &timeline) {
+  for (GorillaArray<double> &times : timeline.times) {
+    tracked_destroy(times);
+  }
+  timeline = {};
+}
+
+void history_destroy(HistorySeries &series) {
+  tracked_destroy(series.raw);
+  for (ChunkedArray<HistoryBucket> &buckets : series.buckets) {
+    tracked_destroy(buckets);
+  }
+  for (HistoryDecimated &decimated : series.decimated) {
+    if (decimated.storage) ArenaSlab::release(decimated.storage);
+  }
+  series = {};
+}
+
+void history_enforce_budget() {
+  if (g_history.used_bytes > g_history.budget_bytes) {
+    for (size_t l = 0; l < HISTORY_LEVELS; ++l) {
+      g_history.retention[l] =
+          std::max(HISTORY_MIN_RETENTION[l], g_history.retention[l] * 0.75);
+    }
+  } else if (g_history.used_bytes < g_history.budget_bytes / 2) {
+    for (size_t l = 0; l < HISTORY_LEVELS; ++l) {
+      g_history.retention[l] = std::min(HISTORY_DEFAULT_RETENTION[l],
+                                        g_history.retention[l] * 1.25);
+    }
+  }
+}
+
+HistoryView history_view(const HistoryTimeline &timeline, const double x_min,
+                         const double x_max, const double secs_per_point) {
+  HistoryView view = {};
+  view.timeline = &timeline;
+  view.x_min = x_min;
+  view.x_max = x_max;
+  view.secs_per_point = secs_per_point;
+
+  uint chosen = 0;
+  for (uint l = 1; l < HISTORY_LEVELS; ++l) {
+    if (HISTORY_BUCKET_SECS[l] <= secs_per_point &&
+        timeline.times[l].live_size() > 0) {
+      chosen = l;
+    }
+  }
+  if (timeline.times[chosen].live_size() == 0) {
+    return view;
+  }
+
+  // Unclipped runs: the chosen level, older points from coarser levels and
+  // newer points from finer ones
+  HistorySpan runs[HISTORY_LEVELS] = {};
+  const GorillaArray<double> &chosen_times = timeline.times[chosen];
+  runs[chosen] = {chosen, chosen_times.begin(), chosen_times.size()};
+
+  double oldest = chosen_times[chosen_times.begin()];
+  for (uint l = chosen + 1; l < HISTORY_LEVELS; ++l) {
+    const GorillaArray<double> &times = timeline.times[l];
+    const size_t end = upper_index(times, oldest, true);
+    runs[l] = {l, times.begin(), end};
+    if (end > times.begin()) oldest = times[times.begin()];
+  }
+
+  double newest = chosen_times.last_or(0);
+  for (uint l = chosen; l-- > 0;) {
+    const GorillaArray<double> &times = timeline.times[l];
+    runs[l] = {l, upper_index(times, newest), times.size()};
+    if (runs[l].end > runs[l].begin) newest = times.last_or(0);
+  }
+
+  for (uint l = HISTORY_LEVELS; l-- > 0;) {
+    const GorillaArray<double> &times = timeline.times[l];
+    HistorySpan span = runs[l];
+    if (span.end <= span.begin) continue;
+
+    const size_t from = upper_index(times, x_min);
+    if (from > span.begin) span.begin = from - 1;
+    span.end = std::min(span.end, upper_index(times, x_max) + 1);
+    if (span.end <= span.begin) continue;
+
+    view.spans[view.span_count++] = span;
+    view.count += span.end - span.begin;
+  }
+  return view;
+}
+
+namespace {
+
+// Accumulates the points of one pixel column
+struct DecimationColumn {
+  long index;
+  size_t count;
+  double time_sum;
+  double min_time;
+  float min;
+  double max_time;
+  float max;
+  double sum;
+};
+
+} // namespace
+
+static size_t series_begin(const HistorySeries &series, const uint level) {
+  return level == 0 ? series.raw.begin() : series.buckets[level].begin();
+}
+
+static size_t series_end(const HistorySeries &series, const uint level) {
+  return level == 0 ? series.raw.size() : series.buckets[level].size();
+}
+
+template <class F>
+static void decimation_for_each_column(const HistorySeries &series,
+                                       const HistoryView &view, F emit) {
+  DecimationColumn col = {};
+  const double width = view.secs_per_point > 0 ? view.secs_per_point : 1;
+  for (uint s = 0; s < view.span_count; ++s) {
+    const HistorySpan &span = view.spans[s];
+    const GorillaArray<double> &times = view.timeline->times[span.level];
+    // Series can cover only a part of the timeline
+    const size_t begin = std::max(span.begin, series_begin(series, span.level));
+    const size_t end = std::min(span.end, series_end(series, span.level));
+    for (size_t pos = begin; pos < end; ++pos) {
+      const double time = times[pos];
+      HistoryBucket value;
+      if (span.level == 0) {
+        const float raw = series.raw[pos];
+        value = {raw, raw, raw};
+      } else {
+        value = series.buckets[span.level][pos];
+      }
+
+      const long index =
+          static_cast<long>(std::floor((time - view.x_min) / width));
+      if (col.count > 0 && index != col.index) {
+        emit(col);
+        col.count = 0;
+      }
+      if (col.count == 0) {
+        col = {index, 0, 0, time, value.min, time, value.max, 0};
+      }
+      ++col.count;
+      col.time_sum += time;
+      col.sum += value.avg;
+      if (value.min < col.min) {
+        col.min = value.min;
+        col.min_time = time;
+      }
+      if (value.max > col.max) {
+        col.max = value.max;
+        col.max_time = time;
+      }
+    }
+  }
+  if (col.count > 0) emit(col);
+}
+
+static bool decimation_is_single_point(const DecimationColumn &col) {
+  return col.min_time == col.max_time && col.min == col.max;
+}
+
+const HistoryDecimated &history_decimate(HistorySeries &series,
+                                         const HistoryView &view,
+                                         const HistoryDecimation kind) {
+  HistoryDecimated &res = series.decimated[kind];
+  const size_t sample_count = view.timeline->times[0].size();
+  const size_t series_size = series.raw.size();
+  if (res.valid && res.sample_count == sample_count &&
+      res.series_size == series_size &&
+      res.x_min == view.x_min && res.x_max == view.x_max &&
+      res.secs_per_point == view.secs_per_point) {
+    return res;
+  }
+
+  size_t count = 0;
+  decimation_for_each_column(series, view, [&](const DecimationColumn &col) {
+    const bool two_points = kind == eHistoryDecimation_MinMax &&
+                            !decimation_is_single_point(col);
+    count += two_points ? 2 : 1;
+  });
+
+  if (!res.storage || count > res.capacity) {
+    if (res.storage) ArenaSlab::release(res.storage);
+    const size_t capacity = count + count / 2;
+    const size_t bytes = sizeof(ArenaSlab) + 2 * capacity * sizeof(double);
+    res.storage = ArenaSlab::create(
+        std::max(SLAB_SIZE, (bytes + SLAB_SIZE - 1) / SLAB_SIZE * SLAB_SIZE));
+    if (!res.storage) std::abort();
+    res.capacity = (res.storage->total_size - sizeof(ArenaSlab)) /
+                   (2 * sizeof(double));
+  }
+
+  double *xs = reinterpret_cast<double *>(
+      reinterpret_cast<uint8_t *>(res.storage) + sizeof(ArenaSlab));
+  double *ys = xs + res.capacity;
+  size_t n = 0;
+  decimation_for_each_column(series, view, [&](const DecimationColumn &col) {
+    switch (kind) {
+    case eHistoryDecimation_MinMax:
+      if (decimation_is_single_point(col)) {
+        xs[n] = col.min_time;
+        ys[n++] = col.min;
+      } else if (col.min_time <= col.max_time) {
+        xs[n] = col.min_time;
+        ys[n++] = col.min;
+        xs[n] = col.max_time;
+        ys[n++] = col.max;
+      } else {
+        xs[n] = col.max_time;
+        ys[n++] = col.max;
+        xs[n] = col.min_time;
+        ys[n++] = col.min;
+      }
+      break;
+    case eHistoryDecimation_Max:
+      xs[n] = col.max_time;
+      ys[n++] = col.max;
+      break;
+    default:
+      xs[n] = col.time_sum / col.count;
+      ys[n++] = col.sum / col.count;
+      break;
+    }
+  });
+
+  res.valid = true;
+  res.sample_count = sample_count;
+  res.series_size = series_size;
+  res.x_min = view.x_min;
+  res.x_max = view.x_max;
+  res.secs_per_point = view.secs_per_point;
+  res.xs = xs;
+  res.ys = ys;
+  res.count = n;
+  return res;
+}
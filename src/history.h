@@ -0,0 +1,193 @@
+#pragma once
+
+#include "base.h"
+#include "gorilla.h"
+
+#include <utility>
+
+// Multi-resolution time series storage for charts.
+//
+// Level 0 keeps raw samples, coarser levels roll the same samples into
+// min/max/avg buckets. Every level covers the whole retained span up to the
+// last closed bucket, and g_history trims the oldest data of every level once
+// the memory budget is exceeded.
+//
+// Sample times live in a single timeline pushed once per update, series only
+// store float values indexed by the timeline sample number. Times and raw
+// values are Gorilla compressed, so raw samples can be kept for a day.
+constexpr size_t HISTORY_LEVELS = 4;
+
+// Bucket width of every level in seconds
+constexpr double HISTORY_BUCKET_SECS[HISTORY_LEVELS] = {0, 10, 60, 600};
+
+// Retention of every level when there is enough budget
+constexpr double HISTORY_DEFAULT_RETENTION[HISTORY_LEVELS] = {
+    86400, 6 * 3600, 3 * 86400, 30 * 86400};
+
+// Budget pressure never trims below these, so the default 60 s view of the
+// charts always has raw samples
+constexpr double HISTORY_MIN_RETENTION[HISTORY_LEVELS] = {120, 30 * 60,
+                                                          6 * 3600, 86400};
+
+constexpr size_t HISTORY_DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+struct HistoryBucket {
+  float min;
+  float max;
+  float avg;
+};
+
+// Sample and bucket times shared by all series, with millisecond precision.
+// Bucket times point to the middle of the bucket.
+struct HistoryTimeline {
+  GorillaArray<double> times[HISTORY_LEVELS];
+  double open_start[HISTORY_LEVELS]; // start of the bucket being filled
+  uint open_count[HISTORY_LEVELS];   // samples in the bucket being filled
+  uint closed_count[HISTORY_LEVELS]; // samples in the bucket closed last
+};
+
+enum HistoryDecimation {
+  eHistoryDecimation_MinMax, // lowest and highest point of every column
+  eHistoryDecimation_Max,    // highest point of every column
+  eHistoryDecimation_Avg,    // mean of every column, same xs for all series
+  eHistoryDecimation_Count,
+};
+
+// Points of a series reduced to at most two per pixel column
+struct HistoryDecimated {
+  ArenaSlab *storage; // owns xs and ys
+  size_t capacity;    // points that fit into storage
+
+  // Cache key
+  bool valid;
+  size_t sample_count;
+  size_t series_size;
+  double x_min;
+  double x_max;
+  double secs_per_point;
+
+  const double *xs;
+  const double *ys;
+  size_t count;
+};
+
+// Bucket of a series that is still being filled
+struct HistoryOpenBucket {
+  double start;
+  uint count;
+  double min;
+  double max;
+  double sum;
+};
+
+// Values of a series use the absolute indices of the timeline, but may start
+// later (a chart opened later) or stop earlier (an exited process).
+struct HistorySeries {
+  GorillaArray<float> raw;
+  ChunkedArray<HistoryBucket> buckets[HISTORY_LEVELS]; // [0] is unused
+  HistoryOpenBucket open[HISTORY_LEVELS];
+  HistoryDecimated decimated[eHistoryDecimation_Count];
+};
+
+struct HistoryStore {
+  HistoryTimeline timeline; // pushed by the update loop, used by all charts
+
+  size_t budget_bytes = HISTORY_DEFAULT_BUDGET;
+  size_t used_bytes;
+  double retention[HISTORY_LEVELS] = {
+      HISTORY_DEFAULT_RETENTION[0], HISTORY_DEFAULT_RETENTION[1],
+      HISTORY_DEFAULT_RETENTION[2], HISTORY_DEFAULT_RETENTION[3]};
+};
+
+extern HistoryStore g_history;
+
+// Every host of a fan-in has its own sample times, the host being updated or
+// drawn swaps them into g_history
+inline void history_swap_timeline(HistoryTimeline &timeline) {
+  std::swap(g_history.timeline, timeline);
+}
+
+// Appends a new sample time and trims the timeline to the retention
+void history_push_time(HistoryTimeline &timeline, double time);
+
+// Stores the value of the timeline sample at `time`. Samples must come in
+// time order, values for times missing from the timeline are dropped.
+void history_push(HistorySeries &series, const HistoryTimeline &timeline,
+                  double time, double value);
+
+void history_destroy(HistoryTimeline &timeline);
+void history_destroy(HistorySeries &series);
+
+// Shrinks retention when over budget and slowly restores it when there is
+// plenty of room again. Called once per update after all series are pushed.
+void history_enforce_budget();
+
+// Points of a timeline selected for drawing: at most one run per level,
+// ordered from the oldest to the newest
+struct HistorySpan {
+  uint level;
+  size_t begin; // absolute indices into timeline.times[level]
+  size_t end;
+};
+
+struct HistoryView {
+  const HistoryTimeline *timeline;
+  HistorySpan spans[HISTORY_LEVELS];
+  uint span_count;
+  size_t count;
+
+  double x_min;
+  double x_max;
+  double secs_per_point;
+};
+
+// Picks the coarsest level that still has at least one point per
+// `secs_per_point` for [x_min, x_max] and stitches older and newer data from
+// other levels around it. One point outside of the range is kept on both
+// sides so lines reach the plot edges.
+HistoryView history_view(const HistoryTimeline &timeline, double x_min,
+                         double x_max, double secs_per_point);
+
+// Reduces the view to per pixel column points, where columns are
+// `secs_per_point` wide starting at x_min. The result stays cached in
+// `series` until new samples arrive or the view range changes, so drawing
+// costs O(plot width) regardless of how much history is visible.
+const HistoryDecimated &history_decimate(HistorySeries &series,
+                                         const HistoryView &view,
+                                         HistoryDecimation kind);
+
+inline void history_view_locate(const HistoryView &view, size_t idx,
+                                uint &level, size_t &pos) {
+  for (uint i = 0; i < view.span_count; ++i) {
+    const HistorySpan &span = view.spans[i];
+    const size_t n = span.end - span.begin;
+    if (idx < n) {
+      level = span.level;
+      pos = span.begin + idx;
+      return;
+    }
+    idx -= n;
+  }
+  level = 0;
+  pos = 0;
+}
+
+inline double history_view_time(const HistoryView &view, const size_t idx) {
+  uint level;
+  size_t pos;
+  history_view_locate(view, idx, level, pos);
+  return view.timeline->times[level][pos];
+}
+
+inline double history_view_value(const HistoryView &view,
+                                 const HistorySeries &series,
+                                 const size_t idx) {
+  uint level;
+  size_t pos;
+  history_view_locate(view, idx, level, pos);
+  if (level == 0) {
+    return series.raw.contains(pos) ? series.raw[pos] : 0;
+  }
+  const ChunkedArray<HistoryBucket> &buckets = series.buckets[level];
+  return buckets.contains(pos) ? buckets[pos].avg : 0;
+}
@@ -1,8 +1,14 @@
 #include "base.h"
+#include "history.h"
 #include "ring_buffer.h"
+#include "self_stats.h"
+#include "shm_publisher.h"
+#include "sources/fan_in.h"
 #include "sources/process_stat.h"
+#include "sources/snapshot_file.h"
 #include "sources/sync.h"
 #include "state.h"
+#include "views/host_overview.h"
 
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
@@ -15,7 +21,6 @@
 #include <cstdio>
 #include <cstring>
 #include <dirent.h>
-#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <thread>
@@ -23,10 +28,21 @@
 
 // UNITY BUILD:
 #include "base.cpp"
+#include "gorilla.cpp"
+#include "history.cpp"
+#include "process_recorder.cpp"
+#include "self_stats.cpp"
+#include "shm_publisher.cpp"
+#include "sources/agent.cpp"
 #include "sources/environ_reader.cpp"
+#include "sources/fan_in.cpp"
 #include "sources/library_reader.cpp"
+#include "sources/listener.cpp"
+#include "sources/annotations.cpp"
 #include "sources/on_demand_reader.cpp"
 #include "sources/process_stat.cpp"
+#include "sources/snapshot_codec.cpp"
+#include "sources/snapshot_file.cpp"
 #include "sources/socket_reader.cpp"
 #include "state.cpp"
 #include "tracy/Tracy.hpp"
@@ -35,6 +51,8 @@
 #include "views/cpu_chart.cpp"
 #include "views/entry.cpp"
 #include "views/environ_viewer.cpp"
+#include "views/host_overview.cpp"
+#include "views/internals_window.cpp"
 #include "views/io_chart.cpp"
 #include "views/library_viewer.cpp"
 #include "views/mem_chart.cpp"
@@ -58,6 +76,16 @@ static Theme g_applied_theme = Theme::Light;
 static float g_monitor_scale = 1.0f;
 static ImGuiStyle
     g_base_style; // Style after theme + monitor scale, before zoom
+
+// --connect: every host has its own State and views, the selected one is drawn
+struct Host {
+  State state;
+  ViewState view_state;
+  HistoryTimeline timeline;
+};
+static FanIn g_fan_in;
+static Host g_hosts[FAN_IN_MAX_HOSTS];
+static HostOverviewState g_host_overview;
 void maintaining_second_update(GLFWwindow * /*window*/, int /*button*/,
                                int /*action*/, int /*mods*/) {
   g_needs_updates = 2;
@@ -92,6 +120,9 @@ static void view_settings_read_line(ImGuiContext *, ImGuiSettingsHandler *,
     view_state->preferences_state.update_period = fval;
   } else if (sscanf(line, "TargetFPS=%d", &val) == 1) {
     view_state->preferences_state.target_fps = val;
+  } else if (sscanf(line, "HistoryBudgetMB=%d", &val) == 1) {
+    view_state->preferences_state.history_budget_mb =
+        val < 16 ? 16 : (val > 4096 ? 4096 : val);
   } else if (sscanf(line, "TreeMode=%d", &val) == 1) {
     view_state->brief_table_state.tree_mode = (val != 0);
   } else if (sscanf(line, "ZoomScale=%f", &fval) == 1) {
@@ -127,6 +158,8 @@ static void view_settings_write_all(ImGuiContext * /*ctx*/,
                view_state->preferences_state.update_period);
   buf->appendf("TargetFPS=%d\n", view_state->preferences_state.target_fps);
   buf->appendf("ZoomScale=%.2f\n", view_state->preferences_state.zoom_scale);
+  buf->appendf("HistoryBudgetMB=%d\n",
+               view_state->preferences_state.history_budget_mb);
   if (view_state->preferences_state.font_path[0] != '\0') {
     buf->appendf("FontPath=%s\n", view_state->preferences_state.font_path);
   }
@@ -158,26 +191,16 @@ static void load_fonts(ImGuiIO &io, const char *font_path, float scale) {
   }
 }
 
-static bool state_init(State &state) {
-  const long ticks = sysconf(_SC_CLK_TCK);
-  const long page_size = sysconf(_SC_PAGESIZE);
-  if (ticks <= 0 || page_size <= 0) {
-    fprintf(stderr, "Failed to get system configuration\n");
-    return false;
-  }
-  state.system.ticks_in_second = ticks;
-  state.system.mem_page_size = page_size;
-  return true;
-}
-
 static void state_update(State &state, ViewState &view_state,
                          const UpdateSnapshot &snapshot) {
-  BumpArena old_arena = state.snapshot_arena;
+  BumpArena old_arena = state_apply_snapshot(state, snapshot);
 
-  state.snapshot_arena = snapshot.owner_arena;
-  state.snapshot = state_snapshot_update(state.snapshot_arena, state, snapshot);
-  state.update_count += 1;
-  state.update_system_time = snapshot.system_time;
+  // One timeline for all chart series, they are pushed in views_update
+  const double update_at = std::chrono::duration_cast<Seconds>(
+                               state.update_system_time.time_since_epoch())
+                               .count();
+  history_push_time(g_history.timeline, update_at);
+  process_recorder_update(state.recorder, state.snapshot, update_at);
 
   // Process thread snapshots before general update
   views_process_thread_snapshots(view_state, state, snapshot);
@@ -189,14 +212,39 @@ static void state_update(State &state, ViewState &view_state,
 static bool update(State &state, ViewState &view_state, Sync &sync) {
   ZoneScoped;
   UpdateSnapshot snapshot = {};
-  bool updated = false;
+  size_t applied = 0;
   while (sync.update_queue.pop(snapshot)) {
     state_update(state, view_state, snapshot);
-    updated = true;
+    ++applied;
+  }
+  // Only the last one of a frame gets drawn
+  if (applied > 1) {
+    g_self_stats.snapshots_coalesced.fetch_add(applied - 1,
+                                               std::memory_order_relaxed);
+  }
+  return applied > 0;
+}
+
+static bool update_hosts() {
+  bool updated = false;
+  for (size_t i = 0; i < g_fan_in.count; ++i) {
+    Host &host = g_hosts[i];
+    history_swap_timeline(host.timeline);
+    updated |= update(host.state, host.view_state, g_fan_in.hosts[i].sync);
+    history_swap_timeline(host.timeline);
   }
   return updated;
 }
 
+static void draw_host_overview() {
+  HostOverviewRow rows[FAN_IN_MAX_HOSTS];
+  for (size_t i = 0; i < g_fan_in.count; ++i) {
+    const FanInHost &host = g_fan_in.hosts[i];
+    rows[i] = {host.address, host.connected.load(), &g_hosts[i].state};
+  }
+  host_overview_draw(g_host_overview, rows, g_fan_in.count);
+}
+
 static void draw_main_window(const ImGuiIO &io, const State &state,
                              ViewState &view_state) {
   ZoneScoped;
@@ -223,6 +271,9 @@ static void draw_main_window(const ImGuiIO &io, const State &state,
   FrameContext frame_ctx = {};
   views_draw(frame_ctx, view_state, state);
   frame_ctx.frame_arena.destroy();
+  if (g_fan_in.count > 1) {
+    draw_host_overview();
+  }
 
   ImGui::End();
 }
@@ -311,7 +362,89 @@ Stacked=0
 
 constexpr const char *MAIN_FRAME = "main_frame";
 
-int main(int, char **) {
+static void print_usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [--record FILE | --replay FILE [--speed N] [--step] |\n"
+          "          --connect ADDR...] [--shm NAME] [--annotate PATH]\n"
+          "          [--proc-root DIR]\n"
+          "  --record FILE  append every gathered snapshot to FILE\n"
+          "  --replay FILE  show a recording instead of this machine\n"
+          "  --speed N      replay N times faster than recorded\n"
+          "  --step         start paused, replay one snapshot per step\n"
+          "  --connect ADDR show the host of `prock-collect --listen ADDR`,\n"
+          "                 ADDR is unix:PATH or HOST:PORT, repeat for a\n"
+          "                 dashboard of several hosts\n"
+          "  --shm NAME     publish every update to the shared memory object\n"
+          "                 NAME (/prock), see prock_shm.h\n"
+          "  --annotate PATH\n"
+          "                 mark \"TIME [pid=PID] LABEL\" datagrams sent to\n"
+          "                 the unix socket PATH on the charts, TIME is\n"
+          "                 seconds since epoch or - for now\n"
+          "  --proc-root DIR\n"
+          "                 read procfs from DIR instead of /proc\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  const char *record_path = nullptr;
+  const char *replay_path = nullptr;
+  const char *shm_name = nullptr;
+  const char *annotate_path = nullptr;
+  const char *connect_addresses[FAN_IN_MAX_HOSTS];
+  size_t connect_count = 0;
+  float replay_speed = 1.0f;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc &&
+               connect_count < FAN_IN_MAX_HOSTS) {
+      connect_addresses[connect_count++] = argv[++i];
+    } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+      shm_name = argv[++i];
+    } else if (strcmp(argv[i], "--annotate") == 0 && i + 1 < argc) {
+      annotate_path = argv[++i];
+    } else if (strcmp(argv[i], "--proc-root") == 0 && i + 1 < argc) {
+      g_proc_root = argv[++i];
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      replay_speed = strtof(argv[++i], nullptr);
+    } else if (strcmp(argv[i], "--step") == 0) {
+      replay_speed = 0.0f;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  const int modes = (record_path != nullptr) + (replay_path != nullptr) +
+                    (connect_count > 0);
+  if (modes > 1 || replay_speed < 0.0f || (shm_name && connect_count > 0)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  // Opening only maps the file, snapshots are decoded while replaying
+  ReplayState replay_state = {};
+  if (replay_path && !snapshot_reader_open(replay_state.reader, replay_path)) {
+    fprintf(stderr, "Failed to open recording: %s\n", replay_path);
+    return 1;
+  }
+  if (connect_count > 0 &&
+      !fan_in_connect(g_fan_in, connect_addresses, connect_count)) {
+    fan_in_close(g_fan_in);
+    return 1;
+  }
+  ShmPublisher publisher = {};
+  if (shm_name && !shm_publisher_open(publisher, shm_name, SHM_MAX_CPUS,
+                                      SHM_MAX_PROCESSES)) {
+    return 1;
+  }
+  const int annotation_fd =
+      annotate_path ? annotation_socket_open(annotate_path) : -1;
+  if (annotate_path && annotation_fd < 0) {
+    return 1;
+  }
+
   glfwSetErrorCallback(glfw_error_callback);
   if (!glfwInit()) {
     return 1;
@@ -424,21 +557,59 @@ int main(int, char **) {
     return 1;
   }
 
+  SnapshotWriter writer = {};
+  if (record_path &&
+      !snapshot_writer_open(writer, record_path, state.system.ticks_in_second,
+                            state.system.mem_page_size)) {
+    fprintf(stderr, "Failed to create recording: %s\n", record_path);
+    return 1;
+  }
+
   Sync sync = {};
   view_state.sync = &sync;
+  sync.on_demand_reader.annotation_fd = annotation_fd;
   sync.update_period.store(view_state.preferences_state.update_period);
+  if (replay_path) {
+    // Rates are computed with the clock ticks and pages of the recorded host
+    const SnapshotFileHeader &header = *replay_state.reader.header;
+    state.system.ticks_in_second = header.ticks_in_second;
+    state.system.mem_page_size = header.mem_page_size;
+    sync.replay.active.store(true);
+    sync.replay.speed.store(replay_speed);
+    sync.replay.count = replay_state.reader.index.size;
+  }
+  for (size_t i = 0; i < g_fan_in.count; ++i) {
+    // Rates are computed with the clock ticks and pages of every host
+    const AgentHello &hello = g_fan_in.hosts[i].connection.hello;
+    Host &host = g_hosts[i];
+    host.view_state = view_state; // settings loaded from the ini file
+    host.state.system.ticks_in_second = hello.ticks_in_second;
+    host.state.system.mem_page_size = hello.mem_page_size;
+    host.view_state.sync = &g_fan_in.hosts[i].sync;
+  }
 
-  std::thread gathering_thread{[&sync] {
-    pthread_setname_np(pthread_self(), "gathering");
+  std::thread gathering_thread{[&sync, &replay_state, &writer, record_path] {
+    const bool replaying = sync.replay.active.load();
+    const bool connected = g_fan_in.count > 0;
+    set_thread_name(connected   ? "fan_in"
+                    : replaying ? "replay"
+                                : "gathering");
     GatheringState gathering_state = {};
+    gathering_state.recording = record_path ? &writer : nullptr;
     while (!sync.quit.load()) {
-      gather(gathering_state, sync);
+      if (connected) {
+        if (!fan_in_poll(g_fan_in, FAN_IN_POLL_MS)) continue;
+      } else if (replaying) {
+        replay(replay_state, sync);
+      } else {
+        gather(gathering_state, sync);
+      }
       glfwPostEmptyEvent();
     }
   }};
 
   std::thread proc_reader_thread{[&sync] {
-    pthread_setname_np(pthread_self(), "proc_reader");
+    set_thread_name("proc_reader");
     on_demand_reader_loop(sync);
   }};
 
@@ -452,15 +623,29 @@ int main(int, char **) {
       glfwWaitEvents();
     }
 
-    // F3 toggles debug FPS display
+    // F3 toggles debug FPS display, Shift+F3 the Prock Internals window
     if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) {
-      view_state.preferences_state.show_debug_fps =
-          !view_state.preferences_state.show_debug_fps;
+      bool &shown = ImGui::GetIO().KeyShift
+                        ? view_state.preferences_state.show_internals
+                        : view_state.preferences_state.show_debug_fps;
+      shown = !shown;
     }
 
     auto frame_start = SteadyClock::now();
     FrameMarkStart(MAIN_FRAME);
-    if (update(state, view_state, sync)) {
+    const bool updated = g_fan_in.count > 0 ? update_hosts()
+                                            : update(state, view_state, sync);
+    if (updated) {
+      g_self_stats.ui_update.add(static_cast<float>(
+          std::chrono::duration<double, std::milli>(SteadyClock::now() -
+                                                    frame_start)
+              .count()));
+      g_needs_updates = 2;
+      shm_publish(publisher, state);
+    }
+    Annotation annotation;
+    while (sync.on_demand_reader.annotation_queue.pop(annotation)) {
+      annotation_add(g_annotations, annotation);
       g_needs_updates = 2;
     }
 
@@ -471,6 +656,10 @@ int main(int, char **) {
       sync.quit_cv.notify_one();
     }
 
+    g_history.budget_bytes =
+        static_cast<size_t>(view_state.preferences_state.history_budget_mb) *
+        1024 * 1024;
+
     // Update base style colors if theme changed
     const Theme new_theme = view_state.preferences_state.theme;
     if (g_applied_theme != new_theme) {
@@ -496,7 +685,22 @@ int main(int, char **) {
       load_fonts(io, view_state.preferences_state.font_path, g_monitor_scale);
     }
 
-    draw(window, io, state, view_state);
+    const auto draw_start = SteadyClock::now();
+    if (g_fan_in.count > 0) {
+      // Preferences stay shared, everything else is drawn for the host
+      Host &host = g_hosts[g_host_overview.selected];
+      host.view_state.preferences_state = view_state.preferences_state;
+      history_swap_timeline(host.timeline);
+      draw(window, io, host.state, host.view_state);
+      history_swap_timeline(host.timeline);
+      view_state.preferences_state = host.view_state.preferences_state;
+    } else {
+      draw(window, io, state, view_state);
+    }
+    g_self_stats.ui_draw.add(static_cast<float>(
+        std::chrono::duration<double, std::milli>(SteadyClock::now() -
+                                                  draw_start)
+            .count()));
 
     glfwSwapBuffers(window);
     FrameMarkEnd(MAIN_FRAME);
@@ -515,6 +719,10 @@ int main(int, char **) {
   sync.on_demand_reader.library_cv.notify_one();
   gathering_thread.join();
   proc_reader_thread.join();
+  annotation_socket_close(annotation_fd, annotate_path);
+  snapshot_writer_close(writer);
+  fan_in_close(g_fan_in);
+  shm_publisher_close(publisher);
 
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
@@ -524,5 +732,7 @@ int main(int, char **) {
   glfwDestroyWindow(window);
   glfwTerminate();
 
+  // Comm strings of replayed snapshots point into the mapping
+  snapshot_reader_close(replay_state.reader);
   return 0;
 }
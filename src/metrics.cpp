@@ -0,0 +1,378 @@
+#include "metrics.h"
+
+#include "bounded_writer.h"
+#include "sources/agent.h"
+#include "sources/sync.h"
+#include "state.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// OpenMetrics text of a page
+struct PageWriter : BoundedWriter {
+  void family(const char *name, const char *help) {
+    print("# TYPE %s gauge\n# HELP %s %s\n", name, name, help);
+  }
+
+  // Label value with OpenMetrics escapes, at most twice as long as `str`
+  void print_label(const char *str) {
+    for (const char *it = str; *it; ++it) {
+      const char c = *it;
+      if (c == '"' || c == '\\') {
+        data[size++] = '\\';
+        data[size++] = c;
+      } else if (c == '\n') {
+        data[size++] = '\\';
+        data[size++] = 'n';
+      } else {
+        data[size++] = c;
+      }
+    }
+  }
+};
+
+} // namespace
+
+// Longest metric family header or sample without a comm label
+constexpr size_t METRICS_LINE_BOUND = 192;
+
+static const char *MEMORY_KINDS[] = {
+    "total",  "free",       "available", "buffers",
+    "cached", "swap_total", "swap_free",
+};
+
+static double process_cpu(const ProcessDerivedStat &derived) {
+  return derived.cpu_user_perc + derived.cpu_kernel_perc;
+}
+
+static double process_resident(const ProcessDerivedStat &derived) {
+  return derived.mem_resident_bytes;
+}
+
+// Moves the `count` highest `value` processes to the front of `order`
+static void rank(const StateSnapshot &snapshot, uint32_t *order,
+                 const size_t count,
+                 double (*value)(const ProcessDerivedStat &)) {
+  const size_t total = snapshot.stats.size;
+  const auto higher = [&](const uint32_t left, const uint32_t right) {
+    const double l = value(snapshot.derived_stats.data[left]);
+    const double r = value(snapshot.derived_stats.data[right]);
+    return l != r ? l > r : left < right;
+  };
+  std::partial_sort(order, order + count, order + total, higher);
+}
+
+static void print_processes(PageWriter &out, const StateSnapshot &snapshot,
+                            const uint32_t *top, const size_t count,
+                            const char *name, const int precision,
+                            double (*value)(const ProcessDerivedStat &)) {
+  for (size_t i = 0; i < count; ++i) {
+    const ProcessStat &stat = snapshot.stats.data[top[i]];
+    out.print("%s{pid=\"%d\",comm=\"", name, stat.pid);
+    out.print_label(stat.comm ? stat.comm : "");
+    out.print("\"} %.*f\n", precision,
+              value(snapshot.derived_stats.data[top[i]]));
+  }
+}
+
+String metrics_render(MetricsExporter &exporter,
+                      const StateSnapshot &snapshot) {
+  ZoneScoped;
+  const size_t total = snapshot.stats.size;
+  const size_t count = std::min({exporter.top, METRICS_MAX_TOP, total});
+
+  // Both rankings are copied out of one index buffer
+  uint32_t *order = reinterpret_cast<uint32_t *>(
+      ensure_slab(exporter.order, total * sizeof(uint32_t)));
+  for (size_t i = 0; i < total; ++i) {
+    order[i] = static_cast<uint32_t>(i);
+  }
+  uint32_t top_cpu[METRICS_MAX_TOP];
+  uint32_t top_resident[METRICS_MAX_TOP];
+  rank(snapshot, order, count, process_cpu);
+  std::copy(order, order + count, top_cpu);
+  rank(snapshot, order, count, process_resident);
+  std::copy(order, order + count, top_resident);
+
+  const SystemCpuPerc &cpu = snapshot.cpu_perc;
+  size_t bound = METRICS_LINE_BOUND * (32 + 2 * cpu.total.size + 2 * count);
+  for (size_t i = 0; i < count; ++i) {
+    const char *cpu_comm = snapshot.stats.data[top_cpu[i]].comm;
+    const char *resident_comm = snapshot.stats.data[top_resident[i]].comm;
+    bound += 2 * ((cpu_comm ? strlen(cpu_comm) : 0) +
+                  (resident_comm ? strlen(resident_comm) : 0));
+  }
+  char *data =
+      reinterpret_cast<char *>(ensure_slab(exporter.buffer, bound));
+  PageWriter out = {{data, 0, bound}};
+
+  // [0] is every core together
+  out.family("prock_cpu_percent", "CPU usage of a core or all cores.");
+  for (size_t i = 0; i < cpu.total.size; ++i) {
+    if (i == 0) {
+      out.print("prock_cpu_percent{cpu=\"all\"} %.2f\n", cpu.total.data[i]);
+    } else {
+      out.print("prock_cpu_percent{cpu=\"%zu\"} %.2f\n", i - 1,
+                cpu.total.data[i]);
+    }
+  }
+  out.family("prock_cpu_kernel_percent", "Kernel part of prock_cpu_percent.");
+  for (size_t i = 0; i < cpu.kernel.size; ++i) {
+    if (i == 0) {
+      out.print("prock_cpu_kernel_percent{cpu=\"all\"} %.2f\n",
+                cpu.kernel.data[i]);
+    } else {
+      out.print("prock_cpu_kernel_percent{cpu=\"%zu\"} %.2f\n", i - 1,
+                cpu.kernel.data[i]);
+    }
+  }
+
+  const MemInfo &mem = snapshot.mem_info;
+  const ulong memory_kb[] = {
+      mem.mem_total, mem.mem_free,   mem.mem_available, mem.buffers,
+      mem.cached,    mem.swap_total, mem.swap_free,
+  };
+  out.family("prock_memory_bytes", "System memory from /proc/meminfo.");
+  for (size_t i = 0; i < std::size(MEMORY_KINDS); ++i) {
+    out.print("prock_memory_bytes{kind=\"%s\"} %lu\n", MEMORY_KINDS[i],
+              memory_kb[i] * 1024);
+  }
+
+  constexpr double MB = 1024.0 * 1024.0;
+  out.family("prock_disk_read_bytes_per_second", "Read from all disks.");
+  out.print("prock_disk_read_bytes_per_second %.0f\n",
+            snapshot.disk_io_rate.read_mb_per_sec * MB);
+  out.family("prock_disk_write_bytes_per_second", "Written to all disks.");
+  out.print("prock_disk_write_bytes_per_second %.0f\n",
+            snapshot.disk_io_rate.write_mb_per_sec * MB);
+  out.family("prock_network_receive_bytes_per_second",
+             "Received on all interfaces.");
+  out.print("prock_network_receive_bytes_per_second %.0f\n",
+            snapshot.net_io_rate.recv_mb_per_sec * MB);
+  out.family("prock_network_transmit_bytes_per_second",
+             "Sent on all interfaces.");
+  out.print("prock_network_transmit_bytes_per_second %.0f\n",
+            snapshot.net_io_rate.send_mb_per_sec * MB);
+
+  out.family("prock_processes", "Running processes.");
+  out.print("prock_processes %zu\n", total);
+  out.family("prock_process_cpu_percent",
+             "CPU usage of the busiest processes, 100 per core.");
+  print_processes(out, snapshot, top_cpu, count, "prock_process_cpu_percent",
+                  2, process_cpu);
+  out.family("prock_process_resident_bytes",
+             "Resident memory of the largest processes.");
+  print_processes(out, snapshot, top_resident, count,
+                  "prock_process_resident_bytes", 0, process_resident);
+  out.print("# EOF\n");
+  return {out.data, out.size};
+}
+
+void metrics_exporter_destroy(MetricsExporter &exporter) {
+  if (exporter.buffer) ArenaSlab::release(exporter.buffer);
+  if (exporter.order) ArenaSlab::release(exporter.order);
+  exporter = {};
+}
+
+// ============================================================================
+// HTTP
+// ============================================================================
+
+bool metrics_listen(MetricsServer &server, const char *address,
+                    const size_t top) {
+  server = {};
+  server.listener = LISTENER_CLOSED;
+  server.exporter.top = top;
+  server.request_timeout = std::chrono::seconds(METRICS_REQUEST_TIMEOUT_SEC);
+
+  AgentAddress addr;
+  if (!agent_resolve(address, true, addr)) {
+    fprintf(stderr, "Invalid metrics address: %s\n", address);
+    return false;
+  }
+  return listener_open(server.listener, addr, address, METRICS_MAX_CLIENTS);
+}
+
+void metrics_notify(MetricsServer &server) { listener_wake(server.listener); }
+
+// Queues the response, sent as the client's socket takes it
+static void respond(MetricsClient &client, const char *status,
+                    const char *content_type, const String body) {
+  char header[256];
+  const int header_len = snprintf(header, sizeof(header),
+                                  "HTTP/1.1 %s\r\n"
+                                  "Content-Type: %s\r\n"
+                                  "Content-Length: %zu\r\n"
+                                  "Connection: close\r\n\r\n",
+                                  status, content_type, body.length);
+  const size_t size = header_len + body.length;
+  uint8_t *data = ensure_slab(client.response, size);
+  memcpy(data, header, header_len);
+  memcpy(data + header_len, body.data, body.length);
+  client.response_size = size;
+  client.response_sent = 0;
+  client.deadline =
+      SteadyClock::now() + std::chrono::seconds(METRICS_SEND_TIMEOUT_SEC);
+}
+
+static void respond_text(MetricsClient &client, const char *status,
+                         const char *text) {
+  respond(client, status, "text/plain; charset=utf-8",
+          {const_cast<char *>(text), strlen(text)});
+}
+
+// Sends what the socket takes, false when the client is done
+static bool send_response(MetricsClient &client) {
+  const uint8_t *data =
+      reinterpret_cast<const uint8_t *>(client.response) + sizeof(ArenaSlab);
+  while (client.response_sent < client.response_size) {
+    const ssize_t n =
+        send(client.fd, data + client.response_sent,
+             client.response_size - client.response_sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (n <= 0) return false;
+    client.response_sent += n;
+  }
+  return false;
+}
+
+// Answers once the request headers are complete, false when the client is
+// done
+static bool receive_request(MetricsServer &server, const State &state,
+                            MetricsClient &client) {
+  char *request = client.request;
+  const ssize_t n =
+      recv(client.fd, request + client.request_size,
+           sizeof(client.request) - 1 - client.request_size, 0);
+  if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return true;
+  }
+  if (n <= 0) return false;
+  client.request_size += n;
+  request[client.request_size] = '\0';
+  if (!strstr(request, "\r\n\r\n") && !strstr(request, "\n\n")) {
+    if (client.request_size + 1 < sizeof(client.request)) return true;
+    respond_text(client, "431 Request Header Fields Too Large", "");
+    return send_response(client);
+  }
+
+  const bool is_get = strncmp(request, "GET ", 4) == 0;
+  const char *path = is_get ? request + 4 : "";
+  const size_t path_len = strcspn(path, " ?\r\n");
+  if (!is_get) {
+    respond_text(client, "405 Method Not Allowed", "Only GET\n");
+  } else if (path_len != 8 || strncmp(path, "/metrics", 8) != 0) {
+    respond_text(client, "404 Not Found", "See /metrics\n");
+  } else if (state.update_count < 2) {
+    // Rates need two updates
+    respond_text(client, "503 Service Unavailable", "Starting\n");
+  } else {
+    if (server.page_stale) {
+      server.page = metrics_render(server.exporter, state.snapshot);
+      server.page_stale = false;
+    }
+    respond(client, "200 OK",
+            "application/openmetrics-text; version=1.0.0; charset=utf-8",
+            server.page);
+  }
+  return send_response(client);
+}
+
+static void accept_client(MetricsServer &server) {
+  const int fd = accept4(server.listener.listen_fd, nullptr, nullptr,
+                         SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (fd < 0) return;
+  if (server.client_count >= METRICS_MAX_CLIENTS) {
+    close(fd);
+    return;
+  }
+  MetricsClient &client = server.clients[server.client_count++];
+  client = {};
+  client.fd = fd;
+  client.deadline = SteadyClock::now() + server.request_timeout;
+}
+
+static void close_client(MetricsClient &client) {
+  close(client.fd);
+  if (client.response) ArenaSlab::release(client.response);
+}
+
+// Until the earliest client deadline, -1 without clients
+static int poll_timeout_ms(const MetricsServer &server) {
+  const SteadyTimePoint now = SteadyClock::now();
+  int res = -1;
+  for (size_t i = 0; i < server.client_count; ++i) {
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(
+        server.clients[i].deadline - now);
+    const int ms = static_cast<int>(std::max<long long>(left.count(), 0));
+    res = res < 0 ? ms : std::min(res, ms);
+  }
+  return res;
+}
+
+void metrics_serve(MetricsServer &server, State &state, Sync &sync) {
+  while (!sync.quit.load()) {
+    pollfd fds[2 + METRICS_MAX_CLIENTS] = {};
+    fds[0] = {server.listener.listen_fd, POLLIN, 0};
+    fds[1] = {server.listener.wake_fds[0], POLLIN, 0};
+    for (size_t i = 0; i < server.client_count; ++i) {
+      const MetricsClient &client = server.clients[i];
+      fds[2 + i] = {client.fd,
+                    static_cast<short>(client.response ? POLLOUT : POLLIN), 0};
+    }
+    if (poll(fds, 2 + server.client_count, poll_timeout_ms(server)) < 0) {
+      if (errno == EINTR) continue;
+      perror("metrics: poll");
+      break;
+    }
+
+    if (fds[1].revents != 0) {
+      listener_drain(server.listener);
+      UpdateSnapshot snapshot = {};
+      while (sync.update_queue.pop(snapshot)) {
+        state_apply_snapshot(state, snapshot).destroy();
+        server.page_stale = true;
+      }
+    }
+
+    const SteadyTimePoint now = SteadyClock::now();
+    drop_clients(
+        server.clients, server.client_count,
+        [&](const size_t i, MetricsClient &client) {
+          if (now >= client.deadline) return false;
+          if (fds[2 + i].revents == 0) return true;
+          return client.response ? send_response(client)
+                                 : receive_request(server, state, client);
+        },
+        close_client);
+
+    if (fds[0].revents != 0) {
+      accept_client(server);
+    }
+  }
+
+  UpdateSnapshot snapshot = {};
+  while (sync.update_queue.pop(snapshot)) {
+    snapshot.owner_arena.destroy();
+  }
+}
+
+void metrics_server_close(MetricsServer &server) {
+  for (size_t i = 0; i < server.client_count; ++i) {
+    close_client(server.clients[i]);
+  }
+  listener_close(server.listener);
+  metrics_exporter_destroy(server.exporter);
+  server = {};
+}
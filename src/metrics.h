@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base.h"
+#include "sources/listener.h"
+
+struct State;
+struct StateSnapshot;
+struct Sync;
+
+// Metrics mode of prock-collect (--metrics ADDR): an HTTP endpoint serving
+// GET /metrics in the OpenMetrics text format for Prometheus and friends.
+//
+// System CPU per core, meminfo, disk and network rates are always exported.
+// Processes are limited to the top N by CPU and the top N by resident memory,
+// labeled with pid and comm, so a scrape has at most 2 * N process series.
+constexpr size_t METRICS_MAX_TOP = 100;
+constexpr size_t METRICS_MAX_CLIENTS = 16;
+constexpr size_t METRICS_REQUEST_BYTES = 2048;
+// Clients without complete request headers by then are dropped, so idle
+// connections can't take every slot
+constexpr int METRICS_REQUEST_TIMEOUT_SEC = 5;
+// Clients that stop reading the response are dropped
+constexpr int METRICS_SEND_TIMEOUT_SEC = 5;
+
+struct MetricsExporter {
+  size_t top;        // processes per ranking, at most METRICS_MAX_TOP
+  ArenaSlab *buffer; // rendered page, grown on demand
+  ArenaSlab *order;  // process indices, grown on demand
+};
+
+// Renders `snapshot`, valid until the next call
+String metrics_render(MetricsExporter &exporter, const StateSnapshot &snapshot);
+void metrics_exporter_destroy(MetricsExporter &exporter);
+
+// Sockets are non-blocking, a slow scraper never stalls applying snapshots
+struct MetricsClient {
+  int fd;
+  SteadyTimePoint deadline; // of the request, then of the response
+  char request[METRICS_REQUEST_BYTES]; // headers received so far
+  size_t request_size;
+  ArenaSlab *response; // header and body, nullptr until answered
+  size_t response_size;
+  size_t response_sent;
+};
+
+struct MetricsServer {
+  Listener listener;
+  MetricsClient clients[METRICS_MAX_CLIENTS];
+  size_t client_count;
+  // METRICS_REQUEST_TIMEOUT_SEC, shorter in tests
+  SteadyClock::duration request_timeout;
+
+  MetricsExporter exporter;
+  String page;     // rendered from the latest snapshot on the first scrape
+  bool page_stale; // a snapshot arrived after `page` was rendered
+};
+
+// Same addresses as agent mode (see sources/agent.h), but an empty host
+// listens on every interface for remote scrapers
+bool metrics_listen(MetricsServer &server, const char *address, size_t top);
+// Called by the gathering thread after gather(), wakes metrics_serve()
+void metrics_notify(MetricsServer &server);
+// Until sync.quit: applies snapshots of sync.update_queue to `state` and
+// answers scrapes. Call metrics_notify() after setting sync.quit.
+void metrics_serve(MetricsServer &server, State &state, Sync &sync);
+void metrics_server_close(MetricsServer &server);
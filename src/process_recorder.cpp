@@ -0,0 +1,173 @@
+#include "process_recorder.h"
+
+#include "state.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sys/mman.h>
+
+static uint16_t quantize_perc(const double perc) {
+  const double val = std::round(perc * 4);
+  return static_cast<uint16_t>(std::clamp(val, 0.0, 65535.0));
+}
+
+// Upper half of a float32: 8 bits of mantissa are plenty for rates
+static uint16_t to_bfloat16(const double value) {
+  const float f = static_cast<float>(std::max(value, 0.0));
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  bits += 0x7fff + ((bits >> 16) & 1); // round to nearest even
+  return static_cast<uint16_t>(bits >> 16);
+}
+
+static double from_bfloat16(const uint16_t value) {
+  const uint32_t bits = static_cast<uint32_t>(value) << 16;
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+static RecordedSample recorder_encode(const ProcessDerivedStat &derived) {
+  RecordedSample res;
+  res.cpu_total =
+      quantize_perc(derived.cpu_user_perc + derived.cpu_kernel_perc);
+  res.cpu_kernel = quantize_perc(derived.cpu_kernel_perc);
+  res.mem_resident_kb = static_cast<uint32_t>(
+      std::min(derived.mem_resident_bytes / 1024, 4294967295.0));
+  res.io_read = to_bfloat16(derived.io_read_kb_per_sec);
+  res.io_write = to_bfloat16(derived.io_write_kb_per_sec);
+  res.net_recv = to_bfloat16(derived.net_recv_kb_per_sec);
+  res.net_send = to_bfloat16(derived.net_send_kb_per_sec);
+  return res;
+}
+
+ProcessDerivedStat recorder_decode(const RecordedSample &sample) {
+  ProcessDerivedStat res = {};
+  res.cpu_kernel_perc = sample.cpu_kernel / 4.0;
+  res.cpu_user_perc =
+      std::max(0.0, sample.cpu_total / 4.0 - res.cpu_kernel_perc);
+  res.mem_resident_bytes = sample.mem_resident_kb * 1024.0;
+  res.io_read_kb_per_sec = from_bfloat16(sample.io_read);
+  res.io_write_kb_per_sec = from_bfloat16(sample.io_write);
+  res.net_recv_kb_per_sec = from_bfloat16(sample.net_recv);
+  res.net_send_kb_per_sec = from_bfloat16(sample.net_send);
+  return res;
+}
+
+static constexpr size_t SLOTS_BYTES =
+    RECORDER_SAMPLES * RECORDER_MAX_PROCESSES * sizeof(RecordedSample);
+static constexpr size_t PROCESSES_BYTES =
+    RECORDER_MAX_PROCESSES * sizeof(RecordedProcess);
+static constexpr size_t STORAGE_BYTES =
+    SLOTS_BYTES + 2 * PROCESSES_BYTES + RECORDER_MAX_PROCESSES * sizeof(uint);
+
+static bool recorder_init(ProcessRecorder &recorder) {
+  // Reserved, not committed: untouched slots never cost memory
+  void *storage = mmap(nullptr, STORAGE_BYTES, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (storage == MAP_FAILED) return false;
+
+  recorder.storage = static_cast<uint8_t *>(storage);
+  recorder.slots = reinterpret_cast<RecordedSample *>(recorder.storage);
+  recorder.processes.data =
+      reinterpret_cast<RecordedProcess *>(recorder.storage + SLOTS_BYTES);
+  recorder.spare_processes = reinterpret_cast<RecordedProcess *>(
+      recorder.storage + SLOTS_BYTES + PROCESSES_BYTES);
+  recorder.free_slots = reinterpret_cast<uint *>(
+      recorder.storage + SLOTS_BYTES + 2 * PROCESSES_BYTES);
+  return true;
+}
+
+static void release_slot(ProcessRecorder &recorder, const uint slot) {
+  recorder.free_slots[recorder.free_count++] = slot;
+}
+
+static bool acquire_slot(ProcessRecorder &recorder, uint &slot) {
+  if (recorder.free_count > 0) {
+    slot = recorder.free_slots[--recorder.free_count];
+    return true;
+  }
+  if (recorder.used_slots < RECORDER_MAX_PROCESSES) {
+    slot = recorder.used_slots++;
+    return true;
+  }
+  return false;
+}
+
+void process_recorder_update(ProcessRecorder &recorder,
+                             const StateSnapshot &snapshot, const double at) {
+  ZoneScoped;
+  if (!recorder.storage && !recorder_init(recorder)) {
+    return;
+  }
+
+  const size_t frame = recorder.sample_count % RECORDER_SAMPLES;
+  const Array<RecordedProcess> old = recorder.processes;
+  RecordedProcess *result = recorder.spare_processes;
+  size_t count = 0;
+  size_t old_idx = 0;
+  recorder.untracked = 0;
+
+  // Both lists are sorted by pid
+  for (size_t i = 0; i < snapshot.stats.size; ++i) {
+    const ProcessStat &stat = snapshot.stats.data[i];
+    while (old_idx < old.size && old.data[old_idx].pid < stat.pid) {
+      release_slot(recorder, old.data[old_idx++].slot);
+    }
+
+    RecordedProcess process;
+    if (old_idx < old.size && old.data[old_idx].pid == stat.pid &&
+        old.data[old_idx].starttime == stat.starttime) {
+      process = old.data[old_idx++];
+    } else {
+      if (old_idx < old.size && old.data[old_idx].pid == stat.pid) {
+        release_slot(recorder, old.data[old_idx++].slot);
+      }
+      if (!acquire_slot(recorder, process.slot)) {
+        ++recorder.untracked;
+        continue;
+      }
+      process.pid = stat.pid;
+      process.starttime = stat.starttime;
+      process.first_sample = recorder.sample_count;
+    }
+
+    recorder.slots[process.slot * RECORDER_SAMPLES + frame] =
+        recorder_encode(snapshot.derived_stats.data[i]);
+    result[count++] = process;
+  }
+  while (old_idx < old.size) {
+    release_slot(recorder, old.data[old_idx++].slot);
+  }
+
+  recorder.spare_processes = old.data;
+  recorder.processes = {result, count};
+  recorder.times[frame] = at;
+  ++recorder.sample_count;
+}
+
+void process_recorder_destroy(ProcessRecorder &recorder) {
+  if (recorder.storage) munmap(recorder.storage, STORAGE_BYTES);
+  recorder = {};
+}
+
+size_t process_recorder_byte_size(const ProcessRecorder &recorder) {
+  constexpr size_t SLOT_BYTES = RECORDER_SAMPLES * sizeof(RecordedSample);
+  const size_t frames = std::min(recorder.sample_count, RECORDER_SAMPLES);
+  if (frames == 0) return 0;
+  // Every slot used its first `frames` samples, neighbours may share a page
+  size_t pages = 0;
+  size_t prev_last = SIZE_MAX;
+  for (size_t slot = 0; slot < recorder.used_slots; ++slot) {
+    const size_t begin = slot * SLOT_BYTES;
+    size_t first = begin / SLAB_SIZE;
+    const size_t end = begin + frames * sizeof(RecordedSample);
+    const size_t last = (end - 1) / SLAB_SIZE;
+    if (first == prev_last) ++first;
+    pages += last + 1 - first;
+    prev_last = last;
+  }
+  return pages * SLAB_SIZE;
+}
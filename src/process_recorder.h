@@ -0,0 +1,89 @@
+#pragma once
+
+#include "base.h"
+
+struct ProcessDerivedStat;
+struct StateSnapshot;
+
+// Background history of every process, so per-process charts can show what
+// happened before they were opened.
+//
+// Storage is a ring of RECORDER_SAMPLES samples per process slot, slot after
+// slot. All of it is reserved once up front and only the pages of slots in
+// use are ever touched.
+constexpr size_t RECORDER_SAMPLES = 1200; // 10 minutes at 0.5 s
+constexpr size_t RECORDER_BUDGET = 32 * 1024 * 1024;
+
+// Quantized ProcessDerivedStat, 16 bytes per process per sample
+struct RecordedSample {
+  uint16_t cpu_total;  // percent * 4
+  uint16_t cpu_kernel; // percent * 4
+  uint32_t mem_resident_kb;
+  uint16_t io_read;  // KB/s as bfloat16
+  uint16_t io_write; // KB/s as bfloat16
+  uint16_t net_recv; // KB/s as bfloat16
+  uint16_t net_send; // KB/s as bfloat16
+};
+static_assert(sizeof(RecordedSample) == 16, "recorded sample must stay small");
+
+constexpr size_t RECORDER_MAX_PROCESSES =
+    RECORDER_BUDGET / (RECORDER_SAMPLES * sizeof(RecordedSample));
+
+// A process is identified by (pid, starttime), so a reused pid starts a new
+// history instead of continuing the old one
+struct RecordedProcess {
+  int pid;
+  uint slot;
+  ulonglong starttime;
+  size_t first_sample; // absolute index of its first sample
+};
+
+struct ProcessRecorder {
+  uint8_t *storage; // frames, process lists and free slots
+
+  // Rings of slots [RECORDER_MAX_PROCESSES][RECORDER_SAMPLES]
+  RecordedSample *slots;
+  double times[RECORDER_SAMPLES];
+  size_t sample_count; // total samples recorded, ring index is % SAMPLES
+
+  // Sorted by pid, swapped on every update
+  Array<RecordedProcess> processes;
+  RecordedProcess *spare_processes;
+
+  uint *free_slots;
+  size_t free_count;
+  uint used_slots; // slots ever handed out, bounds touched memory
+
+  size_t untracked; // processes without a free slot at the last update
+};
+
+void process_recorder_update(ProcessRecorder &recorder,
+                             const StateSnapshot &snapshot, double at);
+void process_recorder_destroy(ProcessRecorder &recorder);
+
+// Memory actually backing recorded samples, the pages touched so far
+size_t process_recorder_byte_size(const ProcessRecorder &recorder);
+
+ProcessDerivedStat recorder_decode(const RecordedSample &sample);
+
+// Calls f(time, derived) for all recorded samples of `pid`, oldest first
+template <class F>
+void process_recorder_replay(const ProcessRecorder &recorder, const int pid,
+                             F f) {
+  const Array<RecordedProcess> &processes = recorder.processes;
+  const size_t idx = bin_search_exact(
+      processes.size, [&](size_t i) { return processes.data[i].pid; }, pid);
+  if (idx == SIZE_MAX) return;
+
+  const RecordedProcess &process = processes.data[idx];
+  const size_t ring_start = recorder.sample_count > RECORDER_SAMPLES
+                                ? recorder.sample_count - RECORDER_SAMPLES
+                                : 0;
+  for (size_t s = std::max(ring_start, process.first_sample);
+       s < recorder.sample_count; ++s) {
+    const size_t frame = s % RECORDER_SAMPLES;
+    f(recorder.times[frame],
+      recorder_decode(
+          recorder.slots[process.slot * RECORDER_SAMPLES + frame]));
+  }
+}
@@ -0,0 +1,210 @@
+// Shared memory snapshots of prock, the whole reader for C and C++.
+//
+// `prock --shm NAME` and `prock-collect --shm NAME` publish their latest
+// system and per-process stats into the POSIX shared memory object NAME
+// (e.g. "/prock"). Any number of readers map it read-only and copy a
+// consistent snapshot without syscalls:
+//
+//   struct prock_shm_reader reader;
+//   if (prock_shm_open(&reader, "/prock") == 0) {
+//     struct prock_shm_system system;
+//     static struct prock_shm_process processes[4096];
+//     int n = prock_shm_read(&reader, &system, NULL, 0, processes, 4096);
+//     ... n < 0 until the first snapshot is published
+//     prock_shm_close(&reader);
+//   }
+//
+// Layout, native byte order: prock_shm_header, then two buffers of
+// prock_shm_buffer, header.max_cpus prock_shm_cpu and header.max_processes
+// prock_shm_process. Snapshot `published` is in buffer `published & 1` while
+// the writer fills the other one. Every buffer is a seqlock: its `seq` is odd
+// while the buffer is written, a reader retries when it changed under the
+// copy. The struct sizes are in the header, readers built against another
+// layout are rejected by prock_shm_open().
+//
+// Strict C needs POSIX declarations: -std=c11 -D_POSIX_C_SOURCE=200809L, and
+// -lrt with glibc older than 2.34.
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PROCK_SHM_MAGIC 0x4d485350u // "PSHM"
+#define PROCK_SHM_VERSION 1u
+#define PROCK_SHM_COMM_SIZE 32
+
+struct prock_shm_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size; // sizeof of every struct in this file
+  uint32_t buffer_size;
+  uint32_t cpu_size;
+  uint32_t process_size;
+  uint32_t max_cpus;
+  uint32_t max_processes;
+  uint64_t buffer_offsets[2]; // from the start of the mapping
+  uint64_t published; // snapshots so far, 0 before the first one
+};
+
+struct prock_shm_system {
+  double time; // seconds since epoch
+  double cpu_perc; // of all cores
+  double cpu_kernel_perc;
+  uint64_t mem_total_kb;
+  uint64_t mem_free_kb;
+  uint64_t mem_available_kb;
+  uint64_t mem_buffers_kb;
+  uint64_t mem_cached_kb;
+  uint64_t swap_total_kb;
+  uint64_t swap_free_kb;
+  double disk_read_mb_per_sec;
+  double disk_write_mb_per_sec;
+  double net_recv_mb_per_sec;
+  double net_send_mb_per_sec;
+  uint32_t cpu_count;       // prock_shm_cpu entries in the buffer
+  uint32_t process_count;   // prock_shm_process entries in the buffer
+  uint32_t total_processes; // more than process_count past max_processes
+  uint32_t reserved;
+};
+
+struct prock_shm_buffer {
+  uint64_t seq; // odd while the writer fills the buffer
+  struct prock_shm_system system;
+};
+
+struct prock_shm_cpu {
+  double total_perc; // of one core
+  double kernel_perc;
+};
+
+// Sorted by pid
+struct prock_shm_process {
+  int32_t pid;
+  int32_t ppid;
+  uint32_t threads;
+  char state;
+  char reserved[3];
+  char comm[PROCK_SHM_COMM_SIZE]; // NUL terminated, may be cut short
+  double cpu_user_perc; // 100 per core
+  double cpu_kernel_perc;
+  double mem_resident_bytes;
+  double mem_virtual_bytes;
+  double io_read_kb_per_sec;
+  double io_write_kb_per_sec;
+  double net_recv_kb_per_sec;
+  double net_send_kb_per_sec;
+};
+
+struct prock_shm_reader {
+  const struct prock_shm_header *header;
+  size_t size;
+};
+
+static inline size_t prock_shm_size(const uint32_t max_cpus,
+                                    const uint32_t max_processes) {
+  return sizeof(struct prock_shm_header) +
+         2 * (sizeof(struct prock_shm_buffer) +
+              max_cpus * sizeof(struct prock_shm_cpu) +
+              max_processes * sizeof(struct prock_shm_process));
+}
+
+// 0 on success, -1 with errno set otherwise (EPROTO for another layout)
+static inline int prock_shm_open(struct prock_shm_reader *reader,
+                                 const char *name) {
+  reader->header = NULL;
+  reader->size = 0;
+  const int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  const size_t size = (size_t)st.st_size;
+  void *map = size >= sizeof(struct prock_shm_header)
+                  ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0)
+                  : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED) {
+    if (size < sizeof(struct prock_shm_header)) errno = EPROTO;
+    return -1;
+  }
+
+  const struct prock_shm_header *header =
+      (const struct prock_shm_header *)map;
+  if (header->magic != PROCK_SHM_MAGIC ||
+      header->version != PROCK_SHM_VERSION ||
+      header->header_size != sizeof(struct prock_shm_header) ||
+      header->buffer_size != sizeof(struct prock_shm_buffer) ||
+      header->cpu_size != sizeof(struct prock_shm_cpu) ||
+      header->process_size != sizeof(struct prock_shm_process) ||
+      prock_shm_size(header->max_cpus, header->max_processes) > size) {
+    munmap(map, size);
+    errno = EPROTO;
+    return -1;
+  }
+  reader->header = header;
+  reader->size = size;
+  return 0;
+}
+
+static inline void prock_shm_close(struct prock_shm_reader *reader) {
+  if (reader->header) munmap((void *)reader->header, reader->size);
+  reader->header = NULL;
+  reader->size = 0;
+}
+
+// Copies the latest snapshot: the system stats and up to `max_cpus` cores
+// and `max_processes` processes, `cpus` and `processes` may be NULL when
+// their max is 0. Returns the number of processes copied, -1 before the
+// first snapshot.
+static inline int prock_shm_read(const struct prock_shm_reader *reader,
+                                 struct prock_shm_system *system,
+                                 struct prock_shm_cpu *cpus,
+                                 uint32_t max_cpus,
+                                 struct prock_shm_process *processes,
+                                 uint32_t max_processes) {
+  const struct prock_shm_header *header = reader->header;
+  const char *base = (const char *)header;
+  if (max_cpus > header->max_cpus) max_cpus = header->max_cpus;
+  if (max_processes > header->max_processes) {
+    max_processes = header->max_processes;
+  }
+  for (;;) {
+    const uint64_t published =
+        __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+    if (published == 0) return -1;
+    const uint64_t offset = header->buffer_offsets[published & 1];
+    const struct prock_shm_buffer *buffer =
+        (const struct prock_shm_buffer *)(base + offset);
+    const uint64_t seq = __atomic_load_n(&buffer->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) continue;
+
+    memcpy(system, &buffer->system, sizeof(*system));
+    // Counts of a torn copy are bounded, the copy is retried anyway
+    const uint32_t cpu_count =
+        system->cpu_count < max_cpus ? system->cpu_count : max_cpus;
+    const uint32_t process_count = system->process_count < max_processes
+                                       ? system->process_count
+                                       : max_processes;
+    const char *rows = (const char *)(buffer + 1);
+    if (cpu_count > 0) {
+      memcpy(cpus, rows, cpu_count * sizeof(struct prock_shm_cpu));
+    }
+    rows += header->max_cpus * sizeof(struct prock_shm_cpu);
+    if (process_count > 0) {
+      memcpy(processes, rows,
+             process_count * sizeof(struct prock_shm_process));
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&buffer->seq, __ATOMIC_RELAXED) == seq) {
+      return (int)process_count;
+    }
+  }
+}
@@ -28,6 +28,9 @@ template <class T, size_t N> struct RingBuffer {
     return true;
   }
 
+  // Items waiting, a snapshot when the other side is active
+  size_t size() const { return (tail.load() - head.load()) & MASK; }
+
   bool peek(T &out) const {
     size_t loaded_head = head.load();
     if (loaded_head == tail.load()) return false;
@@ -0,0 +1,85 @@
+#include "self_stats.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+SelfStats g_self_stats;
+
+const char *gather_phase_name(const GatherPhase phase) {
+  switch (phase) {
+  case eGatherPhase_Pids:
+    return "Enumerate pids";
+  case eGatherPhase_Processes:
+    return "Read processes";
+  case eGatherPhase_Sockets:
+    return "Sockets";
+  case eGatherPhase_System:
+    return "System stats";
+  case eGatherPhase_Threads:
+    return "Watched threads";
+  case eGatherPhase_Total:
+    return "Total";
+  case eGatherPhase_COUNT:
+    break;
+  }
+  return "";
+}
+
+size_t SampleWindow::copy(float *out) const {
+  const size_t end = count.load(std::memory_order_acquire);
+  const size_t size = end < SELF_STATS_SAMPLES ? end : SELF_STATS_SAMPLES;
+  for (size_t i = 0; i < size; ++i) {
+    out[i] = samples[(end - size + i) % SELF_STATS_SAMPLES].load(
+        std::memory_order_relaxed);
+  }
+  return size;
+}
+
+SteadyTimePoint self_stats_phase(const GatherPhase phase,
+                                 const SteadyTimePoint started_at) {
+  const SteadyTimePoint now = SteadyClock::now();
+  g_self_stats.gather_phases[phase].add(static_cast<float>(
+      std::chrono::duration<double, std::milli>(now - started_at).count()));
+  return now;
+}
+
+bool self_stats_read_io(size_t &syscalls, size_t &bytes) {
+  // Always the real procfs, prock itself is never in a --proc-root tree
+  FILE *file = fopen("/proc/thread-self/io", "r");
+  if (!file) {
+    return false;
+  }
+  syscalls = 0;
+  bytes = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    char key[32];
+    size_t value = 0;
+    if (sscanf(line, "%31[^:]: %zu", key, &value) == 2) {
+      if (strcmp(key, "rchar") == 0) {
+        bytes = value;
+      } else if (strcmp(key, "syscr") == 0) {
+        syscalls = value;
+      }
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+uint64_t self_stats_thread_cpu_ns() {
+  timespec ts = {};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+float sample_percentile(const float *sorted, const size_t count,
+                        const double p) {
+  if (count == 0) {
+    return 0.0f;
+  }
+  const size_t i = static_cast<size_t>(p * static_cast<double>(count - 1));
+  return sorted[i < count ? i : count - 1];
+}
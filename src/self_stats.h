@@ -0,0 +1,71 @@
+#pragma once
+
+#include "base.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// What prock itself costs, shown in the Prock Internals window.
+// Every counter has one writer and is written with relaxed atomics, a cycle
+// adds a few stores whether the window is open or not. Reading
+// /proc/thread-self/io costs a file read, so it only happens while watched.
+
+enum GatherPhase {
+  eGatherPhase_Pids,
+  eGatherPhase_Processes,
+  eGatherPhase_Sockets,
+  eGatherPhase_System,
+  eGatherPhase_Threads,
+  eGatherPhase_Total,
+  eGatherPhase_COUNT,
+};
+
+const char *gather_phase_name(GatherPhase phase);
+
+constexpr size_t SELF_STATS_SAMPLES = 256;
+
+// Last durations of something, written by one thread and read by any
+struct SampleWindow {
+  std::atomic<float> samples[SELF_STATS_SAMPLES]; // ms
+  std::atomic<size_t> count;
+
+  void add(const float ms) {
+    const size_t i = count.load(std::memory_order_relaxed);
+    samples[i % SELF_STATS_SAMPLES].store(ms, std::memory_order_relaxed);
+    count.store(i + 1, std::memory_order_release);
+  }
+
+  // Copies up to SELF_STATS_SAMPLES samples oldest first, returns how many
+  size_t copy(float *out) const;
+};
+
+struct SelfStats {
+  SampleWindow gather_phases[eGatherPhase_COUNT];
+  SampleWindow gather_lateness; // start after the scheduled slot
+  SampleWindow read_skew;       // first to last process read of a cycle
+  SampleWindow ui_update; // only frames that applied snapshots
+  SampleWindow ui_draw;
+
+  std::atomic<size_t> gathers;
+  std::atomic<size_t> missed_periods; // slots a late gather ran past
+  std::atomic<size_t> read_syscalls; // of the last gather, while watched
+  std::atomic<size_t> read_bytes;    // of the last gather, while watched
+  std::atomic<size_t> snapshots_dropped;   // the update queue was full
+  std::atomic<size_t> snapshots_coalesced; // never drawn, a newer one was
+  std::atomic<uint64_t> gathering_cpu_ns;  // of the gathering thread so far
+
+  std::atomic<bool> watching; // the Internals window is open
+};
+
+extern SelfStats g_self_stats;
+
+// Adds the time since `started_at` to the samples of `phase`, returns now for
+// the start of the next phase
+SteadyTimePoint self_stats_phase(GatherPhase phase,
+                                 SteadyTimePoint started_at);
+// rchar and syscr of /proc/thread-self/io, false if it can't be read
+bool self_stats_read_io(size_t &syscalls, size_t &bytes);
+uint64_t self_stats_thread_cpu_ns();
+// `p` in [0, 1] of samples sorted ascending, 0 if there are none
+float sample_percentile(const float *sorted, size_t count, double p);
@@ -0,0 +1,149 @@
+#include "shm_publisher.h"
+
+#include "state.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+bool shm_publisher_open(ShmPublisher &publisher, const char *name,
+                        const uint32_t max_cpus,
+                        const uint32_t max_processes) {
+  publisher = {};
+  const size_t name_len = strlen(name);
+  if (name[0] != '/' || name_len >= sizeof(publisher.name) ||
+      strchr(name + 1, '/')) {
+    fprintf(stderr, "Shared memory name must be /NAME: %s\n", name);
+    return false;
+  }
+
+  shm_unlink(name);
+  const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to create %s: %s\n", name, strerror(errno));
+    return false;
+  }
+  const size_t size = prock_shm_size(max_cpus, max_processes);
+  void *map = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+    map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "Failed to map %s: %s\n", name, strerror(errno));
+    shm_unlink(name);
+    return false;
+  }
+
+  // ftruncate() zeroes the object, `published` stays 0 until shm_publish()
+  prock_shm_header *header = static_cast<prock_shm_header *>(map);
+  header->magic = PROCK_SHM_MAGIC;
+  header->version = PROCK_SHM_VERSION;
+  header->header_size = sizeof(prock_shm_header);
+  header->buffer_size = sizeof(prock_shm_buffer);
+  header->cpu_size = sizeof(prock_shm_cpu);
+  header->process_size = sizeof(prock_shm_process);
+  header->max_cpus = max_cpus;
+  header->max_processes = max_processes;
+  const size_t buffer_bytes = (size - sizeof(prock_shm_header)) / 2;
+  header->buffer_offsets[0] = sizeof(prock_shm_header);
+  header->buffer_offsets[1] = sizeof(prock_shm_header) + buffer_bytes;
+
+  memcpy(publisher.name, name, name_len + 1);
+  publisher.header = header;
+  publisher.size = size;
+  return true;
+}
+
+void shm_publish(ShmPublisher &publisher, const State &state) {
+  ZoneScoped;
+  // Rates need two updates
+  if (!publisher.header || state.update_count < 2) return;
+
+  prock_shm_header &header = *publisher.header;
+  const uint64_t published = header.published + 1;
+  uint8_t *base = reinterpret_cast<uint8_t *>(publisher.header);
+  prock_shm_buffer &buffer = *reinterpret_cast<prock_shm_buffer *>(
+      base + header.buffer_offsets[published & 1]);
+  prock_shm_cpu *cpus = reinterpret_cast<prock_shm_cpu *>(&buffer + 1);
+  prock_shm_process *processes =
+      reinterpret_cast<prock_shm_process *>(cpus + header.max_cpus);
+
+  // Readers of this buffer see an odd seq until it is complete
+  const uint64_t seq = buffer.seq;
+  __atomic_store_n(&buffer.seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  const StateSnapshot &snapshot = state.snapshot;
+  const SystemCpuPerc &cpu = snapshot.cpu_perc;
+  const MemInfo &mem = snapshot.mem_info;
+  prock_shm_system &system = buffer.system;
+  system.time = std::chrono::duration_cast<Seconds>(
+                    state.update_system_time.time_since_epoch())
+                    .count();
+  system.cpu_perc = cpu.total.size > 0 ? cpu.total.data[0] : 0;
+  system.cpu_kernel_perc = cpu.kernel.size > 0 ? cpu.kernel.data[0] : 0;
+  system.mem_total_kb = mem.mem_total;
+  system.mem_free_kb = mem.mem_free;
+  system.mem_available_kb = mem.mem_available;
+  system.mem_buffers_kb = mem.buffers;
+  system.mem_cached_kb = mem.cached;
+  system.swap_total_kb = mem.swap_total;
+  system.swap_free_kb = mem.swap_free;
+  system.disk_read_mb_per_sec = snapshot.disk_io_rate.read_mb_per_sec;
+  system.disk_write_mb_per_sec = snapshot.disk_io_rate.write_mb_per_sec;
+  system.net_recv_mb_per_sec = snapshot.net_io_rate.recv_mb_per_sec;
+  system.net_send_mb_per_sec = snapshot.net_io_rate.send_mb_per_sec;
+
+  // [0] of the snapshot is every core together
+  const size_t cores = cpu.total.size > 0 ? cpu.total.size - 1 : 0;
+  system.cpu_count =
+      static_cast<uint32_t>(std::min<size_t>(cores, header.max_cpus));
+  for (uint32_t i = 0; i < system.cpu_count; ++i) {
+    cpus[i].total_perc = cpu.total.data[i + 1];
+    cpus[i].kernel_perc = i + 1 < cpu.kernel.size ? cpu.kernel.data[i + 1] : 0;
+  }
+
+  const size_t total = snapshot.stats.size;
+  system.total_processes = static_cast<uint32_t>(total);
+  system.process_count =
+      static_cast<uint32_t>(std::min<size_t>(total, header.max_processes));
+  for (uint32_t i = 0; i < system.process_count; ++i) {
+    const ProcessStat &stat = snapshot.stats.data[i];
+    const ProcessDerivedStat &derived = snapshot.derived_stats.data[i];
+    prock_shm_process &process = processes[i];
+    process.pid = stat.pid;
+    process.ppid = stat.ppid;
+    process.threads = static_cast<uint32_t>(stat.num_threads);
+    process.state = stat.state;
+    const char *comm = stat.comm ? stat.comm : "";
+    const size_t comm_len = std::min(strlen(comm), sizeof(process.comm) - 1);
+    memcpy(process.comm, comm, comm_len);
+    memset(process.comm + comm_len, 0, sizeof(process.comm) - comm_len);
+    process.cpu_user_perc = derived.cpu_user_perc;
+    process.cpu_kernel_perc = derived.cpu_kernel_perc;
+    process.mem_resident_bytes = derived.mem_resident_bytes;
+    process.mem_virtual_bytes = derived.mem_virtual_bytes;
+    process.io_read_kb_per_sec = derived.io_read_kb_per_sec;
+    process.io_write_kb_per_sec = derived.io_write_kb_per_sec;
+    process.net_recv_kb_per_sec = derived.net_recv_kb_per_sec;
+    process.net_send_kb_per_sec = derived.net_send_kb_per_sec;
+  }
+
+  __atomic_store_n(&buffer.seq, seq + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&header.published, published, __ATOMIC_RELEASE);
+}
+
+void shm_publisher_close(ShmPublisher &publisher) {
+  if (publisher.header) {
+    munmap(publisher.header, publisher.size);
+    shm_unlink(publisher.name);
+  }
+  publisher = {};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "base.h"
+#include "prock_shm.h"
+
+struct State;
+
+// Writer side of prock_shm.h (--shm NAME)
+constexpr uint32_t SHM_MAX_CPUS = 1024;
+// Pages past the running processes are never touched
+constexpr uint32_t SHM_MAX_PROCESSES = 65536;
+
+struct ShmPublisher {
+  char name[256];
+  prock_shm_header *header;
+  size_t size;
+};
+
+// Replaces an object left by an earlier run, its readers keep the old one
+bool shm_publisher_open(ShmPublisher &publisher, const char *name,
+                        uint32_t max_cpus, uint32_t max_processes);
+// Publishes the snapshot of `state` once its rates are known
+void shm_publish(ShmPublisher &publisher, const State &state);
+// Unlinks the object
+void shm_publisher_close(ShmPublisher &publisher);
@@ -0,0 +1,684 @@
+#include "agent.h"
+
+#include "sync.h"
+#include "tracy/Tracy.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <linux/tcp.h> // not netinet/tcp.h, they clash in the unity build
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool agent_resolve(const char *address, const bool passive,
+                   AgentAddress &out) {
+  out = {};
+  const char *path = nullptr;
+  if (strncmp(address, "unix:", 5) == 0) {
+    path = address + 5;
+  } else if (strchr(address, '/')) {
+    path = address;
+  }
+  if (path) {
+    sockaddr_un &addr = reinterpret_cast<sockaddr_un &>(out.addr);
+    const size_t len = strlen(path);
+    if (len == 0 || len >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, len + 1);
+    out.len = sizeof(sockaddr_un);
+    out.is_unix = true;
+    return true;
+  }
+
+  const char *colon = strrchr(address, ':');
+  if (!colon) return false;
+  char host[256];
+  const size_t host_len = colon - address;
+  if (host_len >= sizeof(host)) return false;
+  memcpy(host, address, host_len);
+  host[host_len] = '\0';
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host_len > 0 ? host : nullptr, colon + 1, &hints,
+                  &result) != 0) {
+    return false;
+  }
+  memcpy(&out.addr, result->ai_addr, result->ai_addrlen);
+  out.len = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+static bool send_all(const int fd, const void *data, size_t size) {
+  const uint8_t *it = static_cast<const uint8_t *>(data);
+  while (size > 0) {
+    const ssize_t n = send(fd, it, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    it += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool recv_all(const int fd, void *data, size_t size) {
+  uint8_t *it = static_cast<uint8_t *>(data);
+  while (size > 0) {
+    const ssize_t n = recv(fd, it, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    it += n;
+    size -= n;
+  }
+  return true;
+}
+
+static uint8_t *grow_buffer(ArenaSlab *&buffer, const size_t size) {
+  if (!buffer || buffer->total_size - sizeof(ArenaSlab) < size) {
+    if (buffer) ArenaSlab::release(buffer);
+    const size_t slab_size = std::max(2 * size + sizeof(ArenaSlab), SLAB_SIZE);
+    buffer = ArenaSlab::create(slab_size);
+    if (!buffer) return nullptr;
+  }
+  return reinterpret_cast<uint8_t *>(buffer) + sizeof(ArenaSlab);
+}
+
+// Outgoing messages are built in place after room for their header
+static uint8_t *message_begin(ArenaSlab *&buffer, const size_t body_bound) {
+  uint8_t *data = grow_buffer(buffer, sizeof(AgentMessageHeader) + body_bound);
+  return data ? data + sizeof(AgentMessageHeader) : nullptr;
+}
+
+static bool message_send(const int fd, ArenaSlab *buffer,
+                         const AgentMessageType type, const uint8_t *body_end) {
+  uint8_t *data = reinterpret_cast<uint8_t *>(buffer) + sizeof(ArenaSlab);
+  const size_t bytes = body_end - data - sizeof(AgentMessageHeader);
+  const AgentMessageHeader header = {type, static_cast<uint32_t>(bytes)};
+  memcpy(data, &header, sizeof(header));
+  return send_all(fd, data, sizeof(header) + bytes);
+}
+
+static uint8_t *put_bytes(uint8_t *out, const void *data, const size_t size) {
+  memcpy(out, data, size);
+  return out + size;
+}
+
+static bool take_bytes(const uint8_t *&in, const uint8_t *end, void *data,
+                       const size_t size) {
+  if (size > static_cast<size_t>(end - in)) return false;
+  memcpy(data, in, size);
+  in += size;
+  return true;
+}
+
+// ============================================================================
+// Agent
+// ============================================================================
+
+static bool is_loopback(const AgentAddress &addr) {
+  if (addr.addr.ss_family == AF_INET) {
+    const sockaddr_in &in = reinterpret_cast<const sockaddr_in &>(addr.addr);
+    return (ntohl(in.sin_addr.s_addr) >> 24) == 127;
+  }
+  if (addr.addr.ss_family == AF_INET6) {
+    const sockaddr_in6 &in6 =
+        reinterpret_cast<const sockaddr_in6 &>(addr.addr);
+    return IN6_IS_ADDR_LOOPBACK(&in6.sin6_addr);
+  }
+  return false;
+}
+
+bool agent_listen(AgentServer &server, const char *address,
+                  const uint64_t ticks_in_second,
+                  const uint64_t mem_page_size) {
+  server = {};
+  server.listener = LISTENER_CLOSED;
+
+  // Not passive, an empty host listens on loopback only
+  AgentAddress addr;
+  if (!agent_resolve(address, false, addr)) {
+    fprintf(stderr, "Invalid agent address: %s\n", address);
+    return false;
+  }
+  if (!addr.is_unix && !is_loopback(addr)) {
+    fprintf(stderr,
+            "Warning: the agent on %s is not authenticated, anyone reaching "
+            "it can read process environments\n",
+            address);
+  }
+  if (!listener_open(server.listener, addr, address, AGENT_MAX_CLIENTS)) {
+    return false;
+  }
+
+  AgentHello &hello = server.hello;
+  hello.magic = AGENT_MAGIC;
+  hello.version = AGENT_PROTOCOL_VERSION;
+  hello.process_stat_size = sizeof(ProcessStat);
+  hello.cpu_core_stat_size = sizeof(CpuCoreStat);
+  hello.socket_entry_size = sizeof(SocketEntry);
+  hello.ticks_in_second = ticks_in_second;
+  hello.mem_page_size = mem_page_size;
+  return true;
+}
+
+void agent_notify(AgentServer &server) { listener_wake(server.listener); }
+
+static void close_peer(AgentPeer &peer) { close(peer.fd); }
+
+static void accept_peer(AgentServer &server) {
+  const int fd =
+      accept4(server.listener.listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (fd < 0) return;
+  if (server.peer_count >= AGENT_MAX_CLIENTS) {
+    close(fd);
+    return;
+  }
+  const timeval timeout = {AGENT_SEND_TIMEOUT_SEC, 0};
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // TCP only
+
+  const AgentMessageHeader header = {eAgentMessage_Hello, sizeof(AgentHello)};
+  if (!send_all(fd, &header, sizeof(header)) ||
+      !send_all(fd, &server.hello, sizeof(server.hello))) {
+    close(fd);
+    return;
+  }
+  AgentPeer &peer = server.peers[server.peer_count++];
+  peer = {};
+  peer.fd = fd;
+  peer.needs_keyframe = true;
+}
+
+// Every snapshot is encoded at most twice: a delta for peers that received
+// the previous one and a keyframe for peers that just connected
+static void send_snapshot(AgentServer &server,
+                          const UpdateSnapshot &snapshot) {
+  ZoneScoped;
+  if (server.peer_count == 0) return;
+  const size_t bound =
+      sizeof(SnapshotRecordHeader) + snapshot_encode_bound(snapshot);
+  for (const bool keyframe : {false, true}) {
+    bool wanted = false;
+    for (size_t i = 0; i < server.peer_count; ++i) {
+      wanted |= server.peers[i].needs_keyframe == keyframe;
+    }
+    if (!wanted) continue;
+
+    uint8_t *body = message_begin(server.buffer, bound);
+    if (!body) return;
+    SnapshotRecordHeader header;
+    const uint8_t *end = snapshot_encode(server.codec, snapshot, keyframe,
+                                         header, body + sizeof(header));
+    memcpy(body, &header, sizeof(header));
+    drop_clients(
+        server.peers, server.peer_count,
+        [&](size_t, AgentPeer &peer) {
+          if (peer.needs_keyframe != keyframe) return true;
+          peer.needs_keyframe = false;
+          return message_send(peer.fd, server.buffer, eAgentMessage_Snapshot,
+                              end);
+        },
+        close_peer);
+  }
+  snapshot_codec_advance(server.codec, snapshot, true);
+}
+
+static bool send_libraries(AgentServer &server, const int fd,
+                           const LibraryResponse &response) {
+  const Array<LibraryEntry> &libraries = response.libraries;
+  size_t bound = sizeof(AgentResponseHeader);
+  for (size_t i = 0; i < libraries.size; ++i) {
+    bound += sizeof(AgentLibraryEntry) + libraries.data[i].path_len;
+  }
+  uint8_t *out = message_begin(server.buffer, bound);
+  if (!out) return false;
+  const AgentResponseHeader header = {response.pid, response.error_code,
+                                      static_cast<uint32_t>(libraries.size), 0};
+  out = put_bytes(out, &header, sizeof(header));
+  for (size_t i = 0; i < libraries.size; ++i) {
+    const LibraryEntry &library = libraries.data[i];
+    AgentLibraryEntry entry = {};
+    entry.addr_start = library.addr_start;
+    entry.addr_end = library.addr_end;
+    entry.file_size = library.file_size;
+    entry.path_len = static_cast<uint32_t>(library.path_len);
+    out = put_bytes(out, &entry, sizeof(entry));
+    out = put_bytes(out, library.path, library.path_len);
+  }
+  return message_send(fd, server.buffer, eAgentMessage_LibraryResponse, out);
+}
+
+static bool send_environ(AgentServer &server, const int fd,
+                         const EnvironResponse &response) {
+  const Array<EnvironEntry> &entries = response.entries;
+  size_t bound = sizeof(AgentResponseHeader);
+  for (size_t i = 0; i < entries.size; ++i) {
+    bound += sizeof(AgentEnvironEntry) + entries.data[i].name_len +
+             entries.data[i].value_len;
+  }
+  uint8_t *out = message_begin(server.buffer, bound);
+  if (!out) return false;
+  const AgentResponseHeader header = {response.pid, response.error_code,
+                                      static_cast<uint32_t>(entries.size), 0};
+  out = put_bytes(out, &header, sizeof(header));
+  for (size_t i = 0; i < entries.size; ++i) {
+    const EnvironEntry &env = entries.data[i];
+    const AgentEnvironEntry entry = {static_cast<uint32_t>(env.name_len),
+                                     static_cast<uint32_t>(env.value_len)};
+    out = put_bytes(out, &entry, sizeof(entry));
+    out = put_bytes(out, env.name, env.name_len);
+    out = put_bytes(out, env.value, env.value_len);
+  }
+  return message_send(fd, server.buffer, eAgentMessage_EnvironResponse, out);
+}
+
+static bool send_sockets(AgentServer &server, const int fd,
+                         const SocketResponse &response) {
+  const Array<SocketEntry> &sockets = response.sockets;
+  const size_t bytes = sockets.size * sizeof(SocketEntry);
+  uint8_t *out = message_begin(server.buffer,
+                               sizeof(AgentResponseHeader) + bytes);
+  if (!out) return false;
+  const AgentResponseHeader header = {response.pid, response.error_code,
+                                      static_cast<uint32_t>(sockets.size), 0};
+  out = put_bytes(out, &header, sizeof(header));
+  if (bytes > 0) out = put_bytes(out, sockets.data, bytes);
+  return message_send(fd, server.buffer, eAgentMessage_SocketResponse, out);
+}
+
+static bool answer_request(AgentServer &server, const int fd,
+                           const AgentMessageHeader &header,
+                           const uint8_t *body) {
+  ZoneScoped;
+  AgentRequest request;
+  if (header.bytes != sizeof(request)) return false;
+  memcpy(&request, body, sizeof(request));
+
+  bool ok = false;
+  switch (header.type) {
+  case eAgentMessage_LibraryRequest: {
+    LibraryResponse response =
+        read_process_libraries(server.temp_arena, {request.pid});
+    ok = send_libraries(server, fd, response);
+    response.owner_arena.destroy();
+    break;
+  }
+  case eAgentMessage_EnvironRequest: {
+    EnvironResponse response =
+        read_process_environ(server.temp_arena, {request.pid});
+    ok = send_environ(server, fd, response);
+    response.owner_arena.destroy();
+    break;
+  }
+  case eAgentMessage_SocketRequest: {
+    SocketResponse response =
+        read_process_sockets(server.temp_arena, {request.pid});
+    ok = send_sockets(server, fd, response);
+    response.owner_arena.destroy();
+    break;
+  }
+  default:
+    break;
+  }
+  server.temp_arena.destroy();
+  return ok;
+}
+
+// False when the peer is gone or misbehaves
+static bool receive_requests(AgentServer &server, AgentPeer &peer) {
+  const ssize_t n = recv(peer.fd, peer.rx + peer.rx_size,
+                         sizeof(peer.rx) - peer.rx_size, MSG_DONTWAIT);
+  if (n == 0) return false;
+  if (n < 0) return errno == EAGAIN || errno == EINTR;
+  peer.rx_size += n;
+
+  while (peer.rx_size >= sizeof(AgentMessageHeader)) {
+    AgentMessageHeader header;
+    memcpy(&header, peer.rx, sizeof(header));
+    if (header.bytes > sizeof(peer.rx) - sizeof(header)) return false;
+    const size_t size = sizeof(header) + header.bytes;
+    if (peer.rx_size < size) break;
+    if (!answer_request(server, peer.fd, header, peer.rx + sizeof(header))) {
+      return false;
+    }
+    memmove(peer.rx, peer.rx + size, peer.rx_size - size);
+    peer.rx_size -= size;
+  }
+  return true;
+}
+
+void agent_serve(AgentServer &server, Sync &sync) {
+  while (!sync.quit.load()) {
+    pollfd fds[2 + AGENT_MAX_CLIENTS] = {};
+    fds[0] = {server.listener.listen_fd, POLLIN, 0};
+    fds[1] = {server.listener.wake_fds[0], POLLIN, 0};
+    for (size_t i = 0; i < server.peer_count; ++i) {
+      fds[2 + i] = {server.peers[i].fd, POLLIN, 0};
+    }
+    if (poll(fds, 2 + server.peer_count, -1) < 0) {
+      if (errno == EINTR) continue;
+      perror("agent: poll");
+      break;
+    }
+
+    drop_clients(
+        server.peers, server.peer_count,
+        [&](const size_t i, AgentPeer &peer) {
+          return fds[2 + i].revents == 0 || receive_requests(server, peer);
+        },
+        close_peer);
+
+    if (fds[1].revents != 0) {
+      listener_drain(server.listener);
+      UpdateSnapshot snapshot = {};
+      while (sync.update_queue.pop(snapshot)) {
+        send_snapshot(server, snapshot);
+        snapshot.owner_arena.destroy();
+      }
+    }
+
+    if (fds[0].revents != 0) {
+      accept_peer(server);
+    }
+  }
+
+  UpdateSnapshot snapshot = {};
+  while (sync.update_queue.pop(snapshot)) {
+    snapshot.owner_arena.destroy();
+  }
+}
+
+void agent_server_close(AgentServer &server) {
+  for (size_t i = 0; i < server.peer_count; ++i) {
+    close(server.peers[i].fd);
+  }
+  listener_close(server.listener);
+  snapshot_codec_destroy(server.codec);
+  if (server.buffer) ArenaSlab::release(server.buffer);
+  server.temp_arena.destroy();
+  server = {};
+}
+
+// ============================================================================
+// GUI side
+// ============================================================================
+
+bool agent_connect(AgentConnection &connection, const char *address) {
+  connection = {};
+  connection.fd = -1;
+  AgentAddress addr;
+  if (!agent_resolve(address, false, addr)) {
+    fprintf(stderr, "Invalid agent address: %s\n", address);
+    return false;
+  }
+  connection.fd = socket(addr.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (connection.fd < 0 ||
+      connect(connection.fd, reinterpret_cast<sockaddr *>(&addr.addr),
+              addr.len) != 0) {
+    fprintf(stderr, "Failed to connect to %s: %s\n", address,
+            strerror(errno));
+    agent_connection_close(connection);
+    return false;
+  }
+  const int one = 1;
+  setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  AgentMessageHeader header;
+  AgentHello &hello = connection.hello;
+  // The hello is read before anything else, so no message is buffered
+  if (!recv_all(connection.fd, &header, sizeof(header)) ||
+      header.type != eAgentMessage_Hello || header.bytes != sizeof(hello) ||
+      !recv_all(connection.fd, &hello, sizeof(hello)) ||
+      hello.magic != AGENT_MAGIC) {
+    fprintf(stderr, "%s is not a prock agent\n", address);
+    agent_connection_close(connection);
+    return false;
+  }
+  if (hello.version != AGENT_PROTOCOL_VERSION ||
+      hello.process_stat_size != sizeof(ProcessStat) ||
+      hello.cpu_core_stat_size != sizeof(CpuCoreStat) ||
+      hello.socket_entry_size != sizeof(SocketEntry)) {
+    fprintf(stderr, "Agent %s runs an incompatible version of prock\n",
+            address);
+    agent_connection_close(connection);
+    return false;
+  }
+  return true;
+}
+
+static bool read_libraries(const uint8_t *in, const uint8_t *end,
+                           LibraryResponse &response) {
+  AgentResponseHeader header;
+  if (!take_bytes(in, end, &header, sizeof(header)) ||
+      header.count > (end - in) / sizeof(AgentLibraryEntry)) {
+    return false;
+  }
+  response = {header.pid, header.error_code, BumpArena::create(), {}};
+  BumpArena &arena = response.owner_arena;
+  response.libraries = Array<LibraryEntry>::create(arena, header.count);
+  for (size_t i = 0; i < header.count; ++i) {
+    AgentLibraryEntry entry;
+    if (!take_bytes(in, end, &entry, sizeof(entry)) ||
+        entry.path_len > static_cast<size_t>(end - in)) {
+      arena.destroy();
+      return false;
+    }
+    LibraryEntry &library = response.libraries.data[i];
+    library.path = arena.alloc_string_copy(
+        reinterpret_cast<const char *>(in), entry.path_len);
+    library.path_len = entry.path_len;
+    library.addr_start = entry.addr_start;
+    library.addr_end = entry.addr_end;
+    library.file_size = entry.file_size;
+    in += entry.path_len;
+  }
+  return true;
+}
+
+static bool read_environ(const uint8_t *in, const uint8_t *end,
+                         EnvironResponse &response) {
+  AgentResponseHeader header;
+  if (!take_bytes(in, end, &header, sizeof(header)) ||
+      header.count > (end - in) / sizeof(AgentEnvironEntry)) {
+    return false;
+  }
+  response = {header.pid, header.error_code, BumpArena::create(), {}};
+  BumpArena &arena = response.owner_arena;
+  response.entries = Array<EnvironEntry>::create(arena, header.count);
+  for (size_t i = 0; i < header.count; ++i) {
+    AgentEnvironEntry entry;
+    if (!take_bytes(in, end, &entry, sizeof(entry)) ||
+        static_cast<size_t>(entry.name_len) + entry.value_len >
+            static_cast<size_t>(end - in)) {
+      arena.destroy();
+      return false;
+    }
+    EnvironEntry &env = response.entries.data[i];
+    const char *text = reinterpret_cast<const char *>(in);
+    env.name = arena.alloc_string_copy(text, entry.name_len);
+    env.value = arena.alloc_string_copy(text + entry.name_len, entry.value_len);
+    env.name_len = entry.name_len;
+    env.value_len = entry.value_len;
+    in += entry.name_len + entry.value_len;
+  }
+  return true;
+}
+
+static bool read_sockets(const uint8_t *in, const uint8_t *end,
+                         SocketResponse &response) {
+  AgentResponseHeader header;
+  if (!take_bytes(in, end, &header, sizeof(header)) ||
+      header.count != (end - in) / sizeof(SocketEntry)) {
+    return false;
+  }
+  response = {header.pid, header.error_code, BumpArena::create(), {}};
+  response.sockets =
+      Array<SocketEntry>::create(response.owner_arena, header.count);
+  if (header.count > 0) {
+    memcpy(response.sockets.data, in, header.count * sizeof(SocketEntry));
+  }
+  return true;
+}
+
+static bool receive_snapshot(AgentConnection &connection, const uint8_t *body,
+                             const size_t bytes, Sync &sync) {
+  SnapshotRecordHeader record;
+  if (bytes < sizeof(record)) return false;
+  memcpy(&record, body, sizeof(record));
+  if (record.payload_bytes != bytes - sizeof(record)) return false;
+
+  // The body buffer is reused, so comm strings are copied
+  UpdateSnapshot snapshot = {};
+  if (!snapshot_decode(connection.codec, record, body + sizeof(record), false,
+                       snapshot)) {
+    return false;
+  }
+  snapshot_codec_advance(connection.codec, snapshot, true);
+  if (!sync.update_queue.push(snapshot)) {
+    snapshot.owner_arena.destroy();
+  }
+  return true;
+}
+
+static bool dispatch(AgentConnection &connection,
+                     const AgentMessageHeader &header, const uint8_t *body,
+                     Sync &sync) {
+  ZoneScoped;
+  const uint8_t *end = body + header.bytes;
+  OnDemandReaderSync &on_demand = sync.on_demand_reader;
+  switch (header.type) {
+  case eAgentMessage_Snapshot:
+    return receive_snapshot(connection, body, header.bytes, sync);
+  case eAgentMessage_LibraryResponse: {
+    LibraryResponse response;
+    if (!read_libraries(body, end, response)) return false;
+    if (!on_demand.library_response_queue.push(response)) {
+      response.owner_arena.destroy();
+    }
+    return true;
+  }
+  case eAgentMessage_EnvironResponse: {
+    EnvironResponse response;
+    if (!read_environ(body, end, response)) return false;
+    if (!on_demand.environ_response_queue.push(response)) {
+      response.owner_arena.destroy();
+    }
+    return true;
+  }
+  case eAgentMessage_SocketResponse: {
+    SocketResponse response;
+    if (!read_sockets(body, end, response)) return false;
+    if (!on_demand.socket_response_queue.push(response)) {
+      response.owner_arena.destroy();
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// Keeps the `rx_size` bytes received so far
+static uint8_t *reserve(AgentConnection &connection, const size_t size) {
+  ArenaSlab *old = connection.buffer;
+  if (old && old->total_size - sizeof(ArenaSlab) >= size) {
+    return reinterpret_cast<uint8_t *>(old) + sizeof(ArenaSlab);
+  }
+  connection.buffer = nullptr;
+  uint8_t *data = grow_buffer(connection.buffer, size);
+  if (data && old) {
+    memcpy(data, reinterpret_cast<uint8_t *>(old) + sizeof(ArenaSlab),
+           connection.rx_size);
+  }
+  if (old) ArenaSlab::release(old);
+  return data;
+}
+
+bool agent_receive(AgentConnection &connection, Sync &sync) {
+  uint8_t *data = reserve(connection, connection.rx_size + AGENT_RECV_CHUNK);
+  if (!data) return false;
+  const size_t capacity = connection.buffer->total_size - sizeof(ArenaSlab);
+  const ssize_t n = recv(connection.fd, data + connection.rx_size,
+                         capacity - connection.rx_size, 0);
+  if (n == 0) return false;
+  if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  connection.rx_size += n;
+
+  size_t offset = 0;
+  while (connection.rx_size - offset >= sizeof(AgentMessageHeader)) {
+    AgentMessageHeader header;
+    memcpy(&header, data + offset, sizeof(header));
+    if (header.bytes > AGENT_MAX_MESSAGE_BYTES) return false;
+    const size_t size = sizeof(header) + header.bytes;
+    if (connection.rx_size - offset < size) break;
+    if (!dispatch(connection, header, data + offset + sizeof(header), sync)) {
+      return false;
+    }
+    offset += size;
+  }
+  memmove(data, data + offset, connection.rx_size - offset);
+  connection.rx_size -= offset;
+  return true;
+}
+
+struct AgentRequestMessage {
+  AgentMessageHeader header;
+  AgentRequest request;
+};
+
+// Pops requests while the buffer has room for them, the rest stay queued
+template <class Request, size_t N>
+static void buffer_requests(AgentConnection &connection,
+                            RingBuffer<Request, N> &queue,
+                            const AgentMessageType type) {
+  Request request;
+  while (connection.tx_size + sizeof(AgentRequestMessage) <=
+             sizeof(connection.tx) &&
+         queue.pop(request)) {
+    const AgentRequestMessage message = {{type, sizeof(AgentRequest)},
+                                         {request.pid}};
+    memcpy(connection.tx + connection.tx_size, &message, sizeof(message));
+    connection.tx_size += sizeof(message);
+  }
+}
+
+bool agent_send_requests(AgentConnection &connection, Sync &sync) {
+  OnDemandReaderSync &my_sync = sync.on_demand_reader;
+  buffer_requests(connection, my_sync.library_request_queue,
+                  eAgentMessage_LibraryRequest);
+  buffer_requests(connection, my_sync.environ_request_queue,
+                  eAgentMessage_EnvironRequest);
+  buffer_requests(connection, my_sync.socket_request_queue,
+                  eAgentMessage_SocketRequest);
+
+  size_t sent = 0;
+  while (sent < connection.tx_size) {
+    const ssize_t n = send(connection.fd, connection.tx + sent,
+                           connection.tx_size - sent,
+                           MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) continue;
+    // A full socket is retried, a broken one is reported by agent_receive()
+    if (n <= 0) break;
+    sent += n;
+  }
+  memmove(connection.tx, connection.tx + sent, connection.tx_size - sent);
+  connection.tx_size -= sent;
+  return connection.tx_size > 0;
+}
+
+void agent_connection_close(AgentConnection &connection) {
+  if (connection.fd >= 0) close(connection.fd);
+  snapshot_codec_destroy(connection.codec);
+  if (connection.buffer) ArenaSlab::release(connection.buffer);
+  connection = {};
+  connection.fd = -1;
+}
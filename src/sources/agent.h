@@ -0,0 +1,154 @@
+#pragma once
+
+#include "base.h"
+#include "listener.h"
+#include "snapshot_codec.h"
+
+#include <sys/socket.h>
+
+struct Sync;
+
+// Agent mode: prock-collect gathers on a remote host and streams snapshots to
+// prock GUIs over a Unix or TCP socket. Addresses are "unix:PATH" (or any
+// path containing '/') and "HOST:PORT", an empty host is loopback.
+//
+// There is no authentication and clients may read the environ of any process
+// the agent can, so other hosts must be named explicitly ("0.0.0.0:PORT") and
+// get a warning.
+//
+// Every message is an AgentMessageHeader followed by `bytes` of body. The
+// agent starts with AgentHello, then sends one eAgentMessage_Snapshot per
+// gathered snapshot: a SnapshotRecordHeader and the rows delta encoded against
+// the previous snapshot sent to the same client (see snapshot_codec.h). The
+// first snapshot of a client is a keyframe. Library, environ and socket
+// requests of the GUI are answered by the agent with the same pid.
+//
+// Integers are in host byte order and rows are raw structs, so both sides
+// must run the same build on the same architecture. The hello carries the
+// struct sizes to reject mismatches.
+constexpr uint32_t AGENT_MAGIC = 0x4b435250; // "PRCK"
+constexpr uint32_t AGENT_PROTOCOL_VERSION = 1;
+constexpr size_t AGENT_MAX_CLIENTS = 16;
+// Blocked sends to a client that stopped reading drop the client
+constexpr int AGENT_SEND_TIMEOUT_SEC = 5;
+// Bounds the receive buffer of a connection
+constexpr size_t AGENT_MAX_MESSAGE_BYTES = 256 * 1024 * 1024;
+constexpr size_t AGENT_RECV_CHUNK = 64 * 1024;
+// Requests of the UI waiting for a full socket, more stay in their queues
+constexpr size_t AGENT_REQUEST_BUFFER_BYTES = 1024;
+
+enum AgentMessageType : uint32_t {
+  eAgentMessage_Hello,
+  eAgentMessage_Snapshot,
+  eAgentMessage_LibraryRequest, // AgentRequest
+  eAgentMessage_LibraryResponse,
+  eAgentMessage_EnvironRequest, // AgentRequest
+  eAgentMessage_EnvironResponse,
+  eAgentMessage_SocketRequest, // AgentRequest
+  eAgentMessage_SocketResponse,
+  eAgentMessage_COUNT,
+};
+
+struct AgentMessageHeader {
+  uint32_t type;
+  uint32_t bytes; // of the body following the header
+};
+
+struct AgentHello {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t process_stat_size;
+  uint32_t cpu_core_stat_size;
+  uint32_t socket_entry_size;
+  uint32_t reserved;
+  uint64_t ticks_in_second; // of the agent host
+  uint64_t mem_page_size;
+};
+
+struct AgentRequest {
+  int32_t pid;
+};
+
+// Body of responses, followed by `count` entries:
+// - libraries: AgentLibraryEntry and the path
+// - environ: AgentEnvironEntry, the name and the value
+// - sockets: raw SocketEntry structs
+struct AgentResponseHeader {
+  int32_t pid;
+  int32_t error_code;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+struct AgentLibraryEntry {
+  uint64_t addr_start;
+  uint64_t addr_end;
+  int64_t file_size;
+  uint32_t path_len;
+  uint32_t reserved;
+};
+
+struct AgentEnvironEntry {
+  uint32_t name_len;
+  uint32_t value_len;
+};
+
+struct AgentAddress {
+  sockaddr_storage addr;
+  socklen_t len;
+  bool is_unix;
+};
+
+// Parses "unix:PATH", a path or "HOST:PORT", `passive` resolves an empty
+// host to every interface instead of loopback
+bool agent_resolve(const char *address, bool passive, AgentAddress &out);
+
+struct AgentPeer {
+  int fd;
+  bool needs_keyframe;
+  uint8_t rx[64]; // partially received request
+  size_t rx_size;
+};
+
+struct AgentServer {
+  Listener listener;
+  AgentPeer peers[AGENT_MAX_CLIENTS];
+  size_t peer_count;
+
+  AgentHello hello;
+  SnapshotCodec codec; // rows of the last snapshot sent to every peer
+  ArenaSlab *buffer;   // outgoing message, grown on demand
+  BumpArena temp_arena;
+};
+
+bool agent_listen(AgentServer &server, const char *address,
+                  uint64_t ticks_in_second, uint64_t mem_page_size);
+// Called by the gathering thread after gather(), wakes agent_serve()
+void agent_notify(AgentServer &server);
+// Until sync.quit: accepts clients, sends snapshots of sync.update_queue and
+// answers requests. Call agent_notify() after setting sync.quit.
+void agent_serve(AgentServer &server, Sync &sync);
+void agent_server_close(AgentServer &server);
+
+struct AgentConnection {
+  int fd;
+  AgentHello hello;
+  SnapshotCodec codec; // rows of the last received snapshot
+  ArenaSlab *buffer;   // incoming messages, grown on demand
+  size_t rx_size;      // bytes of incomplete messages in buffer
+  // Requests the socket didn't take yet, sent once it is writable
+  uint8_t tx[AGENT_REQUEST_BUFFER_BYTES];
+  size_t tx_size;
+};
+
+// Connects and reads the hello of the agent
+bool agent_connect(AgentConnection &connection, const char *address);
+// Reads what the socket has (blocks for it unless the socket is non-blocking)
+// and handles every complete message: snapshots are pushed to
+// sync.update_queue, responses to the on demand reader queues. Returns false
+// once the connection is closed or broken.
+bool agent_receive(AgentConnection &connection, Sync &sync);
+// Sends the pending on demand reader requests of the UI to the agent without
+// blocking. Returns true while some wait for the socket to become writable.
+bool agent_send_requests(AgentConnection &connection, Sync &sync);
+void agent_connection_close(AgentConnection &connection);
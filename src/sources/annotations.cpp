@@ -0,0 +1,138 @@
+#include "annotations.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+AnnotationStore g_annotations;
+
+static const char *skip_spaces(const char *it, const char *end) {
+  while (it < end && (*it == ' ' || *it == '\t')) ++it;
+  return it;
+}
+
+// Copies the word at `it` NUL-terminated into `out`, the message itself is
+// not. Returns its end, nullptr if it is empty or doesn't fit.
+template <size_t N>
+static const char *copy_word(const char *it, const char *end,
+                             char (&out)[N]) {
+  const char *word_end = it;
+  while (word_end < end && *word_end != ' ' && *word_end != '\t') ++word_end;
+  const size_t word_size = word_end - it;
+  if (word_size == 0 || word_size >= N) return nullptr;
+  memcpy(out, it, word_size);
+  out[word_size] = '\0';
+  return word_end;
+}
+
+bool annotation_parse(const char *message, const size_t size,
+                      const double now, Annotation &out) {
+  const char *it = message;
+  const char *end = message + size;
+  // A trailing newline from echo is not part of the label
+  while (end > it && (end[-1] == '\n' || end[-1] == '\r')) --end;
+  it = skip_spaces(it, end);
+
+  char number[64];
+  const char *word_end = copy_word(it, end, number);
+  if (!word_end) return false;
+
+  out = {};
+  if (strcmp(number, "-") == 0) {
+    out.time = now;
+  } else {
+    char *parsed_end = nullptr;
+    out.time = strtod(number, &parsed_end);
+    if (*parsed_end != '\0' || !(out.time > 0)) return false;
+  }
+
+  it = skip_spaces(word_end, end);
+  if (end - it > 4 && strncmp(it, "pid=", 4) == 0) {
+    word_end = copy_word(it + 4, end, number);
+    if (!word_end) return false;
+    char *pid_end = nullptr;
+    const long pid = strtol(number, &pid_end, 10);
+    if (*pid_end != '\0' || pid <= 0 || pid > INT32_MAX) return false;
+    out.pid = static_cast<int>(pid);
+    it = skip_spaces(word_end, end);
+  }
+  if (it == end) return false;
+
+  // Labels are drawn as they are, control characters would garble them
+  size_t len = 0;
+  for (; it < end && len + 1 < sizeof(out.label); ++it) {
+    const unsigned char c = *it;
+    out.label[len++] = c < 0x20 ? ' ' : static_cast<char>(c);
+  }
+  out.label[len] = '\0';
+  return true;
+}
+
+int annotation_socket_open(const char *path) {
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Annotation socket path too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  const int fd =
+      socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    perror("annotations: socket");
+    return -1;
+  }
+  unlink(path);
+  if (bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) !=
+      0) {
+    fprintf(stderr, "Failed to bind %s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+size_t annotation_receive(const int fd, AnnotationQueue &queue) {
+  ZoneScoped;
+  size_t res = 0;
+  char message[512];
+  for (;;) {
+    const ssize_t size = recv(fd, message, sizeof(message), 0);
+    if (size < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    const double now = std::chrono::duration_cast<Seconds>(
+                           SystemClock::now().time_since_epoch())
+                           .count();
+    Annotation annotation;
+    if (!annotation_parse(message, static_cast<size_t>(size), now,
+                          annotation)) {
+      fprintf(stderr, "Malformed annotation: %.*s\n", static_cast<int>(size),
+              message);
+      continue;
+    }
+    // The UI is behind, dropping is better than waiting for it
+    if (queue.push(annotation)) ++res;
+  }
+  return res;
+}
+
+void annotation_socket_close(const int fd, const char *path) {
+  if (fd < 0) return;
+  close(fd);
+  unlink(path);
+}
+
+void annotation_add(AnnotationStore &store, const Annotation &annotation) {
+  store.items[store.count % ANNOTATION_CAPACITY] = annotation;
+  ++store.count;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base.h"
+#include "ring_buffer.h"
+
+#include <algorithm>
+
+// External event annotations (prock --annotate PATH): deploys, load tests
+// and the like, marked on every chart.
+//
+// Every datagram on the unix socket PATH is one annotation:
+//   TIME [pid=PID] LABEL
+// TIME is seconds since epoch or "-" for the time it arrived, e.g.
+//   echo "- deploy v1.2" | socat - UNIX-SENDTO:/tmp/prock.sock
+// An annotation with a pid is shown on the charts of that process and the
+// system charts, one without on every chart.
+//
+// The on-demand reader thread receives without blocking and hands them to
+// the UI through a queue, full queues drop annotations instead of waiting.
+constexpr size_t ANNOTATION_LABEL_SIZE = 64;
+constexpr size_t ANNOTATION_CAPACITY = 256; // newest ones kept by the UI
+constexpr int ANNOTATION_POLL_MS = 200;
+
+struct Annotation {
+  double time; // seconds since epoch, same as chart times
+  int pid;     // 0 = whole system
+  char label[ANNOTATION_LABEL_SIZE];
+};
+
+using AnnotationQueue = RingBuffer<Annotation, 64>;
+
+// Ring of the newest annotations
+struct AnnotationStore {
+  Annotation items[ANNOTATION_CAPACITY];
+  size_t count; // added in total, items[count % CAPACITY] is the next slot
+};
+
+extern AnnotationStore g_annotations;
+
+// Parses one message, `now` is used for "-". Returns false when malformed.
+bool annotation_parse(const char *message, size_t size, double now,
+                      Annotation &out);
+
+// Binds a non-blocking datagram socket at `path`, replacing a stale one.
+// Returns -1 on error.
+int annotation_socket_open(const char *path);
+// Receives every pending datagram into `queue`, returns the annotations
+// added
+size_t annotation_receive(int fd, AnnotationQueue &queue);
+void annotation_socket_close(int fd, const char *path);
+
+void annotation_add(AnnotationStore &store, const Annotation &annotation);
+
+// Calls f(annotation) for kept annotations in [x_min, x_max] shown on a chart
+// of `pid` (0 = system chart), oldest first
+template <class F>
+void annotations_for_each(const AnnotationStore &store, const int pid,
+                          const double x_min, const double x_max, F f) {
+  const size_t kept = std::min(store.count, ANNOTATION_CAPACITY);
+  for (size_t i = store.count - kept; i < store.count; ++i) {
+    const Annotation &annotation = store.items[i % ANNOTATION_CAPACITY];
+    if (annotation.time < x_min || annotation.time > x_max) continue;
+    if (pid != 0 && annotation.pid != 0 && annotation.pid != pid) continue;
+    f(annotation);
+  }
+}
@@ -19,8 +19,8 @@ EnvironResponse read_process_environ(BumpArena &temp_arena,
   response.pid = pid;
   response.owner_arena = BumpArena::create();
 
-  char path[64];
-  snprintf(path, sizeof(path), "/proc/%d/environ", pid);
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/%d/environ", pid);
 
   FILE *file = fopen(path, "r");
   if (!file) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "base.h"
+
 struct EnvironEntry {
   const char *name;
   const char *value;
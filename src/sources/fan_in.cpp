@@ -0,0 +1,94 @@
+#include "fan_in.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+bool fan_in_connect(FanIn &fan_in, const char *const *addresses,
+                    const size_t count) {
+  fan_in.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (fan_in.epoll_fd < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+  if (count > FAN_IN_MAX_HOSTS) {
+    fprintf(stderr, "At most %zu hosts are supported\n", FAN_IN_MAX_HOSTS);
+    return false;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    FanInHost &host = fan_in.hosts[i];
+    host.address = addresses[i];
+    if (!agent_connect(host.connection, host.address)) return false;
+    ++fan_in.count;
+
+    const int fd = host.connection.fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = i;
+    if (epoll_ctl(fan_in.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      perror("epoll_ctl");
+      return false;
+    }
+    host.connected.store(true);
+  }
+  return true;
+}
+
+static void send_requests(FanIn &fan_in, const size_t i) {
+  FanInHost &host = fan_in.hosts[i];
+  const bool sending = agent_send_requests(host.connection, host.sync);
+  if (sending == host.sending) return;
+  host.sending = sending;
+  epoll_event event = {};
+  event.events = sending ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.u64 = i;
+  epoll_ctl(fan_in.epoll_fd, EPOLL_CTL_MOD, host.connection.fd, &event);
+}
+
+bool fan_in_poll(FanIn &fan_in, const int timeout_ms) {
+  for (size_t i = 0; i < fan_in.count; ++i) {
+    if (fan_in.hosts[i].connected.load()) send_requests(fan_in, i);
+  }
+
+  epoll_event events[FAN_IN_MAX_HOSTS];
+  const int n = epoll_wait(fan_in.epoll_fd, events, FAN_IN_MAX_HOSTS,
+                           timeout_ms);
+  if (n <= 0) return false;
+
+  ZoneScoped;
+  for (int e = 0; e < n; ++e) {
+    const size_t i = events[e].data.u64;
+    FanInHost &host = fan_in.hosts[i];
+    if (events[e].events & EPOLLOUT) send_requests(fan_in, i);
+    if (events[e].events == EPOLLOUT ||
+        agent_receive(host.connection, host.sync)) {
+      continue;
+    }
+    // The last snapshot of the host stays on screen
+    fprintf(stderr, "Disconnected from %s\n", host.address);
+    epoll_ctl(fan_in.epoll_fd, EPOLL_CTL_DEL, host.connection.fd, nullptr);
+    host.connected.store(false);
+  }
+  return true;
+}
+
+void fan_in_close(FanIn &fan_in) {
+  for (size_t i = 0; i < fan_in.count; ++i) {
+    FanInHost &host = fan_in.hosts[i];
+    agent_connection_close(host.connection);
+    UpdateSnapshot snapshot = {};
+    while (host.sync.update_queue.pop(snapshot)) {
+      snapshot.owner_arena.destroy();
+    }
+    host.connected.store(false);
+  }
+  if (fan_in.epoll_fd >= 0) close(fan_in.epoll_fd);
+  fan_in.epoll_fd = -1;
+  fan_in.count = 0;
+}
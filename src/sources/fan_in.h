@@ -0,0 +1,34 @@
+#pragma once
+
+#include "agent.h"
+#include "sync.h"
+
+#include <atomic>
+
+// Several agents in one GUI (prock --connect A --connect B ...). A single
+// thread receives from all of them with epoll, every host has its own Sync,
+// so the UI keeps a State and views per host.
+constexpr size_t FAN_IN_MAX_HOSTS = 64;
+// Pending UI requests are sent at least this often
+constexpr int FAN_IN_POLL_MS = 50;
+
+struct FanInHost {
+  const char *address;
+  AgentConnection connection;
+  Sync sync;
+  std::atomic<bool> connected;
+  bool sending; // waits for EPOLLOUT with requests the socket didn't take
+};
+
+struct FanIn {
+  int epoll_fd;
+  size_t count;
+  FanInHost hosts[FAN_IN_MAX_HOSTS];
+};
+
+// Connects to every address, fails if any of them fails
+bool fan_in_connect(FanIn &fan_in, const char *const *addresses, size_t count);
+// Sends pending requests of every host and handles the messages that arrive
+// within `timeout_ms`. Returns true when something was received.
+bool fan_in_poll(FanIn &fan_in, int timeout_ms);
+void fan_in_close(FanIn &fan_in);
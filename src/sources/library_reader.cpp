@@ -21,8 +21,8 @@ LibraryResponse read_process_libraries(BumpArena &temp_arena,
   response.pid = pid;
   response.owner_arena = BumpArena::create();
 
-  char path[64];
-  snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/%d/maps", pid);
 
   FILE *file = fopen(path, "r");
   if (!file) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "base.h"
+
 struct LibraryEntry {
   const char *path;
   size_t path_len;
@@ -0,0 +1,58 @@
+#include "listener.h"
+
+#include "agent.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool listener_open(Listener &listener, const AgentAddress &addr,
+                   const char *address, const int backlog) {
+  listener = LISTENER_CLOSED;
+  listener.listen_fd =
+      socket(addr.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (addr.is_unix) {
+    const char *path =
+        reinterpret_cast<const sockaddr_un &>(addr.addr).sun_path;
+    unlink(path);
+    memcpy(listener.unix_path, path, strlen(path) + 1);
+  } else if (listener.listen_fd >= 0) {
+    const int one = 1;
+    setsockopt(listener.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one,
+               sizeof(one));
+  }
+  if (listener.listen_fd < 0 ||
+      bind(listener.listen_fd,
+           reinterpret_cast<const sockaddr *>(&addr.addr), addr.len) != 0 ||
+      listen(listener.listen_fd, backlog) != 0 ||
+      pipe2(listener.wake_fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+    fprintf(stderr, "Failed to listen on %s: %s\n", address, strerror(errno));
+    listener_close(listener);
+    return false;
+  }
+  return true;
+}
+
+void listener_wake(Listener &listener) {
+  const char byte = 0;
+  // A full pipe already wakes the server
+  [[maybe_unused]] const ssize_t n = write(listener.wake_fds[1], &byte, 1);
+}
+
+void listener_drain(Listener &listener) {
+  char drain[64];
+  while (read(listener.wake_fds[0], drain, sizeof(drain)) > 0) {
+  }
+}
+
+void listener_close(Listener &listener) {
+  if (listener.listen_fd >= 0) close(listener.listen_fd);
+  if (listener.wake_fds[0] >= 0) close(listener.wake_fds[0]);
+  if (listener.wake_fds[1] >= 0) close(listener.wake_fds[1]);
+  if (listener.unix_path[0] != '\0') unlink(listener.unix_path);
+  listener = LISTENER_CLOSED;
+}
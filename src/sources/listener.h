@@ -0,0 +1,37 @@
+#pragma once
+
+#include "base.h"
+
+struct AgentAddress;
+
+// Listening socket and wake pipe of the agent and metrics servers. Both serve
+// from one thread in poll(), the gathering thread writes the pipe after every
+// snapshot.
+struct Listener {
+  int listen_fd;
+  int wake_fds[2];
+  char unix_path[108]; // unlinked on close
+};
+
+constexpr Listener LISTENER_CLOSED = {-1, {-1, -1}, {}};
+
+// Binds `addr` (`address` in messages), replacing the stale socket of a
+// killed server, and opens the wake pipe. Closed again on failure.
+bool listener_open(Listener &listener, const AgentAddress &addr,
+                   const char *address, int backlog);
+void listener_wake(Listener &listener);
+// Empties the wake pipe after poll() reported it
+void listener_drain(Listener &listener);
+void listener_close(Listener &listener);
+
+// Visits clients backwards so that dropping one can move the last one into its
+// place. `keep(i, client)` false drops it after `drop(client)`.
+template <class T, class Keep, class Drop>
+void drop_clients(T *clients, size_t &count, Keep keep, Drop drop) {
+  for (size_t i = count; i-- > 0;) {
+    if (!keep(i, clients[i])) {
+      drop(clients[i]);
+      clients[i] = clients[--count];
+    }
+  }
+}
@@ -5,6 +5,7 @@
 
 #include "GLFW/glfw3.h"
 
+#include <chrono>
 #include <mutex>
 
 void on_demand_reader_loop(Sync &sync) {
@@ -16,16 +17,30 @@ void on_demand_reader_loop(Sync &sync) {
     SocketRequest sock_request;
     {
       std::unique_lock<std::mutex> lock(sync.quit_mutex);
-      my_sync.library_cv.wait(lock, [&] {
+      const auto has_work = [&] {
         return sync.quit.load() ||
                my_sync.library_request_queue.peek(lib_request) ||
                my_sync.environ_request_queue.peek(env_request) ||
                my_sync.socket_request_queue.peek(sock_request);
-      });
+      };
+      if (my_sync.annotation_fd >= 0) {
+        my_sync.library_cv.wait_for(
+            lock, std::chrono::milliseconds(ANNOTATION_POLL_MS), has_work);
+      } else {
+        my_sync.library_cv.wait(lock, has_work);
+      }
     }
     if (sync.quit.load()) break;
 
+    // Only wake the UI when there is something new for it
+    bool has_news = false;
+    if (my_sync.annotation_fd >= 0) {
+      has_news = annotation_receive(my_sync.annotation_fd,
+                                    my_sync.annotation_queue) > 0;
+    }
+
     while (my_sync.library_request_queue.pop(lib_request)) {
+      has_news = true;
       LibraryResponse response =
           read_process_libraries(temp_arena, lib_request);
       if (!my_sync.library_response_queue.push(response)) {
@@ -34,6 +49,7 @@ void on_demand_reader_loop(Sync &sync) {
     }
 
     while (my_sync.environ_request_queue.pop(env_request)) {
+      has_news = true;
       EnvironResponse response = read_process_environ(temp_arena, env_request);
       if (!my_sync.environ_response_queue.push(response)) {
         response.owner_arena.destroy();
@@ -41,13 +57,14 @@ void on_demand_reader_loop(Sync &sync) {
     }
 
     while (my_sync.socket_request_queue.pop(sock_request)) {
+      has_news = true;
       SocketResponse response = read_process_sockets(temp_arena, sock_request);
       if (!my_sync.socket_response_queue.push(response)) {
         response.owner_arena.destroy();
       }
     }
 
-    glfwPostEmptyEvent();
+    if (has_news) glfwPostEmptyEvent();
     if (temp_arena.cur_slab &&
         (temp_arena.cur_slab->prev ||
          temp_arena.cur_slab->left_size < SLAB_SIZE / 10)) {
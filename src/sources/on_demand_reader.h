@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ring_buffer.h"
+#include "sources/annotations.h"
 #include "sources/environ_reader.h"
 #include "sources/library_reader.h"
 #include "sources/socket_reader.h"
@@ -15,6 +16,10 @@ struct OnDemandReaderSync {
   RingBuffer<SocketRequest, 16> socket_request_queue;
   RingBuffer<SocketResponse, 16> socket_response_queue;
   std::condition_variable library_cv;
+
+  // Polled every ANNOTATION_POLL_MS while open, -1 = no annotations
+  int annotation_fd = -1;
+  AnnotationQueue annotation_queue;
 };
 
 struct Sync;
@@ -1,10 +1,13 @@
 #include "process_stat.h"
 
+#include "self_stats.h"
 #include "sync.h"
 #include "tracy/Tracy.hpp"
 
 #include <algorithm>
+#include <cerrno>
 #include <dirent.h>
+#include <fcntl.h>
 #include <linux/inet_diag.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
@@ -17,6 +20,7 @@
 // Query all TCP/UDP sockets via netlink SOCK_DIAG
 // Returns array sorted by inode for binary search
 Array<SocketEntry> query_sockets_netlink(BumpArena &arena) {
+  ZoneScopedN("Netlink socket dump");
   GrowingArray<SocketEntry> result = {};
   size_t wasted = 0;
 
@@ -132,8 +136,8 @@ Array<SocketEntry> query_sockets_netlink(BumpArena &arena) {
 static void read_process_socket_inodes(const int pid,
                                        GrowingArray<unsigned long> &out,
                                        BumpArena &arena) {
-  char fd_path[64];
-  snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
+  char fd_path[PROC_PATH_SIZE];
+  proc_path(fd_path, "/%d/fd", pid);
 
   DIR *fd_dir = opendir(fd_path);
   if (!fd_dir) return;
@@ -143,7 +147,7 @@ static void read_process_socket_inodes(const int pid,
   while (dirent *entry = readdir(fd_dir)) {
     if (entry->d_type != DT_LNK) continue;
 
-    char full_path[512];
+    char full_path[PROC_PATH_SIZE + 256];
     snprintf(full_path, sizeof(full_path), "%s/%s", fd_path, entry->d_name);
 
     const ssize_t link_len =
@@ -162,10 +166,129 @@ static void read_process_socket_inodes(const int pid,
   closedir(fd_dir);
 }
 
+// Adds "run_ns wait_ns timeslices" of a schedstat file to the sums, false if
+// it can't be read. One read(), it's a single short line.
+static bool read_schedstat(const char *path, ProcessStat &stat) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  char buf[96];
+  const ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0) {
+    return false;
+  }
+  buf[len] = '\0';
+  ulonglong run_ns = 0;
+  ulonglong wait_ns = 0;
+  ulonglong timeslices = 0;
+  if (sscanf(buf, "%llu %llu %llu", &run_ns, &wait_ns, &timeslices) != 3) {
+    return false;
+  }
+  stat.sched_run_ns += run_ns;
+  stat.sched_wait_ns += wait_ns;
+  stat.sched_timeslices += timeslices;
+  return true;
+}
+
+// /proc/[pid]/schedstat only covers the main thread, so processes with more
+// threads sum their task/ entries. Threads that already exited are missing
+// from the sum, unlike from utime and stime.
+static void read_process_schedstat(const int pid, ProcessStat &stat) {
+  char path[PROC_PATH_SIZE];
+  if (stat.num_threads <= 1) {
+    proc_path(path, "/%d/schedstat", pid);
+    read_schedstat(path, stat);
+    return;
+  }
+
+  proc_path(path, "/%d/task", pid);
+  DIR *task_dir = opendir(path);
+  if (!task_dir) {
+    return;
+  }
+  while (dirent *entry = readdir(task_dir)) {
+    if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+    char task_path[PROC_PATH_SIZE];
+    proc_path(task_path, "/%d/task/%s/schedstat", pid, entry->d_name);
+    read_schedstat(task_path, stat);
+  }
+  closedir(task_dir);
+}
+
+// Number of CPUs in a list like "0-3,8,10-11"
+static ulong count_cpu_list(const char *list) {
+  ulong res = 0;
+  while (true) {
+    char *end = nullptr;
+    const ulong first = strtoul(list, &end, 10);
+    if (end == list) break;
+    ulong last = first;
+    if (*end == '-') {
+      list = end + 1;
+      last = strtoul(list, &end, 10);
+      if (end == list) break;
+    }
+    if (last >= first) res += last - first + 1;
+    if (*end != ',') break;
+    list = end + 1;
+  }
+  return res;
+}
+
+// The value after "key:" if `line` is that key's
+static const char *status_value(const char *line, const char *key) {
+  const size_t len = strlen(key);
+  return strncmp(line, key, len) == 0 && line[len] == ':' ? line + len + 1
+                                                          : nullptr;
+}
+
+// Only the few lines stat doesn't have, the rest of the file is skipped
+static void read_process_status(const int pid, ProcessStat &stat) {
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/%d/status", pid);
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  // About 1.5 KB, more with long Groups or CPU masks
+  char buf[8192];
+  size_t size = 0;
+  ssize_t len = 0;
+  while (size < sizeof(buf) - 1 &&
+         (len = read(fd, buf + size, sizeof(buf) - 1 - size)) > 0) {
+    size += static_cast<size_t>(len);
+  }
+  close(fd);
+  buf[size] = '\0';
+
+  ProcessStatus &status = stat.status;
+  status.read_at = SteadyClock::now();
+  char *line = buf;
+  while (line && *line) {
+    char *next = strchr(line, '\n');
+    if (next) *next++ = '\0';
+    if (const char *value = status_value(line, "VmHWM")) {
+      status.vm_hwm_kb = strtoul(value, nullptr, 10);
+    } else if ((value = status_value(line, "VmSwap"))) {
+      status.vm_swap_kb = strtoul(value, nullptr, 10);
+    } else if ((value = status_value(line, "Cpus_allowed_list"))) {
+      status.cpus_allowed = count_cpu_list(value);
+    } else if ((value = status_value(line, "voluntary_ctxt_switches"))) {
+      status.voluntary_ctxt_switches = strtoull(value, nullptr, 10);
+    } else if ((value = status_value(line, "nonvoluntary_ctxt_switches"))) {
+      status.nonvoluntary_ctxt_switches = strtoull(value, nullptr, 10);
+    }
+    line = next;
+  }
+}
+
 // Read stat for a thread (or process) given explicit paths
 static bool read_thread_stat(const int tid, const char *stat_path,
                              const char *statm_path, const char *comm_path,
-                             BumpArena &arena, ProcessStat *out) {
+                             const char *schedstat_path, BumpArena &arena,
+                             ProcessStat *out) {
   ProcessStat &stat = *out;
   stat.pid = tid;
   stat.comm = "";
@@ -173,6 +296,10 @@ static bool read_thread_stat(const int tid, const char *stat_path,
   stat.io_write_bytes = 0;
   stat.net_recv_bytes = 0;
   stat.net_send_bytes = 0;
+  stat.sched_run_ns = 0;
+  stat.sched_wait_ns = 0;
+  stat.sched_timeslices = 0;
+  stat.status = {};
 
   FILE *stat_file = fopen(stat_path, "r");
   FILE *statm_file = fopen(statm_path, "r");
@@ -193,6 +320,7 @@ static bool read_thread_stat(const int tid, const char *stat_path,
     fclose(stat_file);
     return false;
   }
+  stat.read_at = SteadyClock::now();
   if (!fgets(statm_buf, sizeof(statm_buf), statm_file)) {
     fclose(comm_file);
     fclose(statm_file);
@@ -239,23 +367,24 @@ static bool read_thread_stat(const int tid, const char *stat_path,
          &stat.statm_resident, &stat.statm_shared, &stat.statm_text,
          &unused_lib, &stat.statm_data);
 
+  read_schedstat(schedstat_path, stat);
+
   return true;
 }
 
-static bool read_process(const int pid, BumpArena &arena, ProcessStat *out) {
-  constexpr size_t PATH_BUF_SIZE = 64;
-
-  char stat_filename[PATH_BUF_SIZE];
-  snprintf(stat_filename, PATH_BUF_SIZE, "/proc/%d/stat", pid);
+static bool read_process(const int pid, const bool read_status,
+                         BumpArena &arena, ProcessStat *out) {
+  char stat_filename[PROC_PATH_SIZE];
+  proc_path(stat_filename, "/%d/stat", pid);
 
-  char statm_filename[PATH_BUF_SIZE];
-  snprintf(statm_filename, PATH_BUF_SIZE, "/proc/%d/statm", pid);
+  char statm_filename[PROC_PATH_SIZE];
+  proc_path(statm_filename, "/%d/statm", pid);
 
-  char comm_filename[PATH_BUF_SIZE];
-  snprintf(comm_filename, PATH_BUF_SIZE, "/proc/%d/comm", pid);
+  char comm_filename[PROC_PATH_SIZE];
+  proc_path(comm_filename, "/%d/comm", pid);
 
-  char io_filename[PATH_BUF_SIZE];
-  snprintf(io_filename, PATH_BUF_SIZE, "/proc/%d/io", pid);
+  char io_filename[PROC_PATH_SIZE];
+  proc_path(io_filename, "/%d/io", pid);
 
   ProcessStat &stat = *out;
   stat.pid = pid;
@@ -264,6 +393,10 @@ static bool read_process(const int pid, BumpArena &arena, ProcessStat *out) {
   stat.io_write_bytes = 0;
   stat.net_recv_bytes = 0;
   stat.net_send_bytes = 0;
+  stat.sched_run_ns = 0;
+  stat.sched_wait_ns = 0;
+  stat.sched_timeslices = 0;
+  stat.status = {};
 
   FILE *stat_file = fopen(stat_filename, "r");
   FILE *statm_file = fopen(statm_filename, "r");
@@ -285,6 +418,7 @@ static bool read_process(const int pid, BumpArena &arena, ProcessStat *out) {
     fclose(stat_file);
     return false;
   }
+  stat.read_at = SteadyClock::now();
   if (!fgets(statm_buf, sizeof(statm_buf), statm_file)) {
     fclose(comm_file);
     fclose(statm_file);
@@ -333,6 +467,8 @@ static bool read_process(const int pid, BumpArena &arena, ProcessStat *out) {
          &stat.statm_resident, &stat.statm_shared, &stat.statm_text,
          &unused_lib, &stat.statm_data);
 
+  read_process_schedstat(pid, stat);
+
   // Read /proc/[pid]/io (may fail due to permissions, that's OK)
   FILE *io_file = fopen(io_filename, "r");
   if (io_file) {
@@ -351,44 +487,59 @@ static bool read_process(const int pid, BumpArena &arena, ProcessStat *out) {
     fclose(io_file);
   }
 
+  if (read_status) {
+    read_process_status(pid, stat);
+  }
+
   return true;
 }
 
-static Array<ProcessStat> read_all_processes(BumpArena &result_arena) {
+static Array<ProcessStat> read_all_processes(const bool read_status,
+                                             BumpArena &result_arena) {
   ZoneScoped;
-  DIR *proc_dir = opendir("/proc");
+  DIR *proc_dir = opendir(g_proc_root);
   if (!proc_dir) {
     printf("Couldn't get a process list");
     return {};
   }
 
+  SteadyTimePoint phase_at = SteadyClock::now();
   LinkedList<long> pids = {};
-  while (true) {
-    dirent *dir = readdir(proc_dir);
-    if (!dir) {
-      break;
-    }
+  {
+    ZoneScopedN("Enumerate pids");
+    while (true) {
+      dirent *dir = readdir(proc_dir);
+      if (!dir) {
+        break;
+      }
 
-    const char *name = dir->d_name;
-    char *str_end = nullptr;
-    long parsed_pid = strtol(name, &str_end, 10);
-    if (parsed_pid == 0 || parsed_pid == LONG_MAX || parsed_pid == LONG_MIN) {
-      continue;
+      const char *name = dir->d_name;
+      char *str_end = nullptr;
+      long parsed_pid = strtol(name, &str_end, 10);
+      if (parsed_pid == 0 || parsed_pid == LONG_MAX ||
+          parsed_pid == LONG_MIN) {
+        continue;
+      }
+      *(pids.emplace_front(result_arena)) = parsed_pid;
     }
-    *(pids.emplace_front(result_arena)) = parsed_pid;
   }
+  phase_at = self_stats_phase(eGatherPhase_Pids, phase_at);
 
   Array<ProcessStat> result =
       Array<ProcessStat>::create(result_arena, pids.size);
-  const LinkedNode<long> *it = pids.head;
-  ProcessStat *it_result = result.data;
-  while (it) {
-    if (read_process(it->value, result_arena, it_result)) {
-      ++it_result;
+  {
+    ZoneScopedN("Read processes");
+    const LinkedNode<long> *it = pids.head;
+    ProcessStat *it_result = result.data;
+    while (it) {
+      if (read_process(it->value, read_status, result_arena, it_result)) {
+        ++it_result;
+      }
+      it = it->next;
     }
-    it = it->next;
+    result.size = it_result - result.data;
+    ZoneValue(result.size);
   }
-  result.size = it_result - result.data;
 
   closedir(proc_dir);
 
@@ -396,10 +547,12 @@ static Array<ProcessStat> read_all_processes(BumpArena &result_arena) {
             [](const ProcessStat &left, const ProcessStat &right) {
               return left.pid < right.pid;
             });
+  phase_at = self_stats_phase(eGatherPhase_Processes, phase_at);
 
   // Query socket stats from netlink and distribute to processes
   const Array<SocketEntry> socket_stats = query_sockets_netlink(result_arena);
   if (socket_stats.size > 0) {
+    ZoneScopedN("Scan socket fds");
     GrowingArray<unsigned long> inodes = {};
     for (size_t i = 0; i < result.size; ++i) {
       ProcessStat &stat = result.data[i];
@@ -425,6 +578,7 @@ static Array<ProcessStat> read_all_processes(BumpArena &result_arena) {
       stat.net_send_bytes = total_send;
     }
   }
+  self_stats_phase(eGatherPhase_Sockets, phase_at);
 
   return result;
 }
@@ -433,7 +587,9 @@ static Array<ProcessStat> read_all_processes(BumpArena &result_arena) {
 // Returns array where [0] = total, [1..n] = per-core
 static Array<CpuCoreStat> read_cpu_stats(BumpArena &arena) {
   ZoneScoped;
-  FILE *stat_file = fopen("/proc/stat", "r");
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/stat");
+  FILE *stat_file = fopen(path, "r");
   if (!stat_file) {
     return {};
   }
@@ -477,7 +633,9 @@ static Array<CpuCoreStat> read_cpu_stats(BumpArena &arena) {
 // Aggregates all block devices (skips partitions by looking at device naming)
 static DiskIoStat read_disk_io_stats() {
   ZoneScoped;
-  FILE *diskstats_file = fopen("/proc/diskstats", "r");
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/diskstats");
+  FILE *diskstats_file = fopen(path, "r");
   if (!diskstats_file) {
     return {};
   }
@@ -543,7 +701,9 @@ static DiskIoStat read_disk_io_stats() {
 // Aggregates all network interfaces except loopback
 static NetIoStat read_net_io_stats() {
   ZoneScoped;
-  FILE *netdev_file = fopen("/proc/net/dev", "r");
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/net/dev");
+  FILE *netdev_file = fopen(path, "r");
   if (!netdev_file) {
     return {};
   }
@@ -595,8 +755,8 @@ static NetIoStat read_net_io_stats() {
 static Array<ProcessStat> read_process_threads(const int pid,
                                                BumpArena &arena) {
   ZoneScoped;
-  char task_path[64];
-  snprintf(task_path, sizeof(task_path), "/proc/%d/task", pid);
+  char task_path[PROC_PATH_SIZE];
+  proc_path(task_path, "/%d/task", pid);
 
   DIR *task_dir = opendir(task_path);
   if (!task_dir) {
@@ -622,16 +782,17 @@ static Array<ProcessStat> read_process_threads(const int pid,
   while (it) {
     const int tid = it->value;
 
-    char stat_path[128];
-    char statm_path[128];
-    char comm_path[128];
-    snprintf(stat_path, sizeof(stat_path), "/proc/%d/task/%d/stat", pid, tid);
-    snprintf(statm_path, sizeof(statm_path), "/proc/%d/statm",
-             pid); // statm is shared across threads
-    snprintf(comm_path, sizeof(comm_path), "/proc/%d/task/%d/comm", pid, tid);
-
-    if (read_thread_stat(tid, stat_path, statm_path, comm_path, arena,
-                         it_result)) {
+    char stat_path[PROC_PATH_SIZE];
+    char statm_path[PROC_PATH_SIZE];
+    char comm_path[PROC_PATH_SIZE];
+    char schedstat_path[PROC_PATH_SIZE];
+    proc_path(stat_path, "/%d/task/%d/stat", pid, tid);
+    proc_path(statm_path, "/%d/statm", pid); // statm is shared across threads
+    proc_path(comm_path, "/%d/task/%d/comm", pid, tid);
+    proc_path(schedstat_path, "/%d/task/%d/schedstat", pid, tid);
+
+    if (read_thread_stat(tid, stat_path, statm_path, comm_path,
+                         schedstat_path, arena, it_result)) {
       ++it_result;
     }
     it = it->next;
@@ -681,7 +842,9 @@ static Array<ThreadSnapshot> read_watched_threads(Sync &sync,
 
 static MemInfo read_mem_info() {
   ZoneScoped;
-  FILE *meminfo_file = fopen("/proc/meminfo", "r");
+  char path[PROC_PATH_SIZE];
+  proc_path(path, "/meminfo");
+  FILE *meminfo_file = fopen(path, "r");
   if (!meminfo_file) {
     return {};
   }
@@ -715,17 +878,102 @@ static MemInfo read_mem_info() {
   return result;
 }
 
+// Moves state.next_at to the slot after the one of the gather starting at
+// `started_at`. Slots a late gather ran past are skipped rather than made up
+// with gathers back to back.
+static void schedule_next_gather(GatheringState &state, const float period_secs,
+                                 const SteadyTimePoint started_at) {
+  const auto period = std::chrono::duration_cast<SteadyClock::duration>(
+      Seconds{period_secs});
+  if (state.next_at == SteadyTimePoint{} || state.next_period != period_secs) {
+    // First gather or a new period, the grid starts now
+    state.next_period = period_secs;
+    state.next_at = started_at + period;
+    return;
+  }
+  [[maybe_unused]] const double late_ms =
+      std::chrono::duration<double, std::milli>(started_at - state.next_at)
+          .count();
+  g_self_stats.gather_lateness.add(static_cast<float>(late_ms));
+  TracyPlot("Gather lateness ms", late_ms);
+  state.next_at += period;
+  if (state.next_at <= started_at) {
+    const auto missed = (started_at - state.next_at) / period + 1;
+    state.next_at += missed * period;
+    g_self_stats.missed_periods.fetch_add(static_cast<size_t>(missed),
+                                          std::memory_order_relaxed);
+  }
+}
+
+// Time between the first and the last process read of a cycle, the most two
+// processes of one snapshot can be apart
+static void record_read_skew(const Array<ProcessStat> &stats) {
+  if (stats.size == 0) {
+    return;
+  }
+  SteadyTimePoint first = stats.data[0].read_at;
+  SteadyTimePoint last = first;
+  for (size_t i = 1; i < stats.size; ++i) {
+    first = std::min(first, stats.data[i].read_at);
+    last = std::max(last, stats.data[i].read_at);
+  }
+  [[maybe_unused]] const double skew_ms =
+      std::chrono::duration<double, std::milli>(last - first).count();
+  g_self_stats.read_skew.add(static_cast<float>(skew_ms));
+  TracyPlot("Read skew ms", skew_ms);
+}
+
+// Keeps the status of a gather that read it for the ones that don't
+static void remember_status(GatheringState &state,
+                            const Array<ProcessStat> &stats) {
+  ZoneScoped;
+  BumpArena arena = BumpArena::create();
+  state.carried_status = Array<CarriedStatus>::create(arena, stats.size);
+  for (size_t i = 0; i < stats.size; ++i) {
+    const ProcessStat &stat = stats.data[i];
+    state.carried_status.data[i] = {stat.pid, stat.starttime, stat.status};
+  }
+  state.status_arena.destroy();
+  state.status_arena = arena;
+}
+
+// Fills the status from the last gather that read it. Processes started
+// since are read now, until the next full read.
+static void carry_status(const GatheringState &state,
+                         Array<ProcessStat> &stats) {
+  ZoneScoped;
+  const Array<CarriedStatus> &carried = state.carried_status;
+  size_t c = 0;
+  for (size_t i = 0; i < stats.size; ++i) {
+    ProcessStat &stat = stats.data[i];
+    while (c < carried.size && carried.data[c].pid < stat.pid) {
+      ++c;
+    }
+    if (c < carried.size && carried.data[c].pid == stat.pid &&
+        carried.data[c].starttime == stat.starttime) {
+      stat.status = carried.data[c].status;
+    } else {
+      read_process_status(stat.pid, stat);
+    }
+  }
+}
+
 void gather(GatheringState &state, Sync &sync) {
   const float period_secs = sync.update_period.load();
   {
     std::unique_lock<std::mutex> lock(sync.quit_mutex);
     if (period_secs <= 0.0f) {
-      // Paused: wait until quit or period changes
+      // Paused: wait until quit or period changes. The pause is neither late
+      // nor missed, resuming starts a new grid.
+      state.next_at = SteadyTimePoint{};
       sync.quit_cv.wait(lock, [&sync] {
         return sync.quit.load() || sync.update_period.load() > 0.0f;
       });
     } else {
-      sync.quit_cv.wait_until(lock, state.last_update + Seconds{period_secs});
+      // A changed period applies right away
+      sync.quit_cv.wait_until(lock, state.next_at, [&sync, period_secs] {
+        return sync.quit.load() || sync.update_period.load() != period_secs;
+      });
     }
   }
   if (sync.quit.load()) {
@@ -733,20 +981,70 @@ void gather(GatheringState &state, Sync &sync) {
   }
 
   ZoneScoped;
+  const SteadyTimePoint started_at = SteadyClock::now();
+  schedule_next_gather(state, sync.update_period.load(), started_at);
+  const bool watched = g_self_stats.watching.load(std::memory_order_relaxed);
+  size_t syscalls_before = 0;
+  size_t bytes_before = 0;
+  if (watched) {
+    self_stats_read_io(syscalls_before, bytes_before);
+  }
+  const bool read_status = state.status_countdown == 0 ||
+                           sync.status_wanted.load(std::memory_order_relaxed);
+  state.status_countdown =
+      read_status ? STATUS_EVERY_GATHERS - 1 : state.status_countdown - 1;
   BumpArena arena = BumpArena::create();
-  const auto process_stats = read_all_processes(arena);
+  Array<ProcessStat> process_stats = read_all_processes(read_status, arena);
+  if (read_status) {
+    remember_status(state, process_stats);
+  } else {
+    carry_status(state, process_stats);
+  }
+  record_read_skew(process_stats);
+  SteadyTimePoint phase_at = SteadyClock::now();
   const auto cpu_stats = read_cpu_stats(arena);
   const auto mem_info = read_mem_info();
   const auto disk_io_stats = read_disk_io_stats();
   const auto net_io_stats = read_net_io_stats();
+  // The snapshot is stamped with the system-wide reads, processes and
+  // threads carry their own read times
+  phase_at = self_stats_phase(eGatherPhase_System, phase_at);
+  state.last_update = phase_at;
   const auto thread_snapshots = read_watched_threads(sync, arena);
-
-  state.last_update = SteadyClock::now();
+  self_stats_phase(eGatherPhase_Threads, phase_at);
+
+  [[maybe_unused]] const SteadyTimePoint finished_at =
+      self_stats_phase(eGatherPhase_Total, started_at);
+  size_t syscalls_after = 0;
+  size_t bytes_after = 0;
+  if (watched && self_stats_read_io(syscalls_after, bytes_after)) {
+    g_self_stats.read_syscalls.store(syscalls_after - syscalls_before,
+                                     std::memory_order_relaxed);
+    g_self_stats.read_bytes.store(bytes_after - bytes_before,
+                                  std::memory_order_relaxed);
+  }
+  g_self_stats.gathering_cpu_ns.store(self_stats_thread_cpu_ns(),
+                                      std::memory_order_relaxed);
+  g_self_stats.gathers.fetch_add(1, std::memory_order_relaxed);
   const SystemTimePoint system_now = SystemClock::now();
-  const bool pushed = sync.update_queue.push(UpdateSnapshot{
-      arena, process_stats, cpu_stats, mem_info, disk_io_stats, net_io_stats,
-      thread_snapshots, state.last_update, system_now});
-  if (!pushed) {
+  const UpdateSnapshot snapshot = {
+      arena,         process_stats, cpu_stats,        mem_info,
+      disk_io_stats, net_io_stats,  thread_snapshots, state.last_update,
+      system_now};
+  if (state.recording && !snapshot_writer_write(*state.recording, snapshot)) {
+    fprintf(stderr, "Recording stopped: %s\n", strerror(errno));
+    state.recording = nullptr;
+  }
+  TracyPlot("Gather ms", (std::chrono::duration<double, std::milli>(
+                             finished_at - started_at)
+                             .count()));
+  TracyPlot("Processes", static_cast<int64_t>(process_stats.size));
+  TracyPlot("Snapshot arena KB",
+            static_cast<int64_t>(arena.slab_bytes() / 1024));
+  TracyPlot("Mapped slabs", static_cast<int64_t>(g_mapped_slabs.load()));
+  if (!sync.update_queue.push(snapshot)) {
+    g_self_stats.snapshots_dropped.fetch_add(1, std::memory_order_relaxed);
     arena.destroy();
   }
+  TracyPlot("Update queue", static_cast<int64_t>(sync.update_queue.size()));
 }
@@ -69,6 +69,22 @@ RssFile+RssShmem in /proc/[pid]/status) text       (4) text (code) lib (5)
 library (unused since Linux 2.6; always 0) data       (6) data + stack
 */
 
+// From /proc/[pid]/status. The file is several times the size of stat, so
+// it's read every STATUS_EVERY_GATHERS gathers unless Sync::status_wanted,
+// and the last read is carried into the gathers in between.
+struct ProcessStatus {
+  ulonglong voluntary_ctxt_switches;
+  ulonglong nonvoluntary_ctxt_switches;
+  ulong vm_hwm_kb;  // peak resident
+  ulong vm_swap_kb;
+  ulong cpus_allowed; // CPUs in Cpus_allowed_list
+  // On the host that read it, encoded unlike ProcessStat::read_at: rates
+  // carry over between reads by comparing it. {} if never read.
+  SteadyTimePoint read_at;
+};
+
+constexpr uint STATUS_EVERY_GATHERS = 10;
+
 struct ProcessStat {
   int pid;
   const char *comm;
@@ -136,6 +152,18 @@ struct ProcessStat {
   // Network I/O (aggregated from socket stats via netlink INET_DIAG)
   ulonglong net_recv_bytes;
   ulonglong net_send_bytes;
+
+  // From /proc/[pid]/task/*/schedstat, summed over the live threads. 0 when
+  // the kernel has no schedstats.
+  ulonglong sched_run_ns;     // on a CPU
+  ulonglong sched_wait_ns;    // runnable, waiting on a run queue
+  ulonglong sched_timeslices; // times run on a CPU
+
+  ProcessStatus status; // {} for threads
+
+  // When /proc/[pid]/stat was read, rates use it over UpdateSnapshot::at.
+  // Not encoded, {} in replayed and remote snapshots.
+  SteadyTimePoint read_at;
 };
 
 // From /proc/stat - all values are cumulative ticks
@@ -180,8 +208,27 @@ struct NetIoStat {
   ulonglong bytes_transmitted; // Cumulative bytes transmitted
 };
 
+struct SnapshotWriter;
+
+struct CarriedStatus {
+  int pid;
+  ulonglong starttime; // a reused pid doesn't get the old status
+  ProcessStatus status;
+};
+
 struct GatheringState {
   SteadyTimePoint last_update;
+  // Gathers start on a grid of the update period, so their duration doesn't
+  // add up to drift. {} until the first gather and while paused, then the
+  // next slot.
+  SteadyTimePoint next_at;
+  float next_period; // seconds, a new period starts a new grid
+  SnapshotWriter *recording; // every gathered snapshot is appended if set
+
+  // Status of every process at the last gather that read it, sorted by pid
+  BumpArena status_arena;
+  Array<CarriedStatus> carried_status;
+  uint status_countdown; // gathers left until status is read anyway
 };
 
 struct Sync;
@@ -0,0 +1,354 @@
+#include "snapshot_codec.h"
+
+#include "sync.h"
+#include "tracy/Tracy.hpp"
+
+static constexpr size_t MAX_VARINT_BYTES = 10;
+// Payloads are padded, so consecutive records keep headers aligned
+static constexpr size_t PAYLOAD_ALIGNMENT = 8;
+
+// Process operations, stored as varint (count << 2 | op)
+enum RowOp {
+  eRowOp_Copy = 0,  // `count` unchanged rows
+  eRowOp_Drop = 1,  // `count` previous rows of exited processes
+  eRowOp_Delta = 2, // one changed row
+  eRowOp_New = 3,   // one new process: pid, comm and its row
+};
+
+static uint8_t *put_varint(uint8_t *out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<uint8_t>(value);
+  return out;
+}
+
+static bool get_varint(const uint8_t *&in, const uint8_t *end,
+                       uint64_t &value) {
+  value = 0;
+  for (uint shift = 0; shift < 64 && in < end; shift += 7) {
+    const uint8_t byte = *in++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) return true;
+  }
+  return false;
+}
+
+// Worst case of put_row(): a pair of varints per literal byte
+static constexpr size_t row_bound(const size_t size) {
+  return 2 * size + 2 * MAX_VARINT_BYTES;
+}
+
+// Writes `row` XOR `base` (zeros when null) as pairs of varints (zero run,
+// literal length), every pair followed by its literal bytes. Zero gaps shorter
+// than a new pair stay inside the literal.
+static uint8_t *put_row(uint8_t *out, const void *row, const void *base,
+                        const size_t size) {
+  const uint8_t *cur = static_cast<const uint8_t *>(row);
+  const uint8_t *prev = static_cast<const uint8_t *>(base);
+  const auto diff = [&](size_t i) -> uint8_t {
+    return prev ? cur[i] ^ prev[i] : cur[i];
+  };
+
+  size_t i = 0;
+  while (i < size) {
+    size_t zeros = 0;
+    while (i + zeros < size && diff(i + zeros) == 0) {
+      ++zeros;
+    }
+    i += zeros;
+
+    size_t len = 0;
+    size_t gap = 0;
+    while (i + len + gap < size) {
+      if (diff(i + len + gap) != 0) {
+        len += gap + 1;
+        gap = 0;
+      } else if (++gap >= 3) {
+        break;
+      }
+    }
+
+    out = put_varint(out, zeros);
+    out = put_varint(out, len);
+    for (size_t k = 0; k < len; ++k) {
+      *out++ = diff(i + k);
+    }
+    i += len;
+  }
+  return out;
+}
+
+static bool get_row(const uint8_t *&in, const uint8_t *end, void *row,
+                    const void *base, const size_t size) {
+  uint8_t *cur = static_cast<uint8_t *>(row);
+  if (base) {
+    memcpy(cur, base, size);
+  } else {
+    memset(cur, 0, size);
+  }
+
+  size_t i = 0;
+  while (i < size) {
+    uint64_t zeros;
+    uint64_t len;
+    if (!get_varint(in, end, zeros) || !get_varint(in, end, len)) {
+      return false;
+    }
+    if (zeros > size - i || len > size - i - zeros ||
+        len > static_cast<size_t>(end - in)) {
+      return false;
+    }
+    i += zeros;
+    for (size_t k = 0; k < len; ++k) {
+      cur[i + k] ^= in[k];
+    }
+    in += len;
+    i += len;
+  }
+  return true;
+}
+
+// Fields of a row that are encoded: the comm pointer differs between copies
+// and read_at only means something on the host that read it
+static ProcessStat encoded_fields(const ProcessStat &stat) {
+  ProcessStat res = stat;
+  res.comm = nullptr;
+  res.read_at = {};
+  return res;
+}
+
+static int64_t to_ns(const SteadyTimePoint at) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             at.time_since_epoch())
+      .count();
+}
+
+static int64_t to_ns(const SystemTimePoint at) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             at.time_since_epoch())
+      .count();
+}
+
+size_t snapshot_encode_bound(const UpdateSnapshot &snapshot) {
+  size_t res = PAYLOAD_ALIGNMENT +
+               snapshot.cpu_stats.size * row_bound(sizeof(CpuCoreStat));
+  for (size_t i = 0; i < snapshot.stats.size; ++i) {
+    const char *comm = snapshot.stats.data[i].comm;
+    res += row_bound(sizeof(ProcessStat)) + 3 * MAX_VARINT_BYTES +
+           (comm ? strlen(comm) : 0) + 1;
+  }
+  return res;
+}
+
+uint8_t *snapshot_encode(const SnapshotCodec &codec,
+                         const UpdateSnapshot &snapshot, const bool keyframe,
+                         SnapshotRecordHeader &header, uint8_t *payload) {
+  ZoneScoped;
+  uint8_t *out = payload;
+
+  const Array<CpuCoreStat> &prev_cpu = codec.cpu_stats;
+  for (size_t i = 0; i < snapshot.cpu_stats.size; ++i) {
+    const bool has_base = !keyframe && i < prev_cpu.size;
+    out = put_row(out, &snapshot.cpu_stats.data[i],
+                  has_base ? &prev_cpu.data[i] : nullptr, sizeof(CpuCoreStat));
+  }
+
+  // Runs of copied or dropped rows are written when the run ends
+  RowOp run_op = eRowOp_Copy;
+  size_t run = 0;
+  const auto extend_run = [&](const RowOp op) {
+    if (run > 0 && run_op != op) {
+      out = put_varint(out, run << 2 | run_op);
+      run = 0;
+    }
+    run_op = op;
+    ++run;
+  };
+  const auto end_run = [&] {
+    if (run > 0) out = put_varint(out, run << 2 | run_op);
+    run = 0;
+  };
+
+  // Both lists are sorted by pid
+  const Array<ProcessStat> prev =
+      keyframe ? Array<ProcessStat>{} : codec.stats;
+  size_t p = 0;
+  for (size_t i = 0; i < snapshot.stats.size; ++i) {
+    const ProcessStat row = encoded_fields(snapshot.stats.data[i]);
+    const char *comm = snapshot.stats.data[i].comm;
+    comm = comm ? comm : "";
+    while (p < prev.size && prev.data[p].pid < row.pid) {
+      extend_run(eRowOp_Drop);
+      ++p;
+    }
+
+    if (p < prev.size && prev.data[p].pid == row.pid) {
+      const ProcessStat base = encoded_fields(prev.data[p]);
+      if (base.starttime == row.starttime &&
+          strcmp(prev.data[p].comm, comm) == 0) {
+        ++p;
+        if (memcmp(&row, &base, sizeof(ProcessStat)) == 0) {
+          extend_run(eRowOp_Copy);
+        } else {
+          end_run();
+          out = put_varint(out, eRowOp_Delta);
+          out = put_row(out, &row, &base, sizeof(ProcessStat));
+        }
+        continue;
+      }
+      // Reused pid or renamed process
+      extend_run(eRowOp_Drop);
+      ++p;
+    }
+
+    end_run();
+    const size_t len = strlen(comm);
+    out = put_varint(out, eRowOp_New);
+    out = put_varint(out, static_cast<uint32_t>(row.pid));
+    out = put_varint(out, len);
+    memcpy(out, comm, len + 1);
+    out += len + 1;
+    out = put_row(out, &row, nullptr, sizeof(ProcessStat));
+  }
+  end_run();
+  while ((out - payload) % PAYLOAD_ALIGNMENT != 0) {
+    *out++ = 0;
+  }
+
+  header = {};
+  header.magic = SNAPSHOT_RECORD_MAGIC;
+  header.payload_bytes = static_cast<uint32_t>(out - payload);
+  header.process_count = static_cast<uint32_t>(snapshot.stats.size);
+  header.cpu_count = static_cast<uint32_t>(snapshot.cpu_stats.size);
+  header.keyframe = keyframe;
+  header.at_ns = to_ns(snapshot.at);
+  header.system_time_ns = to_ns(snapshot.system_time);
+  header.mem_info = snapshot.mem_info;
+  header.disk_io_stats = snapshot.disk_io_stats;
+  header.net_io_stats = snapshot.net_io_stats;
+  return out;
+}
+
+static bool decode_rows(const SnapshotCodec &codec,
+                        const SnapshotRecordHeader &header, const uint8_t *in,
+                        const bool stable, UpdateSnapshot &out) {
+  const uint8_t *end = in + header.payload_bytes;
+  BumpArena &arena = out.owner_arena;
+
+  const Array<CpuCoreStat> &prev_cpu = codec.cpu_stats;
+  out.cpu_stats = Array<CpuCoreStat>::create(arena, header.cpu_count);
+  for (size_t c = 0; c < out.cpu_stats.size; ++c) {
+    const bool has_base = !header.keyframe && c < prev_cpu.size;
+    if (!get_row(in, end, &out.cpu_stats.data[c],
+                 has_base ? &prev_cpu.data[c] : nullptr,
+                 sizeof(CpuCoreStat))) {
+      return false;
+    }
+  }
+
+  const Array<ProcessStat> prev =
+      header.keyframe ? Array<ProcessStat>{} : codec.stats;
+  const auto own_comm = [&](const char *comm) {
+    return stable ? comm : arena.alloc_string_copy(comm);
+  };
+  out.stats = Array<ProcessStat>::create(arena, header.process_count);
+  size_t p = 0;
+  size_t n = 0;
+  while (n < out.stats.size) {
+    uint64_t op;
+    if (!get_varint(in, end, op)) return false;
+    const size_t count = op >> 2;
+    ProcessStat &row = out.stats.data[n];
+    switch (static_cast<RowOp>(op & 3)) {
+    case eRowOp_Copy:
+      if (count > prev.size - p || count > out.stats.size - n) return false;
+      for (size_t k = 0; k < count; ++k) {
+        out.stats.data[n + k] = prev.data[p + k];
+        out.stats.data[n + k].comm = own_comm(prev.data[p + k].comm);
+      }
+      p += count;
+      n += count;
+      break;
+    case eRowOp_Drop:
+      if (count > prev.size - p) return false;
+      p += count;
+      break;
+    case eRowOp_Delta: {
+      if (p >= prev.size) return false;
+      const ProcessStat base = encoded_fields(prev.data[p]);
+      if (!get_row(in, end, &row, &base, sizeof(ProcessStat))) return false;
+      row.comm = own_comm(prev.data[p].comm);
+      ++p;
+      ++n;
+      break;
+    }
+    case eRowOp_New: {
+      uint64_t pid;
+      uint64_t len;
+      if (!get_varint(in, end, pid) || !get_varint(in, end, len) ||
+          len >= static_cast<size_t>(end - in) || in[len] != '\0') {
+        return false;
+      }
+      const char *comm = reinterpret_cast<const char *>(in);
+      in += len + 1;
+      if (!get_row(in, end, &row, nullptr, sizeof(ProcessStat)) ||
+          static_cast<uint64_t>(row.pid) != pid) {
+        return false;
+      }
+      row.comm = own_comm(comm);
+      ++n;
+      break;
+    }
+    }
+  }
+  return true;
+}
+
+bool snapshot_decode(const SnapshotCodec &codec,
+                     const SnapshotRecordHeader &header,
+                     const uint8_t *payload, const bool stable,
+                     UpdateSnapshot &out) {
+  ZoneScoped;
+  out = {};
+  if (header.magic != SNAPSHOT_RECORD_MAGIC ||
+      !decode_rows(codec, header, payload, stable, out)) {
+    out.owner_arena.destroy();
+    out = {};
+    return false;
+  }
+  out.mem_info = header.mem_info;
+  out.disk_io_stats = header.disk_io_stats;
+  out.net_io_stats = header.net_io_stats;
+  out.at = SteadyTimePoint{std::chrono::duration_cast<SteadyClock::duration>(
+      std::chrono::nanoseconds{header.at_ns})};
+  out.system_time =
+      SystemTimePoint{std::chrono::duration_cast<SystemClock::duration>(
+          std::chrono::nanoseconds{header.system_time_ns})};
+  return true;
+}
+
+void snapshot_codec_advance(SnapshotCodec &codec,
+                            const UpdateSnapshot &snapshot,
+                            const bool copy_comm) {
+  BumpArena next_arena = BumpArena::create();
+  codec.stats = Array<ProcessStat>::create(next_arena, snapshot.stats.size);
+  for (size_t i = 0; i < snapshot.stats.size; ++i) {
+    ProcessStat &copy = codec.stats.data[i];
+    copy = snapshot.stats.data[i];
+    const char *comm = copy.comm ? copy.comm : "";
+    copy.comm = copy_comm ? next_arena.alloc_string_copy(comm) : comm;
+  }
+  codec.cpu_stats =
+      Array<CpuCoreStat>::create(next_arena, snapshot.cpu_stats.size);
+  memcpy(codec.cpu_stats.data, snapshot.cpu_stats.data,
+         snapshot.cpu_stats.size * sizeof(CpuCoreStat));
+  codec.arena.destroy();
+  codec.arena = next_arena;
+}
+
+void snapshot_codec_destroy(SnapshotCodec &codec) {
+  codec.arena.destroy();
+  codec = {};
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "base.h"
+#include "process_stat.h"
+
+struct UpdateSnapshot;
+
+// Delta encoding of UpdateSnapshots, shared by recordings and the agent
+// protocol. Both sides keep the rows of the previous snapshot in a
+// SnapshotCodec and encode the next one against them:
+// - CpuCoreStat rows are XORed with the previous row of the same core
+// - ProcessStat rows, sorted by pid, become a list of operations on the
+//   previous rows: copy a run of unchanged rows, drop a run of exited ones,
+//   XOR one changed row, or add a new process with its comm
+// XORed rows only store their non-zero bytes, so an idle process costs
+// nothing and a busy one a few bytes. Keyframes do not use previous rows.
+constexpr uint32_t SNAPSHOT_RECORD_MAGIC = 0x50414e53; // "SNAP"
+
+// Everything of a snapshot except its rows, followed by the encoded rows
+struct SnapshotRecordHeader {
+  uint32_t magic;
+  uint32_t payload_bytes; // encoded rows following the header
+  uint32_t process_count;
+  uint32_t cpu_count;
+  uint32_t keyframe;
+  uint32_t reserved;
+  int64_t at_ns;          // steady clock of the recorded host
+  int64_t system_time_ns; // wall clock
+  MemInfo mem_info;
+  DiskIoStat disk_io_stats;
+  NetIoStat net_io_stats;
+};
+
+struct SnapshotCodec {
+  BumpArena arena;
+  Array<ProcessStat> stats;
+  Array<CpuCoreStat> cpu_stats;
+};
+
+// Upper bound of the encoded rows of `snapshot`
+size_t snapshot_encode_bound(const UpdateSnapshot &snapshot);
+// Fills `header` and writes the rows to `payload`, returns the payload end
+uint8_t *snapshot_encode(const SnapshotCodec &codec,
+                         const UpdateSnapshot &snapshot, bool keyframe,
+                         SnapshotRecordHeader &header, uint8_t *payload);
+// Decodes into a new out.owner_arena. Comm strings of a `stable` payload
+// (mapped file) are used in place, otherwise they are copied.
+bool snapshot_decode(const SnapshotCodec &codec,
+                     const SnapshotRecordHeader &header,
+                     const uint8_t *payload, bool stable, UpdateSnapshot &out);
+// Makes the rows of `snapshot` the base of the next delta
+void snapshot_codec_advance(SnapshotCodec &codec,
+                            const UpdateSnapshot &snapshot, bool copy_comm);
+void snapshot_codec_destroy(SnapshotCodec &codec);
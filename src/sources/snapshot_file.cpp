@@ -0,0 +1,251 @@
+#include "snapshot_file.h"
+
+#include "sync.h"
+#include "tracy/Tracy.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char FILE_MAGIC[8] = {'P', 'R', 'O', 'C', 'K', 'R', 'E', 'C'};
+
+static uint8_t *writer_buffer(SnapshotWriter &writer, const size_t size) {
+  if (!writer.buffer ||
+      writer.buffer->total_size - sizeof(ArenaSlab) < size) {
+    if (writer.buffer) ArenaSlab::release(writer.buffer);
+    const size_t slab_size = std::max(2 * size + sizeof(ArenaSlab), SLAB_SIZE);
+    writer.buffer = ArenaSlab::create(slab_size);
+    if (!writer.buffer) return nullptr;
+  }
+  return reinterpret_cast<uint8_t *>(writer.buffer) + sizeof(ArenaSlab);
+}
+
+bool snapshot_writer_open(SnapshotWriter &writer, const char *path,
+                          const uint64_t ticks_in_second,
+                          const uint64_t mem_page_size) {
+  writer = {};
+  writer.file = fopen(path, "wb");
+  if (!writer.file) return false;
+
+  SnapshotFileHeader header = {};
+  memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_FILE_VERSION;
+  header.process_stat_size = sizeof(ProcessStat);
+  header.cpu_core_stat_size = sizeof(CpuCoreStat);
+  header.ticks_in_second = ticks_in_second;
+  header.mem_page_size = mem_page_size;
+  if (fwrite(&header, sizeof(header), 1, writer.file) != 1) {
+    fclose(writer.file);
+    writer.file = nullptr;
+    return false;
+  }
+  writer.offset = sizeof(header);
+  return true;
+}
+
+bool snapshot_writer_write(SnapshotWriter &writer,
+                           const UpdateSnapshot &snapshot) {
+  ZoneScoped;
+  if (!writer.file) return false;
+
+  const bool keyframe = writer.count % SNAPSHOT_KEYFRAME_INTERVAL == 0;
+  uint8_t *const payload =
+      writer_buffer(writer, snapshot_encode_bound(snapshot));
+  if (!payload) return false;
+  SnapshotRecordHeader header;
+  snapshot_encode(writer.codec, snapshot, keyframe, header, payload);
+
+  // Flushed per record, so a killed recorder loses at most the last one
+  if (fwrite(&header, sizeof(header), 1, writer.file) != 1 ||
+      fwrite(payload, header.payload_bytes, 1, writer.file) != 1 ||
+      fflush(writer.file) != 0) {
+    return false;
+  }
+
+  *writer.index.emplace_back(writer.index_arena, writer.wasted_bytes) = {
+      writer.offset, header.at_ns};
+  writer.offset += sizeof(header) + header.payload_bytes;
+  ++writer.count;
+
+  snapshot_codec_advance(writer.codec, snapshot, true);
+  return true;
+}
+
+void snapshot_writer_close(SnapshotWriter &writer) {
+  if (writer.file) {
+    SnapshotFileTrailer trailer = {};
+    trailer.index_offset = writer.offset;
+    trailer.count = writer.count;
+    trailer.magic = SNAPSHOT_INDEX_MAGIC;
+    fwrite(writer.index.data(), sizeof(SnapshotIndexEntry), writer.index.size(),
+           writer.file);
+    fwrite(&trailer, sizeof(trailer), 1, writer.file);
+    fclose(writer.file);
+  }
+  writer.index_arena.destroy();
+  snapshot_codec_destroy(writer.codec);
+  if (writer.buffer) ArenaSlab::release(writer.buffer);
+  writer = {};
+}
+
+// Walks record headers of a recording without an index
+static void rebuild_index(SnapshotReader &reader) {
+  GrowingArray<SnapshotIndexEntry> index = {};
+  size_t wasted_bytes = 0;
+  size_t offset = sizeof(SnapshotFileHeader);
+  while (offset + sizeof(SnapshotRecordHeader) <= reader.size) {
+    const auto *record =
+        reinterpret_cast<const SnapshotRecordHeader *>(reader.data + offset);
+    const size_t end = offset + sizeof(SnapshotRecordHeader) +
+                       static_cast<size_t>(record->payload_bytes);
+    if (record->magic != SNAPSHOT_RECORD_MAGIC || end > reader.size) break;
+    *index.emplace_back(reader.index_arena, wasted_bytes) = {offset,
+                                                            record->at_ns};
+    offset = end;
+  }
+  reader.index = {index.data(), index.size()};
+}
+
+bool snapshot_reader_open(SnapshotReader &reader, const char *path) {
+  reader = {};
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(SnapshotFileHeader)) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  reader.data = static_cast<const uint8_t *>(data);
+  reader.size = st.st_size;
+
+  reader.header = reinterpret_cast<const SnapshotFileHeader *>(reader.data);
+  if (memcmp(reader.header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+      reader.header->version != SNAPSHOT_FILE_VERSION ||
+      reader.header->process_stat_size != sizeof(ProcessStat) ||
+      reader.header->cpu_core_stat_size != sizeof(CpuCoreStat)) {
+    snapshot_reader_close(reader);
+    return false;
+  }
+
+  const size_t min_size =
+      sizeof(SnapshotFileHeader) + sizeof(SnapshotFileTrailer);
+  if (reader.size >= min_size) {
+    const auto *trailer = reinterpret_cast<const SnapshotFileTrailer *>(
+        reader.data + reader.size - sizeof(SnapshotFileTrailer));
+    const size_t index_bytes = trailer->count * sizeof(SnapshotIndexEntry);
+    if (trailer->magic == SNAPSHOT_INDEX_MAGIC &&
+        trailer->index_offset + index_bytes + sizeof(SnapshotFileTrailer) ==
+            reader.size) {
+      reader.index = {reinterpret_cast<const SnapshotIndexEntry *>(
+                          reader.data + trailer->index_offset),
+                      trailer->count};
+      return true;
+    }
+  }
+  rebuild_index(reader);
+  return true;
+}
+
+static bool decode_record(SnapshotReader &reader, const size_t i,
+                          UpdateSnapshot &out) {
+  const auto *record = reinterpret_cast<const SnapshotRecordHeader *>(
+      reader.data + reader.index.data[i].offset);
+  if (record->magic != SNAPSHOT_RECORD_MAGIC ||
+      (!record->keyframe && reader.next != i)) {
+    return false;
+  }
+  // Zero copy: comm strings are stored NUL terminated and used in place
+  const uint8_t *payload = reinterpret_cast<const uint8_t *>(record + 1);
+  if (!snapshot_decode(reader.codec, *record, payload, true, out)) {
+    return false;
+  }
+  snapshot_codec_advance(reader.codec, out, false);
+  reader.next = i + 1;
+  return true;
+}
+
+bool snapshot_reader_read(SnapshotReader &reader, const size_t i,
+                          UpdateSnapshot &out) {
+  ZoneScoped;
+  if (i >= reader.index.size) return false;
+
+  if (i != reader.next) {
+    // Continue from the closest keyframe or the current position
+    const size_t keyframe = i - i % SNAPSHOT_KEYFRAME_INTERVAL;
+    size_t from = reader.next > keyframe && reader.next < i ? reader.next
+                                                            : keyframe;
+    for (; from < i; ++from) {
+      UpdateSnapshot skipped = {};
+      if (!decode_record(reader, from, skipped)) return false;
+      skipped.owner_arena.destroy();
+    }
+  }
+  return decode_record(reader, i, out);
+}
+
+void snapshot_reader_close(SnapshotReader &reader) {
+  if (reader.data) {
+    munmap(const_cast<uint8_t *>(reader.data), reader.size);
+  }
+  reader.index_arena.destroy();
+  snapshot_codec_destroy(reader.codec);
+  reader = {};
+}
+
+void replay(ReplayState &state, Sync &sync) {
+  SnapshotReader &reader = state.reader;
+  ReplaySync &my_sync = sync.replay;
+  {
+    std::unique_lock<std::mutex> lock(sync.quit_mutex);
+    if (reader.next >= reader.index.size) {
+      // The last snapshot stays on screen
+      sync.quit_cv.wait(lock, [&sync] { return sync.quit.load(); });
+      return;
+    }
+
+    const float speed = my_sync.speed.load();
+    if (speed <= 0.0f) {
+      // Paused: wait until quit, a step or resume
+      sync.quit_cv.wait(lock, [&] {
+        return sync.quit.load() || my_sync.steps.load() > 0 ||
+               my_sync.speed.load() > 0.0f;
+      });
+      if (my_sync.steps.load() > 0) {
+        my_sync.steps.fetch_sub(1);
+      } else {
+        state.last_push = SteadyClock::now();
+        return;
+      }
+    } else if (reader.next > 0) {
+      const int64_t gap_ns = reader.index.data[reader.next].at_ns -
+                             reader.index.data[reader.next - 1].at_ns;
+      const auto due = state.last_push + Seconds{gap_ns / 1e9 / speed};
+      const bool interrupted = sync.quit_cv.wait_until(lock, due, [&] {
+        return sync.quit.load() || my_sync.speed.load() != speed;
+      });
+      if (interrupted) return;
+    }
+  }
+  if (sync.quit.load()) {
+    return;
+  }
+
+  ZoneScoped;
+  UpdateSnapshot snapshot = {};
+  if (!snapshot_reader_read(reader, reader.next, snapshot)) {
+    fprintf(stderr, "Replay stopped: snapshot %zu is corrupted\n",
+            reader.next);
+    reader.next = reader.index.size;
+    return;
+  }
+  state.last_push = SteadyClock::now();
+  my_sync.position.store(reader.next);
+  if (!sync.update_queue.push(snapshot)) {
+    snapshot.owner_arena.destroy();
+  }
+}
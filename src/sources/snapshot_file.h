@@ -0,0 +1,102 @@
+#pragma once
+
+#include "base.h"
+#include "process_stat.h"
+#include "snapshot_codec.h"
+
+#include <atomic>
+#include <cstdio>
+
+struct Sync;
+struct UpdateSnapshot;
+
+// Recording of UpdateSnapshots, replayed later instead of gathering.
+//
+// Layout: SnapshotFileHeader, one record per snapshot, the index of all
+// records and SnapshotFileTrailer. A recording that was cut short has no
+// index, the reader then rebuilds it by walking the record headers.
+//
+// Records hold no pointers, their rows are delta encoded against the previous
+// record (see snapshot_codec.h). Every SNAPSHOT_KEYFRAME_INTERVAL-th record
+// does not depend on earlier ones, so seeking decodes at most that many
+// records.
+constexpr uint32_t SNAPSHOT_FILE_VERSION = 2;
+constexpr uint32_t SNAPSHOT_INDEX_MAGIC = 0x58444e49;  // "INDX"
+constexpr size_t SNAPSHOT_KEYFRAME_INTERVAL = 64;
+
+struct SnapshotFileHeader {
+  char magic[8]; // "PROCKREC"
+  uint32_t version;
+  uint32_t process_stat_size; // rows are stored as raw structs
+  uint32_t cpu_core_stat_size;
+  uint32_t reserved;
+  uint64_t ticks_in_second; // of the recorded host
+  uint64_t mem_page_size;
+};
+
+struct SnapshotIndexEntry {
+  uint64_t offset; // of the record header
+  int64_t at_ns;
+};
+
+struct SnapshotFileTrailer {
+  uint64_t index_offset;
+  uint64_t count;
+  uint32_t magic;
+  uint32_t reserved;
+};
+
+struct SnapshotWriter {
+  FILE *file;
+  uint64_t offset;
+  uint64_t count;
+
+  BumpArena index_arena;
+  GrowingArray<SnapshotIndexEntry> index;
+  size_t wasted_bytes;
+
+  SnapshotCodec codec; // rows of the previous record with own comm copies
+  ArenaSlab *buffer; // encoded payload, grown on demand
+};
+
+bool snapshot_writer_open(SnapshotWriter &writer, const char *path,
+                          uint64_t ticks_in_second, uint64_t mem_page_size);
+bool snapshot_writer_write(SnapshotWriter &writer,
+                           const UpdateSnapshot &snapshot);
+// Writes the index, the file stays readable without it
+void snapshot_writer_close(SnapshotWriter &writer);
+
+struct SnapshotReader {
+  const uint8_t *data; // the whole file, mapped read-only
+  size_t size;
+  const SnapshotFileHeader *header;
+  Array<const SnapshotIndexEntry> index; // in the mapping when complete
+
+  BumpArena index_arena; // rebuilt index of a truncated recording
+  size_t next; // snapshot following the last decoded one
+
+  SnapshotCodec codec; // rows of the last decoded snapshot, comm in mapping
+};
+
+bool snapshot_reader_open(SnapshotReader &reader, const char *path);
+// Decodes snapshot `i` into a new owner_arena, thread snapshots stay empty
+bool snapshot_reader_read(SnapshotReader &reader, size_t i,
+                          UpdateSnapshot &out);
+void snapshot_reader_close(SnapshotReader &reader);
+
+// Replay controls, shared between the UI and the replay thread
+struct ReplaySync {
+  std::atomic<bool> active;
+  std::atomic<float> speed{1.0f}; // 0 = paused
+  std::atomic<int> steps;         // single steps requested while paused
+  std::atomic<size_t> position;   // snapshots fed to update_queue
+  size_t count;
+};
+
+struct ReplayState {
+  SnapshotReader reader;
+  SteadyTimePoint last_push;
+};
+
+// Replaces gather(): feeds the next recorded snapshot once it is due
+void replay(ReplayState &state, Sync &sync);
@@ -3,14 +3,15 @@
 #include "tracy/Tracy.hpp"
 
 #include <algorithm>
+#include <cstdio>
 #include <dirent.h>
 #include <unistd.h>
 
 // Collect socket inodes for a specific process from /proc/<pid>/fd
 static size_t collect_socket_inodes(const int pid, unsigned long *inodes,
                                     const size_t max_inodes) {
-  char fd_dir_path[64];
-  snprintf(fd_dir_path, sizeof(fd_dir_path), "/proc/%d/fd", pid);
+  char fd_dir_path[PROC_PATH_SIZE];
+  proc_path(fd_dir_path, "/%d/fd", pid);
 
   DIR *fd_dir = opendir(fd_dir_path);
   if (!fd_dir) return 0;
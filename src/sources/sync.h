@@ -4,6 +4,7 @@
 #include "on_demand_reader.h"
 #include "process_stat.h"
 #include "ring_buffer.h"
+#include "snapshot_file.h"
 
 #include <condition_variable>
 #include <mutex>
@@ -38,5 +39,9 @@ struct Sync {
   std::atomic<int> watched_pids[MAX_WATCHED_PIDS];
   std::atomic<int> watched_pids_count{0};
 
+  // Something shows /proc/[pid]/status fields, read it on every gather
+  std::atomic<bool> status_wanted{false};
+
   OnDemandReaderSync on_demand_reader;
+  ReplaySync replay;
 };
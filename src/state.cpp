@@ -1,18 +1,107 @@
 #include "state.h"
 #include "sources/sync.h"
 
+#include <cstdio>
+#include <unistd.h>
+
+bool state_init(State &state) {
+  const long ticks = sysconf(_SC_CLK_TCK);
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (ticks <= 0 || page_size <= 0) {
+    fprintf(stderr, "Failed to get system configuration\n");
+    return false;
+  }
+  state.system.ticks_in_second = ticks;
+  state.system.mem_page_size = page_size;
+  return true;
+}
+
+BumpArena state_apply_snapshot(State &state, const UpdateSnapshot &snapshot) {
+  const BumpArena old_arena = state.snapshot_arena;
+  state.snapshot_arena = snapshot.owner_arena;
+  state.snapshot =
+      state_snapshot_update(state.snapshot_arena, state, snapshot);
+  state.update_count += 1;
+  state.update_system_time = snapshot.system_time;
+  return old_arena;
+}
+
+double stat_interval_secs(const ProcessStat &old_stat,
+                          const SteadyTimePoint old_at,
+                          const ProcessStat &new_stat,
+                          const SteadyTimePoint new_at) {
+  if (old_stat.read_at != SteadyTimePoint{} &&
+      new_stat.read_at != SteadyTimePoint{}) {
+    return Seconds(new_stat.read_at - old_stat.read_at).count();
+  }
+  return Seconds(new_at - old_at).count();
+}
+
+StatCpuPerc stat_cpu_perc(const ProcessStat &old_stat,
+                          const ProcessStat &new_stat,
+                          const double interval_secs,
+                          const uint64_t ticks_in_second) {
+  StatCpuPerc res = {};
+  const double ticks_passed = ticks_in_second * interval_secs;
+  if (ticks_passed <= 0) {
+    return res;
+  }
+  if (new_stat.utime >= old_stat.utime) {
+    res.user = (new_stat.utime - old_stat.utime) / ticks_passed * 100;
+  }
+  if (new_stat.stime >= old_stat.stime) {
+    res.kernel = (new_stat.stime - old_stat.stime) / ticks_passed * 100;
+  }
+
+  if (old_stat.sched_run_ns == 0 ||
+      new_stat.sched_run_ns < old_stat.sched_run_ns) {
+    return res;
+  }
+  const double ns_passed = interval_secs * 1e9;
+  if (new_stat.sched_wait_ns >= old_stat.sched_wait_ns) {
+    res.run_delay =
+        (new_stat.sched_wait_ns - old_stat.sched_wait_ns) / ns_passed * 100;
+  }
+  const double ticks_perc = res.user + res.kernel;
+  const double run_perc =
+      (new_stat.sched_run_ns - old_stat.sched_run_ns) / ns_passed * 100;
+  // Both reads round the ticks down, more than that is time of threads that
+  // exited and took their schedstat with them
+  if (ticks_perc > run_perc + 2 * 100 / ticks_passed) {
+    return res;
+  }
+  res.kernel = ticks_perc > 0 ? run_perc * res.kernel / ticks_perc : 0;
+  res.user = run_perc - res.kernel;
+  return res;
+}
+
+// Context switch rate between two reads of the status. It's read less often
+// than the snapshots come, in between the rate of the last two reads holds.
+static double ctxsw_per_sec(const ProcessStat &old_stat,
+                            const ProcessDerivedStat &old_derived,
+                            const ProcessStat &new_stat) {
+  const ProcessStatus &old_status = old_stat.status;
+  const ProcessStatus &new_status = new_stat.status;
+  if (new_status.read_at == old_status.read_at) {
+    return old_derived.ctxsw_per_sec;
+  }
+  const double secs = Seconds(new_status.read_at - old_status.read_at).count();
+  if (old_status.read_at == SteadyTimePoint{} || secs <= 0) {
+    return 0;
+  }
+  const ulonglong old_count = old_status.voluntary_ctxt_switches +
+                              old_status.nonvoluntary_ctxt_switches;
+  const ulonglong new_count = new_status.voluntary_ctxt_switches +
+                              new_status.nonvoluntary_ctxt_switches;
+  return new_count >= old_count ? (new_count - old_count) / secs : 0;
+}
+
 StateSnapshot state_snapshot_update(BumpArena &arena, const State &old_state,
                                     const UpdateSnapshot &snapshot) {
   const StateSnapshot &old = old_state.snapshot;
   const Array<ProcessDerivedStat> derived_stats =
       Array<ProcessDerivedStat>::create(arena, snapshot.stats.size);
 
-  const double ticks_passed =
-      old_state.system.ticks_in_second *
-      std::chrono::duration_cast<Seconds>(snapshot.at - old.at).count();
-  const double time_delta_secs =
-      std::chrono::duration_cast<Seconds>(snapshot.at - old.at).count();
-
   size_t old_state_idx = 0;
   for (size_t i = 0; i < derived_stats.size; ++i) {
     ProcessDerivedStat &result = derived_stats.data[i];
@@ -26,17 +115,23 @@ StateSnapshot state_snapshot_update(BumpArena &arena, const State &old_state,
     if (old_state_idx < old.stats.size &&
         new_stat.pid == old.stats.data[old_state_idx].pid) {
       const ProcessStat &old_stat = old.stats.data[old_state_idx];
-      if (new_stat.utime >= old_stat.utime) {
-        result.cpu_user_perc =
-            (new_stat.utime - old_stat.utime) / ticks_passed * 100;
-      }
-      if (new_stat.stime >= old_stat.stime) {
-        result.cpu_kernel_perc =
-            (new_stat.stime - old_stat.stime) / ticks_passed * 100;
-      }
+      const double time_delta_secs =
+          stat_interval_secs(old_stat, old.at, new_stat, snapshot.at);
+      const StatCpuPerc cpu_perc =
+          stat_cpu_perc(old_stat, new_stat, time_delta_secs,
+                        old_state.system.ticks_in_second);
+      result.cpu_user_perc = cpu_perc.user;
+      result.cpu_kernel_perc = cpu_perc.kernel;
+      result.run_delay_perc = cpu_perc.run_delay;
       result.mem_resident_bytes =
           new_stat.statm_resident * old_state.system.mem_page_size;
       result.mem_virtual_bytes = new_stat.vsize;
+      result.mem_peak_resident_bytes = new_stat.status.vm_hwm_kb * 1024.0;
+      result.mem_swap_bytes = new_stat.status.vm_swap_kb * 1024.0;
+      if (old_state_idx < old.derived_stats.size) {
+        result.ctxsw_per_sec = ctxsw_per_sec(
+            old_stat, old.derived_stats.data[old_state_idx], new_stat);
+      }
 
       // Compute I/O rates in KB/s
       if (time_delta_secs > 0) {
@@ -61,6 +156,15 @@ StateSnapshot state_snapshot_update(BumpArena &arena, const State &old_state,
               (new_stat.net_send_bytes - old_stat.net_send_bytes) / 1024.0 /
               time_delta_secs;
         }
+        const ulong old_faults = old_stat.minflt + old_stat.majflt;
+        const ulong new_faults = new_stat.minflt + new_stat.majflt;
+        if (new_faults >= old_faults) {
+          result.faults_per_sec = (new_faults - old_faults) / time_delta_secs;
+        }
+        if (new_stat.majflt >= old_stat.majflt) {
+          result.major_faults_per_sec =
+              (new_stat.majflt - old_stat.majflt) / time_delta_secs;
+        }
       }
     }
   }
@@ -124,3 +228,26 @@ StateSnapshot state_snapshot_update(BumpArena &arena, const State &old_state,
                        disk_io_rate,       snapshot.net_io_stats,
                        net_io_rate,        snapshot.at};
 }
+
+StateSummary state_summary(const State &state) {
+  const StateSnapshot &snapshot = state.snapshot;
+  StateSummary res = {};
+  if (snapshot.cpu_perc.total.size > 0) {
+    res.cpu_perc = snapshot.cpu_perc.total.data[0];
+  }
+  res.mem_total_kb = snapshot.mem_info.mem_total;
+  res.mem_used_kb = static_cast<double>(snapshot.mem_info.mem_total) -
+                    snapshot.mem_info.mem_available;
+  res.disk_io_rate = snapshot.disk_io_rate;
+  res.net_io_rate = snapshot.net_io_rate;
+  for (size_t i = 0; i < snapshot.derived_stats.size; ++i) {
+    const ProcessDerivedStat &derived = snapshot.derived_stats.data[i];
+    const double cpu = derived.cpu_user_perc + derived.cpu_kernel_perc;
+    if (res.top_pid == 0 || cpu > res.top_cpu_perc) {
+      res.top_pid = snapshot.stats.data[i].pid;
+      res.top_comm = snapshot.stats.data[i].comm;
+      res.top_cpu_perc = cpu;
+    }
+  }
+  return res;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "base.h"
+#include "process_recorder.h"
 #include "sources/process_stat.h"
 
 struct State;
@@ -14,12 +15,19 @@ struct SystemInfo {
 struct ProcessDerivedStat {
   double cpu_user_perc;
   double cpu_kernel_perc;
+  double run_delay_perc; // waiting to run, of one core
   double mem_resident_bytes;
   double mem_virtual_bytes;
   double io_read_kb_per_sec;
   double io_write_kb_per_sec;
   double net_recv_kb_per_sec;
   double net_send_kb_per_sec;
+  double faults_per_sec; // minor + major
+  double major_faults_per_sec;
+  // From ProcessStatus, held between its reads
+  double ctxsw_per_sec; // voluntary + nonvoluntary
+  double mem_peak_resident_bytes;
+  double mem_swap_bytes;
 };
 
 // Computed CPU percentages: [0]=aggregate, [1..n]=per-core
@@ -62,7 +70,49 @@ struct State {
 
   uint update_count;
   SystemTimePoint update_system_time;
+
+  ProcessRecorder recorder;
+};
+
+// One line of a host in the host overview
+struct StateSummary {
+  double cpu_perc; // of all cores
+  double mem_used_kb;
+  double mem_total_kb;
+  DiskIoRate disk_io_rate;
+  NetIoRate net_io_rate;
+  int top_pid; // busiest process, 0 without processes
+  const char *top_comm;
+  double top_cpu_perc;
 };
 
+// Reads SystemInfo of this machine
+bool state_init(State &state);
+// Makes `snapshot` the current one: takes its arena, derives the stats and
+// counts the update. Returns the arena of the previous snapshot, the caller
+// destroys it once nothing points into it anymore.
+BumpArena state_apply_snapshot(State &state, const UpdateSnapshot &snapshot);
+
+// Seconds between two reads of a process or thread: between their own read
+// times if both have one, between the snapshots they are in otherwise
+double stat_interval_secs(const ProcessStat &old_stat, SteadyTimePoint old_at,
+                          const ProcessStat &new_stat, SteadyTimePoint new_at);
+
+// CPU use of a process or thread between two reads, % of one core
+struct StatCpuPerc {
+  double user;
+  double kernel;
+  double run_delay;
+};
+
+// From the schedstat nanoseconds when both reads have them, split into user
+// and kernel by the ticks. From the ticks alone when schedstat is missing or
+// lost the time of threads that exited. Run delay is 0 without schedstat.
+StatCpuPerc stat_cpu_perc(const ProcessStat &old_stat,
+                          const ProcessStat &new_stat, double interval_secs,
+                          uint64_t ticks_in_second);
+
 StateSnapshot state_snapshot_update(BumpArena &arena, const State &old_state,
                                     const UpdateSnapshot &snapshot);
+
+StateSummary state_summary(const State &state);
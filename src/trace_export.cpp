@@ -0,0 +1,284 @@
+#include "trace_export.h"
+
+#include "bounded_writer.h"
+#include "state.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Events of one process at most: metadata, a slice end and begin and the
+// counters, without the comm
+static constexpr size_t PROCESS_EVENTS_BYTES = 1536;
+
+// Counters of the system track, two values per counter
+struct TraceCounterInfo {
+  const char *name;
+  const char *args[2];
+};
+
+static constexpr TraceCounterInfo SYSTEM_COUNTERS[TRACE_SYSTEM_VALUES / 2] = {
+    {"CPU %", {"total", "kernel"}},
+    {"Memory bytes", {"used", "swap"}},
+    {"Disk MB/s", {"read", "write"}},
+    {"Network MB/s", {"recv", "send"}},
+};
+
+namespace {
+
+// Chrome trace events into the exporter buffer
+struct TraceWriter : BoundedWriter {
+  bool &need_comma;
+
+  // Separator of the traceEvents array
+  void event() {
+    if (need_comma) print(",\n");
+    need_comma = true;
+  }
+
+  void metadata(const int pid, const char *comm) {
+    event();
+    print("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":"
+          "{\"name\":",
+          pid);
+    print_json_string(comm);
+    print("}}");
+    event();
+    print("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+          "\"args\":{\"name\":",
+          pid, pid);
+    print_json_string(comm);
+    print("}}");
+  }
+
+  void slice(const char phase, const int pid, const char *comm,
+             const double ts) {
+    event();
+    print("{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.0f", phase, pid, pid,
+          ts);
+    if (comm) {
+      print(",\"name\":");
+      print_json_string(comm);
+    }
+    print("}");
+  }
+
+  void counter(const int pid, const char *name, const double ts,
+               const char *arg, const double value) {
+    event();
+    print("{\"ph\":\"C\",\"pid\":%d,\"ts\":%.0f,\"name\":\"%s\",\"args\":"
+          "{\"%s\":%.6g}}",
+          pid, ts, name, arg, value);
+  }
+
+  void counter2(const int pid, const char *name, const double ts,
+                const char *const args[2], const double first,
+                const double second) {
+    event();
+    print("{\"ph\":\"C\",\"pid\":%d,\"ts\":%.0f,\"name\":\"%s\",\"args\":"
+          "{\"%s\":%.6g,\"%s\":%.6g}}",
+          pid, ts, name, args[0], first, args[1], second);
+  }
+};
+
+} // namespace
+
+static TraceWriter trace_writer(TraceExporter &exporter, const size_t bound) {
+  char *data = reinterpret_cast<char *>(ensure_slab(exporter.buffer, bound));
+  return {{data, 0, bound}, exporter.need_comma};
+}
+
+static uint32_t hash_comm(const char *comm) {
+  // FNV-1a
+  uint32_t res = 2166136261u;
+  for (const char *it = comm; *it; ++it) {
+    res = (res ^ static_cast<uint8_t>(*it)) * 16777619u;
+  }
+  return res;
+}
+
+String trace_export_begin(TraceExporter &exporter) {
+  ZoneScoped;
+  for (float &value : exporter.system) {
+    value = NAN;
+  }
+  for (size_t i = 0; i < exporter.processes.size; ++i) {
+    TraceProcess &process = exporter.processes.data[i];
+    process.comm_hash = 0;
+    process.open = false;
+    for (float &value : process.counters) {
+      value = NAN;
+    }
+  }
+  exporter.need_comma = false;
+  TraceWriter writer = trace_writer(exporter, 256);
+  writer.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  writer.metadata(0, "System");
+  return {writer.data, writer.size};
+}
+
+static void end_slice(TraceWriter &writer, const TraceProcess &process,
+                      const double ts) {
+  if (process.open) writer.slice('E', process.pid, nullptr, ts);
+}
+
+// Writes `value` unless the counter already has it
+static bool update_value(float &last, const double value) {
+  const float f = static_cast<float>(value);
+  if (f == last) return false;
+  last = f;
+  return true;
+}
+
+static void write_system(TraceWriter &writer, TraceExporter &exporter,
+                         const StateSnapshot &snapshot, const double ts) {
+  const SystemCpuPerc &cpu = snapshot.cpu_perc;
+  const MemInfo &mem = snapshot.mem_info;
+  const double values[TRACE_SYSTEM_VALUES] = {
+      cpu.total.size > 0 ? cpu.total.data[0] : 0,
+      cpu.kernel.size > 0 ? cpu.kernel.data[0] : 0,
+      (static_cast<double>(mem.mem_total) - mem.mem_available) * 1024,
+      (static_cast<double>(mem.swap_total) - mem.swap_free) * 1024,
+      snapshot.disk_io_rate.read_mb_per_sec,
+      snapshot.disk_io_rate.write_mb_per_sec,
+      snapshot.net_io_rate.recv_mb_per_sec,
+      snapshot.net_io_rate.send_mb_per_sec,
+  };
+  for (size_t i = 0; i < TRACE_SYSTEM_VALUES / 2; ++i) {
+    // Both values are written when either changes
+    const bool first = update_value(exporter.system[2 * i], values[2 * i]);
+    const bool second =
+        update_value(exporter.system[2 * i + 1], values[2 * i + 1]);
+    if (first || second) {
+      writer.counter2(0, SYSTEM_COUNTERS[i].name, ts, SYSTEM_COUNTERS[i].args,
+                      values[2 * i], values[2 * i + 1]);
+    }
+  }
+}
+
+static void write_counters(TraceWriter &writer, TraceProcess &process,
+                           const ProcessDerivedStat &derived,
+                           const double ts) {
+  float *last = process.counters;
+  const int pid = process.pid;
+  if (update_value(last[eTraceCounter_Cpu],
+                   derived.cpu_user_perc + derived.cpu_kernel_perc)) {
+    writer.counter(pid, "CPU %", ts, "cpu", last[eTraceCounter_Cpu]);
+  }
+  if (update_value(last[eTraceCounter_Rss], derived.mem_resident_bytes)) {
+    writer.counter(pid, "RSS bytes", ts, "rss", derived.mem_resident_bytes);
+  }
+  static constexpr const char *IO_ARGS[2] = {"read", "write"};
+  const bool read =
+      update_value(last[eTraceCounter_IoRead], derived.io_read_kb_per_sec);
+  const bool write =
+      update_value(last[eTraceCounter_IoWrite], derived.io_write_kb_per_sec);
+  if (read || write) {
+    writer.counter2(pid, "Disk KB/s", ts, IO_ARGS, derived.io_read_kb_per_sec,
+                    derived.io_write_kb_per_sec);
+  }
+  static constexpr const char *NET_ARGS[2] = {"recv", "send"};
+  const bool recv =
+      update_value(last[eTraceCounter_NetRecv], derived.net_recv_kb_per_sec);
+  const bool send =
+      update_value(last[eTraceCounter_NetSend], derived.net_send_kb_per_sec);
+  if (recv || send) {
+    writer.counter2(pid, "Network KB/s", ts, NET_ARGS,
+                    derived.net_recv_kb_per_sec, derived.net_send_kb_per_sec);
+  }
+}
+
+String trace_export_update(TraceExporter &exporter,
+                           const StateSnapshot &snapshot, const double time) {
+  ZoneScoped;
+  const Array<ProcessStat> &stats = snapshot.stats;
+  const Array<TraceProcess> &old_processes = exporter.processes;
+
+  size_t bound = 1024 + old_processes.size * 128;
+  for (size_t i = 0; i < stats.size; ++i) {
+    // Escaped comm of the slice and both metadata events
+    bound += PROCESS_EVENTS_BYTES + 3 * 6 * strlen(stats.data[i].comm);
+  }
+  TraceWriter writer = trace_writer(exporter, bound);
+  const double ts = time * 1e6;
+  write_system(writer, exporter, snapshot, ts);
+
+  TraceProcess *processes = reinterpret_cast<TraceProcess *>(ensure_slab(
+      exporter.spare_slab, std::max<size_t>(stats.size, 1) *
+                               sizeof(TraceProcess)));
+
+  // Both lists are sorted by pid: gone processes end their slice, new ones
+  // start one, the rest carries its last counter values over
+  size_t old_i = 0;
+  for (size_t i = 0; i < stats.size; ++i) {
+    const ProcessStat &stat = stats.data[i];
+    while (old_i < old_processes.size &&
+           old_processes.data[old_i].pid < stat.pid) {
+      end_slice(writer, old_processes.data[old_i++], ts);
+    }
+    TraceProcess &process = processes[i];
+    const bool same = old_i < old_processes.size &&
+                      old_processes.data[old_i].pid == stat.pid &&
+                      old_processes.data[old_i].starttime == stat.starttime;
+    if (old_i < old_processes.size &&
+        old_processes.data[old_i].pid == stat.pid) {
+      if (same) {
+        process = old_processes.data[old_i];
+      } else {
+        // Reused pid
+        end_slice(writer, old_processes.data[old_i], ts);
+      }
+      ++old_i;
+    }
+    if (!same) {
+      process = {};
+      process.pid = stat.pid;
+      process.starttime = stat.starttime;
+      for (float &value : process.counters) {
+        value = NAN;
+      }
+    }
+
+    const uint32_t comm_hash = hash_comm(stat.comm);
+    if (!process.open || process.comm_hash != comm_hash) {
+      process.comm_hash = comm_hash;
+      writer.metadata(stat.pid, stat.comm);
+    }
+    if (!process.open) {
+      process.open = true;
+      writer.slice('B', stat.pid, stat.comm, ts);
+    }
+    write_counters(writer, process, snapshot.derived_stats.data[i], ts);
+  }
+  while (old_i < old_processes.size) {
+    end_slice(writer, old_processes.data[old_i++], ts);
+  }
+
+  std::swap(exporter.processes_slab, exporter.spare_slab);
+  exporter.processes = {processes, stats.size};
+  exporter.last_time = time;
+  return {writer.data, writer.size};
+}
+
+String trace_export_end(TraceExporter &exporter) {
+  ZoneScoped;
+  const size_t bound = 64 + exporter.processes.size * 128;
+  TraceWriter writer = trace_writer(exporter, bound);
+  const double ts = exporter.last_time * 1e6;
+  for (size_t i = 0; i < exporter.processes.size; ++i) {
+    end_slice(writer, exporter.processes.data[i], ts);
+    exporter.processes.data[i].open = false;
+  }
+  writer.print("\n]}\n");
+  return {writer.data, writer.size};
+}
+
+void trace_export_destroy(TraceExporter &exporter) {
+  if (exporter.buffer) ArenaSlab::release(exporter.buffer);
+  if (exporter.processes_slab) ArenaSlab::release(exporter.processes_slab);
+  if (exporter.spare_slab) ArenaSlab::release(exporter.spare_slab);
+  exporter = {};
+}
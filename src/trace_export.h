@@ -0,0 +1,63 @@
+#pragma once
+
+#include "base.h"
+
+struct StateSnapshot;
+
+// Chrome / Perfetto JSON trace of updates (prock-collect --format trace),
+// written piece by piece so a capture of any length never sits in memory.
+//
+// - pid 0 ("System") has counter tracks for CPU, memory, disk and network
+// - every process is a track named after its comm with a slice from the
+//   update it first appeared in to the update it was gone in, and counter
+//   tracks for CPU, resident memory, disk and network rates
+// - counters are only written when their value changes, an idle process
+//   costs nothing between its first and last sample
+//
+// A process is identified by (pid, starttime), so a reused pid ends the
+// slice of the old process and starts a new one.
+enum TraceCounter {
+  eTraceCounter_Cpu,
+  eTraceCounter_Rss,
+  eTraceCounter_IoRead,
+  eTraceCounter_IoWrite,
+  eTraceCounter_NetRecv,
+  eTraceCounter_NetSend,
+  eTraceCounter_COUNT,
+};
+
+constexpr size_t TRACE_SYSTEM_VALUES = 8;
+
+// A process of the last update and its counter values written last
+struct TraceProcess {
+  int pid;
+  ulonglong starttime;
+  uint32_t comm_hash; // the track is renamed when the comm changes (exec)
+  bool open;          // its slice began in the current trace
+  float counters[eTraceCounter_COUNT]; // NaN until written
+};
+
+struct TraceExporter {
+  ArenaSlab *buffer; // formatted events, grown on demand
+
+  // Sorted by pid, swapped on every update
+  ArenaSlab *processes_slab;
+  ArenaSlab *spare_slab;
+  Array<TraceProcess> processes;
+
+  // Of pid 0 written last, NaN until written
+  float system[TRACE_SYSTEM_VALUES];
+  double last_time;
+  bool need_comma; // an event was written since trace_export_begin
+};
+
+// Starts a trace, e.g. a new file after rotation. Tracks, slices and
+// counters of processes that are still alive start again at the next update.
+String trace_export_begin(TraceExporter &exporter);
+// Events of one update at `time`, seconds since epoch. The snapshot needs
+// rates, i.e. at least the second update.
+String trace_export_update(TraceExporter &exporter,
+                           const StateSnapshot &snapshot, double time);
+// Ends every open slice at the last update and closes the JSON
+String trace_export_end(TraceExporter &exporter);
+void trace_export_destroy(TraceExporter &exporter);
@@ -0,0 +1,224 @@
+#include "screen.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+static const char *STYLE_SGR[eTuiStyle_COUNT] = {
+    "\x1b[0m",       // Normal
+    "\x1b[0;1m",     // Title
+    "\x1b[0;30;42m", // Header
+    "\x1b[0;30;46m", // Selected
+    "\x1b[0;2m",     // Dim
+    "\x1b[0;32m",    // New
+    "\x1b[0;31m",    // Dead
+    "\x1b[0;32m",    // Cpu
+    "\x1b[0;33m",    // Mem
+    "\x1b[0;34m",    // Disk
+    "\x1b[0;35m",    // Net
+};
+
+static constexpr TuiCell BLANK = {' ', eTuiStyle_Normal};
+
+static bool same(const TuiCell &left, const TuiCell &right) {
+  return left.ch == right.ch && left.style == right.style;
+}
+
+void tui_screen_resize(TuiScreen &screen, const int width, const int height) {
+  screen.width = width > 0 ? width : 0;
+  screen.height = height > 0 ? height : 0;
+  const size_t bytes = static_cast<size_t>(screen.width) * screen.height *
+                       sizeof(TuiCell);
+  screen.cells =
+      reinterpret_cast<TuiCell *>(ensure_slab(screen.cells_slab, bytes));
+  screen.shown =
+      reinterpret_cast<TuiCell *>(ensure_slab(screen.shown_slab, bytes));
+  screen.clear = true;
+  tui_screen_clear(screen);
+}
+
+void tui_screen_clear(TuiScreen &screen) {
+  const size_t count = static_cast<size_t>(screen.width) * screen.height;
+  for (size_t i = 0; i < count; ++i) {
+    screen.cells[i] = BLANK;
+  }
+}
+
+// Next code point of UTF-8 `it`, broken sequences and control characters
+// become '?'
+static uint32_t next_code_point(const char *&it) {
+  const uint8_t lead = static_cast<uint8_t>(*it++);
+  if (lead < 0x80) return lead < 0x20 || lead == 0x7f ? '?' : lead;
+  int extra = 0;
+  uint32_t res = 0;
+  if ((lead & 0xe0) == 0xc0) {
+    extra = 1;
+    res = lead & 0x1f;
+  } else if ((lead & 0xf0) == 0xe0) {
+    extra = 2;
+    res = lead & 0x0f;
+  } else if ((lead & 0xf8) == 0xf0) {
+    extra = 3;
+    res = lead & 0x07;
+  } else {
+    return '?';
+  }
+  for (int i = 0; i < extra; ++i) {
+    if ((static_cast<uint8_t>(*it) & 0xc0) != 0x80) return '?';
+    res = res << 6 | (static_cast<uint8_t>(*it++) & 0x3f);
+  }
+  return res < 0xa0 || res > 0x10ffff ? '?' : res;
+}
+
+int tui_put(TuiScreen &screen, const int x, const int y, const int max_width,
+            const uint8_t style, const char *text) {
+  if (y < 0 || y >= screen.height || x < 0) return 0;
+  const int end = std::min(x + max_width, screen.width);
+  TuiCell *row = screen.cells + static_cast<size_t>(y) * screen.width;
+  int col = x;
+  for (const char *it = text; *it && col < end; ++col) {
+    row[col] = {next_code_point(it), style};
+  }
+  return col - x;
+}
+
+int tui_printf(TuiScreen &screen, const int x, const int y,
+               const int max_width, const uint8_t style, const char *format,
+               ...) {
+  char text[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  return tui_put(screen, x, y, max_width, style, text);
+}
+
+void tui_fill(TuiScreen &screen, const int x, const int y, const int width,
+              const uint8_t style) {
+  if (y < 0 || y >= screen.height) return;
+  TuiCell *row = screen.cells + static_cast<size_t>(y) * screen.width;
+  for (int col = std::max(x, 0); col < std::min(x + width, screen.width);
+       ++col) {
+    row[col] = {' ', style};
+  }
+}
+
+void tui_sparkline(TuiScreen &screen, const int x, const int y,
+                   const int width, const int rows, const uint8_t style,
+                   const float *values, const size_t count,
+                   const double max) {
+  // Dots of the left and right column of a braille cell, from the bottom
+  static constexpr uint8_t DOTS[2][4] = {{0x40, 0x04, 0x02, 0x01},
+                                         {0x80, 0x20, 0x10, 0x08}};
+  const int levels = rows * 4;
+  for (int col = 0; col < width; ++col) {
+    int heights[2] = {};
+    for (int half = 0; half < 2; ++half) {
+      // The newest value is the right half of the last column
+      const size_t from_end = 2 * static_cast<size_t>(width - col) - half;
+      if (from_end > count || max <= 0) continue;
+      const double value = values[count - from_end];
+      int height = static_cast<int>(std::lround(value / max * levels));
+      if (value > 0 && height == 0) height = 1;
+      heights[half] = std::min(std::max(height, 0), levels);
+    }
+    for (int row = 0; row < rows; ++row) {
+      uint32_t bits = 0;
+      for (int half = 0; half < 2; ++half) {
+        const int dots = std::min(std::max(heights[half] - row * 4, 0), 4);
+        for (int dot = 0; dot < dots; ++dot) {
+          bits |= DOTS[half][dot];
+        }
+      }
+      const int cell_y = y + rows - 1 - row;
+      const int cell_x = x + col;
+      if (cell_y < 0 || cell_y >= screen.height || cell_x < 0 ||
+          cell_x >= screen.width) {
+        continue;
+      }
+      screen.cells[static_cast<size_t>(cell_y) * screen.width + cell_x] = {
+          bits ? 0x2800 + bits : ' ', style};
+    }
+  }
+}
+
+static size_t put_utf8(char *out, const uint32_t ch) {
+  if (ch < 0x80) {
+    out[0] = static_cast<char>(ch);
+    return 1;
+  }
+  if (ch < 0x800) {
+    out[0] = static_cast<char>(0xc0 | ch >> 6);
+    out[1] = static_cast<char>(0x80 | (ch & 0x3f));
+    return 2;
+  }
+  if (ch < 0x10000) {
+    out[0] = static_cast<char>(0xe0 | ch >> 12);
+    out[1] = static_cast<char>(0x80 | (ch >> 6 & 0x3f));
+    out[2] = static_cast<char>(0x80 | (ch & 0x3f));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xf0 | ch >> 18);
+  out[1] = static_cast<char>(0x80 | (ch >> 12 & 0x3f));
+  out[2] = static_cast<char>(0x80 | (ch >> 6 & 0x3f));
+  out[3] = static_cast<char>(0x80 | (ch & 0x3f));
+  return 4;
+}
+
+static size_t put_str(char *out, const char *str) {
+  const size_t len = strlen(str);
+  memcpy(out, str, len);
+  return len;
+}
+
+String tui_screen_flush(TuiScreen &screen) {
+  ZoneScoped;
+  const size_t count = static_cast<size_t>(screen.width) * screen.height;
+  // Cursor move, style and a 4 byte character for every cell at worst
+  const size_t bound = 64 + count * 40;
+  char *out = reinterpret_cast<char *>(ensure_slab(screen.out, bound));
+  size_t size = 0;
+
+  if (screen.clear) {
+    size += put_str(out + size, "\x1b[0m\x1b[H\x1b[2J");
+    for (size_t i = 0; i < count; ++i) {
+      screen.shown[i] = BLANK;
+    }
+    screen.clear = false;
+  }
+
+  int style = -1;
+  int cursor_x = -1;
+  int cursor_y = -1;
+  for (int y = 0; y < screen.height; ++y) {
+    for (int x = 0; x < screen.width; ++x) {
+      const size_t i = static_cast<size_t>(y) * screen.width + x;
+      const TuiCell &cell = screen.cells[i];
+      if (same(cell, screen.shown[i])) continue;
+      if (x != cursor_x || y != cursor_y) {
+        size +=
+            snprintf(out + size, bound - size, "\x1b[%d;%dH", y + 1, x + 1);
+      }
+      if (cell.style != style) {
+        style = cell.style;
+        size += put_str(out + size, STYLE_SGR[style]);
+      }
+      size += put_utf8(out + size, cell.ch);
+      cursor_x = x + 1;
+      cursor_y = y;
+      screen.shown[i] = cell;
+    }
+  }
+  return {out, size};
+}
+
+void tui_screen_destroy(TuiScreen &screen) {
+  if (screen.cells_slab) ArenaSlab::release(screen.cells_slab);
+  if (screen.shown_slab) ArenaSlab::release(screen.shown_slab);
+  if (screen.out) ArenaSlab::release(screen.out);
+  screen = {};
+}
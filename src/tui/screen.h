@@ -0,0 +1,64 @@
+#pragma once
+
+#include "base.h"
+
+// Cell grid of the terminal UI. Views draw every frame into `cells`, the
+// flush only emits escape sequences for cells that differ from what the
+// terminal already shows, so an idle screen costs nothing to redraw and a
+// changing number costs a cursor move and a few bytes.
+enum TuiStyle : uint8_t {
+  eTuiStyle_Normal,
+  eTuiStyle_Title,
+  eTuiStyle_Header,
+  eTuiStyle_Selected,
+  eTuiStyle_Dim,
+  eTuiStyle_New,
+  eTuiStyle_Dead,
+  eTuiStyle_Cpu,
+  eTuiStyle_Mem,
+  eTuiStyle_Disk,
+  eTuiStyle_Net,
+  eTuiStyle_COUNT,
+};
+
+struct TuiCell {
+  uint32_t ch; // code point, every one is drawn one column wide
+  uint8_t style;
+};
+
+struct TuiScreen {
+  int width;
+  int height;
+  TuiCell *cells; // drawn this frame
+  TuiCell *shown; // on the terminal
+  ArenaSlab *cells_slab;
+  ArenaSlab *shown_slab;
+  ArenaSlab *out; // escape sequences of the last flush
+  bool clear;     // the terminal is cleared before the next flush
+};
+
+// Sets the size, the next flush redraws everything
+void tui_screen_resize(TuiScreen &screen, int width, int height);
+// Blanks every cell
+void tui_screen_clear(TuiScreen &screen);
+
+// UTF-8 `text` at column x of row y, cut at `max_width` columns and the
+// screen edge. Returns the columns written.
+int tui_put(TuiScreen &screen, int x, int y, int max_width, uint8_t style,
+            const char *text);
+__attribute__((format(printf, 6, 7))) int
+tui_printf(TuiScreen &screen, int x, int y, int max_width, uint8_t style,
+           const char *format, ...);
+// Blank cells of `style`, e.g. the background of a selected row
+void tui_fill(TuiScreen &screen, int x, int y, int width, uint8_t style);
+
+// Braille chart of the newest values, two per column and four dots per row,
+// `rows` high with values from 0 to `max`
+void tui_sparkline(TuiScreen &screen, int x, int y, int width, int rows,
+                   uint8_t style, const float *values, size_t count,
+                   double max);
+
+// Escape sequences that turn the terminal into `cells`, valid until the next
+// call. Empty when nothing changed.
+String tui_screen_flush(TuiScreen &screen);
+void tui_screen_destroy(TuiScreen &screen);
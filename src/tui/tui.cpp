@@ -0,0 +1,552 @@
+#include "tui.h"
+
+#include "state.h"
+#include "tui/screen.h"
+
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Same as the process table of the GUI
+static constexpr int64_t NEW_PROCESS_HIGHLIGHT_NS = 2'000'000'000;
+
+// The name gets what is left, optional columns are dropped from the right
+// until it has at least this many
+static constexpr int MIN_NAME_WIDTH = 16;
+static constexpr int CHART_LABEL_WIDTH = 16;
+
+struct TuiColumn {
+  BriefTableColumnId id;
+  const char *title;
+  int width;
+  bool optional;
+};
+
+static constexpr TuiColumn COLUMNS[] = {
+    {eBriefTableColumnId_Pid, "PID", 7, false},
+    {eBriefTableColumnId_State, "S", 1, false},
+    {eBriefTableColumnId_Threads, "THR", 4, false},
+    {eBriefTableColumnId_CpuTotalPerc, "CPU%", 6, false},
+    {eBriefTableColumnId_MemRssBytes, "RSS", 7, false},
+    {eBriefTableColumnId_IoReadKbPerSec, "READ/s", 7, true},
+    {eBriefTableColumnId_IoWriteKbPerSec, "WRITE/s", 7, true},
+    {eBriefTableColumnId_NetRecvKbPerSec, "RECV/s", 7, true},
+    {eBriefTableColumnId_NetSendKbPerSec, "SEND/s", 7, true},
+    {eBriefTableColumnId_RunDelayPerc, "DLY%", 6, true},
+    {eBriefTableColumnId_Name, "NAME", 0, false},
+};
+static constexpr int COLUMN_COUNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+void tui_init(TuiState &tui) {
+  tui = {};
+  tui.table.sorted_by = eBriefTableColumnId_CpuTotalPerc;
+  tui.table.sorted_order = ImGuiSortDirection_Descending;
+  tui.table.selected_pid = -1;
+}
+
+// Case insensitive match of the comm or the pid, then ancestors in tree mode
+static void apply_filter(BriefTableState &table) {
+  const char *filter = table.filter_text;
+  for (size_t i = 0; i < table.lines.size; ++i) {
+    BriefTableLine &line = table.lines.data[i];
+    if (filter[0] == '\0') {
+      line.filter_state = 1;
+      continue;
+    }
+    char pid[16];
+    snprintf(pid, sizeof(pid), "%d", line.pid);
+    line.filter_state =
+        strcasestr(line.comm, filter) || strstr(pid, filter) ? 1 : 0;
+  }
+  if (filter[0] != '\0') mark_brief_table_filter_ancestors(table);
+}
+
+static void push_chart(TuiChartSeries &series, const double value) {
+  if (series.count == TUI_CHART_SAMPLES) {
+    memmove(series.values, series.values + 1,
+            (TUI_CHART_SAMPLES - 1) * sizeof(float));
+    --series.count;
+  }
+  series.values[series.count++] = static_cast<float>(value);
+}
+
+void tui_update(TuiState &tui, State &state) {
+  ZoneScoped;
+  brief_table_update(tui.table, state);
+  apply_filter(tui.table);
+
+  const StateSummary summary = state_summary(state);
+  push_chart(tui.charts[eTuiChart_Cpu], summary.cpu_perc);
+  push_chart(tui.charts[eTuiChart_Mem], summary.mem_used_kb);
+  push_chart(tui.charts[eTuiChart_Disk],
+             summary.disk_io_rate.read_mb_per_sec +
+                 summary.disk_io_rate.write_mb_per_sec);
+  push_chart(tui.charts[eTuiChart_Net],
+             summary.net_io_rate.recv_mb_per_sec +
+                 summary.net_io_rate.send_mb_per_sec);
+}
+
+size_t tui_parse_key(const char *input, const size_t size, int &key) {
+  key = eTuiKey_None;
+  if (size == 0) return 0;
+  const char c = input[0];
+  if (c != '\x1b') {
+    if (c == '\n') {
+      key = eTuiKey_Enter;
+    } else if (c == '\b') {
+      key = eTuiKey_Backspace;
+    } else {
+      key = static_cast<unsigned char>(c);
+    }
+    return 1;
+  }
+  // A lone escape
+  if (size == 1 || (input[1] != '[' && input[1] != 'O')) {
+    key = eTuiKey_Escape;
+    return 1;
+  }
+  // CSI or SS3 ends with a byte in @..~, parameters come before it
+  size_t end = 2;
+  while (end < size && !(input[end] >= '@' && input[end] <= '~')) {
+    ++end;
+  }
+  if (end == size) return 0;
+  const char final_byte = input[end];
+  const int param = end > 2 ? atoi(input + 2) : 0;
+  switch (final_byte) {
+  case 'A':
+    key = eTuiKey_Up;
+    break;
+  case 'B':
+    key = eTuiKey_Down;
+    break;
+  case 'C':
+    key = eTuiKey_Right;
+    break;
+  case 'D':
+    key = eTuiKey_Left;
+    break;
+  case 'H':
+    key = eTuiKey_Home;
+    break;
+  case 'F':
+    key = eTuiKey_End;
+    break;
+  case '~':
+    key = param == 1 || param == 7   ? eTuiKey_Home
+          : param == 4 || param == 8 ? eTuiKey_End
+          : param == 5               ? eTuiKey_PageUp
+          : param == 6               ? eTuiKey_PageDown
+                                     : eTuiKey_None;
+    break;
+  default:
+    break;
+  }
+  return end + 1;
+}
+
+static void resort(TuiState &tui, State &state) {
+  BriefTableState &table = tui.table;
+  if (table.tree_mode) {
+    sort_brief_table_tree(table, state.snapshot_arena);
+  } else {
+    sort_brief_table_lines(table);
+  }
+  apply_filter(table);
+}
+
+static void sort_by(TuiState &tui, State &state, const BriefTableColumnId id,
+                    const ImGuiSortDirection order) {
+  // Like the GUI, sorting leaves tree mode
+  tui.table.tree_mode = false;
+  tui.table.sorted_by = id;
+  tui.table.sorted_order = order;
+  resort(tui, state);
+}
+
+static void next_sort_column(TuiState &tui, State &state, const int step) {
+  int current = 0;
+  for (int i = 0; i < COLUMN_COUNT; ++i) {
+    if (COLUMNS[i].id == tui.table.sorted_by) current = i;
+  }
+  const int next = (current + step + COLUMN_COUNT) % COLUMN_COUNT;
+  // Numbers start with the highest, text and pids in ascending order
+  const BriefTableColumnId id = COLUMNS[next].id;
+  const bool ascending = id == eBriefTableColumnId_Pid ||
+                         id == eBriefTableColumnId_Name ||
+                         id == eBriefTableColumnId_State;
+  sort_by(tui, state, id,
+          ascending ? ImGuiSortDirection_Ascending
+                    : ImGuiSortDirection_Descending);
+}
+
+// Moves the selection by `delta` visible lines
+static void move_selection(TuiState &tui, const long delta) {
+  const BriefTableState &table = tui.table;
+  long visible = 0;
+  long selected = -1;
+  for (size_t i = 0; i < table.lines.size; ++i) {
+    const BriefTableLine &line = table.lines.data[i];
+    if (line.filter_state == 0) continue;
+    if (line.pid == table.selected_pid) selected = visible;
+    ++visible;
+  }
+  if (visible == 0) return;
+  const long target =
+      std::clamp(selected < 0 ? 0 : selected + delta, 0L, visible - 1);
+  long index = 0;
+  for (size_t i = 0; i < table.lines.size; ++i) {
+    const BriefTableLine &line = table.lines.data[i];
+    if (line.filter_state == 0) continue;
+    if (index++ == target) {
+      tui.table.selected_pid = line.pid;
+      return;
+    }
+  }
+}
+
+static bool handle_filter_key(TuiState &tui, State &state, const int key) {
+  char *filter = tui.table.filter_text;
+  const size_t len = strlen(filter);
+  if (key == eTuiKey_Enter) {
+    tui.editing_filter = false;
+    return true;
+  }
+  if (key == eTuiKey_Escape) {
+    filter[0] = '\0';
+    tui.editing_filter = false;
+  } else if (key == eTuiKey_Backspace) {
+    if (len > 0) filter[len - 1] = '\0';
+  } else if (key < 0x100 && isprint(key) &&
+             len + 1 < sizeof(tui.table.filter_text)) {
+    filter[len] = static_cast<char>(key);
+    filter[len + 1] = '\0';
+  } else {
+    return true;
+  }
+  tui.scroll = 0;
+  resort(tui, state);
+  return true;
+}
+
+bool tui_handle_key(TuiState &tui, State &state, const int key) {
+  if (tui.editing_filter) return handle_filter_key(tui, state, key);
+
+  const long page = std::max(tui.table_rows - 1, 1);
+  switch (key) {
+  case 'q':
+  case 'Q':
+  case 3: // Ctrl-C
+    return false;
+  case eTuiKey_Up:
+  case 'k':
+    move_selection(tui, -1);
+    break;
+  case eTuiKey_Down:
+  case 'j':
+    move_selection(tui, 1);
+    break;
+  case eTuiKey_PageUp:
+    move_selection(tui, -page);
+    break;
+  case eTuiKey_PageDown:
+    move_selection(tui, page);
+    break;
+  case eTuiKey_Home:
+    move_selection(tui, -static_cast<long>(tui.table.lines.size));
+    break;
+  case eTuiKey_End:
+    move_selection(tui, static_cast<long>(tui.table.lines.size));
+    break;
+  case eTuiKey_Left:
+  case '<':
+    next_sort_column(tui, state, -1);
+    break;
+  case eTuiKey_Right:
+  case '>':
+    next_sort_column(tui, state, 1);
+    break;
+  case 'r':
+    sort_by(tui, state, tui.table.sorted_by,
+            tui.table.sorted_order == ImGuiSortDirection_Descending
+                ? ImGuiSortDirection_Ascending
+                : ImGuiSortDirection_Descending);
+    break;
+  case 'P':
+    sort_by(tui, state, eBriefTableColumnId_CpuTotalPerc,
+            ImGuiSortDirection_Descending);
+    break;
+  case 'M':
+    sort_by(tui, state, eBriefTableColumnId_MemRssBytes,
+            ImGuiSortDirection_Descending);
+    break;
+  case 'N':
+    sort_by(tui, state, eBriefTableColumnId_Pid, ImGuiSortDirection_Ascending);
+    break;
+  case 't':
+    // Tree mode is ordered by pid, as in the GUI
+    tui.table.tree_mode = !tui.table.tree_mode;
+    tui.table.sorted_by = eBriefTableColumnId_Pid;
+    tui.table.sorted_order = ImGuiSortDirection_Ascending;
+    resort(tui, state);
+    break;
+  case '/':
+    tui.editing_filter = true;
+    break;
+  case eTuiKey_Escape:
+    tui.table.filter_text[0] = '\0';
+    resort(tui, state);
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+// ============================================================================
+// Drawing
+// ============================================================================
+
+static void format_bytes(char *buf, const size_t size, const double bytes) {
+  if (bytes >= 1024.0 * 1024.0 * 1024.0) {
+    snprintf(buf, size, "%.1fG", bytes / (1024.0 * 1024.0 * 1024.0));
+  } else if (bytes >= 1024.0 * 1024.0) {
+    snprintf(buf, size, "%.1fM", bytes / (1024.0 * 1024.0));
+  } else if (bytes >= 1024.0) {
+    snprintf(buf, size, "%.0fK", bytes / 1024.0);
+  } else {
+    snprintf(buf, size, "%.0fB", bytes);
+  }
+}
+
+static void draw_chart(TuiScreen &screen, const TuiChartSeries &series,
+                       const int x, const int y, const int width,
+                       const uint8_t style, const char *label,
+                       const char *value, const double max) {
+  tui_put(screen, x, y, CHART_LABEL_WIDTH, eTuiStyle_Title, label);
+  tui_put(screen, x, y + 1, CHART_LABEL_WIDTH, eTuiStyle_Normal, value);
+  tui_sparkline(screen, x + CHART_LABEL_WIDTH, y, width - CHART_LABEL_WIDTH,
+                TUI_CHART_ROWS, style, series.values, series.count, max);
+}
+
+static double series_max(const TuiChartSeries &series, const double floor) {
+  double res = floor;
+  for (size_t i = 0; i < series.count; ++i) {
+    res = std::max(res, static_cast<double>(series.values[i]));
+  }
+  return res;
+}
+
+static void draw_charts(TuiScreen &screen, const TuiState &tui,
+                        const StateSummary &summary, const int y) {
+  const int half = screen.width / 2;
+  const int right = screen.width - half;
+  char value[64];
+  char total[32];
+
+  snprintf(value, sizeof(value), "%.1f%%", summary.cpu_perc);
+  draw_chart(screen, tui.charts[eTuiChart_Cpu], 0, y, half - 1,
+             eTuiStyle_Cpu, "CPU", value, 100);
+
+  format_bytes(value, sizeof(value), summary.mem_used_kb * 1024);
+  format_bytes(total, sizeof(total), summary.mem_total_kb * 1024);
+  strncat(value, " / ", sizeof(value) - strlen(value) - 1);
+  strncat(value, total, sizeof(value) - strlen(value) - 1);
+  draw_chart(screen, tui.charts[eTuiChart_Mem], half, y, right,
+             eTuiStyle_Mem, "Memory", value,
+             std::max(summary.mem_total_kb, 1.0));
+
+  // Rates scale to the highest value on screen
+  snprintf(value, sizeof(value), "%.1f/%.1f MB/s",
+           summary.disk_io_rate.read_mb_per_sec,
+           summary.disk_io_rate.write_mb_per_sec);
+  draw_chart(screen, tui.charts[eTuiChart_Disk], 0, y + TUI_CHART_ROWS,
+             half - 1, eTuiStyle_Disk, "Disk read/write", value,
+             series_max(tui.charts[eTuiChart_Disk], 0.01));
+  snprintf(value, sizeof(value), "%.1f/%.1f MB/s",
+           summary.net_io_rate.recv_mb_per_sec,
+           summary.net_io_rate.send_mb_per_sec);
+  draw_chart(screen, tui.charts[eTuiChart_Net], half, y + TUI_CHART_ROWS,
+             right, eTuiStyle_Net, "Net recv/send", value,
+             series_max(tui.charts[eTuiChart_Net], 0.01));
+}
+
+static void format_cell(char *buf, const size_t size, const TuiColumn &column,
+                        const BriefTableLine &line) {
+  const ProcessDerivedStat &derived = line.derived_stat;
+  switch (column.id) {
+  case eBriefTableColumnId_Pid:
+    snprintf(buf, size, "%*d", column.width, line.pid);
+    return;
+  case eBriefTableColumnId_State:
+    snprintf(buf, size, "%c", line.state ? line.state : '?');
+    return;
+  case eBriefTableColumnId_Threads:
+    snprintf(buf, size, "%*ld", column.width, line.num_threads);
+    return;
+  case eBriefTableColumnId_CpuTotalPerc:
+    snprintf(buf, size, "%*.1f", column.width,
+             derived.cpu_user_perc + derived.cpu_kernel_perc);
+    return;
+  case eBriefTableColumnId_RunDelayPerc:
+    snprintf(buf, size, "%*.1f", column.width, derived.run_delay_perc);
+    return;
+  case eBriefTableColumnId_MemRssBytes: {
+    char value[16];
+    format_bytes(value, sizeof(value), derived.mem_resident_bytes);
+    snprintf(buf, size, "%*s", column.width, value);
+    return;
+  }
+  case eBriefTableColumnId_IoReadKbPerSec:
+  case eBriefTableColumnId_IoWriteKbPerSec:
+  case eBriefTableColumnId_NetRecvKbPerSec:
+  case eBriefTableColumnId_NetSendKbPerSec: {
+    double kb = derived.net_send_kb_per_sec;
+    if (column.id == eBriefTableColumnId_IoReadKbPerSec) {
+      kb = derived.io_read_kb_per_sec;
+    } else if (column.id == eBriefTableColumnId_IoWriteKbPerSec) {
+      kb = derived.io_write_kb_per_sec;
+    } else if (column.id == eBriefTableColumnId_NetRecvKbPerSec) {
+      kb = derived.net_recv_kb_per_sec;
+    }
+    char value[16];
+    if (kb > 0) {
+      format_bytes(value, sizeof(value), kb * 1024);
+    } else {
+      value[0] = '\0';
+    }
+    snprintf(buf, size, "%*s", column.width, value);
+    return;
+  }
+  default:
+    buf[0] = '\0';
+    return;
+  }
+}
+
+void tui_draw(TuiScreen &screen, TuiState &tui, const State &state) {
+  ZoneScoped;
+  tui_screen_clear(screen);
+  const int width = screen.width;
+  const int height = screen.height;
+  const StateSummary summary = state_summary(state);
+  const BriefTableState &table = tui.table;
+
+  size_t visible = 0;
+  size_t selected = SIZE_MAX;
+  for (size_t i = 0; i < table.lines.size; ++i) {
+    const BriefTableLine &line = table.lines.data[i];
+    if (line.filter_state == 0) continue;
+    if (line.pid == table.selected_pid) selected = visible;
+    ++visible;
+  }
+
+  tui_printf(screen, 0, 0, width, eTuiStyle_Title,
+             "prock  %zu processes%s%s", visible,
+             table.tree_mode ? "  [tree]" : "",
+             table.filter_text[0] ? "  [filtered]" : "");
+  draw_charts(screen, tui, summary, 1);
+
+  // Columns that fit, the name takes the rest
+  bool shown[COLUMN_COUNT];
+  int fixed = 0;
+  for (int i = 0; i < COLUMN_COUNT; ++i) {
+    shown[i] = true;
+    fixed += COLUMNS[i].width + 1;
+  }
+  for (int i = COLUMN_COUNT - 1; i >= 0 && width - fixed < MIN_NAME_WIDTH;
+       --i) {
+    if (COLUMNS[i].optional) {
+      shown[i] = false;
+      fixed -= COLUMNS[i].width + 1;
+    }
+  }
+
+  const int header_y = 1 + 2 * TUI_CHART_ROWS;
+  tui_fill(screen, 0, header_y, width, eTuiStyle_Header);
+  int x = 0;
+  for (int i = 0; i < COLUMN_COUNT; ++i) {
+    if (!shown[i]) continue;
+    const TuiColumn &column = COLUMNS[i];
+    const bool sorted = column.id == table.sorted_by && !table.tree_mode;
+    const char *arrow = !sorted ? ""
+                        : table.sorted_order == ImGuiSortDirection_Descending
+                            ? "v"
+                            : "^";
+    if (column.width > 0) {
+      tui_printf(screen, x, header_y, column.width, eTuiStyle_Header, "%*s%s",
+                 column.width - (sorted ? 1 : 0), column.title, arrow);
+      x += column.width + 1;
+    } else {
+      tui_printf(screen, x, header_y, width - x, eTuiStyle_Header, "%s%s",
+                 column.title, arrow);
+    }
+  }
+
+  // Keep the selection on screen
+  const int first_row = header_y + 1;
+  tui.table_rows = std::max(height - first_row - 1, 0);
+  const size_t rows = static_cast<size_t>(tui.table_rows);
+  if (selected != SIZE_MAX) {
+    if (selected < tui.scroll) tui.scroll = selected;
+    if (rows > 0 && selected >= tui.scroll + rows) {
+      tui.scroll = selected - rows + 1;
+    }
+  }
+  tui.scroll = std::min(tui.scroll, visible > rows ? visible - rows : 0);
+
+  const int64_t now_ns = state.snapshot.at.time_since_epoch().count();
+  size_t index = 0;
+  int y = first_row;
+  for (size_t i = 0; i < table.lines.size && y < first_row + tui.table_rows;
+       ++i) {
+    const BriefTableLine &line = table.lines.data[i];
+    if (line.filter_state == 0) continue;
+    if (index++ < tui.scroll) continue;
+
+    const bool is_dead = line.death_time_ns != 0;
+    uint8_t style = eTuiStyle_Normal;
+    if (line.pid == table.selected_pid) {
+      style = eTuiStyle_Selected;
+    } else if (is_dead) {
+      style = eTuiStyle_Dead;
+    } else if (now_ns - line.first_seen_ns < NEW_PROCESS_HIGHLIGHT_NS) {
+      style = eTuiStyle_New;
+    } else if (line.filter_state == 2) {
+      style = eTuiStyle_Dim;
+    }
+    if (style == eTuiStyle_Selected) tui_fill(screen, 0, y, width, style);
+
+    x = 0;
+    for (int c = 0; c < COLUMN_COUNT; ++c) {
+      if (!shown[c]) continue;
+      const TuiColumn &column = COLUMNS[c];
+      if (column.width > 0) {
+        char cell[32];
+        format_cell(cell, sizeof(cell), column, line);
+        tui_put(screen, x, y, column.width, style, cell);
+        x += column.width + 1;
+      } else {
+        const int indent =
+            std::min(2 * line.tree_depth, std::max(width - x, 0));
+        tui_put(screen, x + indent, y, width - x - indent, style,
+                line.comm ? line.comm : "");
+      }
+    }
+    ++y;
+  }
+
+  const int bottom = height - 1;
+  if (tui.editing_filter) {
+    tui_printf(screen, 0, bottom, width, eTuiStyle_Title, "Filter: %s_",
+               table.filter_text);
+  } else {
+    tui_put(screen, 0, bottom, width, eTuiStyle_Dim,
+            "q quit  arrows select  < > sort  r reverse  P/M/N cpu/mem/pid  "
+            "t tree  / filter  esc clear");
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "state.h"
+#include "views/brief_table.h"
+
+struct TuiScreen;
+
+// Terminal front-end of prock (prock-tui). The process table is the
+// BriefTableState of the GUI, updated and sorted by the same functions, so
+// both show the same lines in the same order.
+//
+// Layout: summary line, CPU/memory and disk/network sparklines, the table
+// header, process lines and the key help or filter prompt at the bottom.
+constexpr size_t TUI_CHART_SAMPLES = 512; // two per column
+constexpr int TUI_CHART_ROWS = 2;
+
+enum TuiChart {
+  eTuiChart_Cpu,
+  eTuiChart_Mem,
+  eTuiChart_Disk,
+  eTuiChart_Net,
+  eTuiChart_COUNT,
+};
+
+// Newest value last
+struct TuiChartSeries {
+  float values[TUI_CHART_SAMPLES];
+  size_t count;
+};
+
+enum TuiKey {
+  eTuiKey_None = 0,
+  eTuiKey_Enter = '\r',
+  eTuiKey_Escape = 0x1b,
+  eTuiKey_Backspace = 0x7f,
+  eTuiKey_Up = 0x100,
+  eTuiKey_Down,
+  eTuiKey_Left,
+  eTuiKey_Right,
+  eTuiKey_PageUp,
+  eTuiKey_PageDown,
+  eTuiKey_Home,
+  eTuiKey_End,
+};
+
+struct TuiState {
+  BriefTableState table;
+  TuiChartSeries charts[eTuiChart_COUNT];
+  size_t scroll;       // first line of the table on screen
+  int table_rows;      // lines that fit, set by tui_draw
+  bool editing_filter; // keys go to table.filter_text
+};
+
+void tui_init(TuiState &tui);
+// After every state update, before the old snapshot arena is destroyed
+void tui_update(TuiState &tui, State &state);
+// Parses one key of terminal input, returns the bytes used or 0 when `size`
+// bytes are not a whole key yet
+size_t tui_parse_key(const char *input, size_t size, int &key);
+// Returns false to quit
+bool tui_handle_key(TuiState &tui, State &state, int key);
+void tui_draw(TuiScreen &screen, TuiState &tui, const State &state);
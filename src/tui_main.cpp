@@ -0,0 +1,279 @@
+// prock-tui: the process table and system charts of prock in a terminal,
+// for machines without a display. Drawing is plain ANSI escape sequences, see
+// tui/screen.h, and the table is the one of the GUI, see tui/tui.h.
+
+#include "base.h"
+#include "sources/process_stat.h"
+#include "sources/sync.h"
+#include "state.h"
+#include "tui/screen.h"
+#include "tui/tui.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+// UNITY BUILD:
+#include "base.cpp"
+#include "self_stats.cpp"
+#include "sources/environ_reader.cpp"
+#include "sources/library_reader.cpp"
+#include "sources/process_stat.cpp"
+#include "sources/snapshot_codec.cpp"
+#include "sources/snapshot_file.cpp"
+#include "sources/socket_reader.cpp"
+#include "state.cpp"
+#include "tui/screen.cpp"
+#include "tui/tui.cpp"
+#include "views/brief_table_logic.cpp"
+
+static Sync g_sync;
+
+// Written by signal handlers and the gathering thread, wakes the main loop
+static int g_wake_fds[2] = {-1, -1};
+static volatile sig_atomic_t g_resized;
+
+static termios g_saved_termios;
+
+static void wake() {
+  const char byte = 0;
+  // Full pipe means a wake up is pending already
+  (void)!write(g_wake_fds[1], &byte, 1);
+}
+
+static void on_quit(int) {
+  g_sync.quit.store(true);
+  wake();
+}
+
+static void on_resize(int) {
+  g_resized = 1;
+  wake();
+}
+
+static void print_usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --period S       seconds between updates (default 1)\n"
+          "  --proc-root DIR  read procfs from DIR instead of /proc\n"
+          "  -h, --help       show this help\n"
+          "\n"
+          "Keys: arrows or j/k select, PgUp/PgDn/Home/End scroll, < > sort\n"
+          "column, r reverse, P/M/N sort by CPU/memory/PID, t tree,\n"
+          "/ filter, Esc clear filter, q quit\n",
+          argv0);
+}
+
+static bool parse_args(float &period, const int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      print_usage(argv[0]);
+      return false;
+    }
+    if (strcmp(arg, "--period") == 0 && i + 1 < argc) {
+      period = strtof(argv[++i], nullptr);
+      if (period <= 0.0f) {
+        fprintf(stderr, "--period must be positive\n");
+        return false;
+      }
+      continue;
+    }
+    if (strcmp(arg, "--proc-root") == 0 && i + 1 < argc) {
+      g_proc_root = argv[++i];
+      continue;
+    }
+    fprintf(stderr, "Unknown argument: %s\n", arg);
+    print_usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+static void write_all(const String &text) {
+  size_t done = 0;
+  while (done < text.length) {
+    const ssize_t written = write(STDOUT_FILENO, text.data + done,
+                                  text.length - done);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return;
+    done += static_cast<size_t>(written);
+  }
+}
+
+static void write_str(const char *text) {
+  write_all({const_cast<char *>(text), strlen(text)});
+}
+
+// Raw input without echo, Ctrl-C still raises SIGINT. Alternate screen and
+// hidden cursor until terminal_restore.
+static bool terminal_setup() {
+  if (tcgetattr(STDIN_FILENO, &g_saved_termios) != 0) {
+    perror("tcgetattr");
+    return false;
+  }
+  termios raw = g_saved_termios;
+  raw.c_iflag &= ~(IXON | ICRNL | INLCR | ISTRIP);
+  raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+  raw.c_cc[VMIN] = 0;
+  raw.c_cc[VTIME] = 0;
+  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0) {
+    perror("tcsetattr");
+    return false;
+  }
+  write_str("\x1b[?1049h\x1b[?25l");
+  return true;
+}
+
+static void terminal_restore() {
+  write_str("\x1b[0m\x1b[?25h\x1b[?1049l");
+  tcsetattr(STDIN_FILENO, TCSAFLUSH, &g_saved_termios);
+}
+
+static void terminal_size(TuiScreen &screen) {
+  winsize size = {};
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0) {
+    size.ws_col = 80;
+    size.ws_row = 24;
+  }
+  tui_screen_resize(screen, size.ws_col, size.ws_row);
+}
+
+// The table copies what it keeps of the old lines, so the old arena goes
+// after tui_update
+static void apply_snapshot(TuiState &tui, State &state,
+                           const UpdateSnapshot &snapshot) {
+  ZoneScoped;
+  BumpArena old_arena = state_apply_snapshot(state, snapshot);
+  tui_update(tui, state);
+  old_arena.destroy();
+}
+
+// Returns false to quit
+static bool read_keys(TuiState &tui, State &state, char *input,
+                      size_t &input_size, const size_t capacity) {
+  const ssize_t got =
+      read(STDIN_FILENO, input + input_size, capacity - input_size);
+  if (got == 0) return false;
+  if (got < 0) return errno == EINTR || errno == EAGAIN;
+  input_size += static_cast<size_t>(got);
+
+  size_t used = 0;
+  while (used < input_size) {
+    int key = eTuiKey_None;
+    const size_t size = tui_parse_key(input + used, input_size - used, key);
+    if (size == 0) break;
+    used += size;
+    if (!tui_handle_key(tui, state, key)) return false;
+  }
+  // A partial escape sequence waits for the rest, a full buffer is garbage
+  if (used == 0 && input_size == capacity) used = input_size;
+  memmove(input, input + used, input_size - used);
+  input_size -= used;
+  return true;
+}
+
+static void run(TuiState &tui, State &state, Sync &sync) {
+  TuiScreen screen = {};
+  terminal_size(screen);
+  char input[64];
+  size_t input_size = 0;
+
+  while (!sync.quit.load()) {
+    if (g_resized) {
+      g_resized = 0;
+      terminal_size(screen);
+    }
+
+    tui_draw(screen, tui, state);
+    write_all(tui_screen_flush(screen));
+
+    pollfd fds[2] = {};
+    fds[0] = {STDIN_FILENO, POLLIN, 0};
+    fds[1] = {g_wake_fds[0], POLLIN, 0};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      perror("poll");
+      break;
+    }
+
+    if (fds[1].revents != 0) {
+      char drain[64];
+      while (read(g_wake_fds[0], drain, sizeof(drain)) > 0) {
+      }
+      UpdateSnapshot snapshot = {};
+      while (sync.update_queue.pop(snapshot)) {
+        apply_snapshot(tui, state, snapshot);
+      }
+    }
+
+    if (fds[0].revents != 0 &&
+        !read_keys(tui, state, input, input_size, sizeof(input))) {
+      break;
+    }
+  }
+  tui_screen_destroy(screen);
+}
+
+int main(int argc, char **argv) {
+  float period = 1.0f;
+  if (!parse_args(period, argc, argv)) {
+    return 1;
+  }
+  if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) {
+    fprintf(stderr, "prock-tui needs a terminal, see prock-collect for "
+                    "headless recording\n");
+    return 1;
+  }
+
+  State state = {};
+  if (!state_init(state)) {
+    return 1;
+  }
+  if (pipe2(g_wake_fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+    perror("pipe2");
+    return 1;
+  }
+  if (!terminal_setup()) {
+    return 1;
+  }
+  signal(SIGINT, on_quit);
+  signal(SIGTERM, on_quit);
+  signal(SIGWINCH, on_resize);
+
+  TuiState tui;
+  tui_init(tui);
+
+  Sync &sync = g_sync;
+  sync.update_period.store(period);
+  std::thread gathering_thread{[&sync] {
+    set_thread_name("gathering");
+    GatheringState gathering_state = {};
+    while (!sync.quit.load()) {
+      gather(gathering_state, sync);
+      wake();
+    }
+  }};
+
+  run(tui, state, sync);
+
+  sync.quit.store(true);
+  sync.quit_cv.notify_one();
+  gathering_thread.join();
+  terminal_restore();
+
+  UpdateSnapshot snapshot = {};
+  while (sync.update_queue.pop(snapshot)) {
+    snapshot.owner_arena.destroy();
+  }
+  state.snapshot_arena.destroy();
+  return 0;
+}
@@ -32,18 +32,22 @@ static constexpr ImU32 DEAD_PROCESS_COLOR = IM_COL32(180, 50, 50, 60);
 const char *PROCESS_COPY_HEADER =
     "PID\tName\tState\tThreads\tCPU Total\tCPU User\tCPU Kernel\tRSS "
     "(KB)\tVirt (KB)\tI/O Read (KB/s)\tI/O Write (KB/s)\tNet Recv (KB/s)\tNet "
-    "Send (KB/s)\n";
+    "Send (KB/s)\tRun Delay\tCtx Switches/s\tFaults/s\tPeak RSS (KB)\tSwap "
+    "(KB)\tCPUs Allowed\n";
 
 static void open_all_windows(const int pid, const char *comm,
-                             ViewState &view_state) {
+                             ViewState &view_state, const State &state) {
   const ImGuiID dock_id =
       process_host_open(view_state.process_host_state, pid, comm);
   if (dock_id == 0) return;
   constexpr ProcessWindowFlags no_focus = eProcessWindowFlags_NoFocusOnAppearing;
-  cpu_chart_add(view_state.cpu_chart_state, pid, comm, dock_id);
-  mem_chart_add(view_state.mem_chart_state, pid, comm, dock_id, no_focus);
-  io_chart_add(view_state.io_chart_state, pid, comm, dock_id, no_focus);
-  net_chart_add(view_state.net_chart_state, pid, comm, dock_id, no_focus);
+  cpu_chart_add(view_state.cpu_chart_state, state, pid, comm, dock_id);
+  mem_chart_add(view_state.mem_chart_state, state, pid, comm, dock_id,
+                no_focus);
+  io_chart_add(view_state.io_chart_state, state, pid, comm, dock_id,
+               no_focus);
+  net_chart_add(view_state.net_chart_state, state, pid, comm, dock_id,
+                no_focus);
   library_viewer_request(view_state.library_viewer_state, *view_state.sync, pid,
                          comm, dock_id, no_focus);
   environ_viewer_request(view_state.environ_viewer_state, *view_state.sync, pid,
@@ -56,24 +60,27 @@ static void open_all_windows(const int pid, const char *comm,
 
 static void copy_process_row(const BriefTableLine &line) {
   const ProcessDerivedStat &derived = line.derived_stat;
-  char buf[512];
+  char buf[1024];
   snprintf(buf, sizeof(buf),
            "%s%d\t%s\t%c\t%ld\t%.1f\t%.1f\t%.1f\t%.0f\t%.0f\t%.1f\t%.1f\t%.1f\t"
-           "%.1f",
+           "%.1f\t%.1f\t%.1f\t%.1f\t%.0f\t%.0f\t%lu",
            PROCESS_COPY_HEADER, line.pid, line.comm, line.state,
            line.num_threads, derived.cpu_user_perc + derived.cpu_kernel_perc,
            derived.cpu_user_perc, derived.cpu_kernel_perc,
            derived.mem_resident_bytes / 1024.0,
            derived.mem_virtual_bytes / 1024.0, derived.io_read_kb_per_sec,
            derived.io_write_kb_per_sec, derived.net_recv_kb_per_sec,
-           derived.net_send_kb_per_sec);
+           derived.net_send_kb_per_sec, derived.run_delay_perc,
+           derived.ctxsw_per_sec, derived.faults_per_sec,
+           derived.mem_peak_resident_bytes / 1024.0,
+           derived.mem_swap_bytes / 1024.0, line.cpus_allowed);
   ImGui::SetClipboardText(buf);
 }
 
 static void copy_all_processes(BumpArena &arena,
                                const BriefTableState &my_state) {
   // Header + all rows
-  const size_t buf_size = 256 + my_state.lines.size * 256;
+  const size_t buf_size = 512 + my_state.lines.size * 384;
   char *buf = arena.alloc_string(buf_size);
   char *ptr = buf;
   ptr += snprintf(ptr, buf_size, "%s", PROCESS_COPY_HEADER);
@@ -83,19 +90,24 @@ static void copy_all_processes(BumpArena &arena,
     const ProcessDerivedStat &derived = line.derived_stat;
     ptr += snprintf(ptr, buf_size - (ptr - buf),
                     "%d\t%s\t%c\t%ld\t%.1f\t%.1f\t%.1f\t%.0f\t%.0f\t%.1f\t%."
-                    "1f\t%.1f\t%.1f\n",
+                    "1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.0f\t%.0f\t%lu\n",
                     line.pid, line.comm, line.state, line.num_threads,
                     derived.cpu_user_perc + derived.cpu_kernel_perc,
                     derived.cpu_user_perc, derived.cpu_kernel_perc,
                     derived.mem_resident_bytes / 1024.0,
                     derived.mem_virtual_bytes / 1024.0,
                     derived.io_read_kb_per_sec, derived.io_write_kb_per_sec,
-                    derived.net_recv_kb_per_sec, derived.net_send_kb_per_sec);
+                    derived.net_recv_kb_per_sec, derived.net_send_kb_per_sec,
+                    derived.run_delay_perc, derived.ctxsw_per_sec,
+                    derived.faults_per_sec,
+                    derived.mem_peak_resident_bytes / 1024.0,
+                    derived.mem_swap_bytes / 1024.0, line.cpus_allowed);
   }
   ImGui::SetClipboardText(buf);
 }
 
 static void table_context_menu_draw(FrameContext &ctx, ViewState &view_state,
+                                    const State &state,
                                     BriefTableState &my_state,
                                     const BriefTableLine &line,
                                     const char *label) {
@@ -110,16 +122,16 @@ static void table_context_menu_draw(FrameContext &ctx, ViewState &view_state,
     }
     ImGui::Separator();
     if (ImGui::MenuItem("CPU Chart")) {
-      cpu_chart_add(view_state.cpu_chart_state, pid, line.comm);
+      cpu_chart_add(view_state.cpu_chart_state, state, pid, line.comm);
     }
     if (ImGui::MenuItem("Memory Chart")) {
-      mem_chart_add(view_state.mem_chart_state, pid, line.comm);
+      mem_chart_add(view_state.mem_chart_state, state, pid, line.comm);
     }
     if (ImGui::MenuItem("I/O Chart")) {
-      io_chart_add(view_state.io_chart_state, pid, line.comm);
+      io_chart_add(view_state.io_chart_state, state, pid, line.comm);
     }
     if (ImGui::MenuItem("Network Chart")) {
-      net_chart_add(view_state.net_chart_state, pid, line.comm);
+      net_chart_add(view_state.net_chart_state, state, pid, line.comm);
     }
     if (ImGui::MenuItem("Show Loaded Libraries")) {
       library_viewer_request(view_state.library_viewer_state, *view_state.sync,
@@ -168,25 +180,7 @@ static void compute_filter_visibility(BriefTableState &my_state,
   }
 
   // Second pass (tree mode only): propagate visibility to ancestors
-  // Iterate in REVERSE - in reverse DFS order, a shallower depth after a
-  // deeper visible node means this node is an ancestor of that visible node
-  if (my_state.tree_mode) {
-    int last_visible_depth = -1;
-    for (size_t i = my_state.lines.size; i-- > 0;) {
-      BriefTableLine &line = my_state.lines.data[i];
-      const int depth = line.tree_depth;
-
-      // If at shallower depth than last visible, this is an ancestor
-      if (depth < last_visible_depth && line.filter_state == 0) {
-        line.filter_state = 2; // ancestor
-      }
-
-      // Track depth of visible nodes
-      if (line.filter_state != 0) {
-        last_visible_depth = depth;
-      }
-    }
-  }
+  mark_brief_table_filter_ancestors(my_state);
 }
 
 static void data_columns_draw(const BriefTableLine &line) {
@@ -234,6 +228,29 @@ static void data_columns_draw(const BriefTableLine &line) {
   if (ImGui::TableSetColumnIndex(eBriefTableColumnId_NetSendKbPerSec))
     ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%.1f",
                        derived_stat.net_send_kb_per_sec);
+  if (ImGui::TableSetColumnIndex(eBriefTableColumnId_RunDelayPerc))
+    ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%.1f",
+                       derived_stat.run_delay_perc);
+  if (ImGui::TableSetColumnIndex(eBriefTableColumnId_CtxswPerSec))
+    ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%.0f",
+                       derived_stat.ctxsw_per_sec);
+  if (ImGui::TableSetColumnIndex(eBriefTableColumnId_FaultsPerSec))
+    ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%.0f",
+                       derived_stat.faults_per_sec);
+  if (ImGui::TableSetColumnIndex(eBriefTableColumnId_MemPeakRssBytes)) {
+    char buf[32];
+    format_memory_bytes(derived_stat.mem_peak_resident_bytes, buf,
+                        sizeof(buf));
+    ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%s", buf);
+  }
+  if (ImGui::TableSetColumnIndex(eBriefTableColumnId_MemSwapBytes)) {
+    char buf[32];
+    format_memory_bytes(derived_stat.mem_swap_bytes, buf, sizeof(buf));
+    ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%s", buf);
+  }
+  if (ImGui::TableSetColumnIndex(eBriefTableColumnId_CpusAllowed))
+    ImGui::TextAligned(1.0f, ImGui::GetColumnWidth(), "%lu",
+                       line.cpus_allowed);
 }
 
 void brief_table_draw(FrameContext &ctx, ViewState &view_state,
@@ -306,12 +323,42 @@ void brief_table_draw(FrameContext &ctx, ViewState &view_state,
                             ImGuiTableColumnFlags_PreferSortDescending |
                                 ImGuiTableColumnFlags_DefaultHide,
                             0.0f, eBriefTableColumnId_NetSendKbPerSec);
+    ImGui::TableSetupColumn("Run Delay (%)",
+                            ImGuiTableColumnFlags_PreferSortDescending, 0.0f,
+                            eBriefTableColumnId_RunDelayPerc);
+    ImGui::TableSetupColumn("Ctx Switches/s",
+                            ImGuiTableColumnFlags_PreferSortDescending |
+                                ImGuiTableColumnFlags_DefaultHide,
+                            0.0f, eBriefTableColumnId_CtxswPerSec);
+    ImGui::TableSetupColumn("Faults/s",
+                            ImGuiTableColumnFlags_PreferSortDescending |
+                                ImGuiTableColumnFlags_DefaultHide,
+                            0.0f, eBriefTableColumnId_FaultsPerSec);
+    ImGui::TableSetupColumn("Peak RSS (Bytes)",
+                            ImGuiTableColumnFlags_PreferSortDescending |
+                                ImGuiTableColumnFlags_DefaultHide,
+                            0.0f, eBriefTableColumnId_MemPeakRssBytes);
+    ImGui::TableSetupColumn("Swap (Bytes)",
+                            ImGuiTableColumnFlags_PreferSortDescending |
+                                ImGuiTableColumnFlags_DefaultHide,
+                            0.0f, eBriefTableColumnId_MemSwapBytes);
+    ImGui::TableSetupColumn("CPUs Allowed", ImGuiTableColumnFlags_DefaultHide,
+                            0.0f, eBriefTableColumnId_CpusAllowed);
     if (reset_sort_to_pid) {
       ImGui::TableSetColumnSortDirection(eBriefTableColumnId_Pid,
                                          ImGuiSortDirection_Ascending, false);
     }
     ImGui::TableHeadersRow();
 
+    my_state.status_shown = false;
+    for (const BriefTableColumnId id :
+         {eBriefTableColumnId_CtxswPerSec, eBriefTableColumnId_MemPeakRssBytes,
+          eBriefTableColumnId_MemSwapBytes, eBriefTableColumnId_CpusAllowed}) {
+      if (ImGui::TableGetColumnFlags(id) & ImGuiTableColumnFlags_IsEnabled) {
+        my_state.status_shown = true;
+      }
+    }
+
     if (ImGuiTableSortSpecs *sort_specs = ImGui::TableGetSortSpecs()) {
       if (sort_specs->SpecsDirty) {
         my_state.sorted_by =
@@ -419,9 +466,9 @@ void brief_table_draw(FrameContext &ctx, ViewState &view_state,
         }
         if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0) &&
             !ImGui::IsItemToggledOpen()) {
-          open_all_windows(line.pid, line.comm, view_state);
+          open_all_windows(line.pid, line.comm, view_state, state);
         }
-        table_context_menu_draw(ctx, view_state, my_state, line, label);
+        table_context_menu_draw(ctx, view_state, state, my_state, line, label);
         data_columns_draw(line);
 
         if (node_open && has_children) {
@@ -442,10 +489,10 @@ void brief_table_draw(FrameContext &ctx, ViewState &view_state,
         }
 
         if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
-          open_all_windows(line.pid, line.comm, view_state);
+          open_all_windows(line.pid, line.comm, view_state, state);
         }
 
-        table_context_menu_draw(ctx, view_state, my_state, line, label);
+        table_context_menu_draw(ctx, view_state, state, my_state, line, label);
         data_columns_draw(line);
       }
 
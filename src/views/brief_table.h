@@ -24,6 +24,12 @@ enum BriefTableColumnId {
   eBriefTableColumnId_IoWriteKbPerSec,
   eBriefTableColumnId_NetRecvKbPerSec,
   eBriefTableColumnId_NetSendKbPerSec,
+  eBriefTableColumnId_RunDelayPerc,
+  eBriefTableColumnId_CtxswPerSec,
+  eBriefTableColumnId_FaultsPerSec,
+  eBriefTableColumnId_MemPeakRssBytes,
+  eBriefTableColumnId_MemSwapBytes,
+  eBriefTableColumnId_CpusAllowed,
   eBriefTableColumnId_Count,
 };
 
@@ -33,6 +39,7 @@ struct BriefTableLine {
   const char *comm;
   char state;
   long num_threads;
+  ulong cpus_allowed;
 
   ProcessDerivedStat derived_stat;
 
@@ -50,6 +57,7 @@ struct BriefTableState {
   char kill_error[128];
   bool tree_mode; // Toggle: false = flat, true = tree
   char filter_text[256];
+  bool status_shown; // a column from /proc/[pid]/status is visible
 };
 
 void brief_table_update(BriefTableState &my_state, State &state);
@@ -62,3 +70,6 @@ size_t binary_search_pid(const Array<ProcessStat> &stats, int pid);
 
 void sort_brief_table_lines(BriefTableState &my_state);
 void sort_brief_table_tree(BriefTableState &my_state, BumpArena &arena);
+// Tree mode: hidden ancestors of matching lines get filter_state 2, after
+// filter_state is set to 1 for every matching line
+void mark_brief_table_filter_ancestors(BriefTableState &my_state);
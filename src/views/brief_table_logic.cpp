@@ -56,6 +56,22 @@ static bool table_line_is_less(const BriefTableColumnId sorted_by,
   case eBriefTableColumnId_NetSendKbPerSec:
     return left.derived_stat.net_send_kb_per_sec <
            right.derived_stat.net_send_kb_per_sec;
+  case eBriefTableColumnId_RunDelayPerc:
+    return left.derived_stat.run_delay_perc <
+           right.derived_stat.run_delay_perc;
+  case eBriefTableColumnId_CtxswPerSec:
+    return left.derived_stat.ctxsw_per_sec < right.derived_stat.ctxsw_per_sec;
+  case eBriefTableColumnId_FaultsPerSec:
+    return left.derived_stat.faults_per_sec <
+           right.derived_stat.faults_per_sec;
+  case eBriefTableColumnId_MemPeakRssBytes:
+    return left.derived_stat.mem_peak_resident_bytes <
+           right.derived_stat.mem_peak_resident_bytes;
+  case eBriefTableColumnId_MemSwapBytes:
+    return left.derived_stat.mem_swap_bytes <
+           right.derived_stat.mem_swap_bytes;
+  case eBriefTableColumnId_CpusAllowed:
+    return left.cpus_allowed < right.cpus_allowed;
   case eBriefTableColumnId_Count:
     return false;
   }
@@ -145,6 +161,27 @@ void sort_brief_table_tree(BriefTableState &my_state, BumpArena &arena) {
   my_state.lines.size = sorted_idx;
 }
 
+void mark_brief_table_filter_ancestors(BriefTableState &my_state) {
+  if (!my_state.tree_mode) return;
+  // Iterate in REVERSE - in reverse DFS order, a shallower depth after a
+  // deeper visible node means this node is an ancestor of that visible node
+  int last_visible_depth = -1;
+  for (size_t i = my_state.lines.size; i-- > 0;) {
+    BriefTableLine &line = my_state.lines.data[i];
+    const int depth = line.tree_depth;
+
+    // If at shallower depth than last visible, this is an ancestor
+    if (depth < last_visible_depth && line.filter_state == 0) {
+      line.filter_state = 2; // ancestor
+    }
+
+    // Track depth of visible nodes
+    if (line.filter_state != 0) {
+      last_visible_depth = depth;
+    }
+  }
+}
+
 void sort_brief_table_lines(BriefTableState &my_state) {
   sort_flat(my_state);
 }
@@ -157,6 +194,7 @@ static void brief_table_line_init(BriefTableLine &new_line,
   new_line.comm = stat.comm;
   new_line.state = stat.state;
   new_line.num_threads = stat.num_threads;
+  new_line.cpus_allowed = stat.status.cpus_allowed;
 
   new_line.derived_stat = derived_stat;
   new_line.filter_state = 0;
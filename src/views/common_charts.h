@@ -9,6 +9,8 @@
 constexpr const char *TITLE_TOTAL = "Total";
 constexpr const char *TITLE_KERNEL = "Kernel";
 constexpr const char *TITLE_INTERRUPTS = "Interrupts";
+constexpr const char *TITLE_RUN_DELAY = "Run delay";
+constexpr const char *TITLE_CTXSW = "Context switches/s";
 
 // IO chart titles
 constexpr const char *TITLE_READ = "Read";
@@ -17,6 +19,10 @@ constexpr const char *TITLE_WRITE = "Write";
 // Memory chart titles
 constexpr const char *TITLE_USED = "Used";
 constexpr const char *TITLE_AVAILABLE = "Available";
+constexpr const char *TITLE_PEAK = "Peak";
+constexpr const char *TITLE_SWAP = "Swap";
+constexpr const char *TITLE_FAULTS = "Faults/s";
+constexpr const char *TITLE_MAJOR_FAULTS = "Major faults/s";
 
 // Net chart titles
 constexpr const char *TITLE_RECV = "Recv";
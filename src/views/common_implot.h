@@ -1,8 +1,14 @@
 #pragma once
 
 #include "base.h"
+#include "history.h"
+#include "sources/annotations.h"
 #include "imgui.h"
 #include "implot.h"
+#include "implot_internal.h"
+
+#include <algorithm>
+#include <cmath>
 
 inline void chart_add_tooltip(const char *title, const char *tooltip) {
   if (ImPlot::IsLegendEntryHovered(title)) {
@@ -21,13 +27,13 @@ inline void push_fill_alpha(const float val = 0.25f) {
 }
 inline void pop_fill_alpha() { ImPlot::PopStyleVar(); }
 
-inline void setup_chart(const GrowingArray<double> &times,
+inline void setup_chart(const HistoryTimeline &timeline,
                         const ImPlotFormatter y_formatter) {
   ImPlot::SetupAxes("Time", nullptr, ImPlotAxisFlags_AutoFit);
 
   ImPlot::SetupAxisScale(ImAxis_X1, ImPlotScale_Time);
 
-  const double last = times.last_or(0);
+  const double last = timeline.times[0].last_or(0);
   const double range_start = last - 60;
   ImPlot::SetupAxisFitConstraints(ImAxis_X1, range_start, last);
 
@@ -36,3 +42,65 @@ inline void setup_chart(const GrowingArray<double> &times,
 
   ImPlot::SetupMouseText(ImPlotLocation_NorthEast);
 }
+
+// A per second rate on a Y axis of its own on the right, its lines are
+// plotted between ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2) and back to Y1.
+// Must be called with the rest of the setup.
+inline void setup_rate_axis() {
+  ImPlot::SetupAxis(ImAxis_Y2, "/s",
+                    ImPlotAxisFlags_AuxDefault | ImPlotAxisFlags_AutoFit);
+  ImPlot::SetupAxisLimitsConstraints(ImAxis_Y2, 0, HUGE_VAL);
+}
+
+// Selects history points for the current plot, must be called after setup.
+// An auto-following X axis is fitted to the plotted points, so everything up
+// to the newest sample is kept then.
+inline HistoryView chart_history_view(const HistoryTimeline &timeline) {
+  const ImPlotRect limits = ImPlot::GetPlotLimits();
+  const ImPlotAxis &x_axis = ImPlot::GetCurrentPlot()->Axes[ImAxis_X1];
+  const double x_max = x_axis.IsAutoFitting() ? HUGE_VAL : limits.X.Max;
+  const double width = std::max(1.0f, ImPlot::GetPlotSize().x);
+  return history_view(timeline, limits.X.Min, x_max, limits.X.Size() / width);
+}
+
+inline void plot_line(const char *label, const HistoryView &view,
+                      HistorySeries &series) {
+  const HistoryDecimated &line =
+      history_decimate(series, view, eHistoryDecimation_MinMax);
+  ImPlot::PlotLine(label, line.xs, line.ys, static_cast<int>(line.count));
+}
+
+// Shaded up to the column maximum so short peaks stay visible
+inline void plot_shaded(const char *label, const HistoryView &view,
+                        HistorySeries &series) {
+  const HistoryDecimated &shade =
+      history_decimate(series, view, eHistoryDecimation_Max);
+  ImPlot::PlotShaded(label, shade.xs, shade.ys, static_cast<int>(shade.count));
+}
+
+// Vertical markers of external events (see sources/annotations.h) with the
+// label in a tag on the time axis, `pid` is 0 for system charts. Must be
+// called after setup.
+inline void plot_annotations(const int pid) {
+  static constexpr ImVec4 COLOR = {1.0f, 0.6f, 0.2f, 0.8f};
+  const ImPlotRect limits = ImPlot::GetPlotLimits();
+  double xs[ANNOTATION_CAPACITY];
+  const Annotation *hovered = nullptr;
+  const bool plot_hovered = ImPlot::IsPlotHovered();
+  const float mouse_x = ImGui::GetMousePos().x;
+  int count = 0;
+  annotations_for_each(
+      g_annotations, pid, limits.X.Min, limits.X.Max,
+      [&](const Annotation &annotation) {
+        xs[count++] = annotation.time;
+        ImPlot::TagX(annotation.time, COLOR, "%s", annotation.label);
+        const float x = ImPlot::PlotToPixels(annotation.time, 0).x;
+        if (plot_hovered && std::abs(x - mouse_x) < 4) hovered = &annotation;
+      });
+  if (count == 0) return;
+  ImPlot::SetNextLineStyle(COLOR);
+  ImPlot::PlotInfLines("##Annotations", xs, count);
+  if (hovered) {
+    ImGui::SetTooltip("%s", hovered->label);
+  }
+}
@@ -13,6 +13,18 @@
 
 #include <cmath>
 
+static void cpu_chart_push(CpuChartData &chart, const double at,
+                           const ProcessDerivedStat &derived) {
+  history_push(chart.cpu_kernel_perc, g_history.timeline, at,
+               derived.cpu_kernel_perc);
+  history_push(chart.cpu_total_perc, g_history.timeline, at,
+               derived.cpu_kernel_perc + derived.cpu_user_perc);
+  history_push(chart.run_delay_perc, g_history.timeline, at,
+               derived.run_delay_perc);
+  history_push(chart.ctxsw_per_sec, g_history.timeline, at,
+               derived.ctxsw_per_sec);
+}
+
 void cpu_chart_update(CpuChartState &my_state, const State &state) {
   const double update_at = std::chrono::duration_cast<Seconds>(
                                state.update_system_time.time_since_epoch())
@@ -22,14 +34,7 @@ void cpu_chart_update(CpuChartState &my_state, const State &state) {
       my_state.charts, state,
       [&](CpuChartData &chart, const ProcessStat & /*stat*/,
           const ProcessDerivedStat &derived) {
-        *chart.times.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-            update_at;
-        *chart.cpu_kernel_perc.emplace_back(my_state.cur_arena,
-                                            my_state.wasted_bytes) =
-            derived.cpu_kernel_perc;
-        *chart.cpu_total_perc.emplace_back(my_state.cur_arena,
-                                           my_state.wasted_bytes) =
-            derived.cpu_kernel_perc + derived.cpu_user_perc;
+        cpu_chart_push(chart, update_at, derived);
       });
 
   if (my_state.wasted_bytes > SLAB_SIZE) {
@@ -37,12 +42,6 @@ void cpu_chart_update(CpuChartState &my_state, const State &state) {
     BumpArena new_arena = BumpArena::create();
 
     my_state.charts.realloc(new_arena);
-    for (size_t i = 0; i < my_state.charts.size(); ++i) {
-      CpuChartData &chart = my_state.charts.data()[i];
-      chart.times.realloc(new_arena);
-      chart.cpu_total_perc.realloc(new_arena);
-      chart.cpu_kernel_perc.realloc(new_arena);
-    }
 
     my_state.cur_arena = new_arena;
     my_state.wasted_bytes = 0;
@@ -72,29 +71,36 @@ void cpu_chart_draw(ViewState &view_state) {
       push_fit_with_padding();
       if (ImPlot::BeginPlot("CPU Usage", ImVec2(-1, -1),
                             ImPlotFlags_Crosshairs)) {
-        setup_chart(chart.times, format_percent);
+        setup_chart(g_history.timeline, format_percent);
+        setup_rate_axis();
         const int num_cores = view_state.system_cpu_chart_state.num_cores;
         ImPlot::SetupAxisLimits(ImAxis_Y1, 0, std::max(1, num_cores) * 100,
                                 ImPlotCond_Once);
+        const HistoryView view = chart_history_view(g_history.timeline);
 
         push_fill_alpha();
-        ImPlot::PlotShaded(TITLE_TOTAL, chart.times.data(),
-                           chart.cpu_total_perc.data(),
-                           chart.cpu_total_perc.size());
-        ImPlot::PlotShaded(TITLE_KERNEL, chart.times.data(),
-                           chart.cpu_kernel_perc.data(),
-                           chart.cpu_kernel_perc.size());
+        plot_shaded(TITLE_TOTAL, view, chart.cpu_total_perc);
+        plot_shaded(TITLE_KERNEL, view, chart.cpu_kernel_perc);
         pop_fill_alpha();
 
-        ImPlot::PlotLine(TITLE_KERNEL, chart.times.data(),
-                         chart.cpu_kernel_perc.data(),
-                         chart.cpu_kernel_perc.size());
-        ImPlot::PlotLine(TITLE_TOTAL, chart.times.data(),
-                         chart.cpu_total_perc.data(),
-                         chart.cpu_total_perc.size());
-
-        chart_add_tooltip(TITLE_TOTAL, "utime + stime from /proc/[pid]/stat");
-        chart_add_tooltip(TITLE_KERNEL, "stime from /proc/[pid]/stat");
+        plot_line(TITLE_KERNEL, view, chart.cpu_kernel_perc);
+        plot_line(TITLE_TOTAL, view, chart.cpu_total_perc);
+        plot_line(TITLE_RUN_DELAY, view, chart.run_delay_perc);
+        ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+        plot_line(TITLE_CTXSW, view, chart.ctxsw_per_sec);
+        ImPlot::SetAxes(ImAxis_X1, ImAxis_Y1);
+
+        chart_add_tooltip(TITLE_TOTAL,
+                          "on-CPU time from /proc/[pid]/task/*/schedstat, "
+                          "utime + stime from /proc/[pid]/stat without it");
+        chart_add_tooltip(TITLE_KERNEL, "stime share from /proc/[pid]/stat");
+        chart_add_tooltip(TITLE_RUN_DELAY,
+                          "run queue wait from /proc/[pid]/task/*/schedstat, "
+                          "runnable but not on a CPU");
+        chart_add_tooltip(TITLE_CTXSW,
+                          "voluntary + nonvoluntary from /proc/[pid]/status");
+
+        plot_annotations(chart.pid);
 
         ImPlot::EndPlot();
       }
@@ -107,16 +113,18 @@ void cpu_chart_draw(ViewState &view_state) {
     if (should_be_opened) {
       ++last;
     } else {
-      my_state.wasted_bytes += chart.times.total_byte_size();
-      my_state.wasted_bytes += chart.cpu_total_perc.total_byte_size();
-      my_state.wasted_bytes += chart.cpu_kernel_perc.total_byte_size();
+      history_destroy(chart.cpu_kernel_perc);
+      history_destroy(chart.cpu_total_perc);
+      history_destroy(chart.run_delay_perc);
+      history_destroy(chart.ctxsw_per_sec);
+      my_state.wasted_bytes += sizeof(chart);
     }
   }
   my_state.charts.shrink_to(last);
 }
 
-void cpu_chart_add(CpuChartState &my_state, const int pid, const char *comm,
-                   const ImGuiID dock_id) {
+void cpu_chart_add(CpuChartState &my_state, const State &state,
+                   const int pid, const char *comm, const ImGuiID dock_id) {
   if (process_window_focus(my_state.charts, pid)) {
     return;
   }
@@ -128,5 +136,10 @@ void cpu_chart_add(CpuChartState &my_state, const int pid, const char *comm,
   data.flags |= eProcessWindowFlags_RedockRequested;
   snprintf(data.label, sizeof(data.label), "CPU Usage: %s (%d)", comm, pid);
 
+  process_recorder_replay(
+      state.recorder, pid, [&](const double at, const ProcessDerivedStat &d) {
+        cpu_chart_push(data, at, d);
+      });
+
   common_views_sort_added(my_state.charts);
 }
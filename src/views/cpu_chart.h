@@ -1,5 +1,6 @@
 #pragma once
 
+#include "history.h"
 #include "process_window_flags.h"
 
 struct CpuChartData {
@@ -7,9 +8,10 @@ struct CpuChartData {
   ImGuiID dock_id;
   ProcessWindowFlags flags;
   char label[128];
-  GrowingArray<double> times;
-  GrowingArray<double> cpu_kernel_perc;
-  GrowingArray<double> cpu_total_perc;
+  HistorySeries cpu_kernel_perc;
+  HistorySeries cpu_total_perc;
+  HistorySeries run_delay_perc;
+  HistorySeries ctxsw_per_sec;
 };
 
 struct CpuChartState {
@@ -21,5 +23,5 @@ struct CpuChartState {
 void cpu_chart_update(CpuChartState &my_state, const State &state);
 void cpu_chart_draw(ViewState &view_state);
 
-void cpu_chart_add(CpuChartState &my_state, int pid, const char *comm,
-                   ImGuiID dock_id = 0);
+void cpu_chart_add(CpuChartState &my_state, const State &state, int pid,
+                   const char *comm, ImGuiID dock_id = 0);
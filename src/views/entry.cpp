@@ -3,6 +3,7 @@
 #include "views/brief_table.h"
 #include "views/cpu_chart.h"
 #include "views/environ_viewer.h"
+#include "views/internals_window.h"
 #include "views/io_chart.h"
 #include "views/library_viewer.h"
 #include "views/mem_chart.h"
@@ -16,8 +17,37 @@
 #include "views/threads_viewer.h"
 #include "views/view_state.h"
 
+#include "history.h"
+#include "sources/sync.h"
+
 #include "tracy/Tracy.hpp"
 
+// Memory the views abandoned in their arenas when windows closed
+static void plot_wasted_bytes([[maybe_unused]] const ViewState &view_state) {
+  TracyPlot("Wasted bytes: process hosts",
+            static_cast<int64_t>(view_state.process_host_state.wasted_bytes));
+  TracyPlot("Wasted bytes: CPU charts",
+            static_cast<int64_t>(view_state.cpu_chart_state.wasted_bytes));
+  TracyPlot("Wasted bytes: memory charts",
+            static_cast<int64_t>(view_state.mem_chart_state.wasted_bytes));
+  TracyPlot("Wasted bytes: I/O charts",
+            static_cast<int64_t>(view_state.io_chart_state.wasted_bytes));
+  TracyPlot("Wasted bytes: network charts",
+            static_cast<int64_t>(view_state.net_chart_state.wasted_bytes));
+  TracyPlot(
+      "Wasted bytes: library viewers",
+      static_cast<int64_t>(view_state.library_viewer_state.wasted_bytes));
+  TracyPlot(
+      "Wasted bytes: environ viewers",
+      static_cast<int64_t>(view_state.environ_viewer_state.wasted_bytes));
+  TracyPlot(
+      "Wasted bytes: threads viewers",
+      static_cast<int64_t>(view_state.threads_viewer_state.wasted_bytes));
+  TracyPlot("Wasted bytes: socket viewers",
+            static_cast<int64_t>(view_state.socket_viewer_state.wasted_bytes));
+  TracyPlot("History KB", static_cast<int64_t>(g_history.used_bytes / 1024));
+}
+
 void views_update(ViewState &view_state, State &state) {
   ZoneScoped;
   brief_table_update(view_state.brief_table_state, state);
@@ -33,11 +63,13 @@ void views_update(ViewState &view_state, State &state) {
   environ_viewer_update(view_state.environ_viewer_state, *view_state.sync);
   threads_viewer_update(view_state.threads_viewer_state, state, *view_state.sync);
   socket_viewer_update(view_state.socket_viewer_state, *view_state.sync);
+  history_enforce_budget();
+  plot_wasted_bytes(view_state);
 }
 
 void views_draw(FrameContext &ctx, ViewState &view_state, const State &state) {
   ZoneScoped;
-  menu_bar_draw(view_state);
+  menu_bar_draw(view_state, state);
   brief_table_draw(ctx, view_state, state);
   process_host_draw(view_state);
   cpu_chart_draw(view_state);
@@ -52,6 +84,17 @@ void views_draw(FrameContext &ctx, ViewState &view_state, const State &state) {
   environ_viewer_draw(ctx, view_state);
   threads_viewer_draw(ctx, view_state, state);
   socket_viewer_draw(ctx, view_state);
+  internals_window_draw(view_state, state);
+
+  // Charts show ProcessStatus fields too, all of them are read on every
+  // gather only while something shows them
+  if (view_state.sync) {
+    view_state.sync->status_wanted.store(
+        view_state.brief_table_state.status_shown ||
+            view_state.cpu_chart_state.charts.size() > 0 ||
+            view_state.mem_chart_state.charts.size() > 0,
+        std::memory_order_relaxed);
+  }
 }
 
 void views_process_thread_snapshots(ViewState &view_state, const State &state,
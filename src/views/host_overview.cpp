@@ -0,0 +1,76 @@
+#include "host_overview.h"
+
+#include "views/common.h"
+
+#include "state.h"
+
+#include "imgui.h"
+#include "tracy/Tracy.hpp"
+
+void host_overview_draw(HostOverviewState &my_state,
+                        const HostOverviewRow *rows, const size_t count) {
+  ZoneScoped;
+  ImGui::SetNextWindowSize(ImVec2(900, 250), ImGuiCond_FirstUseEver);
+  if (!ImGui::Begin("Hosts", nullptr, COMMON_VIEW_FLAGS)) {
+    ImGui::End();
+    return;
+  }
+
+  constexpr ImGuiTableFlags table_flags =
+      ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV |
+      ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY;
+  if (ImGui::BeginTable("##Hosts", 8, table_flags)) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Host");
+    ImGui::TableSetupColumn("CPU");
+    ImGui::TableSetupColumn("Memory");
+    ImGui::TableSetupColumn("Disk Read");
+    ImGui::TableSetupColumn("Disk Write");
+    ImGui::TableSetupColumn("Net Recv");
+    ImGui::TableSetupColumn("Net Send");
+    ImGui::TableSetupColumn("Top Process");
+    ImGui::TableHeadersRow();
+
+    char buf[128];
+    for (size_t i = 0; i < count; ++i) {
+      const HostOverviewRow &row = rows[i];
+      const StateSummary summary = state_summary(*row.state);
+      ImGui::PushID(static_cast<int>(i));
+      ImGui::TableNextRow();
+
+      ImGui::TableNextColumn();
+      snprintf(buf, sizeof(buf), "%s%s", row.address,
+               row.connected ? "" : " (disconnected)");
+      if (ImGui::Selectable(buf, my_state.selected == i,
+                            ImGuiSelectableFlags_SpanAllColumns)) {
+        my_state.selected = i;
+      }
+
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f%%", summary.cpu_perc);
+      ImGui::TableNextColumn();
+      format_memory_kb(summary.mem_used_kb, buf, sizeof(buf), nullptr);
+      if (summary.mem_total_kb > 0) {
+        ImGui::Text("%s (%.0f%%)", buf,
+                    summary.mem_used_kb / summary.mem_total_kb * 100);
+      }
+      const double rates[] = {summary.disk_io_rate.read_mb_per_sec,
+                              summary.disk_io_rate.write_mb_per_sec,
+                              summary.net_io_rate.recv_mb_per_sec,
+                              summary.net_io_rate.send_mb_per_sec};
+      for (const double rate : rates) {
+        ImGui::TableNextColumn();
+        format_io_rate_mb(rate, buf, sizeof(buf), nullptr);
+        ImGui::TextUnformatted(buf);
+      }
+      ImGui::TableNextColumn();
+      if (summary.top_pid != 0) {
+        ImGui::Text("%s (%d) %.1f%%", summary.top_comm, summary.top_pid,
+                    summary.top_cpu_perc);
+      }
+      ImGui::PopID();
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+struct State;
+
+// A host of a fan-in, see sources/fan_in.h
+struct HostOverviewRow {
+  const char *address;
+  bool connected;
+  const State *state;
+};
+
+struct HostOverviewState {
+  size_t selected; // host drawn by the other views
+};
+
+void host_overview_draw(HostOverviewState &my_state,
+                        const HostOverviewRow *rows, size_t count);
@@ -0,0 +1,234 @@
+#include "internals_window.h"
+
+#include "views/common.h"
+#include "views/view_state.h"
+
+#include "history.h"
+#include "self_stats.h"
+#include "sources/sync.h"
+#include "state.h"
+
+#include "imgui.h"
+#include "tracy/Tracy.hpp"
+
+#include <algorithm>
+
+// Gathering thread CPU % is averaged over at least this long
+constexpr double CPU_SAMPLE_SECS = 1.0;
+
+static void draw_samples_row(const char *name, const SampleWindow &window) {
+  float samples[SELF_STATS_SAMPLES];
+  float sorted[SELF_STATS_SAMPLES];
+  const size_t count = window.copy(samples);
+  std::copy(samples, samples + count, sorted);
+  std::sort(sorted, sorted + count);
+
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+  ImGui::TextUnformatted(name);
+  for (const double p : {0.5, 0.99, 1.0}) {
+    ImGui::TableNextColumn();
+    ImGui::Text("%.2f",
+                static_cast<double>(sample_percentile(sorted, count, p)));
+  }
+  ImGui::TableNextColumn();
+  ImGui::PushID(name);
+  ImGui::PlotLines("##recent", samples, static_cast<int>(count), 0, nullptr,
+                   0.0f, FLT_MAX, ImVec2(-FLT_MIN, ImGui::GetFrameHeight()));
+  ImGui::PopID();
+}
+
+static bool begin_samples_table(const char *id) {
+  constexpr ImGuiTableFlags table_flags =
+      ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV;
+  if (!ImGui::BeginTable(id, 5, table_flags)) {
+    return false;
+  }
+  ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+  ImGui::TableSetupColumn("p50 ms", ImGuiTableColumnFlags_WidthFixed);
+  ImGui::TableSetupColumn("p99 ms", ImGuiTableColumnFlags_WidthFixed);
+  ImGui::TableSetupColumn("max ms", ImGuiTableColumnFlags_WidthFixed);
+  ImGui::TableSetupColumn("Last samples");
+  ImGui::TableHeadersRow();
+  return true;
+}
+
+// Spread of the total gather time over the last samples
+static void draw_gather_histogram() {
+  constexpr int BINS = 32;
+  float samples[SELF_STATS_SAMPLES];
+  const size_t count =
+      g_self_stats.gather_phases[eGatherPhase_Total].copy(samples);
+  if (count == 0) {
+    return;
+  }
+  const float max = *std::max_element(samples, samples + count);
+  float bins[BINS] = {};
+  for (size_t i = 0; i < count; ++i) {
+    const int bin =
+        max > 0.0f ? static_cast<int>(samples[i] / max * (BINS - 1)) : 0;
+    bins[bin] += 1.0f;
+  }
+  char overlay[64];
+  snprintf(overlay, sizeof(overlay), "0 - %.2f ms", static_cast<double>(max));
+  ImGui::PlotHistogram("##gather_histogram", bins, BINS, 0, overlay, 0.0f,
+                       FLT_MAX, ImVec2(-FLT_MIN, ImGui::GetFrameHeight() * 3));
+}
+
+static void draw_memory_row(const char *owner, const BumpArena &arena,
+                            const size_t wasted_bytes) {
+  char buf[32];
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+  ImGui::TextUnformatted(owner);
+  ImGui::TableNextColumn();
+  format_memory_bytes(static_cast<double>(arena.slab_bytes()), buf,
+                      sizeof(buf));
+  ImGui::TextUnformatted(buf);
+  ImGui::TableNextColumn();
+  format_memory_bytes(static_cast<double>(wasted_bytes), buf, sizeof(buf));
+  ImGui::TextUnformatted(buf);
+}
+
+static void draw_memory_total(const char *owner, const size_t bytes) {
+  char buf[32];
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+  ImGui::TextUnformatted(owner);
+  ImGui::TableNextColumn();
+  format_memory_bytes(static_cast<double>(bytes), buf, sizeof(buf));
+  ImGui::TextUnformatted(buf);
+  ImGui::TableNextColumn();
+}
+
+static size_t slab_cache_bytes() {
+  size_t res = g_slab_cache.size.load(std::memory_order_relaxed) * SLAB_SIZE;
+  for (size_t cls = 0; cls < LARGE_SLAB_CLASSES; ++cls) {
+    res += g_large_slab_caches[cls].size.load(std::memory_order_relaxed) *
+           (SLAB_SIZE << (cls + 1));
+  }
+  return res;
+}
+
+static void draw_memory(const ViewState &view_state, const State &state) {
+  constexpr ImGuiTableFlags table_flags =
+      ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV;
+  if (!ImGui::BeginTable("##Memory", 3, table_flags)) {
+    return;
+  }
+  ImGui::TableSetupColumn("Owner");
+  ImGui::TableSetupColumn("Arena");
+  ImGui::TableSetupColumn("Wasted");
+  ImGui::TableHeadersRow();
+
+  draw_memory_total("Snapshot", state.snapshot_arena.slab_bytes());
+  draw_memory_row("Process windows", view_state.process_host_state.cur_arena,
+                  view_state.process_host_state.wasted_bytes);
+  draw_memory_row("CPU charts", view_state.cpu_chart_state.cur_arena,
+                  view_state.cpu_chart_state.wasted_bytes);
+  draw_memory_row("Memory charts", view_state.mem_chart_state.cur_arena,
+                  view_state.mem_chart_state.wasted_bytes);
+  draw_memory_row("I/O charts", view_state.io_chart_state.cur_arena,
+                  view_state.io_chart_state.wasted_bytes);
+  draw_memory_row("Network charts", view_state.net_chart_state.cur_arena,
+                  view_state.net_chart_state.wasted_bytes);
+  draw_memory_row("Library viewers", view_state.library_viewer_state.cur_arena,
+                  view_state.library_viewer_state.wasted_bytes);
+  draw_memory_row("Environ viewers", view_state.environ_viewer_state.cur_arena,
+                  view_state.environ_viewer_state.wasted_bytes);
+  draw_memory_row("Threads viewers", view_state.threads_viewer_state.cur_arena,
+                  view_state.threads_viewer_state.wasted_bytes);
+  draw_memory_row("Socket viewers", view_state.socket_viewer_state.cur_arena,
+                  view_state.socket_viewer_state.wasted_bytes);
+  draw_memory_total("Chart history", g_history.used_bytes);
+  draw_memory_total("Process recorder",
+                    process_recorder_byte_size(state.recorder));
+  draw_memory_total("Slab cache", slab_cache_bytes());
+  ImGui::EndTable();
+  ImGui::TextDisabled("%zu slabs mapped so far",
+                      g_mapped_slabs.load(std::memory_order_relaxed));
+}
+
+static void update_cpu_perc(InternalsWindowState &my_state) {
+  const SteadyTimePoint now = SteadyClock::now();
+  const double elapsed = Seconds(now - my_state.cpu_at).count();
+  if (elapsed < CPU_SAMPLE_SECS) {
+    return;
+  }
+  const uint64_t cpu_ns =
+      g_self_stats.gathering_cpu_ns.load(std::memory_order_relaxed);
+  if (my_state.cpu_ns != 0 && cpu_ns >= my_state.cpu_ns) {
+    my_state.cpu_perc = static_cast<float>(
+        static_cast<double>(cpu_ns - my_state.cpu_ns) / 1e9 / elapsed * 100);
+  }
+  my_state.cpu_ns = cpu_ns;
+  my_state.cpu_at = now;
+}
+
+void internals_window_draw(ViewState &view_state, const State &state) {
+  ZoneScoped;
+  bool &open = view_state.preferences_state.show_internals;
+  g_self_stats.watching.store(open, std::memory_order_relaxed);
+  if (!open) {
+    return;
+  }
+
+  InternalsWindowState &my_state = view_state.internals_window_state;
+  ImGui::SetNextWindowSize(ImVec2(600, 700), ImGuiCond_FirstUseEver);
+  if (!ImGui::Begin("Prock Internals", &open, COMMON_VIEW_FLAGS)) {
+    ImGui::End();
+    return;
+  }
+  update_cpu_perc(my_state);
+
+  ImGui::SeparatorText("Gathering");
+  ImGui::Text("%zu cycles, thread CPU %.1f%%",
+              g_self_stats.gathers.load(std::memory_order_relaxed),
+              static_cast<double>(my_state.cpu_perc));
+  char read_bytes[32];
+  format_memory_bytes(static_cast<double>(g_self_stats.read_bytes.load(
+                          std::memory_order_relaxed)),
+                      read_bytes, sizeof(read_bytes));
+  ImGui::Text("Last cycle: %zu read syscalls, %s read",
+              g_self_stats.read_syscalls.load(std::memory_order_relaxed),
+              read_bytes);
+  if (begin_samples_table("##Gather")) {
+    for (int i = 0; i < eGatherPhase_COUNT; ++i) {
+      const GatherPhase phase = static_cast<GatherPhase>(i);
+      draw_samples_row(gather_phase_name(phase),
+                       g_self_stats.gather_phases[phase]);
+    }
+    ImGui::EndTable();
+  }
+  draw_gather_histogram();
+
+  ImGui::SeparatorText("Sampling");
+  ImGui::Text("%zu periods missed, a gather ran past them",
+              g_self_stats.missed_periods.load(std::memory_order_relaxed));
+  if (begin_samples_table("##Sampling")) {
+    draw_samples_row("Start lateness", g_self_stats.gather_lateness);
+    draw_samples_row("Process read skew", g_self_stats.read_skew);
+    ImGui::EndTable();
+  }
+
+  ImGui::SeparatorText("Snapshots");
+  ImGui::Text("%zu dropped with the queue full, %zu coalesced in a frame",
+              g_self_stats.snapshots_dropped.load(std::memory_order_relaxed),
+              g_self_stats.snapshots_coalesced.load(std::memory_order_relaxed));
+  if (view_state.sync) {
+    ImGui::Text("%zu waiting in the update queue",
+                view_state.sync->update_queue.size());
+  }
+
+  ImGui::SeparatorText("UI");
+  if (begin_samples_table("##UI")) {
+    draw_samples_row("Update", g_self_stats.ui_update);
+    draw_samples_row("Draw", g_self_stats.ui_draw);
+    ImGui::EndTable();
+  }
+
+  ImGui::SeparatorText("Memory");
+  draw_memory(view_state, state);
+
+  ImGui::End();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstdint>
+
+struct State;
+struct ViewState;
+
+// "Prock Internals": what gathering, updates and drawing cost, and memory by
+// owner. Counters come from self_stats.h, the window only reads them.
+struct InternalsWindowState {
+  // CPU time of the gathering thread at the last sample, % since then
+  uint64_t cpu_ns;
+  SteadyTimePoint cpu_at;
+  float cpu_perc;
+};
+
+void internals_window_draw(ViewState &view_state, const State &state);
@@ -10,6 +10,14 @@
 #include "implot.h"
 #include "tracy/Tracy.hpp"
 
+static void io_chart_push(IoChartData &chart, const double at,
+                          const ProcessDerivedStat &derived) {
+  history_push(chart.read_kb_per_sec, g_history.timeline, at,
+               derived.io_read_kb_per_sec);
+  history_push(chart.write_kb_per_sec, g_history.timeline, at,
+               derived.io_write_kb_per_sec);
+}
+
 void io_chart_update(IoChartState &my_state, const State &state) {
   const double update_at = std::chrono::duration_cast<Seconds>(
                                state.update_system_time.time_since_epoch())
@@ -19,14 +27,7 @@ void io_chart_update(IoChartState &my_state, const State &state) {
       my_state.charts, state,
       [&](IoChartData &chart, const ProcessStat & /*stat*/,
           const ProcessDerivedStat &derived) {
-        *chart.times.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-            update_at;
-        *chart.read_kb_per_sec.emplace_back(my_state.cur_arena,
-                                            my_state.wasted_bytes) =
-            derived.io_read_kb_per_sec;
-        *chart.write_kb_per_sec.emplace_back(my_state.cur_arena,
-                                             my_state.wasted_bytes) =
-            derived.io_write_kb_per_sec;
+        io_chart_push(chart, update_at, derived);
       });
 
   if (my_state.wasted_bytes > SLAB_SIZE) {
@@ -34,12 +35,6 @@ void io_chart_update(IoChartState &my_state, const State &state) {
     BumpArena new_arena = BumpArena::create();
 
     my_state.charts.realloc(new_arena);
-    for (size_t i = 0; i < my_state.charts.size(); ++i) {
-      IoChartData &chart = my_state.charts.data()[i];
-      chart.times.realloc(new_arena);
-      chart.read_kb_per_sec.realloc(new_arena);
-      chart.write_kb_per_sec.realloc(new_arena);
-    }
 
     my_state.cur_arena = new_arena;
     my_state.wasted_bytes = 0;
@@ -71,7 +66,7 @@ void io_chart_draw(ViewState &view_state) {
 
       push_fit_with_padding();
       const bool should_fit_y =
-          !chart.y_axis_fitted && chart.read_kb_per_sec.size() >= 2;
+          !chart.y_axis_fitted && chart.read_kb_per_sec.raw.live_size() >= 2;
       if (should_fit_y) {
         ImPlot::SetNextAxisToFit(ImAxis_Y1);
       }
@@ -81,27 +76,22 @@ void io_chart_draw(ViewState &view_state) {
           chart.y_axis_fitted = true;
         }
 
-        setup_chart(chart.times, format_io_rate_kb);
+        setup_chart(g_history.timeline, format_io_rate_kb);
+        const HistoryView view = chart_history_view(g_history.timeline);
 
         push_fill_alpha();
-        ImPlot::PlotShaded(TITLE_READ, chart.times.data(),
-                           chart.read_kb_per_sec.data(),
-                           chart.read_kb_per_sec.size());
-        ImPlot::PlotShaded(TITLE_WRITE, chart.times.data(),
-                           chart.write_kb_per_sec.data(),
-                           chart.write_kb_per_sec.size());
+        plot_shaded(TITLE_READ, view, chart.read_kb_per_sec);
+        plot_shaded(TITLE_WRITE, view, chart.write_kb_per_sec);
         pop_fill_alpha();
 
-        ImPlot::PlotLine(TITLE_READ, chart.times.data(),
-                         chart.read_kb_per_sec.data(),
-                         chart.read_kb_per_sec.size());
-        ImPlot::PlotLine(TITLE_WRITE, chart.times.data(),
-                         chart.write_kb_per_sec.data(),
-                         chart.write_kb_per_sec.size());
+        plot_line(TITLE_READ, view, chart.read_kb_per_sec);
+        plot_line(TITLE_WRITE, view, chart.write_kb_per_sec);
 
         chart_add_tooltip(TITLE_READ, "read_bytes from /proc/[pid]/io");
         chart_add_tooltip(TITLE_WRITE, "write_bytes from /proc/[pid]/io");
 
+        plot_annotations(chart.pid);
+
         ImPlot::EndPlot();
       }
 
@@ -113,16 +103,17 @@ void io_chart_draw(ViewState &view_state) {
     if (should_be_opened) {
       ++last;
     } else {
-      my_state.wasted_bytes += chart.times.total_byte_size();
-      my_state.wasted_bytes += chart.read_kb_per_sec.total_byte_size();
-      my_state.wasted_bytes += chart.write_kb_per_sec.total_byte_size();
+      history_destroy(chart.read_kb_per_sec);
+      history_destroy(chart.write_kb_per_sec);
+      my_state.wasted_bytes += sizeof(chart);
     }
   }
   my_state.charts.shrink_to(last);
 }
 
-void io_chart_add(IoChartState &my_state, const int pid, const char *comm,
-                  const ImGuiID dock_id, const ProcessWindowFlags extra_flags) {
+void io_chart_add(IoChartState &my_state, const State &state,
+                  const int pid, const char *comm, const ImGuiID dock_id,
+                  const ProcessWindowFlags extra_flags) {
   if (process_window_focus(my_state.charts, pid)) {
     return;
   }
@@ -134,5 +125,10 @@ void io_chart_add(IoChartState &my_state, const int pid, const char *comm,
   data.flags |= eProcessWindowFlags_RedockRequested | extra_flags;
   snprintf(data.label, sizeof(data.label), "I/O Usage: %s (%d)", comm, pid);
 
+  process_recorder_replay(
+      state.recorder, pid, [&](const double at, const ProcessDerivedStat &d) {
+        io_chart_push(data, at, d);
+      });
+
   common_views_sort_added(my_state.charts);
 }
@@ -10,32 +10,37 @@
 #include "implot.h"
 #include "tracy/Tracy.hpp"
 
+static void mem_chart_push(MemChartData &chart, const double at,
+                           const ProcessDerivedStat &derived) {
+  history_push(chart.mem_resident_kb, g_history.timeline, at,
+               derived.mem_resident_bytes / 1024);
+  history_push(chart.mem_peak_resident_kb, g_history.timeline, at,
+               derived.mem_peak_resident_bytes / 1024);
+  history_push(chart.mem_swap_kb, g_history.timeline, at,
+               derived.mem_swap_bytes / 1024);
+  history_push(chart.faults_per_sec, g_history.timeline, at,
+               derived.faults_per_sec);
+  history_push(chart.major_faults_per_sec, g_history.timeline, at,
+               derived.major_faults_per_sec);
+}
+
 void mem_chart_update(MemChartState &my_state, const State &state) {
   const double update_at = std::chrono::duration_cast<Seconds>(
                                state.update_system_time.time_since_epoch())
                                .count();
 
-  common_charts_update(my_state.charts, state,
-                       [&](MemChartData &chart, const ProcessStat & /*stat*/,
-                           const ProcessDerivedStat &derived) {
-                         *chart.times.emplace_back(my_state.cur_arena,
-                                                   my_state.wasted_bytes) =
-                             update_at;
-                         *chart.mem_resident_kb.emplace_back(
-                             my_state.cur_arena, my_state.wasted_bytes) =
-                             derived.mem_resident_bytes / 1024;
-                       });
+  common_charts_update(
+      my_state.charts, state,
+      [&](MemChartData &chart, const ProcessStat & /*stat*/,
+          const ProcessDerivedStat &derived) {
+        mem_chart_push(chart, update_at, derived);
+      });
 
   if (my_state.wasted_bytes > SLAB_SIZE) {
     BumpArena old_arena = my_state.cur_arena;
     BumpArena new_arena = BumpArena::create();
 
     my_state.charts.realloc(new_arena);
-    for (size_t i = 0; i < my_state.charts.size(); ++i) {
-      MemChartData &chart = my_state.charts.data()[i];
-      chart.times.realloc(new_arena);
-      chart.mem_resident_kb.realloc(new_arena);
-    }
 
     my_state.cur_arena = new_arena;
     my_state.wasted_bytes = 0;
@@ -67,7 +72,7 @@ void mem_chart_draw(ViewState &view_state) {
 
       push_fit_with_padding();
       const bool should_fit_y =
-          !chart.y_axis_fitted && chart.mem_resident_kb.size() >= 2;
+          !chart.y_axis_fitted && chart.mem_resident_kb.raw.live_size() >= 2;
       if (should_fit_y) {
         ImPlot::SetNextAxisToFit(ImAxis_Y1);
       }
@@ -77,19 +82,32 @@ void mem_chart_draw(ViewState &view_state) {
           chart.y_axis_fitted = true;
         }
 
-        setup_chart(chart.times, format_memory_kb);
+        setup_chart(g_history.timeline, format_memory_kb);
+        setup_rate_axis();
+        const HistoryView view = chart_history_view(g_history.timeline);
 
         push_fill_alpha();
-        ImPlot::PlotShaded(TITLE_USED, chart.times.data(),
-                           chart.mem_resident_kb.data(),
-                           chart.mem_resident_kb.size());
+        plot_shaded(TITLE_USED, view, chart.mem_resident_kb);
         pop_fill_alpha();
 
-        ImPlot::PlotLine(TITLE_USED, chart.times.data(),
-                         chart.mem_resident_kb.data(),
-                         chart.mem_resident_kb.size());
+        plot_line(TITLE_USED, view, chart.mem_resident_kb);
+        plot_line(TITLE_PEAK, view, chart.mem_peak_resident_kb);
+        plot_line(TITLE_SWAP, view, chart.mem_swap_kb);
+        ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+        plot_line(TITLE_FAULTS, view, chart.faults_per_sec);
+        plot_line(TITLE_MAJOR_FAULTS, view, chart.major_faults_per_sec);
+        ImPlot::SetAxes(ImAxis_X1, ImAxis_Y1);
 
         chart_add_tooltip(TITLE_USED, "resident from /proc/[pid]/statm");
+        chart_add_tooltip(TITLE_PEAK, "VmHWM from /proc/[pid]/status");
+        chart_add_tooltip(TITLE_SWAP, "VmSwap from /proc/[pid]/status");
+        chart_add_tooltip(TITLE_FAULTS,
+                          "minflt + majflt from /proc/[pid]/stat");
+        chart_add_tooltip(TITLE_MAJOR_FAULTS,
+                          "majflt from /proc/[pid]/stat, the ones that read "
+                          "from disk");
+
+        plot_annotations(chart.pid);
 
         ImPlot::EndPlot();
       }
@@ -103,15 +121,20 @@ void mem_chart_draw(ViewState &view_state) {
     if (should_be_opened) {
       ++last;
     } else {
-      my_state.wasted_bytes += chart.times.total_byte_size();
-      my_state.wasted_bytes += chart.mem_resident_kb.total_byte_size();
+      history_destroy(chart.mem_resident_kb);
+      history_destroy(chart.mem_peak_resident_kb);
+      history_destroy(chart.mem_swap_kb);
+      history_destroy(chart.faults_per_sec);
+      history_destroy(chart.major_faults_per_sec);
+      my_state.wasted_bytes += sizeof(chart);
     }
   }
   my_state.charts.shrink_to(last);
 }
 
-void mem_chart_add(MemChartState &my_state, const int pid, const char *comm,
-                   const ImGuiID dock_id, const ProcessWindowFlags extra_flags) {
+void mem_chart_add(MemChartState &my_state, const State &state,
+                   const int pid, const char *comm, const ImGuiID dock_id,
+                   const ProcessWindowFlags extra_flags) {
   if (process_window_focus(my_state.charts, pid)) {
     return;
   }
@@ -123,5 +146,10 @@ void mem_chart_add(MemChartState &my_state, const int pid, const char *comm,
   data.flags |= eProcessWindowFlags_RedockRequested | extra_flags;
   snprintf(data.label, sizeof(data.label), "Memory Usage: %s (%d)", comm, pid);
 
+  process_recorder_replay(
+      state.recorder, pid, [&](const double at, const ProcessDerivedStat &d) {
+        mem_chart_push(data, at, d);
+      });
+
   common_views_sort_added(my_state.charts);
 }
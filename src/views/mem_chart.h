@@ -1,11 +1,16 @@
 #pragma once
 
+#include "history.h"
+
 struct MemChartData {
   int pid;
   ImGuiID dock_id;
   char label[128];
-  GrowingArray<double> times;
-  GrowingArray<double> mem_resident_kb;
+  HistorySeries mem_resident_kb;
+  HistorySeries mem_peak_resident_kb;
+  HistorySeries mem_swap_kb;
+  HistorySeries faults_per_sec;
+  HistorySeries major_faults_per_sec;
   ProcessWindowFlags flags;
   bool y_axis_fitted;
 };
@@ -19,8 +24,9 @@ struct MemChartState {
 void mem_chart_update(MemChartState &my_state, const State &state);
 void mem_chart_draw(ViewState &view_state);
 
-void mem_chart_add(MemChartState &my_state, int pid, const char *comm,
-                   ImGuiID dock_id = 0, ProcessWindowFlags extra_flags = 0);
+void mem_chart_add(MemChartState &my_state, const State &state, int pid,
+                   const char *comm, ImGuiID dock_id = 0,
+                   ProcessWindowFlags extra_flags = 0);
 void mem_chart_close_if_docked_in(MemChartState &my_state, int pid,
                                   ImGuiID dockspace_id);
 void mem_chart_restore_layout_by_pid(MemChartState &my_state, int pid);
@@ -3,6 +3,10 @@
 #include "views/process_host.h"
 #include "views/view_state.h"
 
+#include "history.h"
+#include "sources/sync.h"
+#include "state.h"
+
 #include "imgui.h"
 #include "tracy/Tracy.hpp"
 
@@ -10,11 +14,17 @@ static constexpr float PERIODS[] = {0.0f, 0.25f, 0.5f, 1.0f, 2.0f, 5.0f};
 static const char *PERIOD_LABELS[] = {"Paused", "0.25s", "0.5s",
                                       "1s",     "2s",    "5s"};
 
+static constexpr float REPLAY_SPEEDS[] = {0.0f, 0.5f, 1.0f, 2.0f,
+                                          5.0f, 10.0f, 60.0f};
+static const char *REPLAY_SPEED_LABELS[] = {"Paused", "0.5x", "1x", "2x",
+                                            "5x",     "10x",  "60x"};
+
 static constexpr float ZOOM_SCALES[] = {0.75f, 1.0f, 1.25f, 1.5f, 2.0f};
 static const char *ZOOM_LABELS[] = {"75%", "100%", "125%", "150%", "200%"};
 static constexpr int ZOOM_COUNT = 5;
 
-static void draw_preferences_modal(PreferencesState &prefs) {
+static void draw_preferences_modal(PreferencesState &prefs,
+                                   const ProcessRecorder &recorder) {
   if (prefs.show_preferences_modal) {
     ImGui::OpenPopup("Preferences");
   }
@@ -98,6 +108,28 @@ static void draw_preferences_modal(PreferencesState &prefs) {
     ImGui::SetNextItemWidth(100);
     ImGui::SliderInt("Target FPS", &prefs.target_fps, 15, 60);
 
+    ImGui::Spacing();
+    ImGui::Spacing();
+
+    ImGui::Text("Chart History");
+    ImGui::Separator();
+
+    ImGui::SetNextItemWidth(100);
+    ImGui::SliderInt("Memory Budget", &prefs.history_budget_mb, 16, 4096,
+                     "%d MB", ImGuiSliderFlags_Logarithmic);
+    ImGui::TextDisabled("Using %.1f MB, full resolution for the last %.0f min",
+                        static_cast<double>(g_history.used_bytes) / (1 << 20),
+                        g_history.retention[0] / 60);
+    ImGui::TextDisabled(
+        "Recording %zu processes in the background, %.1f of %zu MB",
+        recorder.processes.size,
+        static_cast<double>(process_recorder_byte_size(recorder)) / (1 << 20),
+        RECORDER_BUDGET >> 20);
+    if (recorder.untracked > 0) {
+      ImGui::TextDisabled("%zu processes not recorded, the cap is reached",
+                          recorder.untracked);
+    }
+
     ImGui::Spacing();
     ImGui::Separator();
     ImGui::Spacing();
@@ -111,7 +143,30 @@ static void draw_preferences_modal(PreferencesState &prefs) {
   }
 }
 
-void menu_bar_draw(ViewState &view_state) {
+static void draw_replay_menu(Sync &sync) {
+  ReplaySync &replay = sync.replay;
+  if (!ImGui::BeginMenu("Replay")) return;
+
+  ImGui::TextDisabled("Snapshot %zu of %zu", replay.position.load(),
+                      replay.count);
+  ImGui::Separator();
+  const float speed = replay.speed.load();
+  for (int i = 0; i < IM_ARRAYSIZE(REPLAY_SPEEDS); ++i) {
+    if (ImGui::MenuItem(REPLAY_SPEED_LABELS[i], nullptr,
+                        speed == REPLAY_SPEEDS[i])) {
+      replay.speed.store(REPLAY_SPEEDS[i]);
+      sync.quit_cv.notify_one();
+    }
+  }
+  ImGui::Separator();
+  if (ImGui::MenuItem("Step", nullptr, false, speed <= 0.0f)) {
+    replay.steps.fetch_add(1);
+    sync.quit_cv.notify_one();
+  }
+  ImGui::EndMenu();
+}
+
+void menu_bar_draw(ViewState &view_state, const State &state) {
   ZoneScoped;
   if (ImGui::BeginMenuBar()) {
     if (ImGui::BeginMenu("View")) {
@@ -135,6 +190,14 @@ void menu_bar_draw(ViewState &view_state) {
 
       ImGui::Separator();
 
+      if (ImGui::MenuItem("Prock Internals", "Shift+F3",
+                          view_state.preferences_state.show_internals)) {
+        view_state.preferences_state.show_internals =
+            !view_state.preferences_state.show_internals;
+      }
+
+      ImGui::Separator();
+
       const bool has_focused_process =
           view_state.process_host_state.focused_pid > 0;
       if (ImGui::MenuItem("Restore Process Window Layout", nullptr, false,
@@ -152,6 +215,9 @@ void menu_bar_draw(ViewState &view_state) {
       }
       ImGui::EndMenu();
     }
+    if (view_state.sync && view_state.sync->replay.active.load()) {
+      draw_replay_menu(*view_state.sync);
+    }
 
     // Draw FPS on the right side if debug mode enabled (toggle with F3)
     if (view_state.preferences_state.show_debug_fps) {
@@ -168,5 +234,5 @@ void menu_bar_draw(ViewState &view_state) {
     ImGui::EndMenuBar();
   }
 
-  draw_preferences_modal(view_state.preferences_state);
+  draw_preferences_modal(view_state.preferences_state, state.recorder);
 }
@@ -11,8 +11,11 @@ struct PreferencesState {
   char font_path[512] = {};  // Custom TTF font path, empty = default
   bool font_needs_reload = false;  // Signal to reload font atlas
   bool show_debug_fps = false;  // Toggle with F3
+  bool show_internals = false;  // Prock Internals window, Shift+F3
+  int history_budget_mb = 64;  // Memory for chart history, all charts
 };
 
+struct State;
 struct ViewState;
 
-void menu_bar_draw(ViewState &view_state);
+void menu_bar_draw(ViewState &view_state, const State &state);
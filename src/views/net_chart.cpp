@@ -10,6 +10,14 @@
 #include "implot.h"
 #include "tracy/Tracy.hpp"
 
+static void net_chart_push(NetChartData &chart, const double at,
+                           const ProcessDerivedStat &derived) {
+  history_push(chart.recv_kb_per_sec, g_history.timeline, at,
+               derived.net_recv_kb_per_sec);
+  history_push(chart.send_kb_per_sec, g_history.timeline, at,
+               derived.net_send_kb_per_sec);
+}
+
 void net_chart_update(NetChartState &my_state, const State &state) {
   const double update_at = std::chrono::duration_cast<Seconds>(
                                state.update_system_time.time_since_epoch())
@@ -19,14 +27,7 @@ void net_chart_update(NetChartState &my_state, const State &state) {
       my_state.charts, state,
       [&](NetChartData &chart, const ProcessStat & /*stat*/,
           const ProcessDerivedStat &derived) {
-        *chart.times.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-            update_at;
-        *chart.recv_kb_per_sec.emplace_back(my_state.cur_arena,
-                                            my_state.wasted_bytes) =
-            derived.net_recv_kb_per_sec;
-        *chart.send_kb_per_sec.emplace_back(my_state.cur_arena,
-                                            my_state.wasted_bytes) =
-            derived.net_send_kb_per_sec;
+        net_chart_push(chart, update_at, derived);
       });
 
   if (my_state.wasted_bytes > SLAB_SIZE) {
@@ -34,12 +35,6 @@ void net_chart_update(NetChartState &my_state, const State &state) {
     BumpArena new_arena = BumpArena::create();
 
     my_state.charts.realloc(new_arena);
-    for (size_t i = 0; i < my_state.charts.size(); ++i) {
-      NetChartData &chart = my_state.charts.data()[i];
-      chart.times.realloc(new_arena);
-      chart.recv_kb_per_sec.realloc(new_arena);
-      chart.send_kb_per_sec.realloc(new_arena);
-    }
 
     my_state.cur_arena = new_arena;
     my_state.wasted_bytes = 0;
@@ -70,7 +65,7 @@ void net_chart_draw(ViewState &view_state) {
 
       push_fit_with_padding();
       const bool should_fit_y =
-          !chart.y_axis_fitted && chart.recv_kb_per_sec.size() >= 2;
+          !chart.y_axis_fitted && chart.recv_kb_per_sec.raw.live_size() >= 2;
       if (should_fit_y) {
         ImPlot::SetNextAxisToFit(ImAxis_Y1);
       }
@@ -80,27 +75,22 @@ void net_chart_draw(ViewState &view_state) {
           chart.y_axis_fitted = true;
         }
 
-        setup_chart(chart.times, format_io_rate_kb);
+        setup_chart(g_history.timeline, format_io_rate_kb);
+        const HistoryView view = chart_history_view(g_history.timeline);
 
         push_fill_alpha();
-        ImPlot::PlotShaded(TITLE_RECV, chart.times.data(),
-                           chart.recv_kb_per_sec.data(),
-                           chart.recv_kb_per_sec.size());
-        ImPlot::PlotShaded(TITLE_SEND, chart.times.data(),
-                           chart.send_kb_per_sec.data(),
-                           chart.send_kb_per_sec.size());
+        plot_shaded(TITLE_RECV, view, chart.recv_kb_per_sec);
+        plot_shaded(TITLE_SEND, view, chart.send_kb_per_sec);
         pop_fill_alpha();
 
-        ImPlot::PlotLine(TITLE_RECV, chart.times.data(),
-                         chart.recv_kb_per_sec.data(),
-                         chart.recv_kb_per_sec.size());
-        ImPlot::PlotLine(TITLE_SEND, chart.times.data(),
-                         chart.send_kb_per_sec.data(),
-                         chart.send_kb_per_sec.size());
+        plot_line(TITLE_RECV, view, chart.recv_kb_per_sec);
+        plot_line(TITLE_SEND, view, chart.send_kb_per_sec);
 
         chart_add_tooltip(TITLE_RECV, "Socket stats via netlink (INET_DIAG)");
         chart_add_tooltip(TITLE_SEND, "Socket stats via netlink (INET_DIAG)");
 
+        plot_annotations(chart.pid);
+
         ImPlot::EndPlot();
       }
 
@@ -112,16 +102,17 @@ void net_chart_draw(ViewState &view_state) {
     if (should_be_opened) {
       ++last;
     } else {
-      my_state.wasted_bytes += chart.times.total_byte_size();
-      my_state.wasted_bytes += chart.recv_kb_per_sec.total_byte_size();
-      my_state.wasted_bytes += chart.send_kb_per_sec.total_byte_size();
+      history_destroy(chart.recv_kb_per_sec);
+      history_destroy(chart.send_kb_per_sec);
+      my_state.wasted_bytes += sizeof(chart);
     }
   }
   my_state.charts.shrink_to(last);
 }
 
-void net_chart_add(NetChartState &my_state, const int pid, const char *comm,
-                   const ImGuiID dock_id, const ProcessWindowFlags extra_flags) {
+void net_chart_add(NetChartState &my_state, const State &state,
+                   const int pid, const char *comm, const ImGuiID dock_id,
+                   const ProcessWindowFlags extra_flags) {
   if (process_window_focus(my_state.charts, pid)) {
     return;
   }
@@ -133,5 +124,10 @@ void net_chart_add(NetChartState &my_state, const int pid, const char *comm,
   data.flags |= eProcessWindowFlags_RedockRequested | extra_flags;
   snprintf(data.label, sizeof(data.label), "Network Usage: %s (%d)", comm, pid);
 
+  process_recorder_replay(
+      state.recorder, pid, [&](const double at, const ProcessDerivedStat &d) {
+        net_chart_push(data, at, d);
+      });
+
   common_views_sort_added(my_state.charts);
 }
@@ -1,12 +1,13 @@
 #pragma once
 
+#include "history.h"
+
 struct NetChartData {
   int pid;
   ImGuiID dock_id;
   char label[128];
-  GrowingArray<double> times;
-  GrowingArray<double> recv_kb_per_sec;
-  GrowingArray<double> send_kb_per_sec;
+  HistorySeries recv_kb_per_sec;
+  HistorySeries send_kb_per_sec;
   ProcessWindowFlags flags;
   bool y_axis_fitted;
 };
@@ -20,8 +21,9 @@ struct NetChartState {
 void net_chart_update(NetChartState &my_state, const State &state);
 void net_chart_draw(ViewState &view_state);
 
-void net_chart_add(NetChartState &my_state, int pid, const char *comm,
-                   ImGuiID dock_id = 0, ProcessWindowFlags extra_flags = 0);
+void net_chart_add(NetChartState &my_state, const State &state, int pid,
+                   const char *comm, ImGuiID dock_id = 0,
+                   ProcessWindowFlags extra_flags = 0);
 void net_chart_close_if_docked_in(NetChartState &my_state, int pid,
                                   ImGuiID dockspace_id);
 void net_chart_restore_layout_by_pid(NetChartState &my_state, int pid);
@@ -23,17 +23,12 @@ void system_cpu_chart_update(SystemCpuChartState &my_state,
                                state.update_system_time.time_since_epoch())
                                .count();
 
-  *my_state.times.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-      update_at;
-  *my_state.total_usage.emplace_back(my_state.cur_arena,
-                                     my_state.wasted_bytes) =
-      snapshot.cpu_perc.total.data[0];
-  *my_state.kernel_usage.emplace_back(my_state.cur_arena,
-                                      my_state.wasted_bytes) =
-      snapshot.cpu_perc.kernel.data[0];
-  *my_state.interrupts_usage.emplace_back(my_state.cur_arena,
-                                          my_state.wasted_bytes) =
-      snapshot.cpu_perc.interrupts.data[0];
+  history_push(my_state.total_usage, g_history.timeline, update_at,
+               snapshot.cpu_perc.total.data[0]);
+  history_push(my_state.kernel_usage, g_history.timeline, update_at,
+               snapshot.cpu_perc.kernel.data[0]);
+  history_push(my_state.interrupts_usage, g_history.timeline, update_at,
+               snapshot.cpu_perc.interrupts.data[0]);
 
   // Per-core data (skip index 0 which is aggregate)
   int num_cores = static_cast<int>(snapshot.cpu_perc.total.size) - 1;
@@ -41,26 +36,8 @@ void system_cpu_chart_update(SystemCpuChartState &my_state,
   my_state.num_cores = num_cores;
 
   for (int i = 0; i < num_cores; ++i) {
-    *my_state.core_usage[i].emplace_back(my_state.cur_arena,
-                                         my_state.wasted_bytes) =
-        snapshot.cpu_perc.total.data[i + 1];
-  }
-
-  if (my_state.wasted_bytes > SLAB_SIZE) {
-    BumpArena old_arena = my_state.cur_arena;
-    BumpArena new_arena = BumpArena::create();
-
-    my_state.times.realloc(new_arena);
-    my_state.total_usage.realloc(new_arena);
-    my_state.kernel_usage.realloc(new_arena);
-    my_state.interrupts_usage.realloc(new_arena);
-    for (int i = 0; i < my_state.num_cores; ++i) {
-      my_state.core_usage[i].realloc(new_arena);
-    }
-
-    my_state.cur_arena = new_arena;
-    my_state.wasted_bytes = 0;
-    old_arena.destroy();
+    history_push(my_state.core_usage[i], g_history.timeline, update_at,
+                 snapshot.cpu_perc.total.data[i + 1]);
   }
 }
 
@@ -71,7 +48,7 @@ void system_cpu_chart_draw(FrameContext &ctx, ViewState &view_state) {
     push_fit_with_padding();
     if (ImPlot::BeginPlot("##SystemCPU", ImVec2(-1, -1),
                           ImPlotFlags_Crosshairs)) {
-      setup_chart(my_state.times, format_percent);
+      setup_chart(g_history.timeline, format_percent);
 
       if (my_state.show_per_core && my_state.stacked) {
         ImPlot::SetupAxisLimits(ImAxis_Y1, 0, std::max(1, my_state.num_cores) * 100,
@@ -79,37 +56,30 @@ void system_cpu_chart_draw(FrameContext &ctx, ViewState &view_state) {
       } else {
         ImPlot::SetupAxisLimits(ImAxis_Y1, 0, 100, ImPlotCond_Once);
       }
+      const HistoryView view = chart_history_view(g_history.timeline);
 
       if (!my_state.show_per_core) {
         push_fill_alpha();
-        ImPlot::PlotShaded(TITLE_TOTAL, my_state.times.data(),
-                           my_state.total_usage.data(),
-                           my_state.total_usage.size());
-        ImPlot::PlotShaded(TITLE_KERNEL, my_state.times.data(),
-                           my_state.kernel_usage.data(),
-                           my_state.kernel_usage.size());
-        ImPlot::PlotShaded(TITLE_INTERRUPTS, my_state.times.data(),
-                           my_state.interrupts_usage.data(),
-                           my_state.interrupts_usage.size());
+        plot_shaded(TITLE_TOTAL, view, my_state.total_usage);
+        plot_shaded(TITLE_KERNEL, view, my_state.kernel_usage);
+        plot_shaded(TITLE_INTERRUPTS, view, my_state.interrupts_usage);
         pop_fill_alpha();
 
-        ImPlot::PlotLine(TITLE_INTERRUPTS, my_state.times.data(),
-                         my_state.interrupts_usage.data(),
-                         my_state.interrupts_usage.size());
-        ImPlot::PlotLine(TITLE_KERNEL, my_state.times.data(),
-                         my_state.kernel_usage.data(),
-                         my_state.kernel_usage.size());
-        ImPlot::PlotLine(TITLE_TOTAL, my_state.times.data(),
-                         my_state.total_usage.data(),
-                         my_state.total_usage.size());
+        plot_line(TITLE_INTERRUPTS, view, my_state.interrupts_usage);
+        plot_line(TITLE_KERNEL, view, my_state.kernel_usage);
+        plot_line(TITLE_TOTAL, view, my_state.total_usage);
 
         chart_add_tooltip(TITLE_TOTAL, "user + system + irq + softirq from /proc/stat");
         chart_add_tooltip(TITLE_KERNEL, "system from /proc/stat");
         chart_add_tooltip(TITLE_INTERRUPTS, "irq + softirq from /proc/stat");
       } else if (my_state.stacked) {
         // Stacked per-core view
-        const size_t n = my_state.core_usage[0].size();
+        // Column averages share their xs across cores, so they can be summed
+        const HistoryDecimated &first = history_decimate(
+            my_state.core_usage[0], view, eHistoryDecimation_Avg);
+        const size_t n = first.count;
         if (n > 0 && my_state.num_cores > 0) {
+          const double *times = first.xs;
           Array<double> prev = Array<double>::create(ctx.frame_arena, n);
           Array<double> curr = Array<double>::create(ctx.frame_arena, n);
           memset(prev.data, 0, n * sizeof(double));
@@ -130,14 +100,17 @@ void system_cpu_chart_draw(FrameContext &ctx, ViewState &view_state) {
             if (is_hidden) {
               std::swap(prev.data, curr.data);
             } else {
-              const double *core_data = my_state.core_usage[i].data();
+              const HistoryDecimated &core_data = history_decimate(
+                  my_state.core_usage[i], view, eHistoryDecimation_Avg);
+              // A core brought online later has no oldest columns
+              const size_t skip = n - std::min(n, core_data.count);
               for (size_t j = 0; j < n; ++j) {
-                curr.data[j] = prev.data[j] + core_data[j];
+                curr.data[j] = prev.data[j];
+                if (j >= skip) curr.data[j] += core_data.ys[j - skip];
               }
             }
 
-            ImPlot::PlotShaded(label, my_state.times.data(), prev.data,
-                               curr.data, n);
+            ImPlot::PlotShaded(label, times, prev.data, curr.data, n);
 
             std::swap(prev.data, curr.data);
           }
@@ -148,12 +121,12 @@ void system_cpu_chart_draw(FrameContext &ctx, ViewState &view_state) {
         for (int i = 0; i < my_state.num_cores; ++i) {
           char label[16];
           snprintf(label, sizeof(label), "Core %d", i);
-          ImPlot::PlotLine(label, my_state.times.data(),
-                           my_state.core_usage[i].data(),
-                           my_state.core_usage[i].size());
+          plot_line(label, view, my_state.core_usage[i]);
         }
       }
 
+      plot_annotations(0);
+
       ImPlot::EndPlot();
     }
 
@@ -1,15 +1,14 @@
 #pragma once
 
+#include "history.h"
+
 constexpr int MAX_CORES = 128;
 
 struct SystemCpuChartState {
-  BumpArena cur_arena;
-  GrowingArray<double> times;
-  GrowingArray<double> total_usage;
-  GrowingArray<double> kernel_usage;
-  GrowingArray<double> interrupts_usage;
-  GrowingArray<double> core_usage[MAX_CORES];
-  size_t wasted_bytes;
+  HistorySeries total_usage;
+  HistorySeries kernel_usage;
+  HistorySeries interrupts_usage;
+  HistorySeries core_usage[MAX_CORES];
   int num_cores;
 
   bool show_per_core;
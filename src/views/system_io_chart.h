@@ -1,11 +1,10 @@
 #pragma once
 
+#include "history.h"
+
 struct SystemIoChartState {
-  BumpArena cur_arena;
-  GrowingArray<double> times;
-  GrowingArray<double> read_mb_per_sec;  // Read throughput in MB/s
-  GrowingArray<double> write_mb_per_sec; // Write throughput in MB/s
-  size_t wasted_bytes;
+  HistorySeries read_mb_per_sec;  // Read throughput in MB/s
+  HistorySeries write_mb_per_sec; // Write throughput in MB/s
   bool y_axis_fitted;
 };
 
@@ -25,25 +25,9 @@ void system_mem_chart_update(SystemMemChartState &my_state,
 
   const ulong used_kb = mem.mem_total - mem.mem_available;
 
-  *my_state.times.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-      update_at;
-  *my_state.used.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-      used_kb;
-  *my_state.available.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-      mem.mem_available;
-
-  if (my_state.wasted_bytes > SLAB_SIZE) {
-    BumpArena old_arena = my_state.cur_arena;
-    BumpArena new_arena = BumpArena::create();
-
-    my_state.times.realloc(new_arena);
-    my_state.used.realloc(new_arena);
-    my_state.available.realloc(new_arena);
-
-    my_state.cur_arena = new_arena;
-    my_state.wasted_bytes = 0;
-    old_arena.destroy();
-  }
+  history_push(my_state.used, g_history.timeline, update_at, used_kb);
+  history_push(my_state.available, g_history.timeline, update_at,
+               mem.mem_available);
 }
 
 void system_mem_chart_draw(FrameContext & /*ctx*/, ViewState &view_state) {
@@ -53,7 +37,7 @@ void system_mem_chart_draw(FrameContext & /*ctx*/, ViewState &view_state) {
   if (ImGui::Begin("System Memory Usage", nullptr, COMMON_VIEW_FLAGS)) {
     push_fit_with_padding();
     const bool should_fit_y =
-        !my_state.y_axis_fitted && my_state.used.size() >= 2;
+        !my_state.y_axis_fitted && my_state.used.raw.live_size() >= 2;
     if (should_fit_y) {
       ImPlot::SetNextAxisToFit(ImAxis_Y1);
     }
@@ -62,23 +46,22 @@ void system_mem_chart_draw(FrameContext & /*ctx*/, ViewState &view_state) {
       if (should_fit_y) {
         my_state.y_axis_fitted = true;
       }
-      setup_chart(my_state.times, format_memory_kb);
+      setup_chart(g_history.timeline, format_memory_kb);
+      const HistoryView view = chart_history_view(g_history.timeline);
 
       push_fill_alpha();
-      ImPlot::PlotShaded(TITLE_USED, my_state.times.data(),
-                         my_state.used.data(), my_state.used.size());
-      ImPlot::PlotShaded(TITLE_AVAILABLE, my_state.times.data(),
-                         my_state.available.data(), my_state.available.size());
+      plot_shaded(TITLE_USED, view, my_state.used);
+      plot_shaded(TITLE_AVAILABLE, view, my_state.available);
       pop_fill_alpha();
 
-      ImPlot::PlotLine(TITLE_USED, my_state.times.data(), my_state.used.data(),
-                       my_state.used.size());
-      ImPlot::PlotLine(TITLE_AVAILABLE, my_state.times.data(),
-                       my_state.available.data(), my_state.available.size());
+      plot_line(TITLE_USED, view, my_state.used);
+      plot_line(TITLE_AVAILABLE, view, my_state.available);
 
       chart_add_tooltip(TITLE_USED, "MemTotal - MemAvailable from /proc/meminfo");
       chart_add_tooltip(TITLE_AVAILABLE, "MemAvailable from /proc/meminfo");
 
+      plot_annotations(0);
+
       ImPlot::EndPlot();
     }
 
@@ -1,11 +1,10 @@
 #pragma once
 
+#include "history.h"
+
 struct SystemMemChartState {
-  BumpArena cur_arena;
-  GrowingArray<double> times;
-  GrowingArray<double> used;      // Used memory in KB (Total - Available)
-  GrowingArray<double> available; // Available memory in KB
-  size_t wasted_bytes;
+  HistorySeries used;      // Used memory in KB (Total - Available)
+  HistorySeries available; // Available memory in KB
   bool y_axis_fitted;
 };
 
@@ -20,25 +20,10 @@ void system_net_chart_update(SystemNetChartState &my_state,
                                state.update_system_time.time_since_epoch())
                                .count();
 
-  *my_state.times.emplace_back(my_state.cur_arena, my_state.wasted_bytes) =
-      update_at;
-  *my_state.recv_mb_per_sec.emplace_back(
-      my_state.cur_arena, my_state.wasted_bytes) = rate.recv_mb_per_sec;
-  *my_state.send_mb_per_sec.emplace_back(
-      my_state.cur_arena, my_state.wasted_bytes) = rate.send_mb_per_sec;
-
-  if (my_state.wasted_bytes > SLAB_SIZE) {
-    BumpArena old_arena = my_state.cur_arena;
-    BumpArena new_arena = BumpArena::create();
-
-    my_state.times.realloc(new_arena);
-    my_state.recv_mb_per_sec.realloc(new_arena);
-    my_state.send_mb_per_sec.realloc(new_arena);
-
-    my_state.cur_arena = new_arena;
-    my_state.wasted_bytes = 0;
-    old_arena.destroy();
-  }
+  history_push(my_state.recv_mb_per_sec, g_history.timeline, update_at,
+               rate.recv_mb_per_sec);
+  history_push(my_state.send_mb_per_sec, g_history.timeline, update_at,
+               rate.send_mb_per_sec);
 }
 
 void system_net_chart_draw(FrameContext & /*ctx*/, ViewState &view_state) {
@@ -47,8 +32,8 @@ void system_net_chart_draw(FrameContext & /*ctx*/, ViewState &view_state) {
 
   if (ImGui::Begin("System Network", nullptr, COMMON_VIEW_FLAGS)) {
     push_fit_with_padding();
-    const bool should_fit_y =
-        !my_state.y_axis_fitted && my_state.recv_mb_per_sec.size() >= 2;
+    const bool should_fit_y = !my_state.y_axis_fitted &&
+                              my_state.recv_mb_per_sec.raw.live_size() >= 2;
     if (should_fit_y) {
       ImPlot::SetNextAxisToFit(ImAxis_Y1);
     }
@@ -57,27 +42,22 @@ void system_net_chart_draw(FrameContext & /*ctx*/, ViewState &view_state) {
       if (should_fit_y) {
         my_state.y_axis_fitted = true;
       }
-      setup_chart(my_state.times, format_io_rate_mb);
+      setup_chart(g_history.timeline, format_io_rate_mb);
+      const HistoryView view = chart_history_view(g_history.timeline);
 
       push_fill_alpha();
-      ImPlot::PlotShaded(TITLE_RECV, my_state.times.data(),
-                         my_state.recv_mb_per_sec.data(),
-                         my_state.recv_mb_per_sec.size());
-      ImPlot::PlotShaded(TITLE_SEND, my_state.times.data(),
-                         my_state.send_mb_per_sec.data(),
-                         my_state.send_mb_per_sec.size());
+      plot_shaded(TITLE_RECV, view, my_state.recv_mb_per_sec);
+      plot_shaded(TITLE_SEND, view, my_state.send_mb_per_sec);
       pop_fill_alpha();
 
-      ImPlot::PlotLine(TITLE_RECV, my_state.times.data(),
-                       my_state.recv_mb_per_sec.data(),
-                       my_state.recv_mb_per_sec.size());
-      ImPlot::PlotLine(TITLE_SEND, my_state.times.data(),
-                       my_state.send_mb_per_sec.data(),
-                       my_state.send_mb_per_sec.size());
+      plot_line(TITLE_RECV, view, my_state.recv_mb_per_sec);
+      plot_line(TITLE_SEND, view, my_state.send_mb_per_sec);
 
       chart_add_tooltip(TITLE_RECV, "receive bytes from /proc/net/dev");
       chart_add_tooltip(TITLE_SEND, "transmit bytes from /proc/net/dev");
 
+      plot_annotations(0);
+
       ImPlot::EndPlot();
     }
 
@@ -1,11 +1,10 @@
 #pragma once
 
+#include "history.h"
+
 struct SystemNetChartState {
-  BumpArena cur_arena;
-  GrowingArray<double> times;
-  GrowingArray<double> recv_mb_per_sec;  // Receive throughput in MB/s
-  GrowingArray<double> send_mb_per_sec;  // Send throughput in MB/s
-  size_t wasted_bytes;
+  HistorySeries recv_mb_per_sec;  // Receive throughput in MB/s
+  HistorySeries send_mb_per_sec;  // Send throughput in MB/s
   bool y_axis_fitted;
 };
 
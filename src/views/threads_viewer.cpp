@@ -213,7 +213,7 @@ void threads_viewer_process_snapshot(ThreadsViewerState &state,
                                      const State &state_data,
                                      const Array<ThreadSnapshot> &snapshots) {
   const long page_size = state_data.system.mem_page_size;
-  const double ticks_in_second = state_data.system.ticks_in_second;
+  const uint64_t ticks_in_second = state_data.system.ticks_in_second;
 
   for (size_t w = 0; w < state.windows.size(); ++w) {
     ThreadsViewerWindow &win = state.windows.data()[w];
@@ -252,9 +252,6 @@ void threads_viewer_process_snapshot(ThreadsViewerState &state,
         Array<ThreadDerivedStat>::create(state.cur_arena, snap->threads.size);
 
     const SteadyTimePoint now = state_data.snapshot.at;
-    const double time_delta =
-        std::chrono::duration_cast<Seconds>(now - prev_at).count();
-    const double ticks_passed = ticks_in_second * time_delta;
 
     size_t prev_idx = 0;
     for (size_t i = 0; i < win.threads.size; ++i) {
@@ -269,16 +266,13 @@ void threads_viewer_process_snapshot(ThreadsViewerState &state,
       }
 
       if (prev_idx < prev_threads.size &&
-          prev_threads.data[prev_idx].pid == thread.pid && ticks_passed > 0) {
+          prev_threads.data[prev_idx].pid == thread.pid) {
         const ProcessStat &prev = prev_threads.data[prev_idx];
-        if (thread.utime >= prev.utime) {
-          derived.cpu_user_perc =
-              (thread.utime - prev.utime) / ticks_passed * 100;
-        }
-        if (thread.stime >= prev.stime) {
-          derived.cpu_kernel_perc =
-              (thread.stime - prev.stime) / ticks_passed * 100;
-        }
+        const StatCpuPerc cpu_perc = stat_cpu_perc(
+            prev, thread, stat_interval_secs(prev, prev_at, thread, now),
+            ticks_in_second);
+        derived.cpu_user_perc = cpu_perc.user;
+        derived.cpu_kernel_perc = cpu_perc.kernel;
       }
     }
 
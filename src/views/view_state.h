@@ -3,6 +3,7 @@
 #include "views/brief_table.h"
 #include "views/cpu_chart.h"
 #include "views/environ_viewer.h"
+#include "views/internals_window.h"
 #include "views/io_chart.h"
 #include "views/library_viewer.h"
 #include "views/socket_viewer.h"
@@ -93,4 +94,5 @@ struct ViewState {
   EnvironViewerState environ_viewer_state;
   ThreadsViewerState threads_viewer_state;
   SocketViewerState socket_viewer_state;
+  InternalsWindowState internals_window_state;
 };
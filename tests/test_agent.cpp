@@ -0,0 +1,234 @@
+#include "doctest.h"
+
+#include "sources/agent.h"
+#include "sources/fan_in.h"
+#include "sources/sync.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// ============================================================================
+// Agent Tests
+// ============================================================================
+
+namespace {
+
+// prock-collect --listen in threads of this process
+struct TestAgent {
+  Sync sync{};
+  AgentServer server{};
+  std::thread gathering;
+  std::thread serving;
+
+  bool start(const char *address) {
+    sync.update_period.store(0.02f);
+    if (!agent_listen(server, address, 100, 4096)) return false;
+    gathering = std::thread{[this] {
+      GatheringState gathering_state = {};
+      while (!sync.quit.load()) {
+        gather(gathering_state, sync);
+        agent_notify(server);
+      }
+    }};
+    serving = std::thread{[this] { agent_serve(server, sync); }};
+    return true;
+  }
+
+  ~TestAgent() { stop(); }
+
+  void stop() {
+    if (!serving.joinable()) return;
+    sync.quit.store(true);
+    sync.quit_cv.notify_one();
+    gathering.join();
+    agent_notify(server);
+    serving.join();
+    agent_server_close(server);
+  }
+};
+
+} // namespace
+
+TEST_CASE("Agent addresses") {
+  AgentServer server = {};
+  CHECK_FALSE(agent_listen(server, "no port", 100, 4096));
+  AgentConnection connection = {};
+  CHECK_FALSE(agent_connect(connection, "unix:/tmp/prock_no_such_agent"));
+
+  // An empty host never listens on other interfaces
+  REQUIRE(agent_listen(server, ":0", 100, 4096));
+  sockaddr_storage bound = {};
+  socklen_t bound_len = sizeof(bound);
+  REQUIRE(getsockname(server.listener.listen_fd,
+                      reinterpret_cast<sockaddr *>(&bound), &bound_len) == 0);
+  if (bound.ss_family == AF_INET) {
+    const sockaddr_in &in = reinterpret_cast<const sockaddr_in &>(bound);
+    CHECK(ntohl(in.sin_addr.s_addr) == INADDR_LOOPBACK);
+  } else {
+    REQUIRE(bound.ss_family == AF_INET6);
+    const sockaddr_in6 &in6 = reinterpret_cast<const sockaddr_in6 &>(bound);
+    CHECK(IN6_IS_ADDR_LOOPBACK(&in6.sin6_addr));
+  }
+  agent_server_close(server);
+}
+
+TEST_CASE("Agent streams snapshots and answers requests") {
+  char address[64];
+  snprintf(address, sizeof(address), "unix:/tmp/prock_agent_%d", getpid());
+  TestAgent agent;
+  REQUIRE(agent.start(address));
+
+  AgentConnection connection = {};
+  REQUIRE(agent_connect(connection, address));
+  CHECK(connection.hello.ticks_in_second == 100);
+  CHECK(connection.hello.mem_page_size == 4096);
+
+  Sync sync = {};
+  OnDemandReaderSync &on_demand = sync.on_demand_reader;
+  on_demand.library_request_queue.push({getpid()});
+  on_demand.environ_request_queue.push({getpid()});
+  CHECK_FALSE(agent_send_requests(connection, sync));
+
+  int snapshots = 0;
+  bool got_libraries = false;
+  bool got_environ = false;
+  for (int i = 0; i < 1000 && (snapshots < 3 || !got_libraries ||
+                               !got_environ);
+       ++i) {
+    REQUIRE(agent_receive(connection, sync));
+
+    UpdateSnapshot snapshot = {};
+    while (sync.update_queue.pop(snapshot)) {
+      ++snapshots;
+      CHECK(snapshot.cpu_stats.size > 0);
+      const ProcessStat *self = nullptr;
+      for (size_t p = 0; p < snapshot.stats.size; ++p) {
+        if (p > 0) {
+          CHECK(snapshot.stats.data[p - 1].pid < snapshot.stats.data[p].pid);
+        }
+        if (snapshot.stats.data[p].pid == getpid()) {
+          self = &snapshot.stats.data[p];
+        }
+      }
+      REQUIRE(self != nullptr);
+      CHECK(std::string(self->comm).rfind("prock", 0) == 0);
+      snapshot.owner_arena.destroy();
+    }
+
+    LibraryResponse libraries = {};
+    if (on_demand.library_response_queue.pop(libraries)) {
+      got_libraries = true;
+      CHECK(libraries.pid == getpid());
+      CHECK(libraries.error_code == 0);
+      CHECK(libraries.libraries.size > 0);
+      libraries.owner_arena.destroy();
+    }
+    EnvironResponse environ_response = {};
+    if (on_demand.environ_response_queue.pop(environ_response)) {
+      got_environ = true;
+      CHECK(environ_response.pid == getpid());
+      CHECK(environ_response.error_code == 0);
+      environ_response.owner_arena.destroy();
+    }
+  }
+  CHECK(snapshots >= 3);
+  CHECK(got_libraries);
+  CHECK(got_environ);
+  agent_connection_close(connection);
+}
+
+TEST_CASE("Agent requests wait for a full socket") {
+  int fds[2];
+  REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  const char filler[4096] = {};
+  size_t filled = 0;
+  for (;;) {
+    const ssize_t n = send(fds[0], filler, sizeof(filler), MSG_NOSIGNAL);
+    if (n <= 0) break;
+    filled += n;
+  }
+  REQUIRE(errno == EAGAIN);
+
+  AgentConnection connection = {};
+  connection.fd = fds[0];
+  Sync sync = {};
+  OnDemandReaderSync &on_demand = sync.on_demand_reader;
+  on_demand.library_request_queue.push({7});
+  on_demand.environ_request_queue.push({8});
+  on_demand.socket_request_queue.push({9});
+  CHECK(agent_send_requests(connection, sync));
+  LibraryRequest pending = {};
+  CHECK_FALSE(on_demand.library_request_queue.pop(pending));
+
+  char drained[4096];
+  while (filled > 0) {
+    const size_t chunk = filled < sizeof(drained) ? filled : sizeof(drained);
+    const ssize_t n = read(fds[1], drained, chunk);
+    REQUIRE(n > 0);
+    filled -= n;
+  }
+  CHECK_FALSE(agent_send_requests(connection, sync));
+
+  const AgentMessageType types[] = {eAgentMessage_LibraryRequest,
+                                    eAgentMessage_EnvironRequest,
+                                    eAgentMessage_SocketRequest};
+  for (int i = 0; i < 3; ++i) {
+    struct {
+      AgentMessageHeader header;
+      AgentRequest request;
+    } message = {};
+    REQUIRE(read(fds[1], &message, sizeof(message)) == sizeof(message));
+    CHECK(message.header.type == static_cast<uint32_t>(types[i]));
+    CHECK(message.header.bytes == sizeof(AgentRequest));
+    CHECK(message.request.pid == 7 + i);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_CASE("Fan-in receives from every host") {
+  char addresses[2][64];
+  TestAgent agents[2];
+  for (int i = 0; i < 2; ++i) {
+    snprintf(addresses[i], sizeof(addresses[i]),
+             "unix:/tmp/prock_agent_%d_%d", getpid(), i);
+    REQUIRE(agents[i].start(addresses[i]));
+  }
+
+  static FanIn fan_in; // too big for the stack
+  const char *const list[] = {addresses[0], addresses[1]};
+  REQUIRE(fan_in_connect(fan_in, list, 2));
+  CHECK(fan_in.count == 2);
+
+  int snapshots[2] = {};
+  for (int i = 0; i < 1000 && (snapshots[0] < 2 || snapshots[1] < 2); ++i) {
+    fan_in_poll(fan_in, FAN_IN_POLL_MS);
+    for (int h = 0; h < 2; ++h) {
+      UpdateSnapshot snapshot = {};
+      while (fan_in.hosts[h].sync.update_queue.pop(snapshot)) {
+        ++snapshots[h];
+        CHECK(snapshot.stats.size > 0);
+        snapshot.owner_arena.destroy();
+      }
+    }
+  }
+  CHECK(snapshots[0] >= 2);
+  CHECK(snapshots[1] >= 2);
+  CHECK(fan_in.hosts[1].connected.load());
+
+  // A stopped agent is reported, the other host keeps streaming
+  agents[1].stop();
+  for (int i = 0; i < 1000 && fan_in.hosts[1].connected.load(); ++i) {
+    fan_in_poll(fan_in, FAN_IN_POLL_MS);
+  }
+  CHECK_FALSE(fan_in.hosts[1].connected.load());
+  CHECK(fan_in.hosts[0].connected.load());
+  fan_in_close(fan_in);
+}
@@ -0,0 +1,149 @@
+#include "doctest.h"
+
+#include "sources/annotations.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+// ============================================================================
+// Annotation Tests
+// ============================================================================
+
+namespace {
+
+bool parse(const char *message, Annotation &out) {
+  return annotation_parse(message, strlen(message), 1000.0, out);
+}
+
+std::vector<std::string> labels(const AnnotationStore &store, const int pid,
+                                const double x_min, const double x_max) {
+  std::vector<std::string> res;
+  annotations_for_each(store, pid, x_min, x_max,
+                       [&](const Annotation &a) { res.push_back(a.label); });
+  return res;
+}
+
+Annotation make(const double time, const int pid, const char *label) {
+  Annotation res = {};
+  res.time = time;
+  res.pid = pid;
+  snprintf(res.label, sizeof(res.label), "%s", label);
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("Annotation parsing") {
+  Annotation a;
+
+  SUBCASE("now") {
+    REQUIRE(parse("- deploy v1.2\n", a));
+    CHECK(a.time == 1000.0);
+    CHECK(a.pid == 0);
+    CHECK(std::string(a.label) == "deploy v1.2");
+  }
+
+  SUBCASE("time and pid") {
+    REQUIRE(parse("1700000000.5 pid=42  load test", a));
+    CHECK(a.time == 1700000000.5);
+    CHECK(a.pid == 42);
+    CHECK(std::string(a.label) == "load test");
+  }
+
+  SUBCASE("control characters") {
+    REQUIRE(parse("- a\tb\x1b", a));
+    CHECK(std::string(a.label) == "a b ");
+  }
+
+  SUBCASE("long label is truncated") {
+    const std::string message = "- " + std::string(200, 'x');
+    REQUIRE(parse(message.c_str(), a));
+    CHECK(strlen(a.label) == ANNOTATION_LABEL_SIZE - 1);
+  }
+
+  SUBCASE("malformed") {
+    CHECK_FALSE(parse("", a));
+    CHECK_FALSE(parse("-\n", a));
+    CHECK_FALSE(parse("soon deploy", a));
+    CHECK_FALSE(parse("-5 deploy", a));
+    CHECK_FALSE(parse("- pid=x deploy", a));
+    CHECK_FALSE(parse("- pid=0 deploy", a));
+    CHECK_FALSE(parse("- pid=7", a));
+    CHECK_FALSE(parse("- pid=7x deploy", a));
+  }
+
+  SUBCASE("the pid ends with the message") {
+    const char message[] = "- pid=12345 x";
+    CHECK_FALSE(annotation_parse(message, strlen("- pid=12"), 1000.0, a));
+  }
+}
+
+TEST_CASE("Annotation store") {
+  AnnotationStore store = {};
+  annotation_add(store, make(10, 0, "system"));
+  annotation_add(store, make(20, 42, "mine"));
+  annotation_add(store, make(30, 43, "other"));
+
+  CHECK(labels(store, 0, 0, 100) ==
+        std::vector<std::string>{"system", "mine", "other"});
+  CHECK(labels(store, 42, 0, 100) ==
+        std::vector<std::string>{"system", "mine"});
+  CHECK(labels(store, 0, 15, 30) == std::vector<std::string>{"mine", "other"});
+
+  // Only the newest ones are kept
+  for (size_t i = 0; i < ANNOTATION_CAPACITY; ++i) {
+    annotation_add(store, make(100 + i, 0, "new"));
+  }
+  CHECK(labels(store, 0, 0, 99).empty());
+  CHECK(labels(store, 0, 0, 1000).size() == ANNOTATION_CAPACITY);
+}
+
+TEST_CASE("Annotation socket") {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/prock_annotations_test_%d.sock",
+           getpid());
+  const int fd = annotation_socket_open(path);
+  REQUIRE(fd >= 0);
+
+  const int sender = socket(AF_UNIX, SOCK_DGRAM, 0);
+  REQUIRE(sender >= 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  // Short ones after long ones don't see what is left of them
+  const std::string digits(512, '7');
+  const char *messages[] = {
+      "- deploy\n", "garbage",       "1700000000 pid=5 gc", "- pid=1234 long",
+      "- pid=12",   digits.c_str(), "- pid=3 x"};
+  for (const char *message : messages) {
+    CHECK(sendto(sender, message, strlen(message), 0,
+                 reinterpret_cast<const sockaddr *>(&addr),
+                 sizeof(addr)) == static_cast<ssize_t>(strlen(message)));
+  }
+  close(sender);
+
+  AnnotationQueue queue = {};
+  CHECK(annotation_receive(fd, queue) == 4);
+  CHECK(annotation_receive(fd, queue) == 0);
+  Annotation a;
+  REQUIRE(queue.pop(a));
+  CHECK(std::string(a.label) == "deploy");
+  CHECK(a.time > 1700000000);
+  REQUIRE(queue.pop(a));
+  CHECK(a.pid == 5);
+  CHECK(std::string(a.label) == "gc");
+  REQUIRE(queue.pop(a));
+  CHECK(a.pid == 1234);
+  REQUIRE(queue.pop(a));
+  CHECK(a.pid == 3);
+  CHECK(std::string(a.label) == "x");
+  CHECK_FALSE(queue.pop(a));
+
+  annotation_socket_close(fd, path);
+  CHECK(access(path, F_OK) != 0);
+}
@@ -0,0 +1,157 @@
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include "collector.h"
+
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Collector Tests
+// ============================================================================
+
+namespace {
+
+bool parse(CollectOptions &options, std::vector<const char *> args) {
+  args.insert(args.begin(), "prock-collect");
+  return collect_parse_args(options, static_cast<int>(args.size()),
+                            const_cast<char **>(args.data()));
+}
+
+StateSnapshot make_snapshot(BumpArena &arena) {
+  return SnapshotBuilder(arena)
+      .add(1, 0, "init", 'S', 0.5, 0.0, 4096)
+      .add(20, 1, "busy", 'R', 80.0, 10.0, 8192)
+      .add(30, 1, "say \"hi\"\\", 'S', 5.0)
+      .add(40, 1, "idle", 'S')
+      .mem(1000, 400)
+      .build();
+}
+
+} // namespace
+
+TEST_CASE("Collector options") {
+  CollectOptions options = collect_default_options();
+
+  SUBCASE("defaults") {
+    CHECK(parse(options, {}));
+    CHECK(options.format == eCollectFormat_Json);
+    CHECK(options.sort_by == eCollectField_Cpu);
+    CHECK((options.fields & (1u << eCollectField_Comm)) != 0);
+    CHECK((options.fields & (1u << eCollectField_Ppid)) == 0);
+  }
+
+  SUBCASE("all options") {
+    CHECK(parse(options, {"--period", "0.25", "--format", "binary", "--fields",
+                          "comm,mem_kb", "--top", "5", "--sort", "mem_kb",
+                          "--output", "out.bin", "--rotate-mb", "2", "--keep",
+                          "3"}));
+    CHECK(options.period == doctest::Approx(0.25));
+    CHECK(options.format == eCollectFormat_Binary);
+    CHECK(options.fields ==
+          (1u << eCollectField_Comm | 1u << eCollectField_Mem));
+    CHECK(options.top == 5);
+    CHECK(options.sort_by == eCollectField_Mem);
+    CHECK(std::string(options.output) == "out.bin");
+    CHECK(options.rotate_bytes == 2 * 1024 * 1024);
+    CHECK(options.keep_files == 3);
+  }
+
+  SUBCASE("trace of a recording") {
+    CHECK(parse(options, {"--format", "trace", "--from", "rec.prock"}));
+    CHECK(options.format == eCollectFormat_Trace);
+    CHECK(std::string(options.from) == "rec.prock");
+  }
+
+  SUBCASE("errors") {
+    CHECK_FALSE(parse(options, {"--period", "0"}));
+    CHECK_FALSE(parse(options, {"--format", "xml"}));
+    CHECK_FALSE(parse(options, {"--fields", "comm,nope"}));
+    CHECK_FALSE(parse(options, {"--sort", "comm"}));
+    CHECK_FALSE(parse(options, {"--top"}));
+    CHECK_FALSE(parse(options, {"--unknown", "1"}));
+    CHECK_FALSE(parse(options, {"--from", "rec.prock", "--listen", ":1"}));
+  }
+}
+
+TEST_CASE("Collector JSON records") {
+  BumpArena arena = BumpArena::create();
+  const StateSnapshot snapshot = make_snapshot(arena);
+  Collector collector = {};
+  collector.options = collect_default_options();
+  CollectOverhead overhead = {};
+  overhead.cpu_perc = 1.5;
+
+  SUBCASE("top processes by cpu") {
+    collector.options.top = 2;
+    collector.options.fields = 1u << eCollectField_Comm |
+                               1u << eCollectField_Cpu |
+                               1u << eCollectField_Mem;
+    const String record = collect_format(collector, snapshot, 1.5, overhead);
+    const std::string json(record.data, record.length);
+    CHECK(json.back() == '\n');
+    CHECK(json.find("\"time\":1.500") != std::string::npos);
+    CHECK(json.find("\"mem_used_kb\":600.00") != std::string::npos);
+    CHECK(json.find("\"self_cpu\":1.50") != std::string::npos);
+    CHECK(json.find("\"total_procs\":4") != std::string::npos);
+    CHECK(json.find(
+              "\"procs\":[{\"pid\":20,\"comm\":\"busy\",\"cpu\":90.00,"
+              "\"mem_kb\":8},{\"pid\":30,\"comm\":\"say \\\"hi\\\"\\\\\"") !=
+          std::string::npos);
+    CHECK(json.find("\"pid\":1,") == std::string::npos);
+  }
+
+  SUBCASE("every process in pid order") {
+    collector.options.top = 0;
+    collector.options.fields = 1u << eCollectField_State;
+    const String record = collect_format(collector, snapshot, 1.5, overhead);
+    const std::string json(record.data, record.length);
+    CHECK(json.find("[{\"pid\":1,\"state\":\"S\"},{\"pid\":20,\"state\":\"R\"},"
+                    "{\"pid\":30,\"state\":\"S\"},{\"pid\":40,\"state\":"
+                    "\"S\"}]}") != std::string::npos);
+  }
+
+  collect_destroy(collector);
+  arena.destroy();
+}
+
+TEST_CASE("Collector binary frames") {
+  BumpArena arena = BumpArena::create();
+  const StateSnapshot snapshot = make_snapshot(arena);
+  Collector collector = {};
+  collector.options = collect_default_options();
+  collector.options.format = eCollectFormat_Binary;
+  collector.options.top = 1;
+  collector.options.sort_by = eCollectField_Mem;
+  collector.options.fields =
+      1u << eCollectField_Comm | 1u << eCollectField_Mem;
+
+  const String record = collect_format(collector, snapshot, 2.0, {});
+  CollectFrameHeader header;
+  REQUIRE(record.length >= sizeof(header));
+  memcpy(&header, record.data, sizeof(header));
+  CHECK(header.magic == COLLECT_FRAME_MAGIC);
+  CHECK(header.version == COLLECT_FORMAT_VERSION);
+  CHECK(header.bytes == record.length);
+  CHECK(header.process_count == 1);
+  CHECK(header.total_processes == 4);
+  CHECK(header.time == 2.0);
+
+  const char *it =
+      record.data + sizeof(header) + COLLECT_SYSTEM_VALUES * sizeof(float);
+  int32_t pid;
+  memcpy(&pid, it, sizeof(pid));
+  it += sizeof(pid);
+  CHECK(pid == 20);
+  const uint8_t len = static_cast<uint8_t>(*it++);
+  CHECK(std::string(it, len) == "busy");
+  it += len;
+  float mem_kb;
+  memcpy(&mem_kb, it, sizeof(mem_kb));
+  it += sizeof(mem_kb);
+  CHECK(mem_kb == 8.0f);
+  CHECK(it == record.data + record.length);
+
+  collect_destroy(collector);
+  arena.destroy();
+}
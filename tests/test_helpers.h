@@ -37,9 +37,29 @@ struct SnapshotBuilder {
   GrowingArray<ProcessStat> stats;
   GrowingArray<ProcessDerivedStat> derived;
   size_t wasted = 0;
+  SystemCpuPerc cpu_perc = {};
+  MemInfo mem_info = {};
 
   explicit SnapshotBuilder(BumpArena &a) : arena(a), stats{}, derived{} {}
 
+  // All cores and `count` - 1 single ones, entry i at 10 * (i + 1) % with
+  // i + 1 % in the kernel
+  SnapshotBuilder &cpus(size_t count) {
+    cpu_perc.total = Array<double>::create(arena, count);
+    cpu_perc.kernel = Array<double>::create(arena, count);
+    for (size_t i = 0; i < count; ++i) {
+      cpu_perc.total.data[i] = 10.0 * (i + 1);
+      cpu_perc.kernel.data[i] = 1.0 * (i + 1);
+    }
+    return *this;
+  }
+
+  SnapshotBuilder &mem(ulong total_kb, ulong available_kb) {
+    mem_info.mem_total = total_kb;
+    mem_info.mem_available = available_kb;
+    return *this;
+  }
+
   SnapshotBuilder &add(int pid, int ppid, const char *comm, char state = 'S',
                        double cpu_user = 0.0, double cpu_kernel = 0.0,
                        double mem_bytes = 0.0) {
@@ -70,6 +90,8 @@ struct SnapshotBuilder {
     snapshot.stats.size = stats.size();
     snapshot.derived_stats.data = derived.data();
     snapshot.derived_stats.size = derived.size();
+    snapshot.cpu_perc = cpu_perc;
+    snapshot.mem_info = mem_info;
     return snapshot;
   }
 };
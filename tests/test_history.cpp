@@ -0,0 +1,435 @@
+#include "doctest.h"
+
+#include "history.h"
+#include "process_recorder.h"
+#include "state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// History Tests
+// ============================================================================
+
+namespace {
+
+struct HistoryFixture {
+  HistoryFixture() { g_history = {}; }
+  ~HistoryFixture() { g_history = {}; }
+};
+
+void push_samples(HistoryTimeline &timeline, HistorySeries &series,
+                  const double from, const double to, const double step,
+                  const double value) {
+  for (double t = from; t < to; t += step) {
+    history_push_time(timeline, t);
+    history_push(series, timeline, t, value);
+  }
+}
+
+} // namespace
+
+TEST_CASE_FIXTURE(HistoryFixture, "History rolls samples into buckets") {
+  HistoryTimeline timeline = {};
+  HistorySeries series = {};
+
+  // 20 samples in [0, 10) and the first sample of the next bucket
+  for (int i = 0; i <= 20; ++i) {
+    history_push_time(timeline, i * 0.5);
+    history_push(series, timeline, i * 0.5, i < 20 ? i : 100);
+  }
+
+  CHECK(timeline.times[0].live_size() == 21);
+  REQUIRE(timeline.times[1].live_size() == 1);
+  CHECK(timeline.times[1][0] == 5.0);
+  REQUIRE(series.buckets[1].live_size() == 1);
+  CHECK(series.buckets[1][0].min == 0.0);
+  CHECK(series.buckets[1][0].max == 19.0);
+  CHECK(series.buckets[1][0].avg == doctest::Approx(9.5));
+  CHECK(timeline.times[2].live_size() == 0);
+
+  history_destroy(series);
+  history_destroy(timeline);
+  CHECK(g_history.used_bytes == 0);
+}
+
+TEST_CASE_FIXTURE(HistoryFixture, "History trims data beyond retention") {
+  HistoryTimeline timeline = {};
+  HistorySeries series = {};
+  g_history.retention[0] = 120;
+
+  push_samples(timeline, series, 0, 3600, 0.5, 1.0);
+
+  const GorillaArray<double> &raw_times = timeline.times[0];
+  CHECK(raw_times[raw_times.begin()] >= 3600 - 0.5 - 120 - 0.5);
+  CHECK(series.raw.begin() == raw_times.begin());
+  // A few slabs per array at most, not the whole hour
+  CHECK(raw_times.total_byte_size() <= 6 * SLAB_SIZE);
+  CHECK(series.raw.total_byte_size() <= 6 * SLAB_SIZE);
+  // Coarser levels keep the whole hour
+  CHECK(timeline.times[1].live_size() == 359);
+  CHECK(series.buckets[1].live_size() == 359);
+
+  history_destroy(series);
+  history_destroy(timeline);
+  CHECK(g_history.used_bytes == 0);
+}
+
+TEST_CASE_FIXTURE(HistoryFixture, "History view picks the level by zoom") {
+  HistoryTimeline timeline = {};
+  HistorySeries series = {};
+  push_samples(timeline, series, 0, 3600, 0.5, 2.0);
+
+  SUBCASE("narrow range uses raw samples with one extra point per side") {
+    const HistoryView view = history_view(timeline, 3000, 3010, 0.01);
+    REQUIRE(view.span_count == 1);
+    CHECK(view.spans[0].level == 0);
+    CHECK(view.count == 22);
+    CHECK(history_view_time(view, 0) == 3000.0);
+    CHECK(history_view_time(view, view.count - 1) == 3010.5);
+    CHECK(history_view_value(view, series, 0) == 2.0);
+  }
+
+  SUBCASE("wide range uses buckets and raw samples after them") {
+    const HistoryView view = history_view(timeline, 0, HUGE_VAL, 60);
+    REQUIRE(view.span_count >= 2);
+    CHECK(view.spans[0].level == 2);
+    CHECK(view.spans[view.span_count - 1].level == 0);
+    double prev = -1;
+    for (size_t i = 0; i < view.count; ++i) {
+      const double t = history_view_time(view, i);
+      CHECK(t > prev);
+      prev = t;
+      CHECK(history_view_value(view, series, i) == 2.0);
+    }
+    CHECK(prev == 3599.5);
+  }
+
+  SUBCASE("older data comes from coarser levels") {
+    g_history.retention[0] = 120;
+    g_history.retention[1] = 600;
+    g_history.retention[2] = 1800;
+    push_samples(timeline, series, 3600, 4800, 0.5, 2.0);
+
+    const HistoryView view = history_view(timeline, 0, HUGE_VAL, 0.01);
+    REQUIRE(view.span_count == 4);
+    CHECK(view.spans[0].level == 3);
+    CHECK(view.spans[1].level == 2);
+    CHECK(view.spans[2].level == 1);
+    CHECK(view.spans[3].level == 0);
+    CHECK(history_view_time(view, 0) == 300);
+  }
+
+  history_destroy(series);
+  history_destroy(timeline);
+}
+
+TEST_CASE_FIXTURE(HistoryFixture, "History series share one timeline") {
+  HistoryTimeline timeline = {};
+  HistorySeries early = {};
+  HistorySeries late = {};
+  push_samples(timeline, early, 0, 30, 0.5, 1.0);
+
+  history_push_time(timeline, 30);
+  history_push(early, timeline, 30, 1.0);
+  history_push(late, timeline, 30, 5.0);
+
+  // The late series starts at the current sample instead of the first one
+  CHECK(late.raw.begin() == timeline.times[0].size() - 1);
+  CHECK(late.raw.live_size() == 1);
+  CHECK(late.raw[late.raw.begin()] == 5.0f);
+  CHECK(late.buckets[1].live_size() == 0);
+  CHECK(early.raw.size() == timeline.times[0].size());
+
+  const HistoryView view = history_view(timeline, 0, HUGE_VAL, 0.01);
+  CHECK(history_decimate(early, view, eHistoryDecimation_Avg).count == 61);
+  const HistoryDecimated &line =
+      history_decimate(late, view, eHistoryDecimation_Avg);
+  REQUIRE(line.count == 1);
+  CHECK(line.xs[0] == 30.0);
+
+  SUBCASE("values for unknown times are dropped") {
+    history_push(late, timeline, 12.25, 7.0);
+    history_push(late, timeline, 10.0, 7.0);
+    CHECK(late.raw.live_size() == 1);
+  }
+
+  SUBCASE("missed samples read as zeros") {
+    for (int i = 1; i <= 30; ++i) {
+      history_push_time(timeline, 30 + i * 0.5);
+      history_push(early, timeline, 30 + i * 0.5, 1.0);
+    }
+    history_push(late, timeline, 45, 5.0);
+    CHECK(late.raw.live_size() == 31);
+    CHECK(late.raw[late.raw.begin() + 1] == 0.0f);
+    // Buckets closed while the series was not pushed are filled as well
+    REQUIRE(late.buckets[1].live_size() == 1);
+    CHECK(late.buckets[1][late.buckets[1].begin()].max == 5.0f);
+  }
+
+  history_destroy(early);
+  history_destroy(late);
+  history_destroy(timeline);
+}
+
+TEST_CASE_FIXTURE(HistoryFixture, "History series can be backfilled") {
+  HistoryTimeline timeline = {};
+  HistorySeries live = {};
+  push_samples(timeline, live, 0, 120, 0.5, 3.0);
+
+  // As when a chart is opened with recorded samples
+  HistorySeries backfilled = {};
+  for (double t = 60; t < 120; t += 0.5) {
+    history_push(backfilled, timeline, t, 3.0);
+  }
+
+  CHECK(backfilled.raw.begin() == 120);
+  CHECK(backfilled.raw.size() == live.raw.size());
+  CHECK(backfilled.buckets[1].begin() == 6);
+  CHECK(backfilled.buckets[1].size() == live.buckets[1].size());
+  CHECK(backfilled.buckets[1][6].avg == 3.0f);
+  CHECK(backfilled.open[2].count == live.open[2].count);
+
+  history_destroy(live);
+  history_destroy(backfilled);
+  history_destroy(timeline);
+}
+
+TEST_CASE_FIXTURE(HistoryFixture, "History budget adjusts retention") {
+  g_history.budget_bytes = 1000;
+  g_history.used_bytes = 2000;
+  history_enforce_budget();
+  CHECK(g_history.retention[0] < HISTORY_DEFAULT_RETENTION[0]);
+
+  for (int i = 0; i < 100; ++i) {
+    history_enforce_budget();
+  }
+  for (size_t l = 0; l < HISTORY_LEVELS; ++l) {
+    CHECK(g_history.retention[l] == HISTORY_MIN_RETENTION[l]);
+  }
+
+  g_history.used_bytes = 100;
+  for (int i = 0; i < 100; ++i) {
+    history_enforce_budget();
+  }
+  for (size_t l = 0; l < HISTORY_LEVELS; ++l) {
+    CHECK(g_history.retention[l] == HISTORY_DEFAULT_RETENTION[l]);
+  }
+  g_history.used_bytes = 0;
+}
+
+TEST_CASE_FIXTURE(HistoryFixture, "History decimation keeps the envelope") {
+  HistoryTimeline timeline = {};
+  HistorySeries series = {};
+  // Alternates between 0 and 10 with a single spike
+  for (int i = 0; i < 1000; ++i) {
+    history_push_time(timeline, i * 0.5);
+    history_push(series, timeline, i * 0.5, i == 501 ? 99 : (i % 2) * 10);
+  }
+
+  // 100 columns of 5 seconds for the whole range
+  const HistoryView view = history_view(timeline, 0, 500, 5);
+  REQUIRE(view.count == 1000);
+
+  SUBCASE("min/max has at most two points per column") {
+    const HistoryDecimated &line =
+        history_decimate(series, view, eHistoryDecimation_MinMax);
+    CHECK(line.count == 200);
+    double max = 0;
+    for (size_t i = 0; i < line.count; ++i) {
+      CHECK(line.ys[i] >= 0);
+      max = std::max(max, line.ys[i]);
+      if (i > 0) CHECK(line.xs[i] > line.xs[i - 1]);
+    }
+    CHECK(max == 99);
+  }
+
+  SUBCASE("max and avg have one point per column") {
+    const HistoryDecimated &shade =
+        history_decimate(series, view, eHistoryDecimation_Max);
+    CHECK(shade.count == 100);
+    CHECK(shade.ys[0] == 10);
+    CHECK(shade.ys[50] == 99);
+
+    const HistoryDecimated &avg =
+        history_decimate(series, view, eHistoryDecimation_Avg);
+    CHECK(avg.count == 100);
+    CHECK(avg.ys[0] == doctest::Approx(5));
+    CHECK(avg.xs[0] == doctest::Approx(2.25));
+  }
+
+  SUBCASE("zoomed in keeps every sample") {
+    const HistoryView zoomed = history_view(timeline, 100, 110, 0.1);
+    const HistoryDecimated &line =
+        history_decimate(series, zoomed, eHistoryDecimation_MinMax);
+    CHECK(line.count == zoomed.count);
+    CHECK(line.xs[0] == 100);
+  }
+
+  SUBCASE("cached until new samples arrive or the view changes") {
+    const HistoryDecimated &line =
+        history_decimate(series, view, eHistoryDecimation_MinMax);
+    const double *xs = line.xs;
+    const size_t count = line.count;
+
+    // Poison the result: a cache hit must not recompute it
+    const_cast<double *>(line.ys)[0] = -1;
+    CHECK(history_decimate(series, view, eHistoryDecimation_MinMax).ys[0] ==
+          -1);
+
+    const HistoryView other = history_view(timeline, 0, 500, 2.5);
+    CHECK(history_decimate(series, other, eHistoryDecimation_MinMax).ys[0] ==
+          0);
+
+    history_push_time(timeline, 500);
+    history_push(series, timeline, 500, 0);
+    const HistoryView next = history_view(timeline, 0, 500, 5);
+    const HistoryDecimated &updated =
+        history_decimate(series, next, eHistoryDecimation_MinMax);
+    CHECK(updated.xs == xs);
+    CHECK(updated.count == count + 1);
+  }
+
+  history_destroy(series);
+  history_destroy(timeline);
+}
+
+// ============================================================================
+// Process Recorder Tests
+// ============================================================================
+
+namespace {
+
+struct RecorderInput {
+  ProcessStat stats[4];
+  ProcessDerivedStat derived[4];
+  size_t count;
+
+  void add(const int pid, const ulonglong starttime, const double cpu) {
+    stats[count] = {};
+    stats[count].pid = pid;
+    stats[count].starttime = starttime;
+    derived[count] = {};
+    derived[count].cpu_user_perc = cpu;
+    derived[count].mem_resident_bytes = 4096.0 * pid;
+    derived[count].io_read_kb_per_sec = cpu * 10;
+    ++count;
+  }
+
+  StateSnapshot snapshot() {
+    StateSnapshot res = {};
+    res.stats = {stats, count};
+    res.derived_stats = {derived, count};
+    return res;
+  }
+};
+
+std::vector<std::pair<double, double>> replay_cpu(const ProcessRecorder &rec,
+                                                  const int pid) {
+  std::vector<std::pair<double, double>> res;
+  process_recorder_replay(
+      rec, pid, [&](const double at, const ProcessDerivedStat &d) {
+        res.emplace_back(at, d.cpu_user_perc + d.cpu_kernel_perc);
+      });
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("Process recorder quantizes samples") {
+  ProcessDerivedStat derived = {};
+  derived.cpu_user_perc = 12.3;
+  derived.cpu_kernel_perc = 4.56;
+  derived.mem_resident_bytes = 123456 * 1024.0;
+  derived.io_read_kb_per_sec = 1000;
+  derived.net_send_kb_per_sec = 0.125;
+
+  RecorderInput input = {};
+  input.add(1, 100, 0);
+  input.derived[0] = derived;
+  ProcessRecorder recorder = {};
+  const StateSnapshot snapshot = input.snapshot();
+  process_recorder_update(recorder, snapshot, 1.0);
+
+  ProcessDerivedStat res = {};
+  process_recorder_replay(
+      recorder, 1, [&](double, const ProcessDerivedStat &d) { res = d; });
+  CHECK(res.cpu_kernel_perc == doctest::Approx(4.5).epsilon(0.01));
+  CHECK(res.cpu_user_perc + res.cpu_kernel_perc ==
+        doctest::Approx(16.86).epsilon(0.01));
+  CHECK(res.mem_resident_bytes == 123456 * 1024.0);
+  CHECK(res.io_read_kb_per_sec == doctest::Approx(1000).epsilon(0.01));
+  CHECK(res.net_send_kb_per_sec == 0.125);
+  // A page even for one sample
+  CHECK(process_recorder_byte_size(recorder) == SLAB_SIZE);
+
+  process_recorder_destroy(recorder);
+}
+
+TEST_CASE("Process recorder keeps history per pid and starttime") {
+  ProcessRecorder recorder = {};
+  for (int i = 0; i < 3; ++i) {
+    RecorderInput input = {};
+    input.add(10, 100, i);
+    input.add(20, 200, 50);
+    const StateSnapshot snapshot = input.snapshot();
+    process_recorder_update(recorder, snapshot, i);
+  }
+
+  const auto history = replay_cpu(recorder, 10);
+  REQUIRE(history.size() == 3);
+  CHECK(history[0] == std::make_pair(0.0, 0.0));
+  CHECK(history[2] == std::make_pair(2.0, 2.0));
+  CHECK(replay_cpu(recorder, 30).empty());
+
+  SUBCASE("a reused pid starts over") {
+    RecorderInput input = {};
+    input.add(10, 300, 7);
+    input.add(20, 200, 50);
+    const StateSnapshot snapshot = input.snapshot();
+    process_recorder_update(recorder, snapshot, 3);
+
+    const auto reused = replay_cpu(recorder, 10);
+    REQUIRE(reused.size() == 1);
+    CHECK(reused[0] == std::make_pair(3.0, 7.0));
+    CHECK(replay_cpu(recorder, 20).size() == 4);
+  }
+
+  SUBCASE("slots of exited processes are reused") {
+    RecorderInput input = {};
+    input.add(20, 200, 50);
+    input.add(30, 400, 1);
+    const StateSnapshot snapshot = input.snapshot();
+    process_recorder_update(recorder, snapshot, 3);
+
+    CHECK(recorder.used_slots == 2);
+    // Slots are apart, each touched its own page
+    CHECK(process_recorder_byte_size(recorder) == 2 * SLAB_SIZE);
+    CHECK(replay_cpu(recorder, 10).empty());
+    CHECK(replay_cpu(recorder, 30).size() == 1);
+  }
+
+  process_recorder_destroy(recorder);
+}
+
+TEST_CASE("Process recorder keeps the last samples of the ring") {
+  ProcessRecorder recorder = {};
+  const size_t total = RECORDER_SAMPLES + 10;
+  for (size_t i = 0; i < total; ++i) {
+    RecorderInput input = {};
+    input.add(1, 100, static_cast<double>(i % 100));
+    const StateSnapshot snapshot = input.snapshot();
+    process_recorder_update(recorder, snapshot, static_cast<double>(i));
+  }
+
+  const auto history = replay_cpu(recorder, 1);
+  REQUIRE(history.size() == RECORDER_SAMPLES);
+  CHECK(history.front().first == 10.0);
+  CHECK(history.back().first == total - 1.0);
+  // The ring of one slot spans 5 pages
+  CHECK(process_recorder_byte_size(recorder) == 5 * SLAB_SIZE);
+
+  process_recorder_destroy(recorder);
+}
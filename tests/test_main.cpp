@@ -2,8 +2,12 @@
 #include "doctest.h"
 
 #include "base.h"
+#include "gorilla.h"
 #include "ring_buffer.h"
 
+#include <algorithm>
+#include <cmath>
+
 // ============================================================================
 // BumpArena Tests
 // ============================================================================
@@ -47,11 +51,59 @@ TEST_CASE("BumpArena large allocation") {
   REQUIRE(p != nullptr);
   REQUIRE(arena.cur_slab != nullptr);
 
-  CHECK(arena.cur_slab->left_size == 0);
+  // Rounded up to the next cached size, 2 slabs of data and the header
+  CHECK(arena.cur_slab->total_size == SLAB_SIZE * 4);
+  CHECK(arena.cur_slab->left_size ==
+        SLAB_SIZE * 4 - sizeof(ArenaSlab) - large_size);
 
   arena.destroy();
 }
 
+TEST_CASE("Large slabs are reused") {
+  ArenaSlab *slab = ArenaSlab::create(SLAB_SIZE * 3);
+  REQUIRE(slab != nullptr);
+  CHECK(slab->total_size == SLAB_SIZE * 4);
+  memset(slab->advance(100), 0xff, 100);
+  ArenaSlab::release(slab);
+
+  const size_t mapped = g_mapped_slabs.load();
+  ArenaSlab *again = ArenaSlab::create(SLAB_SIZE * 4);
+  CHECK(again == slab);
+  CHECK(g_mapped_slabs.load() == mapped);
+  CHECK(again->left_size == SLAB_SIZE * 4 - sizeof(ArenaSlab));
+  // Cached slabs come back zeroed like fresh mappings
+  const uint8_t *data = static_cast<const uint8_t *>(again->cur);
+  CHECK(std::all_of(data, data + 100, [](uint8_t b) { return b == 0; }));
+  ArenaSlab::release(again);
+}
+
+TEST_CASE("Large slab caches are capped and give pages back") {
+  constexpr size_t SIZE = 4 * 1024 * 1024;
+  const size_t cls = large_slab_class(SIZE);
+  SlabCache &cache = g_large_slab_caches[cls];
+  REQUIRE(large_slab_cache_slabs(cls) == 2);
+
+  ArenaSlab *slabs[3];
+  for (ArenaSlab *&slab : slabs) {
+    slab = ArenaSlab::create(SIZE);
+    REQUIRE(slab != nullptr);
+    memset(slab->cur, 0xff, slab->left_size);
+  }
+  for (ArenaSlab *slab : slabs) {
+    ArenaSlab::release(slab);
+  }
+  CHECK(cache.size.load() == 2);
+
+  // Zeroed by dropping the pages, not by writing them
+  ArenaSlab *again = ArenaSlab::create(SIZE);
+  const uint8_t *data = static_cast<const uint8_t *>(again->cur);
+  for (size_t i = 0; i < again->left_size; i += SLAB_SIZE / 2) {
+    REQUIRE(data[i] == 0);
+  }
+  CHECK(data[again->left_size - 1] == 0);
+  ArenaSlab::release(again);
+}
+
 TEST_CASE("BumpArena destroy and reuse") {
   BumpArena arena = BumpArena::create();
 
@@ -192,6 +244,232 @@ TEST_CASE("GrowingArray basic operations") {
   arena.destroy();
 }
 
+// ============================================================================
+// ChunkedArray Tests
+// ============================================================================
+
+TEST_CASE("ChunkedArray basic operations") {
+  SUBCASE("emplace_back and index across chunks") {
+    ChunkedArray<double> arr = {};
+    const size_t count = ChunkedArray<double>::CHUNK_SIZE * 3 + 7;
+    for (size_t i = 0; i < count; ++i) {
+      *arr.emplace_back() = static_cast<double>(i);
+    }
+
+    CHECK(arr.size() == count);
+    CHECK(arr.chunk_count() == 4);
+    for (size_t i = 0; i < count; ++i) {
+      CHECK(arr[i] == static_cast<double>(i));
+    }
+    CHECK(arr.last_or(-1.0) == static_cast<double>(count - 1));
+
+    arr.destroy();
+    CHECK(arr.size() == 0);
+    CHECK(arr.last_or(-1.0) == -1.0);
+  }
+
+  SUBCASE("elements never move when growing") {
+    ChunkedArray<int> arr = {};
+    int *first = arr.emplace_back();
+    *first = 42;
+    for (size_t i = 0; i < ChunkedArray<int>::CHUNK_SIZE * 600; ++i) {
+      *arr.emplace_back() = 0;
+    }
+
+    // Chunk index outgrew a single slab, the chunks themselves stayed put
+    CHECK(arr.chunk_capacity() > SLAB_SIZE / sizeof(int *));
+    CHECK(&arr[0] == first);
+    CHECK(*first == 42);
+
+    arr.destroy();
+  }
+
+  SUBCASE("chunks are contiguous spans") {
+    ChunkedArray<int> arr = {};
+    const size_t count = ChunkedArray<int>::CHUNK_SIZE + 3;
+    for (size_t i = 0; i < count; ++i) {
+      *arr.emplace_back() = static_cast<int>(i);
+    }
+
+    REQUIRE(arr.chunk_count() == 2);
+    const Array<const int> first = arr.chunk(0);
+    const Array<const int> second = arr.chunk(1);
+    CHECK(first.size == ChunkedArray<int>::CHUNK_SIZE);
+    CHECK(second.size == 3);
+    CHECK(first.data[1] == 1);
+    CHECK(second.data[0] == static_cast<int>(ChunkedArray<int>::CHUNK_SIZE));
+
+    int copy[ChunkedArray<int>::CHUNK_SIZE + 3];
+    arr.copy_to(copy, 0, count);
+    for (size_t i = 0; i < count; ++i) {
+      CHECK(copy[i] == static_cast<int>(i));
+    }
+
+    arr.destroy();
+  }
+
+  SUBCASE("drop_front releases old chunks and keeps indices") {
+    ChunkedArray<double> arr = {};
+    const size_t chunk = ChunkedArray<double>::CHUNK_SIZE;
+    for (size_t i = 0; i < chunk * 3; ++i) {
+      *arr.emplace_back() = static_cast<double>(i);
+    }
+
+    arr.drop_front(chunk / 2);
+    CHECK(arr.begin() == chunk / 2);
+    CHECK(arr.total_byte_size() == 3 * SLAB_SIZE + SLAB_SIZE);
+
+    arr.drop_front(chunk * 2 + 1);
+    CHECK(arr.begin() == chunk * 2 + 1);
+    CHECK(arr.live_size() == chunk - 1);
+    CHECK(arr.total_byte_size() == SLAB_SIZE + SLAB_SIZE);
+    CHECK(arr[chunk * 2 + 1] == static_cast<double>(chunk * 2 + 1));
+    CHECK(arr.chunk(2).size == chunk - 1);
+
+    // Never moves backwards
+    arr.drop_front(0);
+    CHECK(arr.begin() == chunk * 2 + 1);
+
+    *arr.emplace_back() = -1.0;
+    CHECK(arr[chunk * 3] == -1.0);
+    CHECK(arr.last_or(0) == -1.0);
+
+    arr.drop_front(arr.size());
+    CHECK(arr.live_size() == 0);
+    CHECK(arr.last_or(0) == 0);
+
+    arr.destroy();
+  }
+
+  SUBCASE("start_at begins an empty array at any index") {
+    ChunkedArray<float> arr = {};
+    const size_t chunk = ChunkedArray<float>::CHUNK_SIZE;
+    arr.start_at(chunk * 5 + 3);
+    CHECK(arr.begin() == chunk * 5 + 3);
+    CHECK(arr.live_size() == 0);
+    CHECK(!arr.contains(chunk * 5 + 3));
+
+    for (size_t i = 0; i < chunk; ++i) {
+      *arr.emplace_back() = static_cast<float>(i);
+    }
+    CHECK(arr.contains(chunk * 5 + 3));
+    CHECK(!arr.contains(chunk * 5 + 2));
+    CHECK(arr[chunk * 5 + 3] == 0.0f);
+    CHECK(arr[chunk * 6 + 2] == static_cast<float>(chunk - 1));
+    CHECK(arr.total_byte_size() == 2 * SLAB_SIZE + SLAB_SIZE);
+
+    arr.destroy();
+  }
+}
+
+// ============================================================================
+// Gorilla Tests
+// ============================================================================
+
+TEST_CASE("Gorilla blocks round trip") {
+  uint8_t buf[GORILLA_MAX_BLOCK_BYTES];
+
+  SUBCASE("times with jitter keep millisecond precision") {
+    double times[GORILLA_BLOCK];
+    double decoded[GORILLA_BLOCK];
+    for (size_t i = 0; i < GORILLA_BLOCK; ++i) {
+      const double jitter = (i * 7919 % 13) * 0.001;
+      times[i] = std::round((1.7e9 + i * 0.5 + jitter) * 1000) / 1000;
+    }
+    times[100] += 86400; // a long pause
+
+    const size_t bytes = gorilla_encode(times, buf);
+    CHECK(bytes < GORILLA_BLOCK * 2);
+    gorilla_decode(buf, decoded);
+    for (size_t i = 0; i < GORILLA_BLOCK; ++i) {
+      CHECK(decoded[i] == times[i]);
+    }
+  }
+
+  SUBCASE("regular times take about a bit each") {
+    double times[GORILLA_BLOCK];
+    for (size_t i = 0; i < GORILLA_BLOCK; ++i) {
+      times[i] = 1.7e9 + i * 0.5;
+    }
+    CHECK(gorilla_encode(times, buf) <= 8 + 2 + GORILLA_BLOCK / 8 + 1);
+  }
+
+  SUBCASE("values are exact") {
+    float values[GORILLA_BLOCK];
+    float decoded[GORILLA_BLOCK];
+    for (size_t i = 0; i < GORILLA_BLOCK; ++i) {
+      values[i] = i % 3 == 0 ? 0.0f : static_cast<float>(i * i) * 0.37f;
+    }
+    values[5] = -1e30f;
+    values[6] = INFINITY;
+
+    gorilla_encode(values, buf);
+    gorilla_decode(buf, decoded);
+    CHECK(memcmp(values, decoded, sizeof(values)) == 0);
+  }
+
+  SUBCASE("repeated values take a bit each") {
+    float values[GORILLA_BLOCK];
+    for (size_t i = 0; i < GORILLA_BLOCK; ++i) {
+      values[i] = 42.5f;
+    }
+    CHECK(gorilla_encode(values, buf) == 4 + (GORILLA_BLOCK - 1 + 7) / 8);
+  }
+}
+
+TEST_CASE("GorillaArray basic operations") {
+  // Noisy values, so the encoded blocks need several slabs
+  const auto value_at = [](size_t i) {
+    return static_cast<float>(i * 2654435761u % 10007) / 7;
+  };
+  GorillaArray<float> arr = {};
+  const size_t count = GORILLA_BLOCK * 40 + 7;
+  for (size_t i = 0; i < count; ++i) {
+    *arr.emplace_back() = value_at(i);
+  }
+
+  CHECK(arr.size() == count);
+  CHECK(arr.blocks.size() == 40);
+  for (size_t i = 0; i < count; i += 37) {
+    CHECK(arr[i] == value_at(i));
+  }
+  CHECK(arr.last_or(-1) == value_at(count - 1));
+
+  SUBCASE("drop_front releases whole blocks") {
+    const size_t before = arr.total_byte_size();
+    arr.drop_front(GORILLA_BLOCK * 39 + 1);
+    CHECK(arr.blocks.begin() == 39);
+    CHECK(arr.live_size() == GORILLA_BLOCK - 1 + 7);
+    CHECK(arr.total_byte_size() < before);
+    CHECK(arr[GORILLA_BLOCK * 39 + 1] == value_at(GORILLA_BLOCK * 39 + 1));
+  }
+
+  SUBCASE("slowly changing values compress well") {
+    GorillaArray<float> steps = {};
+    for (size_t i = 0; i < count; ++i) {
+      *steps.emplace_back() = static_cast<float>(i / 10);
+    }
+    CHECK(steps.encoded_byte_size() < count);
+    CHECK(steps[count - 1] == static_cast<float>((count - 1) / 10));
+    steps.destroy();
+  }
+
+  SUBCASE("start_at leaves earlier blocks empty") {
+    GorillaArray<double> late = {};
+    late.start_at(GORILLA_BLOCK * 3 + 5);
+    for (size_t i = 0; i < GORILLA_BLOCK * 2; ++i) {
+      *late.emplace_back() = i * 0.5;
+    }
+    CHECK(late.blocks.begin() == 3);
+    CHECK(late[GORILLA_BLOCK * 3 + 5] == 0.0);
+    CHECK(late[GORILLA_BLOCK * 5 + 4] == (GORILLA_BLOCK * 2 - 1) * 0.5);
+    late.destroy();
+  }
+
+  arr.destroy();
+  CHECK(arr.size() == 0);
+}
+
 // ============================================================================
 // LinkedList Tests
 // ============================================================================
@@ -0,0 +1,168 @@
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include "metrics.h"
+#include "sources/process_stat.h"
+#include "sources/sync.h"
+
+#include <cstdio>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// ============================================================================
+// Metrics Tests
+// ============================================================================
+
+namespace {
+
+StateSnapshot make_snapshot(BumpArena &arena) {
+  StateSnapshot snapshot = SnapshotBuilder(arena)
+                               .add(1, 0, "init", 'S', 0.5, 0.0, 4096)
+                               .add(20, 1, "busy", 'R', 80.0, 10.0, 8192)
+                               .add(30, 1, "say \"hi\"\\", 'S', 5.0, 0.0, 1)
+                               .add(40, 1, "big", 'S', 0.0, 0.0, 65536)
+                               .cpus(3)
+                               .mem(1000, 400)
+                               .build();
+  snapshot.net_io_rate.recv_mb_per_sec = 1.0;
+  return snapshot;
+}
+
+bool contains(const std::string &page, const char *line) {
+  return page.find(line) != std::string::npos;
+}
+
+// Connected to the unix socket `address`, -1 on failure
+int connect_unix(const char *address) {
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", address + 5);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// GET `path` on the unix socket `address`, the whole response
+std::string http_get(const char *address, const char *path) {
+  const int fd = connect_unix(address);
+  if (fd < 0) return "";
+  char request[128];
+  const int len =
+      snprintf(request, sizeof(request),
+               "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+  std::string response;
+  if (send(fd, request, len, 0) == len) {
+    char chunk[4096];
+    ssize_t n;
+    while ((n = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+      response.append(chunk, n);
+    }
+  }
+  close(fd);
+  return response;
+}
+
+} // namespace
+
+TEST_CASE("Metrics page") {
+  BumpArena arena = BumpArena::create();
+  const StateSnapshot snapshot = make_snapshot(arena);
+  MetricsExporter exporter = {};
+  exporter.top = 2;
+
+  const String page = metrics_render(exporter, snapshot);
+  const std::string text(page.data, page.length);
+  CHECK(text.rfind("# TYPE prock_cpu_percent gauge\n", 0) == 0);
+  CHECK(text.size() > 6);
+  CHECK(text.compare(text.size() - 6, 6, "# EOF\n") == 0);
+  CHECK(contains(text, "\nprock_cpu_percent{cpu=\"all\"} 10.00\n"));
+  CHECK(contains(text, "\nprock_cpu_percent{cpu=\"1\"} 30.00\n"));
+  CHECK(contains(text, "\nprock_cpu_kernel_percent{cpu=\"0\"} 2.00\n"));
+  CHECK(contains(text, "\nprock_memory_bytes{kind=\"total\"} 1024000\n"));
+  CHECK(contains(text, "\nprock_network_receive_bytes_per_second 1048576\n"));
+  CHECK(contains(text, "\nprock_processes 4\n"));
+
+  // Top 2 of each ranking, comm escaped
+  CHECK(contains(text, "\nprock_process_cpu_percent{pid=\"20\",comm=\"busy\"} "
+                       "90.00\nprock_process_cpu_percent{pid=\"30\","
+                       "comm=\"say \\\"hi\\\"\\\\\"} 5.00\n"));
+  CHECK_FALSE(contains(text, "prock_process_cpu_percent{pid=\"1\""));
+  CHECK(contains(text, "\nprock_process_resident_bytes{pid=\"40\",comm=\"big\"}"
+                       " 65536\nprock_process_resident_bytes{pid=\"20\","
+                       "comm=\"busy\"} 8192\n"));
+  CHECK_FALSE(contains(text, "prock_process_resident_bytes{pid=\"1\""));
+
+  // Later scrapes reuse the buffer
+  const String again = metrics_render(exporter, snapshot);
+  CHECK(again.data == page.data);
+  CHECK(std::string(again.data, again.length) == text);
+
+  metrics_exporter_destroy(exporter);
+  arena.destroy();
+}
+
+TEST_CASE("Metrics endpoint") {
+  char address[64];
+  snprintf(address, sizeof(address), "unix:/tmp/prock_metrics_%d", getpid());
+  Sync sync{};
+  sync.update_period.store(0.02f);
+  static MetricsServer server; // too big for the stack
+  REQUIRE(metrics_listen(server, address, 5));
+  server.request_timeout = std::chrono::milliseconds(100);
+
+  State state = {};
+  state.system.ticks_in_second = 100;
+  state.system.mem_page_size = 4096;
+  std::thread gathering{[&] {
+    GatheringState gathering_state = {};
+    while (!sync.quit.load()) {
+      gather(gathering_state, sync);
+      metrics_notify(server);
+    }
+  }};
+  std::thread serving{[&] { metrics_serve(server, state, sync); }};
+
+  std::string response = http_get(address, "/metrics");
+  for (int i = 0; i < 100 && response.find(" 503 ") != std::string::npos;
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    response = http_get(address, "/metrics");
+  }
+  CHECK(response.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+  CHECK(contains(response, "Content-Type: application/openmetrics-text; "
+                           "version=1.0.0; charset=utf-8\r\n"));
+  CHECK(contains(response, "\nprock_cpu_percent{cpu=\"all\"} "));
+  CHECK(contains(response, "\nprock_memory_bytes{kind=\"available\"} "));
+  CHECK(contains(response, "\nprock_process_cpu_percent{pid=\""));
+  CHECK(response.compare(response.size() - 6, 6, "# EOF\n") == 0);
+
+  CHECK(http_get(address, "/").rfind("HTTP/1.1 404 ", 0) == 0);
+
+  // Connections that never send a request don't lock scrapers out
+  int idle[METRICS_MAX_CLIENTS];
+  for (int &fd : idle) {
+    fd = connect_unix(address);
+    REQUIRE(fd >= 0);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  for (const int fd : idle) {
+    char byte;
+    CHECK(recv(fd, &byte, 1, 0) == 0);
+    close(fd);
+  }
+  CHECK(http_get(address, "/").rfind("HTTP/1.1 404 ", 0) == 0);
+
+  sync.quit.store(true);
+  sync.quit_cv.notify_one();
+  gathering.join();
+  metrics_notify(server);
+  serving.join();
+  metrics_server_close(server);
+  state.snapshot_arena.destroy();
+}
@@ -0,0 +1,168 @@
+#include "doctest.h"
+
+#include "proc_fixture.h"
+#include "sources/environ_reader.h"
+#include "sources/library_reader.h"
+#include "sources/sync.h"
+
+#include <string>
+#include <unistd.h>
+
+// ============================================================================
+// Procfs Root Tests
+// ============================================================================
+
+TEST_CASE("Gathering from a procfs fixture") {
+  char root[] = "/tmp/prock_proc_XXXXXX";
+  REQUIRE(mkdtemp(root));
+  ProcFixtureOptions options = proc_fixture_default_options();
+  options.processes = 64;
+  options.cpus = 4;
+  options.max_depth = 5;
+  options.fds = 6;
+  options.heavy_threads = 5;
+  REQUIRE(proc_fixture_write(root, options));
+  g_proc_root = root;
+
+  Sync sync{};
+  sync.update_period.store(0.001f);
+  sync.watched_pids[0].store(32);
+  sync.watched_pids_count.store(1);
+  GatheringState gathering_state = {};
+  gather(gathering_state, sync);
+  UpdateSnapshot snapshot;
+  REQUIRE(sync.update_queue.pop(snapshot));
+
+  const Array<ProcessStat> &stats = snapshot.stats;
+  REQUIRE(stats.size == options.processes);
+  for (size_t i = 0; i < stats.size; ++i) {
+    CHECK(stats.data[i].pid == static_cast<int>(i + 1));
+  }
+  CHECK(std::string(stats.data[0].comm) == "systemd");
+  CHECK(stats.data[0].ppid == 0);
+  CHECK(stats.data[31].num_threads == 5);
+  CHECK(stats.data[1].statm_resident > 0);
+  CHECK(stats.data[1].io_read_bytes > 0);
+  CHECK(stats.data[1].sched_run_ns == 2 * 1000003);
+  CHECK(stats.data[1].sched_timeslices == 3);
+  // The first gather reads the status
+  const ProcessStatus &status = stats.data[1].status;
+  CHECK(status.voluntary_ctxt_switches == 62);
+  CHECK(status.nonvoluntary_ctxt_switches == 2);
+  CHECK(status.vm_hwm_kb == stats.data[1].statm_resident * 4 + 2);
+  CHECK(status.vm_swap_kb == 0);
+  CHECK(status.cpus_allowed == options.cpus);
+  CHECK(stats.data[6].status.vm_swap_kb == 7);
+
+  // The process tree goes down to max_depth and not further
+  size_t deepest = 0;
+  for (size_t i = 0; i < stats.size; ++i) {
+    size_t depth = 0;
+    for (int pid = stats.data[i].pid; pid != 1; ++depth) {
+      pid = stats.data[pid - 1].ppid;
+    }
+    deepest = std::max(deepest, depth);
+  }
+  CHECK(deepest == options.max_depth);
+
+  REQUIRE(snapshot.cpu_stats.size == options.cpus + 1);
+  const Array<CpuCoreStat> &cpus = snapshot.cpu_stats;
+  CHECK(cpus.data[0].user == cpus.data[1].user + cpus.data[2].user +
+                                 cpus.data[3].user + cpus.data[4].user);
+  CHECK(snapshot.mem_info.mem_total == 32768000);
+  CHECK(snapshot.mem_info.swap_free == 8000000);
+  // Only whole disks (sda, nvme0n1) and no loopback
+  CHECK(snapshot.disk_io_stats.sectors_read >= 2000000);
+  CHECK(snapshot.disk_io_stats.sectors_read < 4000000);
+  CHECK(snapshot.net_io_stats.bytes_received >= 200000000);
+  CHECK(snapshot.net_io_stats.bytes_received < 400000000);
+
+  REQUIRE(snapshot.thread_snapshots.size == 1);
+  const Array<ProcessStat> &threads = snapshot.thread_snapshots.data[0].threads;
+  REQUIRE(threads.size == 5);
+  CHECK(threads.data[0].pid == 32);
+  CHECK(threads.data[1].pid > static_cast<int>(options.processes));
+  // Multi-threaded processes sum the schedstat of their threads
+  ulonglong thread_run_ns = 0;
+  for (size_t i = 0; i < threads.size; ++i) {
+    CHECK(threads.data[i].sched_run_ns > 0);
+    thread_run_ns += threads.data[i].sched_run_ns;
+  }
+  CHECK(stats.data[31].sched_run_ns == thread_run_ns);
+  snapshot.owner_arena.destroy();
+
+  BumpArena temp_arena = BumpArena::create();
+  LibraryResponse libraries = read_process_libraries(temp_arena, {2});
+  CHECK(libraries.error_code == 0);
+  CHECK(libraries.libraries.size == 5);
+  libraries.owner_arena.destroy();
+  EnvironResponse environ_response = read_process_environ(temp_arena, {2});
+  CHECK(environ_response.error_code == 0);
+  CHECK(environ_response.entries.size == 5);
+  environ_response.owner_arena.destroy();
+  temp_arena.destroy();
+
+  g_proc_root = "/proc";
+  CHECK(proc_fixture_remove(root));
+  CHECK(access(root, F_OK) != 0);
+}
+
+TEST_CASE("Status is read every few gathers unless wanted") {
+  char root[] = "/tmp/prock_status_XXXXXX";
+  REQUIRE(mkdtemp(root));
+  ProcFixtureOptions options = proc_fixture_default_options();
+  options.processes = 4;
+  REQUIRE(proc_fixture_write(root, options));
+  g_proc_root = root;
+
+  Sync sync{};
+  sync.update_period.store(0.001f);
+  GatheringState gathering_state = {};
+  UpdateSnapshot snapshot;
+  // Status of pid 2 after a gather
+  const auto gather_status = [&] {
+    gather(gathering_state, sync);
+    REQUIRE(sync.update_queue.pop(snapshot));
+    REQUIRE(snapshot.stats.size == options.processes);
+    const ProcessStatus res = snapshot.stats.data[1].status;
+    snapshot.owner_arena.destroy();
+    return res;
+  };
+  const auto write_switches = [&root](const int count) {
+    const std::string path = std::string(root) + "/2/status";
+    FILE *file = fopen(path.c_str(), "w");
+    REQUIRE(file);
+    fprintf(file, "VmHWM:\t 100 kB\nCpus_allowed_list:\t0-3,8,10-11\n"
+                  "voluntary_ctxt_switches:\t%d\n",
+            count);
+    fclose(file);
+  };
+
+  const ProcessStatus first = gather_status();
+  CHECK(first.voluntary_ctxt_switches == 62);
+  CHECK(first.read_at != SteadyTimePoint{});
+
+  // Carried over as it was until the next read
+  write_switches(1000);
+  for (uint i = 1; i < STATUS_EVERY_GATHERS; ++i) {
+    const ProcessStatus carried = gather_status();
+    CHECK(carried.voluntary_ctxt_switches == 62);
+    CHECK(carried.read_at == first.read_at);
+  }
+  ProcessStatus status = gather_status();
+  CHECK(status.voluntary_ctxt_switches == 1000);
+  CHECK(status.vm_hwm_kb == 100);
+  CHECK(status.cpus_allowed == 7);
+  CHECK(status.read_at > first.read_at);
+
+  // Read on every gather while wanted
+  sync.status_wanted.store(true);
+  write_switches(2000);
+  CHECK(gather_status().voluntary_ctxt_switches == 2000);
+  write_switches(3000);
+  CHECK(gather_status().voluntary_ctxt_switches == 3000);
+
+  gathering_state.status_arena.destroy();
+  g_proc_root = "/proc";
+  CHECK(proc_fixture_remove(root));
+}
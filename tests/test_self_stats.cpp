@@ -0,0 +1,173 @@
+#include "doctest.h"
+
+#include "proc_fixture.h"
+#include "self_stats.h"
+#include "sources/sync.h"
+
+#include <thread>
+#include <unistd.h>
+
+// ============================================================================
+// Self Stats Tests
+// ============================================================================
+
+TEST_CASE("SampleWindow keeps the last samples oldest first") {
+  static SampleWindow window;
+  float samples[SELF_STATS_SAMPLES];
+  CHECK(window.copy(samples) == 0);
+
+  window.add(1.0f);
+  window.add(2.0f);
+  REQUIRE(window.copy(samples) == 2);
+  CHECK(samples[0] == 1.0f);
+  CHECK(samples[1] == 2.0f);
+
+  for (size_t i = 0; i < SELF_STATS_SAMPLES; ++i) {
+    window.add(static_cast<float>(i + 10));
+  }
+  REQUIRE(window.copy(samples) == SELF_STATS_SAMPLES);
+  CHECK(samples[0] == 10.0f);
+  CHECK(samples[SELF_STATS_SAMPLES - 1] ==
+        static_cast<float>(SELF_STATS_SAMPLES + 9));
+}
+
+TEST_CASE("sample_percentile of sorted samples") {
+  const float sorted[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  CHECK(sample_percentile(sorted, 0, 0.5) == 0.0f);
+  CHECK(sample_percentile(sorted, 1, 0.99) == 1.0f);
+  CHECK(sample_percentile(sorted, 10, 0.0) == 1.0f);
+  CHECK(sample_percentile(sorted, 10, 0.5) == 5.0f);
+  CHECK(sample_percentile(sorted, 10, 1.0) == 10.0f);
+}
+
+TEST_CASE("self_stats_read_io counts reads of the calling thread") {
+  size_t syscalls_before = 0;
+  size_t bytes_before = 0;
+  if (!self_stats_read_io(syscalls_before, bytes_before)) {
+    MESSAGE("/proc/thread-self/io is not readable, skipped");
+    return;
+  }
+  char buf[64];
+  FILE *file = fopen("/proc/self/stat", "r");
+  REQUIRE(file);
+  CHECK(fread(buf, 1, sizeof(buf), file) > 0);
+  fclose(file);
+
+  size_t syscalls_after = 0;
+  size_t bytes_after = 0;
+  REQUIRE(self_stats_read_io(syscalls_after, bytes_after));
+  CHECK(syscalls_after > syscalls_before);
+  CHECK(bytes_after >= bytes_before + sizeof(buf));
+  CHECK(self_stats_thread_cpu_ns() > 0);
+}
+
+TEST_CASE("Gathering fills the self stats") {
+  char root[] = "/tmp/prock_self_XXXXXX";
+  REQUIRE(mkdtemp(root));
+  ProcFixtureOptions options = proc_fixture_default_options();
+  options.processes = 16;
+  REQUIRE(proc_fixture_write(root, options));
+  const char *old_root = g_proc_root;
+  g_proc_root = root;
+
+  const size_t gathers = g_self_stats.gathers.load();
+  const size_t total = g_self_stats.gather_phases[eGatherPhase_Total].count;
+  const size_t dropped = g_self_stats.snapshots_dropped.load();
+  g_self_stats.watching.store(true);
+
+  Sync sync{};
+  sync.update_period.store(0.001f);
+  GatheringState gathering_state = {};
+  gather(gathering_state, sync);
+  CHECK(g_self_stats.gathers.load() == gathers + 1);
+  CHECK(g_self_stats.gather_phases[eGatherPhase_Total].count == total + 1);
+  CHECK(g_self_stats.read_syscalls.load() > 0);
+  CHECK(g_self_stats.read_bytes.load() > 0);
+  CHECK(g_self_stats.gathering_cpu_ns.load() > 0);
+
+  // A full queue drops what gather() makes
+  UpdateSnapshot snapshot = {};
+  while (sync.update_queue.push(snapshot)) {
+  }
+  gather(gathering_state, sync);
+  CHECK(g_self_stats.snapshots_dropped.load() == dropped + 1);
+
+  g_self_stats.watching.store(false);
+  while (sync.update_queue.pop(snapshot)) {
+    snapshot.owner_arena.destroy();
+  }
+  g_proc_root = old_root;
+  CHECK(proc_fixture_remove(root));
+}
+
+TEST_CASE("Gathers start on a grid of the update period") {
+  char root[] = "/tmp/prock_grid_XXXXXX";
+  REQUIRE(mkdtemp(root));
+  ProcFixtureOptions options = proc_fixture_default_options();
+  options.processes = 4;
+  REQUIRE(proc_fixture_write(root, options));
+  const char *old_root = g_proc_root;
+  g_proc_root = root;
+
+  constexpr float PERIOD = 0.05f;
+  const auto period = std::chrono::duration_cast<SteadyClock::duration>(
+      Seconds{PERIOD});
+  Sync sync{};
+  sync.update_period.store(PERIOD);
+  GatheringState gathering_state = {};
+  UpdateSnapshot snapshot = {};
+  const auto drain = [&sync, &snapshot] {
+    while (sync.update_queue.pop(snapshot)) {
+      snapshot.owner_arena.destroy();
+    }
+  };
+
+  gather(gathering_state, sync);
+  const SteadyTimePoint grid_at = gathering_state.next_at;
+  REQUIRE(grid_at != SteadyTimePoint{});
+  drain();
+  for (int i = 1; i <= 3; ++i) {
+    gather(gathering_state, sync);
+    // The time gathering took doesn't move the grid
+    CHECK(gathering_state.next_at == grid_at + i * period);
+    REQUIRE(sync.update_queue.pop(snapshot));
+    CHECK(snapshot.at >= grid_at + (i - 1) * period);
+    snapshot.owner_arena.destroy();
+  }
+
+  // Starting 2.5 periods late skips the 2 slots in between
+  const size_t missed = g_self_stats.missed_periods.load();
+  usleep(static_cast<useconds_t>(PERIOD * 3.5f * 1e6f));
+  gather(gathering_state, sync);
+  CHECK(g_self_stats.missed_periods.load() >= missed + 2);
+  CHECK(gathering_state.next_at > SteadyClock::now() - period);
+  CHECK((gathering_state.next_at - grid_at) % period ==
+        SteadyClock::duration::zero());
+  drain();
+
+  // A new period starts a new grid
+  sync.update_period.store(PERIOD * 2);
+  gather(gathering_state, sync);
+  CHECK(gathering_state.next_period == PERIOD * 2);
+  drain();
+
+  // Resuming after a pause at the same period is neither late nor missed
+  sync.update_period.store(0.0f);
+  std::thread pause{[&sync, &gathering_state] {
+    gather(gathering_state, sync);
+  }};
+  usleep(static_cast<useconds_t>(PERIOD * 4 * 1e6f));
+  const size_t missed_before_resume = g_self_stats.missed_periods.load();
+  {
+    std::lock_guard<std::mutex> lock(sync.quit_mutex);
+    sync.update_period.store(PERIOD * 2);
+  }
+  sync.quit_cv.notify_one();
+  pause.join();
+  CHECK(g_self_stats.missed_periods.load() == missed_before_resume);
+  CHECK(gathering_state.next_at > SteadyClock::now());
+  drain();
+
+  g_proc_root = old_root;
+  CHECK(proc_fixture_remove(root));
+}
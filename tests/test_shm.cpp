@@ -0,0 +1,154 @@
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include "prock_shm.h"
+#include "shm_publisher.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+// ============================================================================
+// Shared Memory Tests
+// ============================================================================
+
+namespace {
+
+State make_state(BumpArena &arena) {
+  State state = {};
+  state.update_count = 2;
+  state.snapshot =
+      SnapshotBuilder(arena)
+          .add(1, 0, "init", 'S', 0.5, 0.0, 4096)
+          .add(20, 1, "busy", 'R', 80.0, 10.0, 8192)
+          .add(30, 1, "a_process_with_a_very_long_name_indeed", 'S')
+          .add(40, 1, "idle", 'S')
+          .cpus(3)
+          .mem(1000, 400)
+          .build();
+  return state;
+}
+
+std::string shm_name(const char *test) {
+  return "/prock_" + std::string(test) + "_" + std::to_string(getpid());
+}
+
+} // namespace
+
+TEST_CASE("Shared memory snapshot") {
+  BumpArena arena = BumpArena::create();
+  State state = make_state(arena);
+  const std::string name = shm_name("snapshot");
+  ShmPublisher publisher = {};
+  REQUIRE(shm_publisher_open(publisher, name.c_str(), 4, 3));
+
+  prock_shm_reader reader;
+  REQUIRE(prock_shm_open(&reader, name.c_str()) == 0);
+  prock_shm_system system;
+  prock_shm_cpu cpus[8];
+  prock_shm_process processes[8];
+  CHECK(prock_shm_read(&reader, &system, cpus, 8, processes, 8) == -1);
+
+  // Rates are not known after the first update
+  state.update_count = 1;
+  shm_publish(publisher, state);
+  CHECK(prock_shm_read(&reader, &system, cpus, 8, processes, 8) == -1);
+
+  state.update_count = 2;
+  shm_publish(publisher, state);
+  CHECK(reader.header->published == 1);
+  REQUIRE(prock_shm_read(&reader, &system, cpus, 8, processes, 8) == 3);
+  CHECK(system.cpu_perc == 10.0);
+  CHECK(system.mem_total_kb == 1000);
+  CHECK(system.mem_available_kb == 400);
+  CHECK(system.cpu_count == 2);
+  CHECK(cpus[1].total_perc == 30.0);
+  CHECK(cpus[1].kernel_perc == 3.0);
+  CHECK(system.process_count == 3);
+  CHECK(system.total_processes == 4);
+  CHECK(processes[1].pid == 20);
+  CHECK(processes[1].ppid == 1);
+  CHECK(processes[1].state == 'R');
+  CHECK(std::string(processes[1].comm) == "busy");
+  CHECK(processes[1].cpu_user_perc == 80.0);
+  CHECK(processes[1].mem_resident_bytes == 8192.0);
+  CHECK(std::string(processes[2].comm) == "a_process_with_a_very_long_name");
+
+  // The caller's room limits the copy
+  CHECK(prock_shm_read(&reader, &system, nullptr, 0, processes, 1) == 1);
+  CHECK(processes[0].pid == 1);
+
+  // The next snapshot goes to the other buffer
+  state.snapshot.cpu_perc.total.data[0] = 50.0;
+  shm_publish(publisher, state);
+  CHECK(reader.header->published == 2);
+  CHECK(prock_shm_read(&reader, &system, nullptr, 0, nullptr, 0) == 0);
+  CHECK(system.cpu_perc == 50.0);
+
+  prock_shm_close(&reader);
+  shm_publisher_close(publisher);
+  CHECK(prock_shm_open(&reader, name.c_str()) == -1);
+  arena.destroy();
+}
+
+TEST_CASE("Shared memory rejects other objects") {
+  const std::string name = shm_name("other");
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+  REQUIRE(fd >= 0);
+  REQUIRE(ftruncate(fd, 4096) == 0);
+  close(fd);
+  prock_shm_reader reader;
+  CHECK(prock_shm_open(&reader, name.c_str()) == -1);
+  CHECK(errno == EPROTO);
+  shm_unlink(name.c_str());
+}
+
+TEST_CASE("Shared memory readers never see a torn snapshot") {
+  BumpArena arena = BumpArena::create();
+  State state = make_state(arena);
+  const std::string name = shm_name("torn");
+  ShmPublisher publisher = {};
+  REQUIRE(shm_publisher_open(publisher, name.c_str(), 4, 4));
+
+  // Every value of a snapshot is its number
+  std::atomic<bool> done{false};
+  std::thread writer{[&] {
+    for (int i = 1; i <= 20000; ++i) {
+      state.snapshot.cpu_perc.total.data[0] = i;
+      for (size_t p = 0; p < state.snapshot.derived_stats.size; ++p) {
+        state.snapshot.derived_stats.data[p].cpu_user_perc = i;
+      }
+      shm_publish(publisher, state);
+    }
+    done.store(true);
+  }};
+
+  prock_shm_reader reader;
+  REQUIRE(prock_shm_open(&reader, name.c_str()) == 0);
+  int reads = 0;
+  int torn = 0;
+  double last = 0;
+  while (!done.load() || reads == 0) {
+    prock_shm_system system;
+    prock_shm_process processes[4];
+    if (prock_shm_read(&reader, &system, nullptr, 0, processes, 4) != 4) {
+      continue;
+    }
+    ++reads;
+    for (const prock_shm_process &process : processes) {
+      torn += process.cpu_user_perc != system.cpu_perc;
+    }
+    torn += system.cpu_perc < last;
+    last = system.cpu_perc;
+  }
+  writer.join();
+  CHECK(reads > 0);
+  CHECK(torn == 0);
+
+  prock_shm_close(&reader);
+  shm_publisher_close(publisher);
+  arena.destroy();
+}
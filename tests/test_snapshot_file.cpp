@@ -0,0 +1,218 @@
+#include "doctest.h"
+
+#include "sources/snapshot_file.h"
+#include "sources/sync.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// ============================================================================
+// Snapshot File Tests
+// ============================================================================
+
+namespace {
+
+struct TempPath {
+  char path[32] = "/tmp/prock_test_XXXXXX";
+  TempPath() { close(mkstemp(path)); }
+  ~TempPath() { unlink(path); }
+};
+
+// Snapshot `n` of a made up host: processes come and go, pids get reused
+UpdateSnapshot make_snapshot(const int n) {
+  UpdateSnapshot res = {};
+  std::vector<ProcessStat> stats;
+  for (int pid = 1; pid <= 300; ++pid) {
+    if (pid % 7 == 0 && (n / 10) % 2 == 1) continue; // exit and come back
+    ProcessStat stat = {};
+    stat.pid = pid;
+    stat.comm = pid % 11 == 0 && n > 50 ? "renamed" : "worker";
+    stat.state = pid % 3 == 0 ? 'R' : 'S';
+    stat.starttime = pid % 7 == 0 ? 1000 + n / 10 : 1000;
+    stat.utime = static_cast<ulong>(pid * n);
+    stat.stime = static_cast<ulong>(pid % 5 == 0 ? n : 0);
+    stat.statm_resident = 100 + pid + (pid == 42 ? n * 1000 : 0);
+    stat.io_read_bytes = static_cast<ulonglong>(n) << 20;
+    stat.net_send_bytes = pid == 1 ? 1ull << 40 : 0;
+    stats.push_back(stat);
+  }
+
+  res.stats = Array<ProcessStat>::create(res.owner_arena, stats.size());
+  for (size_t i = 0; i < stats.size(); ++i) {
+    res.stats.data[i] = stats[i];
+    res.stats.data[i].comm = res.owner_arena.alloc_string_copy(stats[i].comm);
+  }
+  res.cpu_stats = Array<CpuCoreStat>::create(res.owner_arena, 5);
+  for (size_t c = 0; c < res.cpu_stats.size; ++c) {
+    res.cpu_stats.data[c].user = n * 10 + c;
+    res.cpu_stats.data[c].idle = n * 90;
+  }
+  res.mem_info.mem_total = 16 << 20;
+  res.mem_info.mem_available = 8 << 20 | n;
+  res.disk_io_stats.sectors_read = n * 8;
+  res.net_io_stats.bytes_received = n * 1500;
+  res.at = SteadyTimePoint{std::chrono::milliseconds{500 * n + 1}};
+  res.system_time = SystemTimePoint{std::chrono::seconds{1700000000 + n}};
+  return res;
+}
+
+void check_snapshot(const UpdateSnapshot &actual, const int n) {
+  UpdateSnapshot expected = make_snapshot(n);
+  REQUIRE(actual.stats.size == expected.stats.size);
+  for (size_t i = 0; i < expected.stats.size; ++i) {
+    ProcessStat a = actual.stats.data[i];
+    ProcessStat e = expected.stats.data[i];
+    CHECK(std::string(a.comm) == e.comm);
+    a.comm = e.comm = nullptr;
+    CHECK(memcmp(&a, &e, sizeof(ProcessStat)) == 0);
+  }
+  REQUIRE(actual.cpu_stats.size == expected.cpu_stats.size);
+  CHECK(memcmp(actual.cpu_stats.data, expected.cpu_stats.data,
+               expected.cpu_stats.size * sizeof(CpuCoreStat)) == 0);
+  CHECK(actual.mem_info.mem_available == expected.mem_info.mem_available);
+  CHECK(actual.disk_io_stats.sectors_read ==
+        expected.disk_io_stats.sectors_read);
+  CHECK(actual.net_io_stats.bytes_received ==
+        expected.net_io_stats.bytes_received);
+  CHECK(actual.at == expected.at);
+  CHECK(actual.system_time == expected.system_time);
+  CHECK(actual.thread_snapshots.size == 0);
+  expected.owner_arena.destroy();
+}
+
+void record(const char *path, const int count, const bool close = true) {
+  SnapshotWriter writer = {};
+  REQUIRE(snapshot_writer_open(writer, path, 100, 4096));
+  for (int n = 0; n < count; ++n) {
+    UpdateSnapshot snapshot = make_snapshot(n);
+    REQUIRE(snapshot_writer_write(writer, snapshot));
+    snapshot.owner_arena.destroy();
+  }
+  if (close) {
+    snapshot_writer_close(writer);
+  } else {
+    // Killed recorder: records are flushed, the index is never written
+    fclose(writer.file);
+    writer.index_arena.destroy();
+    snapshot_codec_destroy(writer.codec);
+    ArenaSlab::release(writer.buffer);
+  }
+}
+
+} // namespace
+
+TEST_CASE("Snapshot file round trip") {
+  TempPath tmp;
+  constexpr int COUNT = 150; // a few keyframe intervals
+  record(tmp.path, COUNT);
+
+  SnapshotReader reader = {};
+  REQUIRE(snapshot_reader_open(reader, tmp.path));
+  CHECK(reader.header->ticks_in_second == 100);
+  CHECK(reader.header->mem_page_size == 4096);
+  REQUIRE(reader.index.size == COUNT);
+
+  SUBCASE("sequential") {
+    for (int n = 0; n < COUNT; ++n) {
+      UpdateSnapshot snapshot = {};
+      REQUIRE(snapshot_reader_read(reader, n, snapshot));
+      check_snapshot(snapshot, n);
+      snapshot.owner_arena.destroy();
+    }
+  }
+
+  SUBCASE("seek") {
+    for (const int n : {137, 3, 64, 70, 69, 149, 0}) {
+      UpdateSnapshot snapshot = {};
+      REQUIRE(snapshot_reader_read(reader, n, snapshot));
+      check_snapshot(snapshot, n);
+      snapshot.owner_arena.destroy();
+    }
+    UpdateSnapshot snapshot = {};
+    CHECK_FALSE(snapshot_reader_read(reader, COUNT, snapshot));
+  }
+
+  snapshot_reader_close(reader);
+}
+
+TEST_CASE("Snapshot file stores unchanged processes compactly") {
+  TempPath tmp;
+  record(tmp.path, 2);
+
+  SnapshotReader reader = {};
+  REQUIRE(snapshot_reader_open(reader, tmp.path));
+  REQUIRE(reader.index.size == 2);
+  const auto *delta = reinterpret_cast<const SnapshotRecordHeader *>(
+      reader.data + reader.index.data[1].offset);
+  CHECK_FALSE(delta->keyframe);
+  // A handful of changed counters instead of the whole ProcessStat
+  CHECK(delta->payload_bytes < delta->process_count * 24);
+  snapshot_reader_close(reader);
+}
+
+TEST_CASE("Snapshot file without index is still readable") {
+  TempPath tmp;
+  record(tmp.path, 20, false);
+
+  // Cut the last record in half
+  FILE *f = fopen(tmp.path, "r+");
+  REQUIRE(f);
+  fseek(f, 0, SEEK_END);
+  REQUIRE(ftruncate(fileno(f), ftell(f) - 100) == 0);
+  fclose(f);
+
+  SnapshotReader reader = {};
+  REQUIRE(snapshot_reader_open(reader, tmp.path));
+  REQUIRE(reader.index.size == 19);
+  UpdateSnapshot snapshot = {};
+  REQUIRE(snapshot_reader_read(reader, 18, snapshot));
+  check_snapshot(snapshot, 18);
+  snapshot.owner_arena.destroy();
+  snapshot_reader_close(reader);
+}
+
+TEST_CASE("Snapshot file rejects other files") {
+  TempPath tmp;
+  FILE *f = fopen(tmp.path, "w");
+  REQUIRE(f);
+  fputs("definitely not a prock recording, just some text", f);
+  fclose(f);
+
+  SnapshotReader reader = {};
+  CHECK_FALSE(snapshot_reader_open(reader, tmp.path));
+  CHECK_FALSE(snapshot_reader_open(reader, "/nonexistent/recording"));
+}
+
+TEST_CASE("Replay steps through a paused recording") {
+  TempPath tmp;
+  record(tmp.path, 3);
+
+  Sync sync = {};
+  ReplayState state = {};
+  REQUIRE(snapshot_reader_open(state.reader, tmp.path));
+  sync.replay.active.store(true);
+  sync.replay.speed.store(0.0f);
+  sync.replay.steps.store(2);
+
+  UpdateSnapshot snapshot = {};
+  for (int n = 0; n < 2; ++n) {
+    replay(state, sync);
+    REQUIRE(sync.update_queue.pop(snapshot));
+    check_snapshot(snapshot, n);
+    CHECK(sync.replay.position.load() == static_cast<size_t>(n + 1));
+    snapshot.owner_arena.destroy();
+  }
+  CHECK(sync.replay.steps.load() == 0);
+
+  // Unpaused: the next snapshot is due 0.5 s / 1000 after the last one
+  sync.replay.speed.store(1000.0f);
+  replay(state, sync);
+  REQUIRE(sync.update_queue.pop(snapshot));
+  check_snapshot(snapshot, 2);
+  snapshot.owner_arena.destroy();
+  CHECK_FALSE(sync.update_queue.pop(snapshot));
+
+  snapshot_reader_close(state.reader);
+}
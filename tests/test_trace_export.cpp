@@ -0,0 +1,113 @@
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include "trace_export.h"
+
+#include <string>
+
+// ============================================================================
+// Trace Export Tests
+// ============================================================================
+
+namespace {
+
+std::string str(const String &text) {
+  return std::string(text.data, text.length);
+}
+
+size_t count(const std::string &text, const std::string &what) {
+  size_t res = 0;
+  for (size_t pos = text.find(what); pos != std::string::npos;
+       pos = text.find(what, pos + what.size())) {
+    ++res;
+  }
+  return res;
+}
+
+} // namespace
+
+TEST_CASE("Trace export") {
+  BumpArena arena = BumpArena::create();
+  TraceExporter exporter = {};
+  std::string trace = str(trace_export_begin(exporter));
+  CHECK(trace.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+  CHECK(trace.find("\"name\":\"System\"") != std::string::npos);
+
+  StateSnapshot first = SnapshotBuilder(arena)
+                            .add(1, 0, "init", 'S', 1.0, 0.5, 4096)
+                            .add(20, 1, "sh \"quoted\"", 'S', 2.0)
+                            .add(30, 1, "gone", 'S')
+                            .build();
+  const std::string update1 = str(trace_export_update(exporter, first, 10.0));
+  trace += update1;
+
+  SUBCASE("first update starts every track") {
+    CHECK(count(update1, "\"ph\":\"B\"") == 3);
+    CHECK(count(update1, "\"name\":\"process_name\"") == 3);
+    CHECK(count(update1, "\"name\":\"thread_name\"") == 3);
+    CHECK(update1.find("{\"ph\":\"B\",\"pid\":20,\"tid\":20,\"ts\":10000000,"
+                       "\"name\":\"sh \\\"quoted\\\"\"}") !=
+          std::string::npos);
+    CHECK(update1.find("{\"ph\":\"C\",\"pid\":1,\"ts\":10000000,\"name\":"
+                       "\"CPU %\",\"args\":{\"cpu\":1.5}}") !=
+          std::string::npos);
+    CHECK(update1.find("\"name\":\"RSS bytes\",\"args\":{\"rss\":4096}") !=
+          std::string::npos);
+  }
+
+  SUBCASE("later updates only write changes") {
+    StateSnapshot second = SnapshotBuilder(arena)
+                               .add(1, 0, "init", 'S', 1.0, 0.5, 4096)
+                               .add(20, 1, "sh \"quoted\"", 'S', 7.0)
+                               .add(40, 1, "new", 'R', 3.0)
+                               .build();
+    const std::string update2 =
+        str(trace_export_update(exporter, second, 11.0));
+    // 30 ended, 40 started, only 20 and 40 have new values
+    CHECK(update2.find(
+              "{\"ph\":\"E\",\"pid\":30,\"tid\":30,\"ts\":11000000}") !=
+          std::string::npos);
+    CHECK(count(update2, "\"ph\":\"B\"") == 1);
+    CHECK(update2.find("\"pid\":40,\"tid\":40,\"ts\":11000000,\"name\":"
+                       "\"new\"") != std::string::npos);
+    CHECK(count(update2, "\"pid\":1,") == 0);
+    CHECK(update2.find("\"pid\":20,\"ts\":11000000,\"name\":\"CPU %\","
+                       "\"args\":{\"cpu\":7}") != std::string::npos);
+    CHECK(count(update2, "\"System\"") == 0);
+    CHECK(count(update2, "\"pid\":0,") == 0);
+    trace += update2;
+
+    // A reused pid is a new process
+    second.stats.data[1].starttime = 99;
+    const std::string update3 =
+        str(trace_export_update(exporter, second, 12.0));
+    CHECK(update3.find(
+              "{\"ph\":\"E\",\"pid\":20,\"tid\":20,\"ts\":12000000}") !=
+          std::string::npos);
+    CHECK(count(update3, "\"ph\":\"B\"") == 1);
+    CHECK(count(update3, "\"name\":\"process_name\"") == 1);
+    trace += update3;
+  }
+
+  SUBCASE("rotation starts a whole new trace") {
+    const std::string end = str(trace_export_end(exporter));
+    CHECK(count(end, "\"ph\":\"E\"") == 3);
+    CHECK(end.find("\"ts\":10000000") != std::string::npos);
+    const std::string restart = str(trace_export_begin(exporter));
+    CHECK(count(restart, "\"ph\":\"B\"") == 0);
+    const std::string update2 = str(trace_export_update(exporter, first, 11.0));
+    CHECK(count(update2, "\"ph\":\"B\"") == 3);
+    CHECK(count(update2, "\"name\":\"CPU %\"") == 4);
+    trace = restart + update2;
+  }
+
+  trace += str(trace_export_end(exporter));
+  CHECK(trace.substr(trace.size() - 4) == "\n]}\n");
+  // Every slice is closed and the events are comma separated
+  CHECK(count(trace, "\"ph\":\"B\"") == count(trace, "\"ph\":\"E\""));
+  CHECK(count(trace, "}{") == 0);
+  CHECK(count(trace, "},\n{") + 1 == count(trace, "\n{\"ph\""));
+
+  trace_export_destroy(exporter);
+  arena.destroy();
+}
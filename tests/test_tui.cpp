@@ -0,0 +1,227 @@
+#include "doctest.h"
+#include "test_helpers.h"
+
+#include "tui/screen.h"
+#include "tui/tui.h"
+
+#include <string>
+
+// ============================================================================
+// Terminal UI Tests
+// ============================================================================
+
+namespace {
+
+std::string flush(TuiScreen &screen) {
+  const String out = tui_screen_flush(screen);
+  return std::string(out.data, out.length);
+}
+
+std::string row_text(const TuiScreen &screen, const int y) {
+  std::string res;
+  for (int x = 0; x < screen.width; ++x) {
+    const uint32_t ch = screen.cells[y * screen.width + x].ch;
+    res += ch < 0x80 ? static_cast<char>(ch) : '#';
+  }
+  return res;
+}
+
+State make_state(BumpArena &arena) {
+  State state = {};
+  state.snapshot_arena = BumpArena::create();
+  state.snapshot = SnapshotBuilder(arena)
+                       .add(1, 0, "init", 'S', 1.0)
+                       .add(20, 1, "sshd", 'S', 2.0, 0.0, 8192)
+                       .add(30, 20, "bash", 'S', 0.5)
+                       .add(40, 30, "make", 'R', 50.0, 10.0, 4096)
+                       .add(50, 1, "cron", 'S')
+                       .build();
+  return state;
+}
+
+} // namespace
+
+TEST_CASE("TUI screen flush") {
+  TuiScreen screen = {};
+  tui_screen_resize(screen, 10, 3);
+
+  SUBCASE("the first flush clears and draws") {
+    tui_put(screen, 0, 0, 10, eTuiStyle_Normal, "hello");
+    const std::string out = flush(screen);
+    CHECK(out.find("\x1b[2J") != std::string::npos);
+    CHECK(out.find("hello") != std::string::npos);
+  }
+
+  SUBCASE("nothing changed, nothing written") {
+    tui_put(screen, 0, 0, 10, eTuiStyle_Normal, "hello");
+    flush(screen);
+    tui_screen_clear(screen);
+    tui_put(screen, 0, 0, 10, eTuiStyle_Normal, "hello");
+    CHECK(flush(screen).empty());
+  }
+
+  SUBCASE("a changed cell costs a cursor move and the cell") {
+    tui_put(screen, 0, 1, 10, eTuiStyle_Normal, "12345");
+    flush(screen);
+    tui_put(screen, 0, 1, 10, eTuiStyle_Normal, "12945");
+    CHECK(flush(screen) == "\x1b[2;3H\x1b[0m9");
+  }
+
+  SUBCASE("text is cut at the edge") {
+    CHECK(tui_put(screen, 7, 2, 10, eTuiStyle_Normal, "abcdef") == 3);
+    CHECK(row_text(screen, 2) == "       abc");
+    CHECK(tui_put(screen, 0, 3, 10, eTuiStyle_Normal, "x") == 0);
+  }
+
+  SUBCASE("UTF-8 is one cell per code point, control characters are not") {
+    tui_put(screen, 0, 0, 10, eTuiStyle_Normal, "\xc3\xa9t\xc3\xa9\x1b");
+    CHECK(screen.cells[0].ch == 0xe9);
+    CHECK(screen.cells[1].ch == 't');
+    CHECK(screen.cells[2].ch == 0xe9);
+    CHECK(screen.cells[3].ch == '?');
+    CHECK(flush(screen).find("\xc3\xa9t\xc3\xa9?") != std::string::npos);
+  }
+
+  tui_screen_destroy(screen);
+}
+
+TEST_CASE("TUI sparkline") {
+  TuiScreen screen = {};
+  tui_screen_resize(screen, 2, 2);
+
+  SUBCASE("two values per column, newest on the right") {
+    const float values[] = {100, 0, 25, 50};
+    tui_sparkline(screen, 0, 0, 2, 2, eTuiStyle_Cpu, values, 4, 100);
+    // Left column: 100 fills both rows on the left dots, 0 nothing
+    CHECK(screen.cells[0].ch == 0x2800 + (0x40 | 0x04 | 0x02 | 0x01));
+    CHECK(screen.cells[2].ch == 0x2800 + (0x40 | 0x04 | 0x02 | 0x01));
+    // Right column: 25 is two dots on the left, 50 a full bottom row
+    CHECK(screen.cells[1].ch == ' ');
+    CHECK(screen.cells[3].ch ==
+          0x2800 + (0x40 | 0x04) + (0x80 | 0x20 | 0x10 | 0x08));
+    CHECK(screen.cells[3].style == eTuiStyle_Cpu);
+  }
+
+  SUBCASE("small values still show") {
+    const float values[] = {0.1f};
+    tui_sparkline(screen, 0, 0, 2, 2, eTuiStyle_Cpu, values, 1, 100);
+    CHECK(screen.cells[3].ch == 0x2800 + 0x80);
+    CHECK(screen.cells[2].ch == ' ');
+  }
+
+  tui_screen_destroy(screen);
+}
+
+TEST_CASE("TUI key parsing") {
+  int key = eTuiKey_None;
+  CHECK(tui_parse_key("q", 1, key) == 1);
+  CHECK(key == 'q');
+  CHECK(tui_parse_key("\x1b[A", 3, key) == 3);
+  CHECK(key == eTuiKey_Up);
+  CHECK(tui_parse_key("\x1bOB", 3, key) == 3);
+  CHECK(key == eTuiKey_Down);
+  CHECK(tui_parse_key("\x1b[6~j", 5, key) == 4);
+  CHECK(key == eTuiKey_PageDown);
+  CHECK(tui_parse_key("\x1b[1~", 4, key) == 4);
+  CHECK(key == eTuiKey_Home);
+  CHECK(tui_parse_key("\x1b[F", 3, key) == 3);
+  CHECK(key == eTuiKey_End);
+  CHECK(tui_parse_key("\n", 1, key) == 1);
+  CHECK(key == eTuiKey_Enter);
+  CHECK(tui_parse_key("\x1b", 1, key) == 1);
+  CHECK(key == eTuiKey_Escape);
+  // Not a whole sequence yet
+  CHECK(tui_parse_key("\x1b[5", 3, key) == 0);
+}
+
+TEST_CASE("TUI process table") {
+  BumpArena arena = BumpArena::create();
+  State state = make_state(arena);
+  TuiState tui;
+  tui_init(tui);
+  tui_update(tui, state);
+
+  REQUIRE(tui.table.lines.size == 5);
+  // Busiest first
+  CHECK(tui.table.lines.data[0].pid == 40);
+  CHECK(tui.table.lines.data[1].pid == 20);
+
+  SUBCASE("sort keys") {
+    CHECK(tui_handle_key(tui, state, 'N'));
+    CHECK(tui.table.lines.data[0].pid == 1);
+    CHECK(tui.table.lines.data[4].pid == 50);
+    tui_handle_key(tui, state, 'r');
+    CHECK(tui.table.lines.data[0].pid == 50);
+    tui_handle_key(tui, state, 'M');
+    CHECK(tui.table.lines.data[0].pid == 20);
+    tui_handle_key(tui, state, '>');
+    CHECK(tui.table.sorted_by == eBriefTableColumnId_IoReadKbPerSec);
+  }
+
+  SUBCASE("tree mode") {
+    tui_handle_key(tui, state, 't');
+    CHECK(tui.table.tree_mode);
+    const int order[] = {1, 20, 30, 40, 50};
+    const int depth[] = {0, 1, 2, 3, 1};
+    for (size_t i = 0; i < 5; ++i) {
+      CHECK(tui.table.lines.data[i].pid == order[i]);
+      CHECK(tui.table.lines.data[i].tree_depth == depth[i]);
+    }
+    // Sorting leaves it
+    tui_handle_key(tui, state, 'P');
+    CHECK_FALSE(tui.table.tree_mode);
+  }
+
+  SUBCASE("filter keeps ancestors in tree mode") {
+    tui_handle_key(tui, state, 't');
+    tui_handle_key(tui, state, '/');
+    CHECK(tui.editing_filter);
+    tui_handle_key(tui, state, 'M');
+    tui_handle_key(tui, state, 'a');
+    tui_handle_key(tui, state, 'K');
+    CHECK(std::string(tui.table.filter_text) == "MaK");
+    tui_handle_key(tui, state, eTuiKey_Enter);
+    CHECK_FALSE(tui.editing_filter);
+    const uint8_t states[] = {2, 2, 2, 1, 0};
+    for (size_t i = 0; i < 5; ++i) {
+      CHECK(tui.table.lines.data[i].filter_state == states[i]);
+    }
+    // Esc clears it
+    tui_handle_key(tui, state, eTuiKey_Escape);
+    CHECK(tui.table.lines.data[4].filter_state == 1);
+  }
+
+  SUBCASE("selection moves over visible lines") {
+    tui_handle_key(tui, state, 'N');
+    tui_handle_key(tui, state, eTuiKey_Down);
+    CHECK(tui.table.selected_pid == 1);
+    tui_handle_key(tui, state, 'j');
+    CHECK(tui.table.selected_pid == 20);
+    tui_handle_key(tui, state, eTuiKey_End);
+    CHECK(tui.table.selected_pid == 50);
+    tui_handle_key(tui, state, eTuiKey_Up);
+    CHECK(tui.table.selected_pid == 40);
+    tui_handle_key(tui, state, eTuiKey_Home);
+    CHECK(tui.table.selected_pid == 1);
+  }
+
+  SUBCASE("draw") {
+    TuiScreen screen = {};
+    tui_screen_resize(screen, 60, 12);
+    tui_draw(screen, tui, state);
+    CHECK(row_text(screen, 0).find("5 processes") != std::string::npos);
+    // Narrow screens drop I/O columns from the right
+    const std::string header = row_text(screen, 5);
+    CHECK(header.find("CPU%v") != std::string::npos);
+    CHECK(header.find("READ") != std::string::npos);
+    CHECK(header.find("WRITE") == std::string::npos);
+    CHECK(row_text(screen, 6).find("make") != std::string::npos);
+    CHECK(row_text(screen, 6).find("60.0") != std::string::npos);
+    CHECK(tui.table_rows == 5);
+    tui_screen_destroy(screen);
+  }
+
+  CHECK_FALSE(tui_handle_key(tui, state, 'q'));
+  state.snapshot_arena.destroy();
+  arena.destroy();
+}
@@ -13,6 +13,8 @@ using ImPlotShadedFlags = int;
 #include "views/common_charts.h"
 #include "views/common.h"
 
+#include <string>
+
 // ============================================================================
 // binary_search_pid Tests
 // ============================================================================
@@ -386,6 +388,143 @@ TEST_CASE("state_snapshot_update") {
           doctest::Approx(50.0));
   }
 
+  SUBCASE("rates use the read times of the processes") {
+    State old_state = {};
+    old_state.system.ticks_in_second = 100;
+    old_state.system.mem_page_size = 4096;
+
+    // Read 0.1 s and 0.9 s into a cycle, then 1 s later in the next one
+    ProcessStat old_procs[2] = {};
+    old_procs[0].pid = 100;
+    old_procs[0].read_at = SteadyTimePoint{} + std::chrono::milliseconds(100);
+    old_procs[1].pid = 200;
+    old_procs[1].read_at = SteadyTimePoint{} + std::chrono::milliseconds(900);
+    ProcessDerivedStat old_derived[2] = {};
+
+    old_state.snapshot.stats.data = old_procs;
+    old_state.snapshot.stats.size = 2;
+    old_state.snapshot.derived_stats.data = old_derived;
+    old_state.snapshot.derived_stats.size = 2;
+    old_state.snapshot.at = SteadyTimePoint{} + std::chrono::seconds(1);
+
+    UpdateSnapshot update = {};
+    ProcessStat new_procs[2] = {old_procs[0], old_procs[1]};
+    for (ProcessStat &proc : new_procs) {
+      proc.read_at += std::chrono::seconds(1);
+      proc.utime = 50;
+      proc.io_read_bytes = 102400;
+    }
+    // The next cycle ran 0.5 s late, snapshots are 1.5 s apart
+    update.stats.data = new_procs;
+    update.stats.size = 2;
+    update.at = old_state.snapshot.at + std::chrono::milliseconds(1500);
+
+    StateSnapshot result = state_snapshot_update(arena, old_state, update);
+
+    REQUIRE(result.derived_stats.size == 2);
+    for (size_t i = 0; i < 2; ++i) {
+      CHECK(result.derived_stats.data[i].cpu_user_perc ==
+            doctest::Approx(50.0));
+      CHECK(result.derived_stats.data[i].io_read_kb_per_sec ==
+            doctest::Approx(100.0));
+    }
+
+    // Without read times, e.g. replayed, the snapshots' times are used
+    new_procs[0].read_at = {};
+    result = state_snapshot_update(arena, old_state, update);
+    CHECK(result.derived_stats.data[0].cpu_user_perc ==
+          doctest::Approx(50.0 / 1.5));
+    CHECK(result.derived_stats.data[1].cpu_user_perc ==
+          doctest::Approx(50.0));
+  }
+
+  SUBCASE("schedstat nanoseconds over ticks") {
+    ProcessStat old_proc = {};
+    old_proc.sched_run_ns = 1'000'000'000;
+    old_proc.sched_wait_ns = 500'000'000;
+    ProcessStat new_proc = old_proc;
+    // 0.25 s apart: 3 ticks are 12%, the nanoseconds say 14%
+    new_proc.utime = 2;
+    new_proc.stime = 1;
+    new_proc.sched_run_ns += 35'000'000;
+    new_proc.sched_wait_ns += 50'000'000;
+
+    StatCpuPerc perc = stat_cpu_perc(old_proc, new_proc, 0.25, 100);
+    CHECK(perc.user + perc.kernel == doctest::Approx(14.0));
+    CHECK(perc.kernel == doctest::Approx(14.0 / 3));
+    CHECK(perc.run_delay == doctest::Approx(20.0));
+
+    // No ticks yet, all of it counts as user time
+    new_proc.utime = 0;
+    new_proc.stime = 0;
+    perc = stat_cpu_perc(old_proc, new_proc, 0.25, 100);
+    CHECK(perc.user == doctest::Approx(14.0));
+    CHECK(perc.kernel == 0.0);
+
+    // A thread exited with its nanoseconds, the ticks kept them
+    new_proc.utime = 20;
+    perc = stat_cpu_perc(old_proc, new_proc, 0.25, 100);
+    CHECK(perc.user == doctest::Approx(80.0));
+    CHECK(perc.run_delay == doctest::Approx(20.0));
+
+    // Without schedstat only the ticks are there
+    old_proc.sched_run_ns = 0;
+    new_proc.sched_run_ns = 0;
+    perc = stat_cpu_perc(old_proc, new_proc, 0.25, 100);
+    CHECK(perc.user == doctest::Approx(80.0));
+    CHECK(perc.run_delay == 0.0);
+    CHECK(stat_cpu_perc(old_proc, new_proc, 0.0, 100).user == 0.0);
+  }
+
+  SUBCASE("context switches and faults") {
+    State old_state = {};
+    old_state.system.ticks_in_second = 100;
+    old_state.system.mem_page_size = 4096;
+
+    ProcessStat old_proc = {};
+    old_proc.pid = 100;
+    old_proc.minflt = 1000;
+    old_proc.majflt = 10;
+    old_proc.status.voluntary_ctxt_switches = 100;
+    old_proc.status.read_at = SteadyTimePoint{} + std::chrono::seconds(1);
+    ProcessDerivedStat old_derived = {};
+    old_derived.ctxsw_per_sec = 42;
+
+    old_state.snapshot.stats.data = &old_proc;
+    old_state.snapshot.stats.size = 1;
+    old_state.snapshot.derived_stats.data = &old_derived;
+    old_state.snapshot.derived_stats.size = 1;
+    old_state.snapshot.at = SteadyTimePoint{} + std::chrono::seconds(1);
+
+    UpdateSnapshot update = {};
+    ProcessStat new_proc = old_proc;
+    new_proc.minflt = 1500;
+    new_proc.majflt = 30;
+    new_proc.status.vm_hwm_kb = 2048;
+    new_proc.status.vm_swap_kb = 16;
+    update.stats.data = &new_proc;
+    update.stats.size = 1;
+    update.at = old_state.snapshot.at + std::chrono::seconds(2);
+
+    // Status not read again, the last rate holds
+    StateSnapshot result = state_snapshot_update(arena, old_state, update);
+    REQUIRE(result.derived_stats.size == 1);
+    const ProcessDerivedStat &derived = result.derived_stats.data[0];
+    CHECK(derived.ctxsw_per_sec == 42.0);
+    CHECK(derived.faults_per_sec == doctest::Approx(260.0));
+    CHECK(derived.major_faults_per_sec == doctest::Approx(10.0));
+    CHECK(derived.mem_peak_resident_bytes == 2048.0 * 1024);
+    CHECK(derived.mem_swap_bytes == 16.0 * 1024);
+
+    // Read again 4 s after the last read
+    new_proc.status.voluntary_ctxt_switches = 300;
+    new_proc.status.nonvoluntary_ctxt_switches = 100;
+    new_proc.status.read_at += std::chrono::seconds(4);
+    result = state_snapshot_update(arena, old_state, update);
+    CHECK(result.derived_stats.data[0].ctxsw_per_sec ==
+          doctest::Approx(75.0));
+  }
+
   SUBCASE("new process (not in old snapshot) gets zero CPU") {
     State old_state = {};
     old_state.system.ticks_in_second = 100;
@@ -492,3 +631,42 @@ TEST_CASE("state_snapshot_update") {
 
   arena.destroy();
 }
+
+// ============================================================================
+// state_summary Tests (host overview)
+// ============================================================================
+
+TEST_CASE("state_summary") {
+  BumpArena arena = BumpArena::create();
+  State state = {};
+
+  SUBCASE("empty state") {
+    const StateSummary summary = state_summary(state);
+    CHECK(summary.cpu_perc == 0.0);
+    CHECK(summary.top_pid == 0);
+  }
+
+  SUBCASE("busiest process and memory") {
+    state.snapshot = SnapshotBuilder(arena)
+                         .add(1, 0, "init", 'S', 1.0, 0.5)
+                         .add(20, 1, "make", 'R', 40.0, 30.0)
+                         .add(30, 1, "cc1", 'R', 60.0, 5.0)
+                         .build();
+    double cpu_total[] = {55.0};
+    state.snapshot.cpu_perc.total = {cpu_total, 1};
+    state.snapshot.mem_info.mem_total = 1000;
+    state.snapshot.mem_info.mem_available = 250;
+    state.snapshot.net_io_rate.recv_mb_per_sec = 2.5;
+
+    const StateSummary summary = state_summary(state);
+    CHECK(summary.cpu_perc == 55.0);
+    CHECK(summary.mem_used_kb == 750.0);
+    CHECK(summary.mem_total_kb == 1000.0);
+    CHECK(summary.net_io_rate.recv_mb_per_sec == 2.5);
+    CHECK(summary.top_pid == 20);
+    CHECK(std::string(summary.top_comm) == "make");
+    CHECK(summary.top_cpu_perc == doctest::Approx(70.0));
+  }
+
+  arena.destroy();
+}